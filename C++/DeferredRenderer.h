@@ -0,0 +1,161 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _DeferredRenderer_h_
+#define _DeferredRenderer_h_
+
+// Deferred rendering of an indexed mesh in two passes. The first pass rasterizes the triangles once
+// and writes for each pixel the id of the closest face and its barycentric coordinates, using the
+// same stencil, depth test and culling rules as renderScene with sigma=0. The second pass resolves any
+// per-vertex attribute from these buffers independently for each pixel, which avoids building a
+// triangle soup and does not require the attributes to be continuous across faces.
+
+#include "DifferentiableRenderer.h"
+#include "ParallelFor.h"
+
+// face id written in the pixels that are not covered by any triangle
+#define GBUFFER_NO_FACE 0xFFFFFFFFu
+
+inline void render_part_gbuffer(unsigned int face_id, unsigned int* face_ids, double* barycentrics, double* z_buffer, int y_begin, int y_end, double* xy1_to_bary, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height)
+{
+	double t[3];
+	double Z0y;
+	int x_begin, x_end;
+	int temp_x;
+	double Z;
+
+	if (y_begin < 0)
+		y_begin = 0;
+	if (y_end > height - 1)
+		y_end = height - 1;
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		t[0] = 0; t[1] = y; t[2] = 1;
+		Z0y = dot_prod(xy1_to_Z, t);
+
+		// compute beginning and ending of the rasterized line
+
+		x_begin = 0;
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
+		if (temp_x > x_begin) x_begin = temp_x;
+
+		x_end = width - 1;
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
+		if (temp_x < x_end) x_end = temp_x;
+
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			Z = Z0y + xy1_to_Z[0] * x;
+			if (Z < z_buffer[indx])
+			{
+				z_buffer[indx] = Z;
+				face_ids[indx] = face_id;
+				for (int k = 0; k < 3; k++)
+					barycentrics[3 * indx + k] = xy1_to_bary[3 * k] * x + xy1_to_bary[3 * k + 1] * y + xy1_to_bary[3 * k + 2];
+			}
+			indx++;
+		}
+	}
+}
+
+void rasterize_triangle_gbuffer(double Vxy[][2], double Zvertex[3], unsigned int face_id, unsigned int* face_ids, double* barycentrics, double* z_buffer, int height, int width)
+{
+	int     y_begin[2], y_end[2];
+	double  edge_eq[3][2];
+	double  bary_to_xy1[9];
+	double  xy1_to_bary[9];
+	double  xy1_to_Z[3];
+	int     left_edge_id[2], right_edge_id[2];
+
+	get_triangle_stencil_equations(Vxy, bary_to_xy1, xy1_to_bary, edge_eq, y_begin, y_end, left_edge_id, right_edge_id);
+	mul_vect_matrix3x3(xy1_to_Z, Zvertex, xy1_to_bary);
+	for (int k = 0; k < 2; k++)
+		render_part_gbuffer(face_id, face_ids, barycentrics, z_buffer, y_begin[k], y_end[k], xy1_to_bary, xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height);
+}
+
+void render_gbuffer(const unsigned int* faces, const double* ij, const double* depths, int nb_faces, int height, int width, bool clockwise, bool backface_culling, unsigned int* face_ids, double* barycentrics, double* z_buffer)
+{
+	// face_ids is height x width, barycentrics is height x width x 3 and z_buffer is height x width
+	if (height <= 0 || width <= 0)
+		throw "the image size should be positive";
+	size_t nb_pixels = (size_t)height * width;
+	fill(z_buffer, z_buffer + nb_pixels, numeric_limits<double>::infinity());
+	fill(face_ids, face_ids + nb_pixels, GBUFFER_NO_FACE);
+	fill(barycentrics, barycentrics + 3 * nb_pixels, 0.0);
+
+	for (int k = 0; k < nb_faces; k++)
+	{
+		const unsigned int* face = &faces[k * 3];
+		double face_ij[3][2];
+		double face_depths[3];
+		bool all_vertices_in_front = true;
+		for (int i = 0; i < 3; i++)
+		{
+			face_depths[i] = depths[face[i]];
+			if (face_depths[i] < 0)
+				all_vertices_in_front = false;
+			for (int j = 0; j < 2; j++)
+				face_ij[i][j] = ij[face[i] * 2 + j];
+		}
+		double signed_area = all_vertices_in_front ? signedArea(face_ij, clockwise) : 0;
+		if ((signed_area > 0) || (!backface_culling))
+			rasterize_triangle_gbuffer(face_ij, face_depths, k, face_ids, barycentrics, z_buffer, height, width);
+	}
+}
+
+void resolve_gbuffer_attributes(const unsigned int* face_ids, const double* barycentrics, int nb_pixels, const unsigned int* faces, const double* attributes, int size, const double* background, double* image, int nb_threads = 0)
+{
+	// interpolate the per-vertex attributes (nb_vertices x size) of the faces referenced in the
+	// face id buffer, the pixels not covered by any face are set to the background values (size)
+	parallel_for(nb_pixels, nb_threads, 4096, [&](int begin, int end, int)
+	{
+		for (int p = begin; p < end; p++)
+		{
+			double* pixel = &image[p * size];
+			unsigned int face_id = face_ids[p];
+			if (face_id == GBUFFER_NO_FACE)
+			{
+				for (int c = 0; c < size; c++)
+					pixel[c] = background[c];
+				continue;
+			}
+			const unsigned int* face = &faces[3 * face_id];
+			const double* bary = &barycentrics[3 * p];
+			const double* a0 = &attributes[face[0] * size];
+			const double* a1 = &attributes[face[1] * size];
+			const double* a2 = &attributes[face[2] * size];
+			for (int c = 0; c < size; c++)
+				pixel[c] = bary[0] * a0[c] + bary[1] * a1[c] + bary[2] * a2[c];
+		}
+	});
+}
+
+#endif
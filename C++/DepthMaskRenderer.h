@@ -0,0 +1,515 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _DepthMaskRenderer_h_
+#define _DepthMaskRenderer_h_
+
+// Specialized kernels to render the depth image or the silhouette mask of a mesh and their adjoints.
+// They give the same images as renderScene with nb_colors=1 and the depths (resp. ones) as colors, but
+// the triangles interiors are rasterized by updating only the z_buffer, the depth image being read from
+// the z_buffer afterwards, and no uv, shade or texture arrays are needed. The interior of a mask being
+// constant, only its antialiased silhouette edges contribute to the adjoint.
+
+#include "DifferentiableRenderer.h"
+
+struct DepthMaskScene {
+	unsigned int* faces;
+	double* depths;
+	double* ij;
+	bool* edgeflags;
+	int nb_triangles;
+	int nb_vertices;
+	bool clockwise;
+	bool backface_culling;
+	int height;
+	int width;
+	double* background; // height x width
+	// fields to store adjoint
+	double* ij_b;
+	double* depths_b;
+};
+
+void checkDepthMaskSceneValid(const DepthMaskScene& scene, bool has_derivatives)
+{
+	if (scene.faces == NULL)
+		throw "scene.faces == NULL";
+	if (scene.depths == NULL)
+		throw "scene.depths == NULL";
+	if (scene.ij == NULL)
+		throw "scene.ij == NULL";
+	if (scene.edgeflags == NULL)
+		throw "scene.edgeflags == NULL";
+	if (scene.background == NULL)
+		throw "scene.background == NULL";
+	if (has_derivatives)
+	{
+		if (scene.ij_b == NULL)
+			throw "scene.ij_b == NULL";
+		if (scene.depths_b == NULL)
+			throw "scene.depths_b == NULL";
+	}
+	for (int k = 0; k < scene.nb_triangles * 3; k++)
+		if (scene.faces[k] >= (unsigned int)scene.nb_vertices)
+			throw "scene.faces value greater than scene.nb_vertices";
+}
+
+void get_faces_order_and_areas(const DepthMaskScene& scene, vector<sortdata>& sum_depth, vector<double>& signedAreaV)
+{
+	// same ordering and culling as in renderScene
+	sum_depth.resize(scene.nb_triangles);
+	signedAreaV.resize(scene.nb_triangles);
+	for (int k = 0; k < scene.nb_triangles; k++)
+	{
+		sum_depth[k].value = 0;
+		sum_depth[k].index = k;
+		bool all_verticesInFront = true;
+		unsigned int * face = &scene.faces[k * 3];
+		for (int i = 0; i < 3; i++)
+		{
+			if (scene.depths[face[i]] < 0)
+				all_verticesInFront = false;
+			sum_depth[k].value += scene.depths[face[i]];
+		}
+		if (all_verticesInFront)
+		{
+			double ij[3][2];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 2; j++)
+					ij[i][j] = scene.ij[face[i] * 2 + j];
+			signedAreaV[k] = signedArea(ij, scene.clockwise);
+		}
+		else
+			signedAreaV[k] = 0;
+	}
+	sort(sum_depth.begin(), sum_depth.end(), sortcompare());
+}
+
+inline void get_face_ij_depths(const DepthMaskScene& scene, int k, double ij[3][2], double depths[3])
+{
+	unsigned int * face = &scene.faces[k * 3];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[face[i] * 2 + j];
+		depths[i] = scene.depths[face[i]];
+	}
+}
+
+inline void get_edge_ij_depths(const DepthMaskScene& scene, int k, int n, double ij[2][2], double depths[2])
+{
+	static const int list_sub[3][2] = { 1,0,2,1,0,2 };
+	unsigned int * face = &scene.faces[k * 3];
+	for (int i = 0; i < 2; i++)
+	{
+		unsigned int v = face[list_sub[n][i]];
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[v * 2 + j];
+		depths[i] = scene.depths[v];
+	}
+}
+
+inline void add_edge_ij_depths_B(const DepthMaskScene& scene, int k, int n, double ij_b[2][2], double depths_b[2])
+{
+	static const int list_sub[3][2] = { 1,0,2,1,0,2 };
+	unsigned int * face = &scene.faces[k * 3];
+	for (int i = 0; i < 2; i++)
+	{
+		unsigned int v = face[list_sub[n][i]];
+		for (int j = 0; j < 2; j++)
+			scene.ij_b[v * 2 + j] += ij_b[i][j];
+		if (scene.depths_b != NULL)
+			scene.depths_b[v] += depths_b[i];
+	}
+}
+
+inline void render_part_z(double* z_buffer, int y_begin, int y_end, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height)
+{
+	double t[3];
+	double Z0y;
+	int x_begin, x_end;
+	int temp_x;
+	double Z;
+
+	if (y_begin < 0)
+		y_begin = 0;
+	if (y_end > height - 1)
+		y_end = height - 1;
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		t[0] = 0; t[1] = y; t[2] = 1;
+		Z0y = dot_prod(xy1_to_Z, t);
+
+		x_begin = 0;
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
+		if (temp_x > x_begin) x_begin = temp_x;
+
+		x_end = width - 1;
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
+		if (temp_x < x_end) x_end = temp_x;
+
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			Z = Z0y + xy1_to_Z[0] * x;
+			if (Z < z_buffer[indx])
+				z_buffer[indx] = Z;
+			indx++;
+		}
+	}
+}
+
+void rasterize_triangle_z(double Vxy[][2], double Zvertex[3], double z_buffer[], int height, int width)
+{
+	int     y_begin[2], y_end[2];
+	double  edge_eq[3][2];
+	double  bary_to_xy1[9];
+	double  xy1_to_bary[9];
+	double  xy1_to_Z[3];
+	int     left_edge_id[2], right_edge_id[2];
+
+	get_triangle_stencil_equations(Vxy, bary_to_xy1, xy1_to_bary, edge_eq, y_begin, y_end, left_edge_id, right_edge_id);
+	mul_vect_matrix3x3(xy1_to_Z, Zvertex, xy1_to_bary);
+	for (int k = 0; k < 2; k++)
+		render_part_z(z_buffer, y_begin[k], y_end[k], xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height);
+}
+
+inline void render_part_depth_B(double* image_B, double* z_buffer, int y_begin, int y_end, double* xy1_to_Z, double* xy1_to_A_B, double* left_eq, double* right_eq, int width, int height)
+{
+	// adjoint of the depth interpolation image = A0y + xy1_to_A[0] * x restricted to the visible pixels
+	double t[3];
+	double Z0y;
+	int x_begin, x_end;
+	int temp_x;
+	double Z;
+
+	if (y_begin < 0)
+		y_begin = 0;
+	if (y_end > height - 1)
+		y_end = height - 1;
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		t[0] = 0; t[1] = y; t[2] = 1;
+		Z0y = dot_prod(xy1_to_Z, t);
+		double A0y_B = 0;
+
+		x_begin = 0;
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
+		if (temp_x > x_begin) x_begin = temp_x;
+
+		x_end = width - 1;
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
+		if (temp_x < x_end) x_end = temp_x;
+
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			Z = Z0y + xy1_to_Z[0] * x;
+			if (Z == z_buffer[indx])
+			{
+				A0y_B += image_B[indx];
+				xy1_to_A_B[0] += image_B[indx] * x;
+				image_B[indx] = 0; // avoid counting twice pixels on the shared edges
+			}
+			indx++;
+		}
+		for (int j = 0; j < 3; j++)
+			xy1_to_A_B[j] += A0y_B * t[j];
+	}
+}
+
+void rasterize_triangle_depth_B(double Vxy[][2], double Vxy_B[][2], double Zvertex[3], double Avertex[3], double Avertex_B[3], double z_buffer[], double image_B[], int height, int width)
+{
+	int     y_begin[2], y_end[2];
+	double  edge_eq[3][2];
+	double  bary_to_xy1[9];
+	double  xy1_to_bary[9];
+	double  xy1_to_Z[3];
+	int     left_edge_id[2], right_edge_id[2];
+
+	get_triangle_stencil_equations(Vxy, bary_to_xy1, xy1_to_bary, edge_eq, y_begin, y_end, left_edge_id, right_edge_id);
+	mul_vect_matrix3x3(xy1_to_Z, Zvertex, xy1_to_bary);
+
+	double xy1_to_A_B[3] = { 0 };
+	for (int k = 0; k < 2; k++)
+		render_part_depth_B(image_B, z_buffer, y_begin[k], y_end[k], xy1_to_Z, xy1_to_A_B, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height);
+
+	double xy1_to_bary_B[9] = { 0 };
+	for (int k = 0; k < 3; k++)
+		for (int j = 0; j < 3; j++)
+		{
+			Avertex_B[k] += xy1_to_A_B[j] * xy1_to_bary[k * 3 + j];
+			xy1_to_bary_B[k * 3 + j] += Avertex[k] * xy1_to_A_B[j];
+		}
+	double bary_to_xy1_B[9] = { 0 };
+	inv_matrix_3x3_B(bary_to_xy1, bary_to_xy1_B, xy1_to_bary, xy1_to_bary_B);
+	for (int v = 0; v < 3; v++)
+		for (int d = 0; d < 2; d++)
+			Vxy_B[v][d] += bary_to_xy1_B[3 * d + v];
+}
+
+void rasterize_edge_coverage(double Vxy[][2], double Zvertex[2], double image[], double z_buffer[], int height, int width, double sigma, bool clockwise)
+{
+	// blend the coverage 1 of the edge over the image with the transparency of the edge overdraw
+	double  xy1_to_bary[6];
+	double  xy1_to_transp[3];
+	double  ineq[12];
+	int     y_begin, y_end;
+	double  xy1_to_Z[3];
+
+	get_edge_stencil_equations(Vxy, height, width, sigma, xy1_to_bary, xy1_to_transp, ineq, y_begin, y_end, clockwise);
+	mul_matrix(1, 2, 3, xy1_to_Z, Zvertex, xy1_to_bary);
+	double T_inc = xy1_to_transp[0];
+
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		double t[3];
+		t[0] = 0; t[1] = y; t[2] = 1;
+		double T0y = dot_prod(xy1_to_transp, t);
+		double Z0y = dot_prod(xy1_to_Z, t);
+
+		int x_begin, x_end;
+		get_xrange_from_ineq(ineq, width, y, x_begin, x_end);
+
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			double Z = Z0y + xy1_to_Z[0] * x;
+			if (Z < z_buffer[indx])
+			{
+				double T = T0y + T_inc * x;
+				image[indx] *= T;
+				image[indx] += (1 - T);
+			}
+			indx++;
+		}
+	}
+}
+
+void rasterize_edge_coverage_B(double Vxy[][2], double Vxy_B[][2], double Zvertex[2], double image[], double image_B[], double z_buffer[], int height, int width, double sigma, bool clockwise)
+{
+	double  xy1_to_bary[6];
+	double  xy1_to_bary_B[6] = { 0 };
+	double  xy1_to_transp[3];
+	double  xy1_to_transp_B[3] = { 0 };
+	double  ineq[12];
+	int     y_begin, y_end;
+	double  xy1_to_Z[3];
+
+	get_edge_stencil_equations(Vxy, height, width, sigma, xy1_to_bary, xy1_to_transp, ineq, y_begin, y_end, clockwise);
+	mul_matrix(1, 2, 3, xy1_to_Z, Zvertex, xy1_to_bary);
+	double T_inc = xy1_to_transp[0];
+
+	for (int y = y_begin; y <= y_end; y++)
+	{
+		double t[3];
+		t[0] = 0; t[1] = y; t[2] = 1;
+		double T0y = dot_prod(xy1_to_transp, t);
+		double T0y_B = 0;
+		double Z0y = dot_prod(xy1_to_Z, t);
+
+		int x_begin, x_end;
+		get_xrange_from_ineq(ineq, width, y, x_begin, x_end);
+
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
+		{
+			double Z = Z0y + xy1_to_Z[0] * x;
+			if (Z < z_buffer[indx])
+			{
+				double T = T0y + T_inc * x;
+				// restoring the coverage before the edge was drawn
+				image[indx] = (image[indx] - (1 - T)) / T;
+				double T_B = image_B[indx] * (image[indx] - 1);
+				image_B[indx] *= T;
+				T0y_B += T_B;
+				xy1_to_transp_B[0] += x * T_B;
+			}
+			indx++;
+		}
+		for (int k = 0; k < 3; k++)
+			xy1_to_transp_B[k] += T0y_B * t[k];
+	}
+	get_edge_stencil_equations_B(Vxy, Vxy_B, sigma, xy1_to_bary_B, xy1_to_transp_B, clockwise);
+}
+
+void rasterize_faces_z(const DepthMaskScene& scene, const vector<double>& signedAreaV, double* z_buffer)
+{
+	fill(z_buffer, z_buffer + (size_t)scene.height * scene.width, numeric_limits<double>::infinity());
+	for (int k = 0; k < scene.nb_triangles; k++)
+		if ((signedAreaV[k] > 0) || (!scene.backface_culling))
+		{
+			double ij[3][2];
+			double depths[3];
+			get_face_ij_depths(scene, k, ij, depths);
+			rasterize_triangle_z(ij, depths, z_buffer, scene.height, scene.width);
+		}
+}
+
+void renderDepth(DepthMaskScene scene, double depth_scale, double* image, double* z_buffer, double sigma)
+{
+	// image is height x width and contains the depth multiplied by depth_scale, or the background
+	checkDepthMaskSceneValid(scene, false);
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_faces_order_and_areas(scene, sum_depth, signedAreaV);
+	rasterize_faces_z(scene, signedAreaV, z_buffer);
+
+	for (size_t k = 0; k < (size_t)scene.height * scene.width; k++)
+		image[k] = (z_buffer[k] < numeric_limits<double>::infinity()) ? z_buffer[k] * depth_scale : scene.background[k];
+
+	if (sigma > 0)
+		for (int it = 0; it < scene.nb_triangles; it++)
+		{
+			size_t k = sum_depth[it].index; // silhouette edges are drawn from the furthest to the nearest
+			if (signedAreaV[k] > 0)
+				for (int n = 0; n < 3; n++)
+					if (scene.edgeflags[n + k * 3])
+					{
+						double ij[2][2];
+						double depths[2];
+						get_edge_ij_depths(scene, k, n, ij, depths);
+						double A[2] = { depths[0] * depth_scale, depths[1] * depth_scale };
+						double* Avertex[2] = { &A[0], &A[1] };
+						rasterize_edge_interpolated(ij, image, Avertex, z_buffer, depths, scene.height, scene.width, 1, sigma, scene.clockwise);
+					}
+		}
+}
+
+void renderDepth_B(DepthMaskScene scene, double depth_scale, double* image, double* z_buffer, double* image_b, double sigma)
+{
+	// accumulate the adjoint of the depth image into scene.ij_b and scene.depths_b,
+	// image and image_b are modified in place
+	checkDepthMaskSceneValid(scene, true);
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_faces_order_and_areas(scene, sum_depth, signedAreaV);
+
+	if (sigma > 0)
+		for (int it = scene.nb_triangles - 1; it >= 0; it--)
+		{
+			size_t k = sum_depth[it].index;
+			if (signedAreaV[k] > 0)
+				for (int n = 2; n >= 0; n--)
+					if (scene.edgeflags[n + k * 3])
+					{
+						double ij[2][2];
+						double depths[2];
+						get_edge_ij_depths(scene, k, n, ij, depths);
+						double A[2] = { depths[0] * depth_scale, depths[1] * depth_scale };
+						double A_B[2] = { 0 };
+						double* Avertex[2] = { &A[0], &A[1] };
+						double* Avertex_B[2] = { &A_B[0], &A_B[1] };
+						double ij_b[2][2] = { { 0 } };
+						rasterize_edge_interpolated_B(ij, ij_b, image, image_b, Avertex, Avertex_B, z_buffer, depths, scene.height, scene.width, 1, sigma, scene.clockwise);
+						double depths_b[2] = { A_B[0] * depth_scale, A_B[1] * depth_scale };
+						add_edge_ij_depths_B(scene, k, n, ij_b, depths_b);
+					}
+		}
+
+	for (int k = scene.nb_triangles - 1; k >= 0; k--)
+		if (signedAreaV[k] > 0)
+		{
+			double ij[3][2];
+			double depths[3];
+			get_face_ij_depths(scene, k, ij, depths);
+			double A[3], A_B[3] = { 0 };
+			for (int i = 0; i < 3; i++)
+				A[i] = depths[i] * depth_scale;
+			double ij_b[3][2] = { { 0 } };
+			rasterize_triangle_depth_B(ij, ij_b, depths, A, A_B, z_buffer, image_b, scene.height, scene.width);
+			unsigned int * face = &scene.faces[k * 3];
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 2; j++)
+					scene.ij_b[face[i] * 2 + j] += ij_b[i][j];
+				scene.depths_b[face[i]] += A_B[i] * depth_scale;
+			}
+		}
+}
+
+void renderMask(DepthMaskScene scene, double* image, double* z_buffer, double sigma)
+{
+	// image is height x width and contains 1 where the mesh is visible, the background elsewhere
+	// and the antialiased coverage along the silhouette edges
+	checkDepthMaskSceneValid(scene, false);
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_faces_order_and_areas(scene, sum_depth, signedAreaV);
+	rasterize_faces_z(scene, signedAreaV, z_buffer);
+
+	for (size_t k = 0; k < (size_t)scene.height * scene.width; k++)
+		image[k] = (z_buffer[k] < numeric_limits<double>::infinity()) ? 1 : scene.background[k];
+
+	if (sigma > 0)
+		for (int it = 0; it < scene.nb_triangles; it++)
+		{
+			size_t k = sum_depth[it].index;
+			if (signedAreaV[k] > 0)
+				for (int n = 0; n < 3; n++)
+					if (scene.edgeflags[n + k * 3])
+					{
+						double ij[2][2];
+						double depths[2];
+						get_edge_ij_depths(scene, k, n, ij, depths);
+						rasterize_edge_coverage(ij, depths, image, z_buffer, scene.height, scene.width, sigma, scene.clockwise);
+					}
+		}
+}
+
+void renderMask_B(DepthMaskScene scene, double* image, double* z_buffer, double* image_b, double sigma)
+{
+	// accumulate the adjoint of the mask into scene.ij_b, the mask does not depend on the depths
+	// and its interior is constant so that only the silhouette edges contribute
+	checkDepthMaskSceneValid(scene, true);
+	if (sigma <= 0)
+		return;
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_faces_order_and_areas(scene, sum_depth, signedAreaV);
+
+	for (int it = scene.nb_triangles - 1; it >= 0; it--)
+	{
+		size_t k = sum_depth[it].index;
+		if (signedAreaV[k] > 0)
+			for (int n = 2; n >= 0; n--)
+				if (scene.edgeflags[n + k * 3])
+				{
+					double ij[2][2];
+					double depths[2];
+					get_edge_ij_depths(scene, k, n, ij, depths);
+					double ij_b[2][2] = { { 0 } };
+					rasterize_edge_coverage_B(ij, ij_b, depths, image, image_b, z_buffer, scene.height, scene.width, sigma, scene.clockwise);
+					double depths_b[2] = { 0 };
+					add_edge_ij_depths_B(scene, k, n, ij_b, depths_b);
+				}
+	}
+}
+
+#endif
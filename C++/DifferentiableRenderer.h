@@ -28,6 +28,9 @@
 	either expressed or implied, of the FreeBSD Project.
 
 */
+#ifndef _DifferentiableRenderer_h_
+#define _DifferentiableRenderer_h_
+
 #include <stdlib.h>
 #include <iostream>
 #include <math.h>
@@ -44,9 +47,9 @@ using namespace std;
 
 
 void get_xrange_from_ineq(double ineq[12], int width, int y, int &x_begin, int &x_end);
-inline void render_part_interpolated(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_A, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA);
+inline void render_part_interpolated(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_A, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, unsigned int* face_ids = NULL, unsigned int face_id = 0);
 inline void render_part_interpolated_B(double* image, double* image_B, double* z_buffer, int y_begin, int y_end, double* xy1_to_A, double* xy1_to_A_B, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA);
-inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_UV, double* xy1_to_L, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, double* Texture, int* Texture_size);
+inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_UV, double* xy1_to_L, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, double* Texture, int* Texture_size, unsigned int* face_ids = NULL, unsigned int face_id = 0);
 inline  void render_part_textured_gouraud_B(double* image, double* image_B, double* z_buffer, int y_begin, int y_end, double* xy1_to_UV, double* xy1_to_UV_B, double* xy1_to_L, double* xy1_to_L_B, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, double* Texture, double* Texture_B, int* Texture_size);
 
 struct Scene {
@@ -363,6 +366,18 @@ inline void dot_prod_B(const double R_B, double V1_B[3], const double V2[3])
 		V1_B[i] += R_B * V2[i];
 }
 
+inline int floor_to_int(double v)
+{
+	// floor of a pixel coordinate clamped so that coordinates far outside of the image, or NaN,
+	// cannot overflow once converted to int, the rasterization loops are then clipped to the image
+	const double limit = 1 << 30;
+	if (!(v > -limit))
+		return -(1 << 30);
+	if (v > limit)
+		return 1 << 30;
+	return (int)floor(v);
+}
+
 inline void Edge_equ(double e[2], const double v1[2], const double v2[2])
 {
 	e[0] = (v1[0] - v2[0]) / (v1[1] - v2[1]);
@@ -414,10 +429,10 @@ template <class T> void bilinear_sample(T* A, T I[], int* I_size, double p[2], i
 
 	// bilinear interpolation 
 
-	int indx00 = sizeA * (fp[0] + I_size[0] * fp[1]);
-	int indx10 = sizeA * (fp[0] + 1 + I_size[0] * fp[1]);
-	int indx01 = sizeA * (fp[0] + I_size[0] * (fp[1] + 1));
-	int indx11 = sizeA * (fp[0] + 1 + I_size[0] * (fp[1] + 1));
+	size_t indx00 = sizeA * (fp[0] + (size_t)I_size[0] * fp[1]);
+	size_t indx10 = sizeA * (fp[0] + 1 + (size_t)I_size[0] * fp[1]);
+	size_t indx01 = sizeA * (fp[0] + (size_t)I_size[0] * (fp[1] + 1));
+	size_t indx11 = sizeA * (fp[0] + 1 + (size_t)I_size[0] * (fp[1] + 1));
 
 	for (int k = 0; k < sizeA; k++)
 		A[k] = ((1 - e[0])*I[indx00 + k] + e[0] * I[indx10 + k])*(1 - e[1]) + ((1 - e[0])*I[indx01 + k] + e[0] * I[indx11 + k])*e[1];
@@ -456,10 +471,10 @@ template <class T> void bilinear_sample_B(T* A, T* A_B, T I[], T I_B[], int* I_s
 
 	// bilinear interpolation 
 
-	int indx00 = sizeA * (fp[0] + I_size[0] * fp[1]);
-	int indx10 = sizeA * (fp[0] + 1 + I_size[0] * fp[1]);
-	int indx01 = sizeA * (fp[0] + I_size[0] * (fp[1] + 1));
-	int indx11 = sizeA * (fp[0] + 1 + I_size[0] * (fp[1] + 1));
+	size_t indx00 = sizeA * (fp[0] + (size_t)I_size[0] * fp[1]);
+	size_t indx10 = sizeA * (fp[0] + 1 + (size_t)I_size[0] * fp[1]);
+	size_t indx01 = sizeA * (fp[0] + (size_t)I_size[0] * (fp[1] + 1));
+	size_t indx11 = sizeA * (fp[0] + 1 + (size_t)I_size[0] * (fp[1] + 1));
 
 	//for(int k=0;k<sizeA;k++) 
 	//	A[k]=( (1-e[0])*I[indx00+k] + e[0]*I[indx10+k] )*(1-e[1])+( (1-e[0])*I[indx01+k] + e[0]*I[indx11+k] )*e[1];
@@ -478,10 +493,10 @@ template <class T> void bilinear_sample_B(T* A, T* A_B, T I[], T I_B[], int* I_s
 		e_B[0] += t1_B * (I[indx10 + k] - I[indx00 + k]);
 		e_B[0] += t2_B * (I[indx11 + k] - I[indx01 + k]);
 
-		I_B[indx00 + k] = (1 - e[0])*(1 - e[1]) * A_B[k];
-		I_B[indx10 + k] = e[0] * (1 - e[1]) * A_B[k];
-		I_B[indx01 + k] = (1 - e[0]) *e[1] * A_B[k];
-		I_B[indx11 + k] = e[0] * e[1] * A_B[k];
+		I_B[indx00 + k] += (1 - e[0])*(1 - e[1]) * A_B[k];
+		I_B[indx10 + k] += e[0] * (1 - e[1]) * A_B[k];
+		I_B[indx01 + k] += (1 - e[0]) *e[1] * A_B[k];
+		I_B[indx11 + k] += e[0] * e[1] * A_B[k];
 	}
 	for (int k = 0; k < 2; k++)
 	{
@@ -526,13 +541,13 @@ void get_triangle_stencil_equations(double Vxy[][2], double  bary_to_xy1[9], dou
 
 	// limit upper part
 
-	y_begin[0] = (short)floor(y_sorted[0]) + 1;
-	y_end[0] = (short)floor(y_sorted[1]);
+	y_begin[0] = floor_to_int(y_sorted[0]) + 1;
+	y_end[0] = floor_to_int(y_sorted[1]);
 
 	// limit lower part
 
-	y_begin[1] = (short)floor(y_sorted[1]) + 1;
-	y_end[1] = (short)floor(y_sorted[2]);
+	y_begin[1] = floor_to_int(y_sorted[1]) + 1;
+	y_end[1] = floor_to_int(y_sorted[2]);
 
 	// set left_edge_id and right_edge_id
 
@@ -558,7 +573,7 @@ void get_triangle_stencil_equations(double Vxy[][2], double  bary_to_xy1[9], dou
 	}
 }
 
-template <class T> void rasterize_triangle_interpolated(double Vxy[][2], double Zvertex[3], T* Avertex[], double z_buffer[], T image[], int height, int width, int sizeA)
+template <class T> void rasterize_triangle_interpolated(double Vxy[][2], double Zvertex[3], T* Avertex[], double z_buffer[], T image[], int height, int width, int sizeA, unsigned int* face_ids = NULL, unsigned int face_id = 0)
 {
 	int     y_begin[2], y_end[2];
 
@@ -586,7 +601,7 @@ template <class T> void rasterize_triangle_interpolated(double Vxy[][2], double
 	mul_vect_matrix3x3(xy1_to_Z, Zvertex, xy1_to_bary);
 	for (int k = 0; k < 2; k++)
 	{
-		render_part_interpolated(image, z_buffer, y_begin[k], y_end[k], xy1_to_A, xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height, sizeA);
+		render_part_interpolated(image, z_buffer, y_begin[k], y_end[k], xy1_to_A, xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height, sizeA, face_ids, face_id);
 	}
 	delete[] xy1_to_A;
 }
@@ -651,18 +666,18 @@ template <class T> void rasterize_triangle_interpolated_B(double Vxy[][2], doubl
 	delete[] xy1_to_A_B;
 }
 
-inline void render_part_interpolated(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_A, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA)
+inline void render_part_interpolated(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_A, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, unsigned int* face_ids, unsigned int face_id)
 {
 	double t[3];
 	double *A0y;
 	double Z0y;
-	short int x_begin, x_end;
+	int x_begin, x_end;
 	int temp_x;
 	double Z;
 	A0y = new double[sizeA];
 
 	if (y_begin < 0)     y_begin = 0;  if (y_end > height - 1) y_end = height - 1;
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{
 		// Line rasterization setup for interpolated values 
 
@@ -674,22 +689,23 @@ inline void render_part_interpolated(double* image, double* z_buffer, int y_begi
 		// compute beginning and ending of the rasterized line		
 
 		x_begin = 0;
-		temp_x = 1 + (short int)floor(left_eq[0] * y + left_eq[1]);
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
 		if (temp_x > x_begin) x_begin = temp_x;
 
 		x_end = width - 1;
-		temp_x = (short int)floor(right_eq[0] * y + right_eq[1]);
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
 		if (temp_x < x_end) x_end = temp_x;
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
 			{
 				z_buffer[indx] = Z;
+				if (face_ids) face_ids[indx] = face_id;
 				for (short int k = 0; k < sizeA; k++)
 					image[sizeA*indx + k] = A0y[k] + xy1_to_A[3 * k] * x;
 			}
@@ -706,7 +722,7 @@ inline void render_part_interpolated_B(double* image, double* image_B, double* z
 	//double *A0y;
 	double *A0y_B;
 	double Z0y;
-	short int x_begin, x_end;
+	int x_begin, x_end;
 	int temp_x;
 	double Z;
 
@@ -715,7 +731,7 @@ inline void render_part_interpolated_B(double* image, double* image_B, double* z
 
 	if (y_begin < 0)     y_begin = 0;  if (y_end > height - 1) y_end = height - 1;
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{
 		// Line rasterization setup for interpolated values 
 
@@ -730,17 +746,17 @@ inline void render_part_interpolated_B(double* image, double* image_B, double* z
 		// compute beginning and ending of the rasterized line		
 
 		x_begin = 0;
-		temp_x = 1 + (short int)floor(left_eq[0] * y + left_eq[1]);
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
 		if (temp_x > x_begin) x_begin = temp_x;
 
 		x_end = width - 1;
-		temp_x = (short int)floor(right_eq[0] * y + right_eq[1]);
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
 		if (temp_x < x_end) x_end = temp_x;
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			Z = Z0y + xy1_to_Z[0] * x;
 			if (Z == z_buffer[indx])
@@ -762,7 +778,7 @@ inline void render_part_interpolated_B(double* image, double* image_B, double* z
 	delete[]A0y_B;
 }
 
-template <class T> void rasterize_triangle_textured_gouraud(double Vxy[][2], double Zvertex[3], double UVvertex[][2], double ShadeVertex[], double z_buffer[], T image[], int height, int width, int sizeA, T* Texture, int* Texture_size)
+template <class T> void rasterize_triangle_textured_gouraud(double Vxy[][2], double Zvertex[3], double UVvertex[][2], double ShadeVertex[], double z_buffer[], T image[], int height, int width, int sizeA, T* Texture, int* Texture_size, unsigned int* face_ids = NULL, unsigned int face_id = 0)
 {
 	int     y_begin[2], y_end[2];
 
@@ -791,7 +807,7 @@ template <class T> void rasterize_triangle_textured_gouraud(double Vxy[][2], dou
 		}
 
 	for (int k = 0; k < 2; k++)
-		render_part_textured_gouraud(image, z_buffer, y_begin[k], y_end[k], xy1_to_UV, xy1_to_L, xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height, sizeA, Texture, Texture_size);
+		render_part_textured_gouraud(image, z_buffer, y_begin[k], y_end[k], xy1_to_UV, xy1_to_L, xy1_to_Z, edge_eq[left_edge_id[k]], edge_eq[right_edge_id[k]], width, height, sizeA, Texture, Texture_size, face_ids, face_id);
 }
 
 template <class T> void rasterize_triangle_textured_gouraud_B(double Vxy[][2], double Vxy_B[][2], double Zvertex[3], double UVvertex[][2], double UVvertex_B[][2], double ShadeVertex[], double ShadeVertex_B[], double z_buffer[], T image[], T image_B[], int height, int width, int sizeA, T* Texture, T* Texture_B, int* Texture_size)
@@ -851,12 +867,12 @@ template <class T> void rasterize_triangle_textured_gouraud_B(double Vxy[][2], d
 			Vxy_B[v][d] += bary_to_xy1_B[3 * d + v];
 }
 
-inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_UV, double* xy1_to_L, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, double* Texture, int* Texture_size)
+inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y_begin, int y_end, double* xy1_to_UV, double* xy1_to_L, double* xy1_to_Z, double* left_eq, double* right_eq, int width, int height, int sizeA, double* Texture, int* Texture_size, unsigned int* face_ids, unsigned int face_id)
 {
 	double t[3];
 	double L0y;
 	double Z0y;
-	short int x_begin, x_end;
+	int x_begin, x_end;
 	int temp_x;
 	double Z;
 	double *A;
@@ -866,7 +882,7 @@ inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y
 
 	if (y_begin < 0)     y_begin = 0;  if (y_end > height - 1) y_end = height - 1;
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{
 
 		// Line rasterization setup for interpolated values 
@@ -885,17 +901,17 @@ inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y
 		// compute beginning and ending of the rasterized line		
 
 		x_begin = 0;
-		temp_x = 1 + (short int)floor(left_eq[0] * y + left_eq[1]);
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
 		if (temp_x > x_begin) x_begin = temp_x;
 
 		x_end = width - 1;
-		temp_x = (short int)floor(right_eq[0] * y + right_eq[1]);
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
 		if (temp_x < x_end) x_end = temp_x;
 
 		// line rasterization
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
@@ -904,6 +920,7 @@ inline  void render_part_textured_gouraud(double* image, double* z_buffer, int y
 				double UV[2];
 
 				z_buffer[indx] = Z;
+				if (face_ids) face_ids[indx] = face_id;
 				L = L0y + xy1_to_L[0] * x;
 
 				for (int k = 0; k < 2; k++)
@@ -925,7 +942,7 @@ inline  void render_part_textured_gouraud_B(double* image, double* image_B, doub
 	double t[3];
 	double L0y;
 	double Z0y;
-	short int x_begin, x_end;
+	int x_begin, x_end;
 	int temp_x;
 	double Z;
 	double *A;
@@ -938,7 +955,7 @@ inline  void render_part_textured_gouraud_B(double* image, double* image_B, doub
 
 	if (y_begin < 0)     y_begin = 0;  if (y_end > height - 1) y_end = height - 1;
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{
 
 		// Line rasterization setup for interpolated values 
@@ -959,17 +976,17 @@ inline  void render_part_textured_gouraud_B(double* image, double* image_B, doub
 		// compute beginning and ending of the rasterized line		
 
 		x_begin = 0;
-		temp_x = 1 + (short int)floor(left_eq[0] * y + left_eq[1]);
+		temp_x = 1 + floor_to_int(left_eq[0] * y + left_eq[1]);
 		if (temp_x > x_begin) x_begin = temp_x;
 
 		x_end = width - 1;
-		temp_x = (short int)floor(right_eq[0] * y + right_eq[1]);
+		temp_x = floor_to_int(right_eq[0] * y + right_eq[1]);
 		if (temp_x < x_end) x_end = temp_x;
 
 		// line rasterization
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			Z = Z0y + xy1_to_Z[0] * x;
 			if (Z == z_buffer[indx])
@@ -1098,7 +1115,7 @@ void get_edge_stencil_equations(double Vxy[][2], int height, int width, double s
 	for (short int k = 0; k < 2; k++)
 	{
 		if (Vxy[k][1] - sigma < y_begin)
-			y_begin = (int)floor(Vxy[k][1] - sigma) + 1;
+			y_begin = floor_to_int(Vxy[k][1] - sigma) + 1;
 	}
 	if (y_begin < 0)
 	{
@@ -1109,7 +1126,7 @@ void get_edge_stencil_equations(double Vxy[][2], int height, int width, double s
 	for (short int k = 0; k < 2; k++)
 	{
 		if (Vxy[k][1] + sigma > y_end)
-			y_end = (int)floor(Vxy[k][1] + sigma);
+			y_end = floor_to_int(Vxy[k][1] + sigma);
 	}
 	if (y_end > height - 1)
 	{
@@ -1221,7 +1238,7 @@ template <class Te> void rasterize_edge_interpolated(double Vxy[][2], Te image[]
 			for (short int k = 0; k < 2; k++) xy1_to_A[3 * i + j] += Avertex[k][i] * xy1_to_bary[k * 3 + j];
 		}
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{	// Line rasterization setup for interpolated values 
 		double t[3];
 		double T0y, Z0y;
@@ -1237,8 +1254,8 @@ template <class Te> void rasterize_edge_interpolated(double Vxy[][2], Te image[]
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
@@ -1297,7 +1314,7 @@ template <class Te> void rasterize_edge_interpolated_B(double Vxy[][2], double V
 				xy1_to_A[3 * i + j] += Avertex[k][i] * xy1_to_bary[k * 3 + j];
 		}
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{	// Line rasterization setup for interpolated values 
 		double t[3];
 		double T0y, Z0y;
@@ -1316,8 +1333,8 @@ template <class Te> void rasterize_edge_interpolated_B(double Vxy[][2], double V
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
@@ -1416,7 +1433,7 @@ template <class Te> void rasterize_edge_textured_gouraud(double Vxy[][2], double
 			for (short int k = 0; k < 2; k++) xy1_to_UV[3 * i + j] += UVvertex[k][i] * xy1_to_bary[k * 3 + j];
 		}
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{	// Line rasterization setup for interpolated values 
 
 		double t[3];
@@ -1440,8 +1457,8 @@ template <class Te> void rasterize_edge_textured_gouraud(double Vxy[][2], double
 		
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
@@ -1512,7 +1529,7 @@ template <class Te> void rasterize_edge_textured_gouraud_B(double Vxy[][2], doub
 		}
 
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{	// Line rasterization setup for interpolated values 
 
 		double t[3];
@@ -1539,8 +1556,8 @@ template <class Te> void rasterize_edge_textured_gouraud_B(double Vxy[][2], doub
 		
 		//rasterize line
 
-		int indx = y * width + x_begin;
-		for (short int x = x_begin; x <= x_end; x++)
+		size_t indx = (size_t)y * width + x_begin;
+		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
 			if (Z < z_buffer[indx])
@@ -1679,7 +1696,7 @@ template <class T> void rasterize_edge_textured_gouraud_error(double Vxy[][2], d
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
+		size_t indx = (size_t)y * width + x_begin;
 		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
@@ -1780,7 +1797,7 @@ template <class T> void rasterize_edge_textured_gouraud_error_B(double Vxy[][2],
 		
 		//rasterize line
 
-		int indx = y * width + x_begin;
+		size_t indx = (size_t)y * width + x_begin;
 		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
@@ -1919,7 +1936,7 @@ template <class T> void rasterize_edge_interpolated_error(double Vxy[][2], doubl
 
 		//rasterize line
 
-		int indx = y * width + x_begin;
+		size_t indx = (size_t)y * width + x_begin;
 		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
@@ -1987,7 +2004,7 @@ template <class T> void rasterize_edge_interpolated_error_B(double Vxy[][2], dou
 	}
 
 
-	for (short int y = y_begin; y <= y_end; y++)
+	for (int y = y_begin; y <= y_end; y++)
 	{
 		// Line rasterization setup for interpolated values 
 
@@ -2008,7 +2025,7 @@ template <class T> void rasterize_edge_interpolated_error_B(double Vxy[][2], dou
 		
 		//rasterize line
 
-		int indx = y * width + x_begin;
+		size_t indx = (size_t)y * width + x_begin;
 		for (int x = x_begin; x <= x_end; x++)
 		{
 			double Z = Z0y + xy1_to_Z[0] * x;
@@ -2083,7 +2100,7 @@ template <class T> void rasterize_edge_interpolated_error_B(double Vxy[][2], dou
 void get_xrange_from_ineq(double ineq[12], int width, int y, int &x_begin, int &x_end)
 {
 	// compute beginning and ending of the rasterized line while doing edge antialiasing		
-	short int temp_x;
+	int temp_x;
 
 	x_begin = 0;
 	x_end = width - 1;
@@ -2092,12 +2109,12 @@ void get_xrange_from_ineq(double ineq[12], int width, int y, int &x_begin, int &
 	{
 		if (ineq[3 * k] < 0)
 		{
-			temp_x = (short int)floor(ineq[3 * k + 1] * y + ineq[3 * k + 2]);
+			temp_x = floor_to_int(ineq[3 * k + 1] * y + ineq[3 * k + 2]);
 			if (temp_x < x_end) { x_end = temp_x; }
 		}
 		else
 		{
-			temp_x = 1 + (short int)floor(-ineq[3 * k + 1] * y - ineq[3 * k + 2]);
+			temp_x = 1 + floor_to_int(-ineq[3 * k + 1] * y - ineq[3 * k + 2]);
 			if (temp_x > x_begin) { x_begin = temp_x; }
 		}
 	}
@@ -2176,25 +2193,11 @@ void checkSceneValid(Scene scene, bool has_derivatives)
 	}
 }
 
-void renderScene(Scene scene, double* image, double* z_buffer, double sigma, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL)
+void get_scene_faces_order_and_areas(const Scene& scene, vector<sortdata>& sum_depth, vector<double>& signedAreaV)
 {
-	
-	checkSceneValid(scene, false);
-	// first pass : render triangle without edge antialiasing
-
-	int Texture_size[2];
-
-	Texture_size[1] = scene.texture_height;
-	Texture_size[0] = scene.texture_width;
-
-	memcpy(image, scene.background, scene.height*scene.width*scene.nb_colors * sizeof(double));
-	//for (int k=0;k<scene.height*scene.width;k++)
-	//z_buffer[k]=100000;
-	fill(z_buffer, z_buffer + scene.height*scene.width, numeric_limits<double>::infinity());
-
-	vector<sortdata> sum_depth;
+	// sort the faces from the furthest to the nearest to the camera to draw the silhouette edges
+	// and compute the signed area of the faces that have all their vertices in front of the camera
 	sum_depth.resize(scene.nb_triangles);
-	vector<double> signedAreaV;
 	signedAreaV.resize(scene.nb_triangles);
 	
 	for (int k = 0; k < scene.nb_triangles; k++)
@@ -2228,48 +2231,123 @@ void renderScene(Scene scene, double* image, double* z_buffer, double sigma, boo
 	}
 
 	sort(sum_depth.begin(), sum_depth.end(), sortcompare());
+}
 
-	for (int k = 0; k < scene.nb_triangles; k++)
-		if ((signedAreaV[k] > 0)||(!scene.backface_culling))
-		{
-			unsigned int * face = &scene.faces[k * 3];
-			double ij[3][2];
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 2; j++)
-					ij[i][j] = scene.ij[face[i] * 2 + j];
+void render_scene_triangle(const Scene& scene, int k, double* image, double* z_buffer, int* Texture_size, unsigned int* face_ids = NULL)
+{
+	// draw the face k, writing k in face_ids, if not NULL, where it is visible
+	unsigned int * face = &scene.faces[k * 3];
+	double ij[3][2];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[face[i] * 2 + j];
 
-			double depths[3];
-			for (int i = 0; i < 3; i++)
-				depths[i] = scene.depths[face[i]];
+	double depths[3];
+	for (int i = 0; i < 3; i++)
+		depths[i] = scene.depths[face[i]];
 
-			if ((scene.textured[k] && scene.shaded[k]))
-			{
-				unsigned int * face_uv = &scene.faces_uv[k * 3];
-				double shade[3];
-				for (int i = 0; i < 3; i++)
-					shade[i] = scene.shade[face[i]];
-				double uv[3][2];
-				for (int i = 0; i < 3; i++)
-					for (int j = 0; j < 2; j++)
-					{
-						uv[i][j] = scene.uv[face_uv[i] * 2 + j] - 1;
-					}
-				rasterize_triangle_textured_gouraud(ij, depths, uv, shade, z_buffer, image, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size);
-			}
-			if (!scene.textured[k])
+	if ((scene.textured[k] && scene.shaded[k]))
+	{
+		unsigned int * face_uv = &scene.faces_uv[k * 3];
+		double shade[3];
+		for (int i = 0; i < 3; i++)
+			shade[i] = scene.shade[face[i]];
+		double uv[3][2];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
 			{
-				double* colors[3];
-				for (int i = 0; i < 3; i++)
-					colors[i] = scene.colors + face[i] * scene.nb_colors;
-				rasterize_triangle_interpolated(ij, depths, colors, z_buffer, image, scene.height, scene.width, scene.nb_colors);
+				uv[i][j] = scene.uv[face_uv[i] * 2 + j] - 1;
 			}
-		}
+		rasterize_triangle_textured_gouraud(ij, depths, uv, shade, z_buffer, image, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size, face_ids, (unsigned int)k);
+	}
+	if (!scene.textured[k])
+	{
+		double* colors[3];
+		for (int i = 0; i < 3; i++)
+			colors[i] = scene.colors + face[i] * scene.nb_colors;
+		rasterize_triangle_interpolated(ij, depths, colors, z_buffer, image, scene.height, scene.width, scene.nb_colors, face_ids, (unsigned int)k);
+	}
+}
 
+void render_scene_edge(const Scene& scene, int k, int n, double* image, double* z_buffer, double sigma, int* Texture_size, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL)
+{
+	// draw the edge n of the face k with the antialiasing edge overdraw
 	int list_sub[3][2] = { 1,0,2,1,0,2 };
+	unsigned int * face = &scene.faces[k * 3];
+	double ij[2][2];
+	int* sub;
+	sub = list_sub[n];
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[face[sub[i]] * 2 + j];
+
+	double depths[2];
+	for (int i = 0; i < 2; i++)
+	{
+		depths[i] = scene.depths[face[sub[i]]];
+	}
+
+	if ((scene.textured[k]) && (scene.shaded[k]))
+	{
+		unsigned int * face_uv = &scene.faces_uv[k * 3];
+
+		double uv[2][2];
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 2; j++)
+				uv[i][j] = scene.uv[face_uv[sub[i]] * 2 + j] - 1;
+		double shade[2];
+		for (int i = 0; i < 2; i++)
+			shade[i] = scene.shade[face[sub[i]]];
+		if (antialiaseError)
+			rasterize_edge_textured_gouraud_error(ij, depths, uv, shade, z_buffer, obs, err_buffer, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size, sigma, scene.clockwise);
+		else
+			rasterize_edge_textured_gouraud(ij, depths, uv, shade, z_buffer, image, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size, sigma, scene.clockwise);
+
+	}
+	else
+	{
+		double* colors[2];
+		for (int i = 0; i < 2; i++)
+		{
+			colors[i] = scene.colors + face[sub[i]] * scene.nb_colors;
+		}
+		if (antialiaseError)
+			rasterize_edge_interpolated_error(ij, depths, colors, z_buffer, obs, err_buffer, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
+		else
+			rasterize_edge_interpolated(ij, image, colors, z_buffer, depths, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
+
+	}
+}
+
+void renderScene(Scene scene, double* image, double* z_buffer, double sigma, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL, unsigned int* face_ids = NULL)
+{
+	// face_ids, if not NULL, receives the id of the face visible in each pixel before the edge
+	// antialiasing, the pixels not covered by any face are left untouched
+	
+	checkSceneValid(scene, false);
+	// first pass : render triangle without edge antialiasing
+
+	int Texture_size[2];
+
+	Texture_size[1] = scene.texture_height;
+	Texture_size[0] = scene.texture_width;
+
+	memcpy(image, scene.background, (size_t)scene.height*scene.width*scene.nb_colors * sizeof(double));
+	//for (int k=0;k<scene.height*scene.width;k++)
+	//z_buffer[k]=100000;
+	fill(z_buffer, z_buffer + (size_t)scene.height*scene.width, numeric_limits<double>::infinity());
+
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_scene_faces_order_and_areas(scene, sum_depth, signedAreaV);
+
+	for (int k = 0; k < scene.nb_triangles; k++)
+		if ((signedAreaV[k] > 0)||(!scene.backface_culling))
+			render_scene_triangle(scene, k, image, z_buffer, Texture_size, face_ids);
 
 	if (antialiaseError)
 	{
-		for (int k = 0; k < scene.width*scene.height; k++)
+		for (size_t k = 0; k < (size_t)scene.width*scene.height; k++)
 		{
 			double s = 0;
 			double d;
@@ -2287,289 +2365,207 @@ void renderScene(Scene scene, double* image, double* z_buffer, double sigma, boo
 		for (int it = 0; it < scene.nb_triangles; it++)
 		{
 			size_t k = sum_depth[it].index;// we render the silhoutette edges from the furthest from the camera to the nearest as we don't use z_buffer for discontinuity edge overdraw
-			unsigned int * face = &scene.faces[k * 3];
 
-			//k=order[i];
 			if (signedAreaV[k] > 0)
+				for (int n = 0; n < 3; n++)
+					if (scene.edgeflags[n + k * 3])
+						render_scene_edge(scene, k, n, image, z_buffer, sigma, Texture_size, antialiaseError, obs, err_buffer);
+		}
+	}
+}
+
+void render_scene_edge_B(const Scene& scene, int k, int n, double* image, double* z_buffer, double* image_b, double sigma, int* Texture_size, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL, double* err_buffer_b = NULL)
+{
+	int list_sub[3][2] = { 1,0,2,1,0,2 };
+	unsigned int * face = &scene.faces[k * 3];
+	double ij[2][2];
+	int* sub;
+	sub = list_sub[n];
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[face[sub[i]] * 2 + j];
+	double ij_b[2][2];
+	sub = list_sub[n];
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+			ij_b[i][j] = scene.ij_b[face[sub[i]] * 2 + j];
+	double depths[2];
+	for (int i = 0; i < 2; i++)
+	{
+		depths[i] = scene.depths[face[sub[i]]];
+	}
+
+	if ((scene.textured[k]) && (scene.shaded[k]))
+	{
+
+		unsigned int * face_uv = &scene.faces_uv[k * 3];
+		double uv[2][2];
+		double uv_b[2][2];
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 2; j++)
 			{
+				uv[i][j] = scene.uv[face_uv[sub[i]] * 2 + j] - 1;
+				uv_b[i][j] = scene.uv_b[face_uv[sub[i]] * 2 + j];
+			}
 
-				for (int n = 0; n < 3; n++)
-				{
+		double shade[2];
+		double shade_b[2];
+		for (int i = 0; i < 2; i++)
+		{
+			shade[i] = scene.shade[face[sub[i]]];
+			shade_b[i] = scene.shade_b[face[sub[i]]];
+		}
 
-					if (scene.edgeflags[n + k * 3])
-					{
-						double ij[2][2];
-						int* sub;
-						sub = list_sub[n];
-						for (int i = 0; i < 2; i++)
-							for (int j = 0; j < 2; j++)
-								ij[i][j] = scene.ij[face[sub[i]] * 2 + j];
-
-						double depths[2];
-						for (int i = 0; i < 2; i++)
-						{
-							depths[i] = scene.depths[face[sub[i]]];
-						}
-
-						if ((scene.textured[k]) && (scene.shaded[k]))
-						{
-							unsigned int * face_uv = &scene.faces_uv[k * 3];
-
-							double uv[2][2];
-							for (int i = 0; i < 2; i++)
-								for (int j = 0; j < 2; j++)
-									uv[i][j] = scene.uv[face_uv[sub[i]] * 2 + j] - 1;
-							double shade[2];
-							for (int i = 0; i < 2; i++)
-								shade[i] = scene.shade[face[sub[i]]];
-							if (antialiaseError)
-								rasterize_edge_textured_gouraud_error(ij, depths, uv, shade, z_buffer, obs, err_buffer, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size, sigma, scene.clockwise);
-							else
-								rasterize_edge_textured_gouraud(ij, depths, uv, shade, z_buffer, image, scene.height, scene.width, scene.nb_colors, scene.texture, Texture_size, sigma, scene.clockwise);
-
-						}
-						else
-						{
-							double* colors[2];
-							for (int i = 0; i < 2; i++)
-							{
-								colors[i] = scene.colors + face[sub[i]] * scene.nb_colors;
-							}
-							if (antialiaseError)
-								rasterize_edge_interpolated_error(ij, depths, colors, z_buffer, obs, err_buffer, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
-							else
-								rasterize_edge_interpolated(ij, image, colors, z_buffer, depths, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
-
-						}
-					}
-				}
+		if (antialiaseError)
+		{
+			rasterize_edge_textured_gouraud_error_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, obs, err_buffer, err_buffer_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size, sigma, scene.clockwise);
+		}
+		else
+		{
+			rasterize_edge_textured_gouraud_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size, sigma, scene.clockwise);
+		}
+
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 2; j++)
+			{
+				scene.uv_b[face_uv[sub[i]] * 2 + j] = uv_b[i][j];
 			}
+		for (int i = 0; i < 2; i++)
+		{
+			scene.shade_b[face[sub[i]]] = shade_b[i];
 		}
+
 	}
+	else
+	{
+		double * colors[2];
+		double * colors_b[2];
+
+		for (int i = 0; i < 2; i++)
+		{
+			colors[i] = scene.colors + face[sub[i]] * scene.nb_colors;
+			colors_b[i] = scene.colors_b + face[sub[i]] * scene.nb_colors;
+		}
+
+		if (antialiaseError)
+			rasterize_edge_interpolated_error_B(ij, ij_b, depths, colors, colors_b, z_buffer, obs, err_buffer, err_buffer_b, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
+		else
+			rasterize_edge_interpolated_B(ij, ij_b, image, image_b, colors, colors_b, z_buffer, depths, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
+	}
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+		{
+			scene.ij_b[face[sub[i]] * 2 + j] = ij_b[i][j];
+		}
 }
 
-void renderScene_B(Scene scene, double* image, double* z_buffer, double* image_b, double sigma, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL, double* err_buffer_b = NULL)
+void render_scene_triangle_B(const Scene& scene, int k, double* image, double* z_buffer, double* image_b, int* Texture_size)
 {
+	unsigned int * face = &scene.faces[k * 3];
+	double ij[3][2];
+	double ij_b[3][2];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 2; j++)
+			ij[i][j] = scene.ij[face[i] * 2 + j];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 2; j++)
+			ij_b[i][j] = scene.ij_b[face[i] * 2 + j];
 
-	// first pass : render triangle without edge antialiasing
-	
-	int Texture_size[2];
+	double depths[3];
+	for (int i = 0; i < 3; i++)
+	{
+		depths[i] = scene.depths[face[i]];
+	}
 
-	Texture_size[1] = scene.texture_height;
-	Texture_size[0] = scene.texture_width;
+	if (scene.textured[k] && scene.shaded[k])
+	{
 
-	checkSceneValid(scene, true);
+		unsigned int * face_uv = &scene.faces_uv[k * 3];
+		double uv[3][2];
+		double uv_b[3][2];
+		double shade[3];
+		double shade_b[3];
 
-	int list_sub[3][2] = { 1,0,2,1,0,2 };
+		for (int i = 0; i < 3; i++)
+			shade[i] = scene.shade[face[i]];
 
-	vector<sortdata> sum_depth;
-	sum_depth.resize(scene.nb_triangles);
-	vector<double> signedAreaV;
-	signedAreaV.resize(scene.nb_triangles);
+		for (int i = 0; i < 3; i++)
+			shade_b[i] = scene.shade_b[face[i]];
 
-	for (int k = 0; k < scene.nb_triangles; k++)
-	{
-		sum_depth[k].value = 0;
-		sum_depth[k].index = k;
-		
-		bool all_verticesInFront=true;
-		unsigned int * face = &scene.faces[k * 3];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+			{
+				uv[i][j] = scene.uv[face_uv[i] * 2 + j] - 1;
+				uv_b[i][j] = scene.uv_b[face_uv[i] * 2 + j];
+			}
 
+		rasterize_triangle_textured_gouraud_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size);
 		for (int i = 0; i < 3; i++)
-		{
-			if (scene.depths[face[i]]<0)
+			for (int j = 0; j < 2; j++)
 			{
-				all_verticesInFront=false;
+				scene.uv_b[face_uv[i] * 2 + j] = uv_b[i][j];
 			}
-			sum_depth[k].value += scene.depths[face[i]];
-		}
-		if (all_verticesInFront)
-		{	
-			double ij[3][2];
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 2; j++)
-					ij[i][j] = scene.ij[face[i] * 2 + j];
-			signedAreaV[k] = signedArea(ij,scene.clockwise);
-		}
-		else
+		for (int i = 0; i < 3; i++)
+			scene.shade_b[face[i]] = shade_b[i];
+
+	}
+	if (!scene.textured[k])
+	{
+		double* colors[3];
+		double* colors_b[3];
+
+		for (int i = 0; i < 3; i++)
 		{
-			signedAreaV[k]=0;
+			colors[i] = scene.colors + face[i] * scene.nb_colors;
+			colors_b[i] = scene.colors_b + face[i] * scene.nb_colors;
 		}
+
+		rasterize_triangle_interpolated_B(ij, ij_b, depths, colors, colors_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors);
 	}
+
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 2; j++)
+			scene.ij_b[face[i] * 2 + j] = ij_b[i][j];
+}
+
+void renderScene_B(Scene scene, double* image, double* z_buffer, double* image_b, double sigma, bool antialiaseError = 0, double* obs = NULL, double*  err_buffer = NULL, double* err_buffer_b = NULL)
+{
+
+	// first pass : render triangle without edge antialiasing
 	
-	sort(sum_depth.begin(), sum_depth.end(), sortcompare());
+	int Texture_size[2];
+
+	Texture_size[1] = scene.texture_height;
+	Texture_size[0] = scene.texture_width;
+
+	checkSceneValid(scene, true);
+
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_scene_faces_order_and_areas(scene, sum_depth, signedAreaV);
 
 	if (sigma > 0)
 		for (int it = scene.nb_triangles - 1; it >= 0; it--)
 		{
 			size_t k = sum_depth[it].index;
-			unsigned int * face = &scene.faces[k * 3];
 
 			if (signedAreaV[k] > 0)
 				for (int n = 2; n >= 0; n--)
-				{
 					if (scene.edgeflags[n + k * 3])
-					{
-						double ij[2][2];
-						int* sub;
-						sub = list_sub[n];
-						for (int i = 0; i < 2; i++)
-							for (int j = 0; j < 2; j++)
-								ij[i][j] = scene.ij[face[sub[i]] * 2 + j];
-						double ij_b[2][2];
-						sub = list_sub[n];
-						for (int i = 0; i < 2; i++)
-							for (int j = 0; j < 2; j++)
-								ij_b[i][j] = scene.ij_b[face[sub[i]] * 2 + j];
-						double depths[2];
-						for (int i = 0; i < 2; i++)
-						{
-							depths[i] = scene.depths[face[sub[i]]];
-						}
-
-						if ((scene.textured[k]) && (scene.shaded[k]))
-						{
-
-							unsigned int * face_uv = &scene.faces_uv[k * 3];
-							double uv[2][2];
-							double uv_b[2][2];
-							for (int i = 0; i < 2; i++)
-								for (int j = 0; j < 2; j++)
-								{
-									uv[i][j] = scene.uv[face_uv[sub[i]] * 2 + j] - 1;
-									uv_b[i][j] = scene.uv_b[face_uv[sub[i]] * 2 + j];
-								}
-
-							double shade[2];
-							double shade_b[2];
-							for (int i = 0; i < 2; i++)
-							{
-								shade[i] = scene.shade[face[sub[i]]];
-								shade_b[i] = scene.shade_b[face[sub[i]]];
-							}
-
-							if (antialiaseError)
-							{
-								rasterize_edge_textured_gouraud_error_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, obs, err_buffer, err_buffer_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size, sigma, scene.clockwise);
-							}
-							else
-							{
-								rasterize_edge_textured_gouraud_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size, sigma, scene.clockwise);
-							}
-
-							for (int i = 0; i < 2; i++)
-								for (int j = 0; j < 2; j++)
-								{
-									scene.uv_b[face_uv[sub[i]] * 2 + j] = uv_b[i][j];
-								}
-							for (int i = 0; i < 2; i++)
-							{
-								scene.shade_b[face[sub[i]]] = shade_b[i];
-							}
-
-						}
-						else
-						{
-							double * colors[2];
-							double * colors_b[2];
-
-							for (int i = 0; i < 2; i++)
-							{
-								colors[i] = scene.colors + face[sub[i]] * scene.nb_colors;
-								colors_b[i] = scene.colors_b + face[sub[i]] * scene.nb_colors;
-							}
-
-							if (antialiaseError)
-								rasterize_edge_interpolated_error_B(ij, ij_b, depths, colors, colors_b, z_buffer, obs, err_buffer, err_buffer_b, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
-							else
-								rasterize_edge_interpolated_B(ij, ij_b, image, image_b, colors, colors_b, z_buffer, depths, scene.height, scene.width, scene.nb_colors, sigma, scene.clockwise);
-						}
-						for (int i = 0; i < 2; i++)
-							for (int j = 0; j < 2; j++)
-							{
-								scene.ij_b[face[sub[i]] * 2 + j] = ij_b[i][j];
-							}
-					}
-				}
+						render_scene_edge_B(scene, k, n, image, z_buffer, image_b, sigma, Texture_size, antialiaseError, obs, err_buffer, err_buffer_b);
 		}
 
 	if (antialiaseError)
 	{
-		image_b = new double[scene.width*scene.height*scene.nb_colors];
-		for (int k = 0; k < scene.width*scene.height; k++)
+		image_b = new double[(size_t)scene.width*scene.height*scene.nb_colors];
+		for (size_t k = 0; k < (size_t)scene.width*scene.height; k++)
 			for (int i = 0; i < scene.nb_colors; i++)
 				image_b[scene.nb_colors*k + i] = -2 * (obs[scene.nb_colors*k + i] - image[scene.nb_colors*k + i])*err_buffer_b[k];
 	}
 
 	for (int k = scene.nb_triangles - 1; k >= 0; k--)
 		if (signedAreaV[k] > 0)
-		{
-			unsigned int * face = &scene.faces[k * 3];
-			double ij[3][2];
-			double ij_b[3][2];
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 2; j++)
-					ij[i][j] = scene.ij[face[i] * 2 + j];
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 2; j++)
-					ij_b[i][j] = scene.ij_b[face[i] * 2 + j];
-
-			double depths[3];
-			for (int i = 0; i < 3; i++)
-			{
-				depths[i] = scene.depths[face[i]];
-			}
-
-			if (scene.textured[k] && scene.shaded[k])
-			{
-
-				unsigned int * face_uv = &scene.faces_uv[k * 3];
-				double uv[3][2];
-				double uv_b[3][2];
-				double shade[3];
-				double shade_b[3];
-
-				for (int i = 0; i < 3; i++)
-					shade[i] = scene.shade[face[i]];
-
-				for (int i = 0; i < 3; i++)
-					shade_b[i] = scene.shade_b[face[i]];
-
-				for (int i = 0; i < 3; i++)
-					for (int j = 0; j < 2; j++)
-					{
-						uv[i][j] = scene.uv[face_uv[i] * 2 + j] - 1;
-						uv_b[i][j] = scene.uv_b[face_uv[i] * 2 + j];
-					}
-
-				rasterize_triangle_textured_gouraud_B(ij, ij_b, depths, uv, uv_b, shade, shade_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors, scene.texture, scene.texture_b, Texture_size);
-				for (int i = 0; i < 3; i++)
-					for (int j = 0; j < 2; j++)
-					{
-						scene.uv_b[face_uv[i] * 2 + j] = uv_b[i][j];
-					}
-				for (int i = 0; i < 3; i++)
-					scene.shade_b[face[i]] = shade_b[i];
-
-			}
-			if (!scene.textured[k])
-			{
-				double* colors[3];
-				double* colors_b[3];
-
-				for (int i = 0; i < 3; i++)
-				{
-					colors[i] = scene.colors + face[i] * scene.nb_colors;
-					colors_b[i] = scene.colors_b + face[i] * scene.nb_colors;
-				}
-
-				rasterize_triangle_interpolated_B(ij, ij_b, depths, colors, colors_b, z_buffer, image, image_b, scene.height, scene.width, scene.nb_colors);
-			}
-
-			for (int i = 0; i < 3; i++)
-				for (int j = 0; j < 2; j++)
-					scene.ij_b[face[i] * 2 + j] = ij_b[i][j];
-		}
+			render_scene_triangle_B(scene, k, image, z_buffer, image_b, Texture_size);
 
 	if (antialiaseError)
 	{
@@ -2577,9 +2573,4 @@ void renderScene_B(Scene scene, double* image, double* z_buffer, double* image_b
 	}
 }
 
-
-
-
-
-
-
+#endif
@@ -0,0 +1,225 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _FrameRenderer_h_
+#define _FrameRenderer_h_
+
+// Render several batches of triangles into the same image and z_buffer, without concatenating their
+// arrays into a single scene. begin_frame initializes the buffers from the background, each call to
+// draw_batch rasterizes the triangles of one batch against the shared z_buffer, and end_frame draws
+// the antialiasing edge overdraw of all the batches sorted globally from the furthest to the nearest,
+// which gives the same image as rendering the concatenated scene. The batches only hold pointers to
+// the arrays of the caller, which should remain valid until the adjoint has been computed. The adjoint
+// accumulates the gradients into the _b buffers of each batch.
+// A frame can also start from a cached z_buffer, and a batch can be drawn without its triangles when
+// they are already in the background, in which case only its silhouette edges are drawn by end_frame
+// and its triangles are skipped by the adjoint.
+
+#include "DifferentiableRenderer.h"
+
+struct batch_sortdata {
+	double value;
+	int batch;
+	int index;
+};
+
+struct batch_sortcompare {
+	bool operator()(batch_sortdata const &left, batch_sortdata const &right) {
+		return left.value > right.value;
+	}
+};
+
+class FrameRenderer {
+public:
+	int height;
+	int width;
+	int nb_colors;
+	double* image;
+	double* z_buffer;
+	vector<Scene> batches;
+	vector<vector<double> > signed_areas;
+	vector<unsigned char> batches_triangles;
+	vector<batch_sortdata> edges_order;
+	bool frame_open;
+
+	FrameRenderer()
+	{
+		height = 0;
+		width = 0;
+		nb_colors = 0;
+		image = NULL;
+		z_buffer = NULL;
+		frame_open = false;
+	}
+
+	void begin_frame(int height, int width, int nb_colors, const double* background, double* image, double* z_buffer, const double* z_buffer_background = NULL)
+	{
+		// z_buffer_background is the z_buffer of the geometry already drawn in the background, if any
+		if ((height <= 0) || (width <= 0) || (nb_colors <= 0))
+			throw "invalid frame dimensions";
+		this->height = height;
+		this->width = width;
+		this->nb_colors = nb_colors;
+		this->image = image;
+		this->z_buffer = z_buffer;
+		batches.clear();
+		batches_triangles.clear();
+		signed_areas.clear();
+		edges_order.clear();
+		memcpy(image, background, (size_t)height * width * nb_colors * sizeof(double));
+		if (z_buffer_background)
+			memcpy(z_buffer, z_buffer_background, (size_t)height * width * sizeof(double));
+		else
+			fill(z_buffer, z_buffer + (size_t)height * width, numeric_limits<double>::infinity());
+		frame_open = true;
+	}
+
+	void draw_batch(const Scene& scene, bool draw_triangles = true)
+	{
+		// rasterize the triangles of the batch, its edges are drawn by end_frame
+		if (!frame_open)
+			throw "draw_batch should be called between begin_frame and end_frame";
+		if ((scene.height != height) || (scene.width != width) || (scene.nb_colors != nb_colors))
+			throw "the batch dimensions do not match the frame dimensions";
+		checkSceneValid(scene, false);
+
+		int Texture_size[2];
+		Texture_size[1] = scene.texture_height;
+		Texture_size[0] = scene.texture_width;
+
+		int batch = (int)batches.size();
+		batches.push_back(scene);
+		batches_triangles.push_back(draw_triangles);
+		signed_areas.push_back(vector<double>());
+		vector<sortdata> sum_depth;
+		get_scene_faces_order_and_areas(scene, sum_depth, signed_areas[batch]);
+		const vector<double>& signedAreaV = signed_areas[batch];
+
+		if (draw_triangles)
+			for (int k = 0; k < scene.nb_triangles; k++)
+				if ((signedAreaV[k] > 0) || (!scene.backface_culling))
+					render_scene_triangle(scene, k, image, z_buffer, Texture_size);
+
+		for (int it = 0; it < scene.nb_triangles; it++)
+			if (signedAreaV[sum_depth[it].index] > 0)
+			{
+				batch_sortdata d;
+				d.value = sum_depth[it].value;
+				d.batch = batch;
+				d.index = (int)sum_depth[it].index;
+				edges_order.push_back(d);
+			}
+	}
+
+	void end_frame(double sigma, bool antialiaseError = 0, double* obs = NULL, double* err_buffer = NULL)
+	{
+		// draw the silhouette edges of all the batches from the furthest to the nearest
+		if (!frame_open)
+			throw "end_frame should be called after begin_frame";
+		frame_open = false;
+		stable_sort(edges_order.begin(), edges_order.end(), batch_sortcompare());
+
+		if (antialiaseError)
+		{
+			for (size_t k = 0; k < (size_t)width * height; k++)
+			{
+				double s = 0;
+				double d;
+				for (int i = 0; i < nb_colors; i++)
+				{
+					d = (image[nb_colors * k + i] - obs[nb_colors * k + i]);
+					s += d * d;
+				}
+				err_buffer[k] = s;
+			}
+		}
+
+		if (sigma > 0)
+			for (size_t it = 0; it < edges_order.size(); it++)
+			{
+				const Scene& scene = batches[edges_order[it].batch];
+				int k = edges_order[it].index;
+				int Texture_size[2];
+				Texture_size[1] = scene.texture_height;
+				Texture_size[0] = scene.texture_width;
+				for (int n = 0; n < 3; n++)
+					if (scene.edgeflags[n + k * 3])
+						render_scene_edge(scene, k, n, image, z_buffer, sigma, Texture_size, antialiaseError, obs, err_buffer);
+			}
+	}
+
+	void render_B(double* image, double* image_b, double sigma, bool antialiaseError = 0, double* obs = NULL, double* err_buffer = NULL, double* err_buffer_b = NULL)
+	{
+		// adjoint of the whole frame, image and err_buffer are the buffers filled by end_frame or copies
+		// of them, they are modified in place
+		if (frame_open)
+			throw "the adjoint should be computed after end_frame";
+		for (size_t b = 0; b < batches.size(); b++)
+			checkSceneValid(batches[b], true);
+
+		if (sigma > 0)
+			for (int it = (int)edges_order.size() - 1; it >= 0; it--)
+			{
+				const Scene& scene = batches[edges_order[it].batch];
+				int k = edges_order[it].index;
+				int Texture_size[2];
+				Texture_size[1] = scene.texture_height;
+				Texture_size[0] = scene.texture_width;
+				for (int n = 2; n >= 0; n--)
+					if (scene.edgeflags[n + k * 3])
+						render_scene_edge_B(scene, k, n, image, z_buffer, image_b, sigma, Texture_size, antialiaseError, obs, err_buffer, err_buffer_b);
+			}
+
+		vector<double> image_b_error;
+		if (antialiaseError)
+		{
+			image_b_error.resize((size_t)width * height * nb_colors);
+			for (size_t k = 0; k < (size_t)width * height; k++)
+				for (int i = 0; i < nb_colors; i++)
+					image_b_error[nb_colors * k + i] = -2 * (obs[nb_colors * k + i] - image[nb_colors * k + i]) * err_buffer_b[k];
+			image_b = &image_b_error[0];
+		}
+
+		for (int b = (int)batches.size() - 1; b >= 0; b--)
+		{
+			if (!batches_triangles[b])
+				continue;
+			const Scene& scene = batches[b];
+			int Texture_size[2];
+			Texture_size[1] = scene.texture_height;
+			Texture_size[0] = scene.texture_width;
+			for (int k = scene.nb_triangles - 1; k >= 0; k--)
+				if (signed_areas[b][k] > 0)
+					render_scene_triangle_B(scene, k, image, z_buffer, image_b, Texture_size);
+		}
+	}
+};
+
+#endif
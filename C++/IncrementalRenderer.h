@@ -0,0 +1,169 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _IncrementalRenderer_h_
+#define _IncrementalRenderer_h_
+
+// Incremental rendering of a scene of which only a few vertices change between two calls. The image,
+// the z_buffer and the id of the face visible in each pixel are kept in persistent buffers given to
+// render, which renders the whole image and should be called again if the buffers move. update takes the list of the vertices that changed since the last call and
+// re-renders only the dirty region, the bounding box of the previous and new positions of the faces
+// adjacent to these vertices enlarged by the width of the edge stencils. The faces and edges that do
+// not overlap the dirty region are culled and the buffers outside of it are left untouched, which gives
+// the same buffers as a full rendering since the changed faces do not contribute outside of it.
+// The topology of the scene should not change between render and the following calls to update.
+
+#include "DeferredRenderer.h"
+#include "ROIRenderer.h"
+
+class IncrementalRenderer {
+public:
+	double sigma;
+	int height;
+	int width;
+	int nb_colors;
+	int nb_vertices;
+	int nb_triangles;
+	double* image;
+	double* z_buffer;
+	unsigned int* face_ids;
+	vector<double> ij_previous;
+	vector<vector<int> > vertices_faces;
+	int dirty[4];
+
+	IncrementalRenderer(double sigma)
+	{
+		this->sigma = sigma;
+		height = width = nb_colors = nb_vertices = nb_triangles = 0;
+		image = NULL;
+		z_buffer = NULL;
+		face_ids = NULL;
+		dirty[0] = dirty[1] = dirty[2] = dirty[3] = 0;
+	}
+
+	void render(const Scene& scene, double* image, double* z_buffer, unsigned int* face_ids)
+	{
+		// image is height x width x nb_colors, z_buffer and face_ids are height x width
+		checkSceneValid(scene, false);
+		height = scene.height;
+		width = scene.width;
+		nb_colors = scene.nb_colors;
+		nb_vertices = scene.nb_vertices;
+		nb_triangles = scene.nb_triangles;
+		this->image = image;
+		this->z_buffer = z_buffer;
+		this->face_ids = face_ids;
+		vertices_faces.assign(nb_vertices, vector<int>());
+		for (int k = 0; k < nb_triangles; k++)
+			for (int i = 0; i < 3; i++)
+				vertices_faces[scene.faces[3 * k + i]].push_back(k);
+		ij_previous.assign(scene.ij, scene.ij + 2 * nb_vertices);
+		render_region(scene, 0, 0, width, height);
+	}
+
+	void update(const Scene& scene, int nb_changed, const int* changed_vertices)
+	{
+		// re-render the region affected by the vertices whose position, depth or attributes changed
+		if (!image)
+			throw "render should be called before update";
+		if ((scene.height != height) || (scene.width != width) || (scene.nb_colors != nb_colors) || (scene.nb_vertices != nb_vertices) || (scene.nb_triangles != nb_triangles))
+			throw "the scene does not match the scene given to render";
+		checkSceneValid(scene, false);
+		double xmin = numeric_limits<double>::infinity(), xmax = -xmin;
+		double ymin = xmin, ymax = -xmin;
+		for (int c = 0; c < nb_changed; c++)
+		{
+			int v = changed_vertices[c];
+			if ((v < 0) || (v >= nb_vertices))
+				throw "changed vertex id out of range";
+			for (size_t f = 0; f < vertices_faces[v].size(); f++)
+				for (int i = 0; i < 3; i++)
+				{
+					unsigned int w = scene.faces[3 * vertices_faces[v][f] + i];
+					const double* positions[2] = { &ij_previous[2 * w], &scene.ij[2 * w] };
+					for (int p = 0; p < 2; p++)
+					{
+						xmin = min(xmin, positions[p][0]);
+						xmax = max(xmax, positions[p][0]);
+						ymin = min(ymin, positions[p][1]);
+						ymax = max(ymax, positions[p][1]);
+					}
+				}
+		}
+		for (int c = 0; c < nb_changed; c++)
+		{
+			int v = changed_vertices[c];
+			ij_previous[2 * v] = scene.ij[2 * v];
+			ij_previous[2 * v + 1] = scene.ij[2 * v + 1];
+		}
+
+		double margin = (sigma > 0 ? sigma : 0) + 1;
+		int x_begin = max(0, floor_to_int(xmin - margin));
+		int x_end = min(width, floor_to_int(xmax + margin) + 2);
+		int y_begin = max(0, floor_to_int(ymin - margin));
+		int y_end = min(height, floor_to_int(ymax + margin) + 2);
+		if ((x_end <= x_begin) || (y_end <= y_begin))
+		{
+			dirty[0] = dirty[1] = dirty[2] = dirty[3] = 0;
+			return;
+		}
+		render_region(scene, x_begin, y_begin, x_end - x_begin, y_end - y_begin);
+	}
+
+	void render_region(const Scene& scene, int x0, int y0, int region_width, int region_height)
+	{
+		dirty[0] = x0;
+		dirty[1] = y0;
+		dirty[2] = region_width;
+		dirty[3] = region_height;
+		SceneROIView view;
+		get_scene_roi_view(scene, x0, y0, region_width, region_height, sigma, true, view);
+		size_t nb_pixels = (size_t)region_width * region_height;
+		vector<double> image_region(nb_pixels * nb_colors);
+		vector<double> z_buffer_region(nb_pixels);
+		vector<unsigned int> face_ids_region(nb_pixels, GBUFFER_NO_FACE);
+		renderScene(view.scene, &image_region[0], &z_buffer_region[0], sigma, false, NULL, NULL, &face_ids_region[0]);
+
+		size_t row_size = (size_t)region_width * nb_colors;
+		for (int y = 0; y < region_height; y++)
+		{
+			size_t offset = (size_t)(y + y0) * width + x0;
+			memcpy(&image[offset * nb_colors], &image_region[y * row_size], row_size * sizeof(double));
+			memcpy(&z_buffer[offset], &z_buffer_region[(size_t)y * region_width], region_width * sizeof(double));
+			for (int x = 0; x < region_width; x++)
+			{
+				unsigned int face_id = face_ids_region[(size_t)y * region_width + x];
+				face_ids[offset + x] = (face_id == GBUFFER_NO_FACE) ? GBUFFER_NO_FACE : view.faces_ids[face_id];
+			}
+		}
+	}
+};
+
+#endif
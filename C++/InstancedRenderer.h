@@ -0,0 +1,236 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _InstancedRenderer_h_
+#define _InstancedRenderer_h_
+
+// Render several instances of the same mesh in a single image, each instance being the template
+// vertices scaled and displaced by per instance offsets, then rotated and translated. The instances
+// share the topology, the colors or the texture, the lights, the camera and the background of a
+// Scene3DPipeline used as configuration. Each instance is transformed on the fly from the template
+// vertices, lit and projected by its own pipeline, in parallel, and the resulting 2D scenes are
+// rasterized as the batches of a single frame sharing the z_buffer and the ordering of the silhouette
+// edges. The adjoint returns the gradients with respect to the pose, the scale and the offsets of each
+// instance, and the gradients with respect to the shared template vertices, colors or texture and lights
+// summed over the instances, accumulated in per thread buffers for the vertices and colors and in a
+// single buffer for the texture as the rasterization adjoint is sequential.
+
+#include "Scene3DPipeline.h"
+#include "FrameRenderer.h"
+#include "ParallelFor.h"
+
+class InstancedRenderer {
+public:
+	// inputs, set by the caller before calling render. The arrays are not copied and should remain valid
+	// until render_backward has been called.
+	Scene3DPipeline* pipeline; // configuration shared by the instances, its vertices are the template
+	int nb_instances;
+	double* quaternions;       // nb_instances x 4, NULL for no rotation
+	double* translations;      // nb_instances x 3, NULL for no translation
+	double* scales;            // nb_instances, NULL for no scaling
+	double* offsets;           // nb_instances x nb_vertices x 3 added to the scaled template, NULL for none
+
+	// outputs
+	vector<double> image;
+	vector<double> z_buffer;
+	double loss;
+
+	// gradients, overwritten by render_backward
+	vector<double> vertices_b;
+	vector<double> quaternions_b;
+	vector<double> translations_b;
+	vector<double> scales_b;
+	vector<double> offsets_b;
+	double light_directional_b[3];
+	double light_ambient_b;
+	vector<double> vertices_colors_b;
+	vector<double> texture_b;
+
+	InstancedRenderer(Scene3DPipeline* pipeline)
+	{
+		this->pipeline = pipeline;
+		nb_instances = 0;
+		quaternions = NULL;
+		translations = NULL;
+		scales = NULL;
+		offsets = NULL;
+		loss = 0;
+		obs = NULL;
+		nb_instances_rendered = 0;
+	}
+
+	double render(double* obs = NULL)
+	{
+		// render all the instances and return the sum of squared differences with obs if obs is not NULL
+		if ((pipeline->shape_basis != NULL) || (pipeline->texture_basis != NULL) || (pipeline->skinning != NULL))
+			throw "the instanced rendering does not support linear models and skinning";
+		if (pipeline->render_depth)
+			throw "the instanced rendering does not support depth rendering";
+		if ((pipeline->vertices == NULL) || (pipeline->background == NULL))
+			throw "vertices and background should be set before calling render";
+		if (nb_instances <= 0)
+			throw "nb_instances should be positive";
+		this->obs = obs;
+		nb_instances_rendered = 0;
+		int nb_vertices = pipeline->topology->nb_vertices;
+		instances.resize(nb_instances, Scene3DPipeline(pipeline->topology));
+
+		// the instances accumulate the texture gradient in texture_b, which should not be reallocated
+		// before render_backward
+		if (pipeline->texture != NULL)
+			texture_b.assign((size_t)pipeline->texture_height * pipeline->texture_width * pipeline->nb_colors, 0.0);
+		else
+			texture_b.clear();
+
+		parallel_for(nb_instances, pipeline->nb_threads, 1, [&](int begin, int end, int)
+		{
+			for (int n = begin; n < end; n++)
+			{
+				Scene3DPipeline& instance = instances[n];
+				instance.set_configuration(*pipeline);
+				instance.nb_threads = 1;
+				instance.quaternion = (quaternions != NULL) ? &quaternions[4 * n] : NULL;
+				instance.translation = (translations != NULL) ? &translations[3 * n] : NULL;
+				instance.vertices_scale = (scales != NULL) ? scales[n] : 1;
+				instance.vertices_offsets = (offsets != NULL) ? &offsets[(size_t)3 * nb_vertices * n] : NULL;
+				instance.texture_b_accumulator = (pipeline->texture != NULL) ? &texture_b[0] : NULL;
+				instance.prepare_scene();
+			}
+		});
+
+		const Camera& camera = pipeline->camera;
+		int nb_colors = pipeline->nb_colors;
+		image.resize((size_t)camera.height * camera.width * nb_colors);
+		z_buffer.resize((size_t)camera.height * camera.width);
+		frame.begin_frame(camera.height, camera.width, nb_colors, pipeline->background, &image[0], &z_buffer[0]);
+		for (int n = 0; n < nb_instances; n++)
+			frame.draw_batch(instances[n].get_scene());
+		frame.end_frame(pipeline->sigma);
+		nb_instances_rendered = nb_instances;
+
+		loss = 0;
+		if (obs != NULL)
+			for (size_t k = 0; k < image.size(); k++)
+			{
+				double d = image[k] - obs[k];
+				loss += d * d;
+			}
+		return loss;
+	}
+
+	void render_backward(double* image_b = NULL)
+	{
+		// backpropagate image_b, or the gradient of the loss if image_b is NULL, down to the inputs
+		if ((nb_instances_rendered == 0) || (nb_instances_rendered != nb_instances))
+			throw "render should be called before render_backward";
+		int nb_vertices = pipeline->topology->nb_vertices;
+		image_work.assign(image.begin(), image.end()); // the adjoint undoes the antialiasing in place
+		image_b_work.resize(image.size());
+		if (image_b == NULL)
+		{
+			if (obs == NULL)
+				throw "render should be called with an observation to backpropagate the loss";
+			for (size_t k = 0; k < image.size(); k++)
+				image_b_work[k] = 2 * (image[k] - obs[k]);
+		}
+		else
+			image_b_work.assign(image_b, image_b + image.size());
+
+		for (int n = 0; n < nb_instances; n++)
+			instances[n].clear_scene_gradients();
+		fill(texture_b.begin(), texture_b.end(), 0.0);
+		frame.render_B(&image_work[0], &image_b_work[0], pipeline->sigma);
+
+		// the instances add their gradients with respect to the template vertices and the vertices colors
+		// in the buffer of the thread that processes them
+
+		int nb_threads = get_nb_threads(pipeline->nb_threads);
+		size_t colors_size = (pipeline->texture == NULL) ? (size_t)nb_vertices * pipeline->nb_colors : 0;
+		vertices_b_threads.assign((size_t)nb_threads * 3 * nb_vertices, 0.0);
+		vertices_colors_b_threads.assign(nb_threads * colors_size, 0.0);
+		offsets_b.assign((offsets != NULL) ? (size_t)3 * nb_vertices * nb_instances : 0, 0.0);
+		parallel_for(nb_instances, nb_threads, 1, [&](int begin, int end, int thread_id)
+		{
+			for (int n = begin; n < end; n++)
+			{
+				Scene3DPipeline& instance = instances[n];
+				instance.vertices_b_accumulator = &vertices_b_threads[(size_t)thread_id * 3 * nb_vertices];
+				instance.vertices_colors_b_accumulator = (colors_size > 0) ? &vertices_colors_b_threads[thread_id * colors_size] : NULL;
+				instance.vertices_offsets_b = (offsets != NULL) ? &offsets_b[(size_t)3 * nb_vertices * n] : NULL;
+				instance.prepare_scene_backward();
+			}
+		});
+
+		// reduce the gradients of the threads and of the instances
+
+		vertices_b.assign(3 * nb_vertices, 0.0);
+		vertices_colors_b.assign(colors_size, 0.0);
+		for (int t = 0; t < nb_threads; t++)
+		{
+			for (int k = 0; k < 3 * nb_vertices; k++)
+				vertices_b[k] += vertices_b_threads[(size_t)t * 3 * nb_vertices + k];
+			for (size_t k = 0; k < colors_size; k++)
+				vertices_colors_b[k] += vertices_colors_b_threads[t * colors_size + k];
+		}
+		quaternions_b.assign((quaternions != NULL) ? 4 * nb_instances : 0, 0.0);
+		translations_b.assign((translations != NULL) ? 3 * nb_instances : 0, 0.0);
+		scales_b.assign((scales != NULL) ? nb_instances : 0, 0.0);
+		for (int i = 0; i < 3; i++)
+			light_directional_b[i] = 0;
+		light_ambient_b = 0;
+		for (int n = 0; n < nb_instances; n++)
+		{
+			const Scene3DPipeline& instance = instances[n];
+			if (scales != NULL)
+				scales_b[n] = instance.vertices_scale_b;
+			if (quaternions != NULL)
+				for (int i = 0; i < 4; i++)
+					quaternions_b[4 * n + i] = instance.quaternion_b[i];
+			if (translations != NULL)
+				for (int i = 0; i < 3; i++)
+					translations_b[3 * n + i] = instance.translation_b[i];
+			for (int i = 0; i < 3; i++)
+				light_directional_b[i] += instance.light_directional_b[i];
+			light_ambient_b += instance.light_ambient_b;
+		}
+	}
+
+private:
+	double* obs;
+	int nb_instances_rendered;
+	vector<Scene3DPipeline> instances;
+	FrameRenderer frame;
+	vector<double> image_work;
+	vector<double> image_b_work;
+	vector<double> vertices_b_threads;
+	vector<double> vertices_colors_b_threads;
+};
+
+#endif
@@ -0,0 +1,332 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _LaplacianRigidEnergy_h_
+#define _LaplacianRigidEnergy_h_
+
+// As-rigid-as-possible energy 0.5 * cregu * sum_c (x_c - x_ref_c)^T L^T L (x_c - x_ref_c)
+// where x_c is the c-th coordinate of the vertices and L the Laplacian matrix of the mesh.
+// The matrix L^T L is stored once in compressed row format and applied to each of the 3 coordinates.
+// The regularized hessian cregu * L^T L + regularization * I can be factorized once using a sparse LDL^T
+// decomposition with a reverse Cuthill-McKee ordering to take preconditioned or Gauss-Newton steps.
+
+#include <vector>
+#include <algorithm>
+#include "ParallelFor.h"
+
+using namespace std;
+
+void reverse_cuthill_mckee(int n, const int* start, const int* columns, int* permutation)
+{
+	// bandwidth reducing ordering of a symmetric sparse matrix, one breadth first search
+	// per connected component starting from a vertex with the smallest degree
+	vector<int> degree(n);
+	for (int i = 0; i < n; i++)
+		degree[i] = start[i + 1] - start[i];
+	vector<unsigned char> visited(n, 0);
+	vector<int> order;
+	order.reserve(n);
+	vector<int> by_degree(n);
+	for (int i = 0; i < n; i++)
+		by_degree[i] = i;
+	stable_sort(by_degree.begin(), by_degree.end(), [&](int a, int b) { return degree[a] < degree[b]; });
+	vector<int> neighbors;
+	for (int s = 0; s < n; s++)
+	{
+		int seed = by_degree[s];
+		if (visited[seed])
+			continue;
+		visited[seed] = 1;
+		size_t head = order.size();
+		order.push_back(seed);
+		while (head < order.size())
+		{
+			int i = order[head++];
+			neighbors.clear();
+			for (int k = start[i]; k < start[i + 1]; k++)
+				if (!visited[columns[k]])
+				{
+					visited[columns[k]] = 1;
+					neighbors.push_back(columns[k]);
+				}
+			stable_sort(neighbors.begin(), neighbors.end(), [&](int a, int b) { return degree[a] < degree[b]; });
+			order.insert(order.end(), neighbors.begin(), neighbors.end());
+		}
+	}
+	for (int i = 0; i < n; i++)
+		permutation[i] = order[n - 1 - i];
+}
+
+class SparseLDL {
+	// LDL^T factorization of a symmetric positive definite matrix given in compressed row format,
+	// following the up-looking algorithm of T. Davis' LDL package, with a fill reducing permutation.
+public:
+	int n;
+	vector<int> P;
+	vector<int> Pinv;
+	vector<int> Lp;
+	vector<int> Li;
+	vector<double> Lx;
+	vector<double> D;
+
+	void factorize(int n, const int* Ap, const int* Ai, const double* Ax, const int* permutation)
+	{
+		this->n = n;
+		P.assign(permutation, permutation + n);
+		Pinv.resize(n);
+		for (int k = 0; k < n; k++)
+			Pinv[P[k]] = k;
+
+		// symbolic factorization: elimination tree and number of non zeros in each column of L
+		vector<int> parent(n), flag(n), Lnz(n);
+		for (int k = 0; k < n; k++)
+		{
+			parent[k] = -1;
+			flag[k] = k;
+			Lnz[k] = 0;
+			int kk = P[k];
+			for (int p = Ap[kk]; p < Ap[kk + 1]; p++)
+			{
+				int i = Pinv[Ai[p]];
+				if (i < k)
+					for (; flag[i] != k; i = parent[i])
+					{
+						if (parent[i] == -1)
+							parent[i] = k;
+						Lnz[i]++;
+						flag[i] = k;
+					}
+			}
+		}
+		Lp.resize(n + 1);
+		Lp[0] = 0;
+		for (int k = 0; k < n; k++)
+			Lp[k + 1] = Lp[k] + Lnz[k];
+		Li.resize(Lp[n]);
+		Lx.resize(Lp[n]);
+		D.resize(n);
+
+		// numerical factorization
+		vector<double> Y(n, 0.0);
+		vector<int> pattern(n);
+		for (int k = 0; k < n; k++)
+		{
+			Y[k] = 0;
+			int top = n;
+			flag[k] = k;
+			Lnz[k] = 0;
+			int kk = P[k];
+			for (int p = Ap[kk]; p < Ap[kk + 1]; p++)
+			{
+				int i = Pinv[Ai[p]];
+				if (i <= k)
+				{
+					Y[i] += Ax[p];
+					int len = 0;
+					for (; flag[i] != k; i = parent[i])
+					{
+						pattern[len++] = i;
+						flag[i] = k;
+					}
+					while (len > 0)
+						pattern[--top] = pattern[--len];
+				}
+			}
+			D[k] = Y[k];
+			Y[k] = 0;
+			for (; top < n; top++)
+			{
+				int i = pattern[top];
+				double yi = Y[i];
+				Y[i] = 0;
+				int p2 = Lp[i] + Lnz[i];
+				for (int p = Lp[i]; p < p2; p++)
+					Y[Li[p]] -= Lx[p] * yi;
+				double l_ki = yi / D[i];
+				D[k] -= l_ki * yi;
+				Li[p2] = k;
+				Lx[p2] = l_ki;
+				Lnz[i]++;
+			}
+			if (D[k] <= 0)
+				throw "the matrix is not positive definite, increase the regularization";
+		}
+	}
+
+	void solve(const double* b, double* x, int stride) const
+	{
+		// solve A x = b where b and x are vectors with elements separated by stride, used to solve
+		// independently for each coordinate of an array of points
+		vector<double> y(n);
+		for (int k = 0; k < n; k++)
+			y[k] = b[P[k] * stride];
+		for (int j = 0; j < n; j++)
+			for (int p = Lp[j]; p < Lp[j + 1]; p++)
+				y[Li[p]] -= Lx[p] * y[j];
+		for (int j = 0; j < n; j++)
+			y[j] /= D[j];
+		for (int j = n - 1; j >= 0; j--)
+			for (int p = Lp[j]; p < Lp[j + 1]; p++)
+				y[j] -= Lx[p] * y[Li[p]];
+		for (int k = 0; k < n; k++)
+			x[P[k] * stride] = y[k];
+	}
+};
+
+class LaplacianRigidEnergy {
+public:
+	int nb_vertices;
+	double cregu;
+	int nb_threads;
+	// L^T L in compressed row format
+	vector<int> LtL_start;
+	vector<int> LtL_columns;
+	vector<double> LtL_values;
+	vector<double> vertices_ref;
+
+	LaplacianRigidEnergy(int nb_vertices, const int* indptr, const int* indices, const double* values, const double* vertices_ref, double cregu)
+	{
+		this->nb_vertices = nb_vertices;
+		this->cregu = cregu;
+		nb_threads = 0;
+		LtL_start.assign(indptr, indptr + nb_vertices + 1);
+		int nnz = indptr[nb_vertices];
+		LtL_columns.assign(indices, indices + nnz);
+		LtL_values.assign(values, values + nnz);
+		for (int k = 0; k < nnz; k++)
+			if ((indices[k] < 0) || (indices[k] >= nb_vertices))
+				throw "invalid column index in the L^T L matrix";
+		set_vertices_ref(vertices_ref);
+		factorized_regularization = -1;
+		factorized_cregu = 0;
+	}
+
+	void set_vertices_ref(const double* vertices_ref)
+	{
+		this->vertices_ref.assign(vertices_ref, vertices_ref + 3 * nb_vertices);
+	}
+
+	double evaluate(const double* vertices, double* grad)
+	{
+		// return the energy and write its gradient with respect to the vertices in grad
+		diff.resize(3 * nb_vertices);
+		for (int k = 0; k < 3 * nb_vertices; k++)
+			diff[k] = vertices[k] - vertices_ref[k];
+		int nb_threads_used = get_nb_threads(nb_threads);
+		vector<double> energy_threads(nb_threads_used, 0.0);
+		parallel_for(nb_vertices, nb_threads_used, 2048, [&](int begin, int end, int thread_id)
+		{
+			double energy = 0;
+			for (int i = begin; i < end; i++)
+			{
+				double s[3] = { 0, 0, 0 };
+				for (int k = LtL_start[i]; k < LtL_start[i + 1]; k++)
+				{
+					const double* d = &diff[3 * LtL_columns[k]];
+					double value = LtL_values[k];
+					s[0] += value * d[0];
+					s[1] += value * d[1];
+					s[2] += value * d[2];
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					grad[3 * i + c] = cregu * s[c];
+					energy += diff[3 * i + c] * grad[3 * i + c];
+				}
+			}
+			energy_threads[thread_id] = energy;
+		});
+		double energy = 0;
+		for (int t = 0; t < nb_threads_used; t++)
+			energy += energy_threads[t];
+		return 0.5 * energy;
+	}
+
+	void factorize(double regularization)
+	{
+		// factorize cregu * L^T L + regularization * I, the regularization makes the matrix
+		// positive definite as L^T L is singular (it has the constant vectors in its kernel)
+		if ((regularization == factorized_regularization) && (cregu == factorized_cregu))
+			return;
+		vector<int> start(nb_vertices + 1);
+		vector<int> columns;
+		vector<double> values;
+		columns.reserve(LtL_columns.size() + nb_vertices);
+		values.reserve(LtL_columns.size() + nb_vertices);
+		start[0] = 0;
+		for (int i = 0; i < nb_vertices; i++)
+		{
+			bool has_diagonal = false;
+			for (int k = LtL_start[i]; k < LtL_start[i + 1]; k++)
+			{
+				double value = cregu * LtL_values[k];
+				if (LtL_columns[k] == i)
+				{
+					value += regularization;
+					has_diagonal = true;
+				}
+				columns.push_back(LtL_columns[k]);
+				values.push_back(value);
+			}
+			if (!has_diagonal)
+			{
+				columns.push_back(i);
+				values.push_back(regularization);
+			}
+			start[i + 1] = (int)columns.size();
+		}
+		vector<int> permutation(nb_vertices);
+		reverse_cuthill_mckee(nb_vertices, &start[0], &columns[0], &permutation[0]);
+		factorization.factorize(nb_vertices, &start[0], &columns[0], &values[0], &permutation[0]);
+		factorized_regularization = regularization;
+		factorized_cregu = cregu;
+	}
+
+	void solve(const double* rhs, double* x, double regularization)
+	{
+		// solve (cregu * L^T L + regularization * I) x = rhs for each coordinate, with rhs and x of size
+		// nb_vertices x 3. The factorization is computed on the first call and reused while the
+		// regularization and cregu do not change.
+		factorize(regularization);
+		parallel_for(3, nb_threads, 1, [&](int begin, int end, int)
+		{
+			for (int c = begin; c < end; c++)
+				factorization.solve(rhs + c, x + c, 3);
+		});
+	}
+
+private:
+	vector<double> diff;
+	SparseLDL factorization;
+	double factorized_regularization;
+	double factorized_cregu;
+};
+
+#endif
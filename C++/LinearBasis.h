@@ -0,0 +1,137 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _LinearBasis_h_
+#define _LinearBasis_h_
+
+// Linear model values = mean + coefs * basis used for blendshapes, PCA shape models or PCA texture models.
+// The basis is stored in float32 by blocks of block_size consecutive values, with all the components of a
+// block stored contiguously, so that both the evaluation and its adjoint stream through memory once and
+// each block can be processed by a different thread without synchronization.
+
+#include <vector>
+#include "ParallelFor.h"
+
+using namespace std;
+
+class LinearBasis {
+public:
+	int nb_components;
+	int size;
+	int block_size;
+	vector<float> mean;
+	vector<float> basis_blocked;
+
+	LinearBasis(int nb_components, int size, const double* mean, const double* basis, int block_size = 256)
+	{
+		// basis is a nb_components x size matrix stored row major, mean can be NULL for a zero mean
+		if ((nb_components <= 0) || (size <= 0) || (block_size <= 0))
+			throw "invalid linear basis dimensions";
+		this->nb_components = nb_components;
+		this->size = size;
+		this->block_size = block_size;
+		this->mean.assign(size, 0.f);
+		if (mean != NULL)
+			for (int i = 0; i < size; i++)
+				this->mean[i] = (float)mean[i];
+		int nb_blocks = get_nb_blocks();
+		basis_blocked.assign((size_t)nb_blocks * block_size * nb_components, 0.f);
+		for (int b = 0; b < nb_blocks; b++)
+		{
+			int begin = b * block_size;
+			int end = (begin + block_size < size) ? begin + block_size : size;
+			float* block = &basis_blocked[(size_t)b * block_size * nb_components];
+			for (int k = 0; k < nb_components; k++)
+				for (int i = begin; i < end; i++)
+					block[k * block_size + i - begin] = (float)basis[(size_t)k * size + i];
+		}
+	}
+
+	int get_nb_blocks() const
+	{
+		return (size + block_size - 1) / block_size;
+	}
+
+	void evaluate(const double* coefs, double* values, int nb_threads = 0) const
+	{
+		parallel_for(get_nb_blocks(), nb_threads, 1, [&](int block_begin, int block_end, int)
+		{
+			vector<double> accumulator(block_size);
+			for (int b = block_begin; b < block_end; b++)
+			{
+				int begin = b * block_size;
+				int length = (begin + block_size < size) ? block_size : size - begin;
+				const float* block = &basis_blocked[(size_t)b * block_size * nb_components];
+				for (int i = 0; i < length; i++)
+					accumulator[i] = mean[begin + i];
+				for (int k = 0; k < nb_components; k++)
+				{
+					double c = coefs[k];
+					const float* row = &block[k * block_size];
+					for (int i = 0; i < length; i++)
+						accumulator[i] += c * row[i];
+				}
+				for (int i = 0; i < length; i++)
+					values[begin + i] = accumulator[i];
+			}
+		});
+	}
+
+	void evaluate_B(const double* values_B, double* coefs_B, int nb_threads = 0) const
+	{
+		// accumulates the gradient with respect to the coefficients into coefs_B
+		nb_threads = get_nb_threads(nb_threads);
+		vector<double> coefs_B_threads((size_t)nb_threads * nb_components, 0.0);
+		parallel_for(get_nb_blocks(), nb_threads, 1, [&](int block_begin, int block_end, int thread_id)
+		{
+			double* coefs_B_thread = &coefs_B_threads[(size_t)thread_id * nb_components];
+			for (int b = block_begin; b < block_end; b++)
+			{
+				int begin = b * block_size;
+				int length = (begin + block_size < size) ? block_size : size - begin;
+				const float* block = &basis_blocked[(size_t)b * block_size * nb_components];
+				const double* v_B = &values_B[begin];
+				for (int k = 0; k < nb_components; k++)
+				{
+					const float* row = &block[k * block_size];
+					double s = 0;
+					for (int i = 0; i < length; i++)
+						s += row[i] * v_B[i];
+					coefs_B_thread[k] += s;
+				}
+			}
+		});
+		for (int t = 0; t < nb_threads; t++)
+			for (int k = 0; k < nb_components; k++)
+				coefs_B[k] += coefs_B_threads[(size_t)t * nb_components + k];
+	}
+};
+
+#endif
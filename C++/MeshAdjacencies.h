@@ -0,0 +1,194 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _MeshAdjacencies_h_
+#define _MeshAdjacencies_h_
+
+// Adjacency tables of a triangulated mesh computed in O(F log F) time and O(F) memory using a sort based
+// deduplication of the edges. Edges are numbered by increasing (min vertex id, max vertex id), which gives
+// the same numbering as np.unique on the edge ids in TriMeshAdjacencies.
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+struct edgesortdata {
+	unsigned long long key;
+	int face_edge;
+};
+
+struct edgesortcompare {
+	bool operator()(edgesortdata const &left, edgesortdata const &right) {
+		if (left.key == right.key)
+			return left.face_edge < right.face_edge;
+		return left.key < right.key;
+	}
+};
+
+struct MeshAdjacencies {
+	int nb_vertices;
+	int nb_faces;
+	int nb_edges;
+	// edge n of face k joins the vertices faces[3*k+n] and faces[3*k+(n+1)%3]
+	vector<int> faces_edges;
+	// vertices of each edge, smallest id first
+	vector<int> edges;
+	// number of faces adjacent to each edge
+	vector<int> edges_nb_faces;
+	bool is_manifold;
+	bool is_closed;
+	bool has_boundaries;
+	// Laplacian matrix diag(degree) - adjacency in compressed row format with sorted columns
+	vector<int> laplacian_start;
+	vector<int> laplacian_columns;
+	vector<double> laplacian_values;
+};
+
+void build_mesh_adjacencies(MeshAdjacencies &adjacencies, const unsigned int* faces, int nb_faces, int nb_vertices, bool compute_laplacian = true)
+{
+	adjacencies.nb_faces = nb_faces;
+	adjacencies.nb_vertices = nb_vertices;
+	for (int k = 0; k < 3 * nb_faces; k++)
+		if (faces[k] >= (unsigned int)nb_vertices)
+			throw "faces value greater than nb_vertices";
+
+	vector<edgesortdata> sorted_edges(3 * nb_faces);
+	for (int k = 0; k < nb_faces; k++)
+		for (int n = 0; n < 3; n++)
+		{
+			unsigned long long a = faces[3 * k + n];
+			unsigned long long b = faces[3 * k + (n + 1) % 3];
+			edgesortdata &e = sorted_edges[3 * k + n];
+			e.key = (a < b) ? a * nb_vertices + b : b * nb_vertices + a;
+			e.face_edge = 3 * k + n;
+		}
+	sort(sorted_edges.begin(), sorted_edges.end(), edgesortcompare());
+
+	adjacencies.faces_edges.resize(3 * nb_faces);
+	adjacencies.edges.clear();
+	adjacencies.edges_nb_faces.clear();
+	adjacencies.is_manifold = true;
+	int nb_edges = 0;
+	int nb_increasing = 0;
+	int nb_decreasing = 0;
+	for (int i = 0; i < 3 * nb_faces; i++)
+	{
+		int face_edge = sorted_edges[i].face_edge;
+		unsigned int a = faces[face_edge];
+		unsigned int b = faces[face_edge - face_edge % 3 + (face_edge % 3 + 1) % 3];
+		if ((i == 0) || (sorted_edges[i].key != sorted_edges[i - 1].key))
+		{
+			nb_edges++;
+			adjacencies.edges.push_back(min(a, b));
+			adjacencies.edges.push_back(max(a, b));
+			adjacencies.edges_nb_faces.push_back(0);
+			nb_increasing = 0;
+			nb_decreasing = 0;
+		}
+		// a manifold edge is shared by at most two faces traversing it in opposite directions
+		if (a < b)
+			nb_increasing++;
+		else
+			nb_decreasing++;
+		if ((nb_increasing > 1) || (nb_decreasing > 1))
+			adjacencies.is_manifold = false;
+		adjacencies.faces_edges[face_edge] = nb_edges - 1;
+		adjacencies.edges_nb_faces[nb_edges - 1]++;
+	}
+	adjacencies.nb_edges = nb_edges;
+	adjacencies.is_closed = adjacencies.is_manifold;
+	adjacencies.has_boundaries = false;
+	for (int e = 0; e < nb_edges; e++)
+	{
+		if (adjacencies.edges_nb_faces[e] > 2)
+			adjacencies.is_manifold = false;
+		if (adjacencies.edges_nb_faces[e] != 2)
+			adjacencies.is_closed = false;
+		if (adjacencies.edges_nb_faces[e] == 1)
+			adjacencies.has_boundaries = true;
+	}
+	adjacencies.is_closed = adjacencies.is_closed && adjacencies.is_manifold;
+	if (!compute_laplacian)
+		return;
+
+	// Laplacian, the neighbors of each vertex are the other extremities of its edges, degenerated
+	// edges joining a vertex to itself are ignored
+
+	vector<int> degree(nb_vertices, 0);
+	for (int e = 0; e < nb_edges; e++)
+		if (adjacencies.edges[2 * e] != adjacencies.edges[2 * e + 1])
+		{
+			degree[adjacencies.edges[2 * e]]++;
+			degree[adjacencies.edges[2 * e + 1]]++;
+		}
+	adjacencies.laplacian_start.resize(nb_vertices + 1);
+	adjacencies.laplacian_start[0] = 0;
+	for (int v = 0; v < nb_vertices; v++)
+		adjacencies.laplacian_start[v + 1] = adjacencies.laplacian_start[v] + degree[v] + 1;
+	int nnz = adjacencies.laplacian_start[nb_vertices];
+	adjacencies.laplacian_columns.resize(nnz);
+	adjacencies.laplacian_values.resize(nnz);
+	vector<int> fill_position(adjacencies.laplacian_start.begin(), adjacencies.laplacian_start.end() - 1);
+	for (int v = 0; v < nb_vertices; v++)
+	{
+		adjacencies.laplacian_columns[fill_position[v]] = v;
+		adjacencies.laplacian_values[fill_position[v]++] = degree[v];
+	}
+	for (int e = 0; e < nb_edges; e++)
+	{
+		int a = adjacencies.edges[2 * e];
+		int b = adjacencies.edges[2 * e + 1];
+		if (a == b)
+			continue;
+		adjacencies.laplacian_columns[fill_position[a]] = b;
+		adjacencies.laplacian_values[fill_position[a]++] = -1;
+		adjacencies.laplacian_columns[fill_position[b]] = a;
+		adjacencies.laplacian_values[fill_position[b]++] = -1;
+	}
+	// sort the columns of each row, the rows are short
+	vector<pair<int, double>> row;
+	for (int v = 0; v < nb_vertices; v++)
+	{
+		int start = adjacencies.laplacian_start[v];
+		int end = adjacencies.laplacian_start[v + 1];
+		row.clear();
+		for (int k = start; k < end; k++)
+			row.push_back(make_pair(adjacencies.laplacian_columns[k], adjacencies.laplacian_values[k]));
+		sort(row.begin(), row.end());
+		for (int k = start; k < end; k++)
+		{
+			adjacencies.laplacian_columns[k] = row[k - start].first;
+			adjacencies.laplacian_values[k] = row[k - start].second;
+		}
+	}
+}
+
+#endif
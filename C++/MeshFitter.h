@@ -0,0 +1,289 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _MeshFitter_h_
+#define _MeshFitter_h_
+
+// Native version of the step method of the python MeshDepthFitter and MeshRGBFitterWithPose classes.
+// Runs several iterations of the damped momentum descent on the vertices, the rigid pose and, when fitting
+// colors, the lights and the mesh color, without going back to python between iterations.
+
+#include "Scene3DPipeline.h"
+#include "LaplacianRigidEnergy.h"
+
+inline double mult_and_clamp(double x, double a, double t)
+{
+	double y = x * a;
+	if (y < -t)
+		y = -t;
+	if (y > t)
+		y = t;
+	return y;
+}
+
+class MeshFitter {
+public:
+	// the pipeline camera, background, sigma and render_depth mode are set by the caller.
+	Scene3DPipeline* pipeline;
+	LaplacianRigidEnergy* rigid_energy;
+	double* observation;   // height x width x nb_colors
+	double max_depth;      // the depth is clipped to [0, max_depth] when the pipeline renders depth
+
+	double inertia;
+	double damping;
+	double step_factor_vertices;
+	double step_max_vertices;
+	double step_factor_quaternion;
+	double step_max_quaternion;
+	double step_factor_translation;
+	double step_max_translation;
+	double step_factor_light_directional;
+	double step_factor_light_ambient;
+	double step_factor_color;
+	bool update_lights;
+	bool update_color;
+
+	// optimized variables and their speeds
+	vector<double> vertices;
+	vector<double> speed_vertices;
+	double quaternion[4];
+	double speed_quaternion[4];
+	double translation[3];
+	double speed_translation[3];
+	double light_directional[3];
+	double speed_light_directional[3];
+	double light_ambient;
+	double speed_light_ambient;
+	vector<double> color;
+	vector<double> speed_color;
+
+	// energies of each iteration of the last call to run
+	vector<double> energies;
+	vector<double> energies_data;
+	vector<double> energies_rigid;
+	// per pixel squared difference of the last iteration
+	vector<double> diff_image;
+
+	MeshFitter(Scene3DPipeline* pipeline, LaplacianRigidEnergy* rigid_energy)
+	{
+		this->pipeline = pipeline;
+		this->rigid_energy = rigid_energy;
+		int nb_vertices = pipeline->topology->nb_vertices;
+		if (rigid_energy->nb_vertices != nb_vertices)
+			throw "the rigid energy and the pipeline topology have different number of vertices";
+		observation = NULL;
+		max_depth = numeric_limits<double>::infinity();
+		inertia = 0.96;
+		damping = 0.05;
+		step_factor_vertices = 0.0005;
+		step_max_vertices = 0.5;
+		step_factor_quaternion = 0.00006;
+		step_max_quaternion = 0.05;
+		step_factor_translation = 0.00005;
+		step_max_translation = 0.1;
+		step_factor_light_directional = 0.0001;
+		step_factor_light_ambient = 0.0001;
+		step_factor_color = 0.00001;
+		update_lights = true;
+		update_color = true;
+		vertices.assign(rigid_energy->vertices_ref.begin(), rigid_energy->vertices_ref.end());
+		speed_vertices.assign(3 * nb_vertices, 0.0);
+		for (int i = 0; i < 4; i++)
+		{
+			quaternion[i] = (i == 3) ? 1 : 0;
+			speed_quaternion[i] = 0;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			translation[i] = 0;
+			speed_translation[i] = 0;
+			light_directional[i] = 0;
+			speed_light_directional[i] = 0;
+		}
+		light_ambient = 1;
+		speed_light_ambient = 0;
+	}
+
+	void run(int nb_iterations)
+	{
+		if (observation == NULL)
+			throw "the observation should be set before running the fitter";
+		int nb_vertices = pipeline->topology->nb_vertices;
+		bool fit_colors = !pipeline->render_depth;
+		if (fit_colors && ((int)color.size() != pipeline->nb_colors))
+			throw "the color should have nb_colors elements";
+
+		pipeline->vertices = &vertices[0];
+		pipeline->quaternion = quaternion;
+		pipeline->translation = translation;
+		if (fit_colors)
+		{
+			pipeline->light_directional = light_directional;
+			vertices_colors.resize(nb_vertices * color.size());
+			pipeline->vertices_colors = &vertices_colors[0];
+			speed_color.resize(color.size(), 0.0);
+		}
+		grad_rigidity.resize(3 * nb_vertices);
+		energies.clear();
+		energies_data.clear();
+		energies_rigid.clear();
+		int image_size = pipeline->camera.height * pipeline->camera.width;
+		int nb_colors = pipeline->nb_colors;
+		image_b.resize(image_size * nb_colors);
+		diff_image.resize(image_size);
+
+		for (int iter = 0; iter < nb_iterations; iter++)
+		{
+			center(&vertices[0], nb_vertices);
+			if (fit_colors)
+			{
+				pipeline->light_ambient = light_ambient;
+				for (int v = 0; v < nb_vertices; v++)
+					for (int c = 0; c < nb_colors; c++)
+						vertices_colors[v * nb_colors + c] = color[c];
+			}
+			pipeline->render(NULL);
+
+			double energy_data = 0;
+			for (int p = 0; p < image_size; p++)
+			{
+				double s = 0;
+				for (int c = 0; c < nb_colors; c++)
+				{
+					int k = p * nb_colors + c;
+					double value = pipeline->image[k];
+					if (!fit_colors)
+					{
+						// clipped depth, the gradient is zero outside the clipping range
+						if ((value < 0) || (value > max_depth))
+						{
+							value = (value < 0) ? 0 : max_depth;
+							double d = value - observation[k];
+							s += d * d;
+							image_b[k] = 0;
+							continue;
+						}
+					}
+					double d = value - observation[k];
+					s += d * d;
+					image_b[k] = 2 * d;
+				}
+				diff_image[p] = s;
+				energy_data += s;
+			}
+
+			double energy_rigid = rigid_energy->evaluate(&vertices[0], &grad_rigidity[0]);
+			energies.push_back(energy_data + energy_rigid);
+			energies_data.push_back(energy_data);
+			energies_rigid.push_back(energy_rigid);
+
+			pipeline->render_backward(&image_b[0]);
+			vector<double> &vertices_b = pipeline->vertices_b;
+			center(&vertices_b[0], nb_vertices);
+
+			// update vertices
+			for (int k = 0; k < 3 * nb_vertices; k++)
+			{
+				double step = mult_and_clamp(-(vertices_b[k] + grad_rigidity[k]), step_factor_vertices, step_max_vertices);
+				speed_vertices[k] = update_speed(speed_vertices[k], step);
+				vertices[k] = vertices[k] + speed_vertices[k];
+			}
+			// update rotation
+			for (int i = 0; i < 4; i++)
+			{
+				double step = mult_and_clamp(-pipeline->quaternion_b[i], step_factor_quaternion, step_max_quaternion);
+				speed_quaternion[i] = update_speed(speed_quaternion[i], step);
+				quaternion[i] = quaternion[i] + speed_quaternion[i];
+			}
+			double norm = sqrt(quaternion[0] * quaternion[0] + quaternion[1] * quaternion[1] + quaternion[2] * quaternion[2] + quaternion[3] * quaternion[3]);
+			for (int i = 0; i < 4; i++)
+				quaternion[i] = quaternion[i] / norm;
+			// update translation
+			for (int i = 0; i < 3; i++)
+			{
+				double step = mult_and_clamp(-pipeline->translation_b[i], step_factor_translation, step_max_translation);
+				speed_translation[i] = update_speed(speed_translation[i], step);
+				translation[i] = translation[i] + speed_translation[i];
+			}
+
+			if (!fit_colors)
+				continue;
+			if (update_lights)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					double step = -pipeline->light_directional_b[i] * step_factor_light_directional;
+					speed_light_directional[i] = update_speed(speed_light_directional[i], step);
+					light_directional[i] = light_directional[i] + speed_light_directional[i];
+				}
+				double step = -pipeline->light_ambient_b * step_factor_light_ambient;
+				speed_light_ambient = update_speed(speed_light_ambient, step);
+				light_ambient = light_ambient + speed_light_ambient;
+			}
+			if (update_color)
+			{
+				for (int c = 0; c < nb_colors; c++)
+				{
+					double color_b = 0;
+					for (int v = 0; v < nb_vertices; v++)
+						color_b += pipeline->vertices_colors_b[v * nb_colors + c];
+					double step = -color_b * step_factor_color;
+					speed_color[c] = update_speed(speed_color[c], step);
+					color[c] = color[c] + speed_color[c];
+				}
+			}
+		}
+	}
+
+private:
+	vector<double> vertices_colors;
+	vector<double> grad_rigidity;
+	vector<double> image_b;
+
+	inline double update_speed(double speed, double step)
+	{
+		return (1 - damping) * (speed * inertia + (1 - inertia) * step);
+	}
+
+	static void center(double* points, int nb_points)
+	{
+		double mean[3] = { 0, 0, 0 };
+		for (int v = 0; v < nb_points; v++)
+			for (int i = 0; i < 3; i++)
+				mean[i] += points[3 * v + i];
+		for (int i = 0; i < 3; i++)
+			mean[i] /= nb_points;
+		for (int v = 0; v < nb_points; v++)
+			for (int i = 0; i < 3; i++)
+				points[3 * v + i] -= mean[i];
+	}
+};
+
+#endif
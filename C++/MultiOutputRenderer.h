@@ -0,0 +1,195 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _MultiOutputRenderer_h_
+#define _MultiOutputRenderer_h_
+
+// Render the colors, the depth and the antialiased silhouette mask of a scene sharing a single
+// visibility resolution: the faces are sorted once, the triangles are rasterized once into the color
+// image and the z_buffer from which the depth and the mask interiors are read, and the silhouette edges
+// are drawn into the three images in a single loop. The adjoint accumulates the gradients of the three
+// outputs in one sweep. The depth or the mask can be skipped by passing NULL pointers.
+
+#include "DifferentiableRenderer.h"
+#include "DepthMaskRenderer.h"
+
+DepthMaskScene get_depth_mask_view(const Scene& scene, double* background, double* depths_b)
+{
+	DepthMaskScene view;
+	view.faces = scene.faces;
+	view.depths = scene.depths;
+	view.ij = scene.ij;
+	view.edgeflags = scene.edgeflags;
+	view.nb_triangles = scene.nb_triangles;
+	view.nb_vertices = scene.nb_vertices;
+	view.clockwise = scene.clockwise;
+	view.backface_culling = scene.backface_culling;
+	view.height = scene.height;
+	view.width = scene.width;
+	view.background = background;
+	view.ij_b = scene.ij_b;
+	view.depths_b = depths_b;
+	return view;
+}
+
+void renderSceneMultiOutput(Scene scene, double* image, double* z_buffer, double sigma, double depth_scale, double* depth_background, double* depth, double* mask)
+{
+	// image is height x width x nb_colors, depth and mask are height x width
+	checkSceneValid(scene, false);
+	if ((depth != NULL) && (depth_background == NULL))
+		throw "depth_background should be provided when rendering the depth";
+	DepthMaskScene view = get_depth_mask_view(scene, depth_background, NULL);
+
+	int Texture_size[2];
+	Texture_size[1] = scene.texture_height;
+	Texture_size[0] = scene.texture_width;
+
+	memcpy(image, scene.background, (size_t)scene.height*scene.width*scene.nb_colors * sizeof(double));
+	fill(z_buffer, z_buffer + (size_t)scene.height*scene.width, numeric_limits<double>::infinity());
+
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_scene_faces_order_and_areas(scene, sum_depth, signedAreaV);
+
+	for (int k = 0; k < scene.nb_triangles; k++)
+		if ((signedAreaV[k] > 0) || (!scene.backface_culling))
+			render_scene_triangle(scene, k, image, z_buffer, Texture_size);
+
+	for (size_t k = 0; k < (size_t)scene.height * scene.width; k++)
+	{
+		bool covered = z_buffer[k] < numeric_limits<double>::infinity();
+		if (depth != NULL)
+			depth[k] = covered ? z_buffer[k] * depth_scale : depth_background[k];
+		if (mask != NULL)
+			mask[k] = covered ? 1 : 0;
+	}
+
+	if (sigma > 0)
+		for (int it = 0; it < scene.nb_triangles; it++)
+		{
+			size_t k = sum_depth[it].index;
+			if (signedAreaV[k] > 0)
+				for (int n = 0; n < 3; n++)
+					if (scene.edgeflags[n + k * 3])
+					{
+						render_scene_edge(scene, k, n, image, z_buffer, sigma, Texture_size);
+						double ij[2][2];
+						double depths[2];
+						get_edge_ij_depths(view, k, n, ij, depths);
+						if (depth != NULL)
+						{
+							double A[2] = { depths[0] * depth_scale, depths[1] * depth_scale };
+							double* Avertex[2] = { &A[0], &A[1] };
+							rasterize_edge_interpolated(ij, depth, Avertex, z_buffer, depths, scene.height, scene.width, 1, sigma, scene.clockwise);
+						}
+						if (mask != NULL)
+							rasterize_edge_coverage(ij, depths, mask, z_buffer, scene.height, scene.width, sigma, scene.clockwise);
+					}
+		}
+}
+
+void renderSceneMultiOutput_B(Scene scene, double* image, double* z_buffer, double* image_b, double sigma, double depth_scale, double* depth, double* depth_b, double* mask, double* mask_b, double* depths_b)
+{
+	// accumulate the adjoints of the outputs that have a non NULL adjoint into the scene adjoint fields
+	// and depths_b (nb_vertices). The images are modified in place.
+	checkSceneValid(scene, true);
+	if ((depth_b != NULL) && ((depth == NULL) || (depths_b == NULL)))
+		throw "depth and depths_b should be provided with depth_b";
+	if ((mask_b != NULL) && (mask == NULL))
+		throw "mask should be provided with mask_b";
+	DepthMaskScene view = get_depth_mask_view(scene, NULL, depths_b);
+
+	int Texture_size[2];
+	Texture_size[1] = scene.texture_height;
+	Texture_size[0] = scene.texture_width;
+
+	vector<sortdata> sum_depth;
+	vector<double> signedAreaV;
+	get_scene_faces_order_and_areas(scene, sum_depth, signedAreaV);
+
+	if (sigma > 0)
+		for (int it = scene.nb_triangles - 1; it >= 0; it--)
+		{
+			size_t k = sum_depth[it].index;
+			if (signedAreaV[k] > 0)
+				for (int n = 2; n >= 0; n--)
+					if (scene.edgeflags[n + k * 3])
+					{
+						double ij[2][2];
+						double depths[2];
+						get_edge_ij_depths(view, k, n, ij, depths);
+						double ij_b[2][2] = { { 0 } };
+						double edge_depths_b[2] = { 0 };
+						if (mask_b != NULL)
+							rasterize_edge_coverage_B(ij, ij_b, depths, mask, mask_b, z_buffer, scene.height, scene.width, sigma, scene.clockwise);
+						if (depth_b != NULL)
+						{
+							double A[2] = { depths[0] * depth_scale, depths[1] * depth_scale };
+							double A_B[2] = { 0 };
+							double* Avertex[2] = { &A[0], &A[1] };
+							double* Avertex_B[2] = { &A_B[0], &A_B[1] };
+							rasterize_edge_interpolated_B(ij, ij_b, depth, depth_b, Avertex, Avertex_B, z_buffer, depths, scene.height, scene.width, 1, sigma, scene.clockwise);
+							for (int i = 0; i < 2; i++)
+								edge_depths_b[i] = A_B[i] * depth_scale;
+						}
+						if ((mask_b != NULL) || (depth_b != NULL))
+							add_edge_ij_depths_B(view, k, n, ij_b, edge_depths_b);
+						if (image_b != NULL)
+							render_scene_edge_B(scene, k, n, image, z_buffer, image_b, sigma, Texture_size);
+					}
+		}
+
+	for (int k = scene.nb_triangles - 1; k >= 0; k--)
+		if (signedAreaV[k] > 0)
+		{
+			if (image_b != NULL)
+				render_scene_triangle_B(scene, k, image, z_buffer, image_b, Texture_size);
+			if (depth_b != NULL)
+			{
+				double ij[3][2];
+				double depths[3];
+				get_face_ij_depths(view, k, ij, depths);
+				double A[3], A_B[3] = { 0 };
+				for (int i = 0; i < 3; i++)
+					A[i] = depths[i] * depth_scale;
+				double ij_b[3][2] = { { 0 } };
+				rasterize_triangle_depth_B(ij, ij_b, depths, A, A_B, z_buffer, depth_b, scene.height, scene.width);
+				unsigned int * face = &scene.faces[k * 3];
+				for (int i = 0; i < 3; i++)
+				{
+					for (int j = 0; j < 2; j++)
+						scene.ij_b[face[i] * 2 + j] += ij_b[i][j];
+					depths_b[face[i]] += A_B[i] * depth_scale;
+				}
+			}
+		}
+}
+
+#endif
@@ -0,0 +1,217 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _NearPlaneClipping_h_
+#define _NearPlaneClipping_h_
+
+// Clipping of the faces of a mesh against the near plane of the camera, located at the depth near.
+// The faces with all their vertices in front of the plane are kept unchanged, the faces with all their
+// vertices behind the plane are removed and the other faces are replaced by their part in front of the
+// plane, made of one or two triangles. The vertices created on the edges crossing the plane are numbered
+// after the vertices of the mesh, and their values are interpolated from the two vertices of their edge
+// with a weight chosen such that the interpolated point of the camera coordinate system lies on the plane.
+// The adjoint distributes the gradient of the created vertices onto the vertices of their edge, including
+// the gradient of the interpolation weight, that depends on the depths of the two vertices.
+
+#include "DifferentiableRenderer.h"
+
+struct NearPlaneClipping {
+	double near;
+	int nb_vertices;
+	int nb_uv;
+	int nb_clip_vertices;
+	vector<int> clip_vertices;      // nb_clip_vertices x 2, vertex in front of the plane and vertex behind
+	vector<int> clip_uv;            // nb_clip_vertices x 2, the corresponding uv indices
+	vector<double> clip_weights;    // weight of the vertex behind the plane in the interpolation
+	vector<unsigned int> faces;     // clipped faces, the clip vertex c has the index nb_vertices + c
+	vector<unsigned int> faces_uv;  // the clip uv c has the index nb_uv + c
+	vector<int> faces_origin;       // mesh face each clipped face comes from
+	vector<int> faces_edges_origin; // edge of the mesh face each edge of the clipped faces lies on, -1 for new edges
+};
+
+inline int add_clip_vertex(NearPlaneClipping& clipping, unsigned int v_front, unsigned int v_behind, unsigned int uv_front, unsigned int uv_behind, const double* depths)
+{
+	// the weights only depend on the ordered pair of vertices so that the faces sharing an edge use the same point
+	clipping.clip_vertices.push_back(v_front);
+	clipping.clip_vertices.push_back(v_behind);
+	clipping.clip_uv.push_back(uv_front);
+	clipping.clip_uv.push_back(uv_behind);
+	clipping.clip_weights.push_back((depths[v_front] - clipping.near) / (depths[v_front] - depths[v_behind]));
+	return (int)clipping.clip_weights.size() - 1;
+}
+
+inline void add_clipped_face(NearPlaneClipping& clipping, int k, const int ids[3], const int ids_uv[3], const int edges_origin[3])
+{
+	// negative ids refer to clip vertices, -1 being the first one
+	for (int i = 0; i < 3; i++)
+	{
+		clipping.faces.push_back(ids[i] >= 0 ? ids[i] : clipping.nb_vertices - 1 - ids[i]);
+		clipping.faces_uv.push_back(ids_uv[i] >= 0 ? ids_uv[i] : clipping.nb_uv - 1 - ids_uv[i]);
+		clipping.faces_edges_origin.push_back(edges_origin[i]);
+	}
+	clipping.faces_origin.push_back(k);
+}
+
+bool clip_faces_near_plane(NearPlaneClipping& clipping, const unsigned int* faces, const unsigned int* faces_uv, int nb_faces, int nb_vertices, int nb_uv, const double* depths, double near)
+{
+	// returns false without modifying clipping when all the vertices are in front of the plane
+	bool any_behind = false;
+	for (int v = 0; v < nb_vertices; v++)
+		if (depths[v] < near)
+		{
+			any_behind = true;
+			break;
+		}
+	if (!any_behind)
+		return false;
+
+	clipping.near = near;
+	clipping.nb_vertices = nb_vertices;
+	clipping.nb_uv = nb_uv;
+	clipping.clip_vertices.clear();
+	clipping.clip_uv.clear();
+	clipping.clip_weights.clear();
+	clipping.faces.clear();
+	clipping.faces_uv.clear();
+	clipping.faces_origin.clear();
+	clipping.faces_edges_origin.clear();
+
+	for (int k = 0; k < nb_faces; k++)
+	{
+		const unsigned int* face = &faces[3 * k];
+		const unsigned int* face_uv = &faces_uv[3 * k];
+		int nb_behind = 0;
+		int i_behind = 0;
+		int i_front = 0;
+		for (int i = 0; i < 3; i++)
+			if (depths[face[i]] < near)
+			{
+				nb_behind++;
+				i_behind = i;
+			}
+			else
+				i_front = i;
+
+		if (nb_behind == 3)
+			continue;
+		if (nb_behind == 0)
+		{
+			int ids[3] = { (int)face[0], (int)face[1], (int)face[2] };
+			int ids_uv[3] = { (int)face_uv[0], (int)face_uv[1], (int)face_uv[2] };
+			int edges_origin[3] = { 0, 1, 2 };
+			add_clipped_face(clipping, k, ids, ids_uv, edges_origin);
+		}
+		else if (nb_behind == 1)
+		{
+			// the quad c2, c1, i1, i2 with c1 on the edge i from i to i1 and c2 on the edge i2 from i2 to i,
+			// split along its diagonal c2, i1
+			int i = i_behind, i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+			int c1 = -1 - add_clip_vertex(clipping, face[i1], face[i], face_uv[i1], face_uv[i], depths);
+			int c2 = -1 - add_clip_vertex(clipping, face[i2], face[i], face_uv[i2], face_uv[i], depths);
+			int ids_a[3] = { c2, c1, (int)face[i1] };
+			int ids_uv_a[3] = { c2, c1, (int)face_uv[i1] };
+			int edges_origin_a[3] = { -1, i, -1 };
+			add_clipped_face(clipping, k, ids_a, ids_uv_a, edges_origin_a);
+			int ids_b[3] = { c2, (int)face[i1], (int)face[i2] };
+			int ids_uv_b[3] = { c2, (int)face_uv[i1], (int)face_uv[i2] };
+			int edges_origin_b[3] = { -1, i1, i2 };
+			add_clipped_face(clipping, k, ids_b, ids_uv_b, edges_origin_b);
+		}
+		else
+		{
+			// the triangle i, c1, c2 with c1 on the edge i from i to i1 and c2 on the edge i2 from i2 to i
+			int i = i_front, i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+			int c1 = -1 - add_clip_vertex(clipping, face[i], face[i1], face_uv[i], face_uv[i1], depths);
+			int c2 = -1 - add_clip_vertex(clipping, face[i], face[i2], face_uv[i], face_uv[i2], depths);
+			int ids[3] = { (int)face[i], c1, c2 };
+			int ids_uv[3] = { (int)face_uv[i], c1, c2 };
+			int edges_origin[3] = { i, -1, i2 };
+			add_clipped_face(clipping, k, ids, ids_uv, edges_origin);
+		}
+	}
+	clipping.nb_clip_vertices = (int)clipping.clip_weights.size();
+	return true;
+}
+
+void clip_interpolate(const NearPlaneClipping& clipping, bool on_uv, int size, const double* values, vector<double>& values_clipped)
+{
+	// values of the mesh vertices (or of the uv when on_uv is true) followed by the values of the clip vertices
+	int nb = on_uv ? clipping.nb_uv : clipping.nb_vertices;
+	const vector<int>& ids = on_uv ? clipping.clip_uv : clipping.clip_vertices;
+	values_clipped.resize((size_t)(nb + clipping.nb_clip_vertices) * size);
+	copy(values, values + (size_t)nb * size, values_clipped.begin());
+	for (int c = 0; c < clipping.nb_clip_vertices; c++)
+	{
+		double t = clipping.clip_weights[c];
+		const double* a = &values[(size_t)ids[2 * c] * size];
+		const double* b = &values[(size_t)ids[2 * c + 1] * size];
+		double* r = &values_clipped[(size_t)(nb + c) * size];
+		for (int i = 0; i < size; i++)
+			r[i] = (1 - t) * a[i] + t * b[i];
+	}
+}
+
+void clip_interpolate_B(const NearPlaneClipping& clipping, bool on_uv, int size, const double* values, const double* values_clip_b, double* values_b, double* weights_b)
+{
+	// accumulates the adjoint of the values of the clip vertices values_clip_b (nb_clip_vertices x size)
+	// into values_b and weights_b, the adjoint of the values of the mesh vertices is left to the caller
+	const vector<int>& ids = on_uv ? clipping.clip_uv : clipping.clip_vertices;
+	for (int c = 0; c < clipping.nb_clip_vertices; c++)
+	{
+		double t = clipping.clip_weights[c];
+		const double* a = &values[(size_t)ids[2 * c] * size];
+		const double* b = &values[(size_t)ids[2 * c + 1] * size];
+		double* a_b = &values_b[(size_t)ids[2 * c] * size];
+		double* b_b = &values_b[(size_t)ids[2 * c + 1] * size];
+		const double* r_b = &values_clip_b[(size_t)c * size];
+		for (int i = 0; i < size; i++)
+		{
+			a_b[i] += (1 - t) * r_b[i];
+			b_b[i] += t * r_b[i];
+			weights_b[c] += (b[i] - a[i]) * r_b[i];
+		}
+	}
+}
+
+void clip_weights_B(const NearPlaneClipping& clipping, const double* depths, const double* weights_b, double* depths_b)
+{
+	// adjoint of t = (z_front - near) / (z_front - z_behind)
+	for (int c = 0; c < clipping.nb_clip_vertices; c++)
+	{
+		int v_front = clipping.clip_vertices[2 * c];
+		int v_behind = clipping.clip_vertices[2 * c + 1];
+		double d = depths[v_front] - depths[v_behind];
+		double inv_d2 = 1 / (d * d);
+		depths_b[v_front] += weights_b[c] * (clipping.near - depths[v_behind]) * inv_d2;
+		depths_b[v_behind] += weights_b[c] * (depths[v_front] - clipping.near) * inv_d2;
+	}
+}
+
+#endif
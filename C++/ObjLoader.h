@@ -0,0 +1,273 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _ObjLoader_h_
+#define _ObjLoader_h_
+
+// Streaming parser for wavefront OBJ files supporting the v (with optional vertex colors), vt, vn and f
+// keywords. Polygonal faces are triangulated as fans and negative (relative) indices are supported.
+// The file is read by chunks so that the memory used beyond the output arrays does not depend on the file size.
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+struct ObjMesh {
+	vector<double> vertices; // nb_vertices x 3
+	vector<double> vertices_colors; // nb_vertices x 3, empty if the v lines do not all have colors
+	vector<double> uv; // nb_uv x 2
+	vector<double> normals; // nb_normals x 3
+	vector<int> faces; // nb_faces x 3
+	vector<int> faces_uv; // nb_faces x 3, empty if the faces do not have texture coordinates
+	vector<int> faces_normals; // nb_faces x 3, empty if the faces do not have normals
+};
+
+class LineReader {
+	// reads a file line by line using a fixed size buffer, lines ending with a backslash are concatenated
+	// with the next line
+public:
+	LineReader(FILE* file, size_t buffer_size = 1 << 20) : file(file), buffer(buffer_size), position(0), end(0) {}
+
+	bool read_line(string& line)
+	{
+		line.clear();
+		bool has_data = false;
+		while (true)
+		{
+			if (position == end)
+			{
+				end = fread(&buffer[0], 1, buffer.size(), file);
+				position = 0;
+				if (end == 0)
+				{
+					// last line of a file that does not end with a newline
+					if (!line.empty() && line.back() == '\r')
+						line.pop_back();
+					return has_data;
+				}
+			}
+			has_data = true;
+			char* start = &buffer[position];
+			char* newline = (char*)memchr(start, '\n', end - position);
+			if (newline == NULL)
+			{
+				line.append(start, end - position);
+				position = end;
+				continue;
+			}
+			line.append(start, newline - start);
+			position += newline - start + 1;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (!line.empty() && line.back() == '\\')
+			{
+				line.pop_back();
+				continue;
+			}
+			return true;
+		}
+	}
+
+private:
+	FILE* file;
+	vector<char> buffer;
+	size_t position;
+	size_t end;
+};
+
+int parse_values(const char* str, double* values, int max_values)
+{
+	// parse up to max_values floating point numbers, returns the number of values read
+	int nb_values = 0;
+	char* next;
+	while (nb_values < max_values)
+	{
+		double value = strtod(str, &next);
+		if (next == str)
+			break;
+		values[nb_values++] = value;
+		str = next;
+	}
+	return nb_values;
+}
+
+int obj_index(long index, int count)
+{
+	// converts a one based or negative relative index into a zero based index
+	long result = index > 0 ? index - 1 : count + index;
+	if ((index == 0) || (result < 0) || (result >= count))
+		throw "invalid index in the faces of the OBJ file";
+	return (int)result;
+}
+
+void read_obj(const char* filename, ObjMesh& mesh)
+{
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL)
+		throw "could not open the OBJ file";
+	mesh = ObjMesh();
+	LineReader reader(file);
+	string line;
+	vector<int> polygon_vertices, polygon_uv, polygon_normals;
+	bool all_vertices_have_colors = true;
+	int nb_vertices = 0;
+	int nb_uv = 0;
+	int nb_normals = 0;
+	bool first_face = true;
+	bool faces_have_uv = false;
+	bool faces_have_normals = false;
+	double values[7];
+	try
+	{
+		while (reader.read_line(line))
+		{
+			// a comment or trailing white spaces end the record
+			size_t comment = line.find('#');
+			if (comment != string::npos)
+				line.erase(comment);
+			while (!line.empty() && (line.back() == ' ' || line.back() == '\t' || line.back() == '\r'))
+				line.pop_back();
+			const char* str = line.c_str();
+			while (*str == ' ' || *str == '\t')
+				str++;
+			if (str[0] == 'v' && (str[1] == ' ' || str[1] == '\t'))
+			{
+				int nb_values = parse_values(str + 2, values, 7);
+				if (nb_values < 3)
+					throw "vertex with less than 3 coordinates in the OBJ file";
+				mesh.vertices.insert(mesh.vertices.end(), values, values + 3);
+				// 'v x y z w' has a weight and 'v x y z r g b' has a color
+				if (nb_values >= 6)
+					mesh.vertices_colors.insert(mesh.vertices_colors.end(), values + nb_values - 3, values + nb_values);
+				else
+					all_vertices_have_colors = false;
+				nb_vertices++;
+			}
+			else if (str[0] == 'v' && str[1] == 't')
+			{
+				int nb_values = parse_values(str + 2, values, 3);
+				if (nb_values < 2)
+					throw "texture coordinate with less than 2 values in the OBJ file";
+				mesh.uv.insert(mesh.uv.end(), values, values + 2);
+				nb_uv++;
+			}
+			else if (str[0] == 'v' && str[1] == 'n')
+			{
+				if (parse_values(str + 2, values, 3) != 3)
+					throw "normal without 3 coordinates in the OBJ file";
+				mesh.normals.insert(mesh.normals.end(), values, values + 3);
+				nb_normals++;
+			}
+			else if (str[0] == 'f' && (str[1] == ' ' || str[1] == '\t'))
+			{
+				polygon_vertices.clear();
+				polygon_uv.clear();
+				polygon_normals.clear();
+				const char* p = str + 2;
+				char* next;
+				while (true)
+				{
+					while (*p == ' ' || *p == '\t')
+						p++;
+					if (*p == '\0')
+						break;
+					// token of the form v, v/vt, v//vn or v/vt/vn
+					long index = strtol(p, &next, 10);
+					if (next == p)
+						throw "could not parse a face in the OBJ file";
+					polygon_vertices.push_back(obj_index(index, nb_vertices));
+					p = next;
+					bool has_uv = false;
+					bool has_normal = false;
+					if (*p == '/')
+					{
+						p++;
+						if (*p != '/')
+						{
+							index = strtol(p, &next, 10);
+							if (next == p)
+								throw "could not parse a face in the OBJ file";
+							polygon_uv.push_back(obj_index(index, nb_uv));
+							has_uv = true;
+							p = next;
+						}
+						if (*p == '/')
+						{
+							p++;
+							index = strtol(p, &next, 10);
+							if (next == p)
+								throw "could not parse a face in the OBJ file";
+							polygon_normals.push_back(obj_index(index, nb_normals));
+							has_normal = true;
+							p = next;
+						}
+					}
+					if (first_face && polygon_vertices.size() == 1)
+					{
+						faces_have_uv = has_uv;
+						faces_have_normals = has_normal;
+					}
+					if ((has_uv != faces_have_uv) || (has_normal != faces_have_normals))
+						throw "faces with and without texture coordinates or normals are mixed in the OBJ file";
+				}
+				int nb_corners = (int)polygon_vertices.size();
+				if (nb_corners < 3)
+					throw "face with less than 3 vertices in the OBJ file";
+				first_face = false;
+				for (int k = 1; k < nb_corners - 1; k++)
+				{
+					int corners[3] = { 0, k, k + 1 };
+					for (int c = 0; c < 3; c++)
+					{
+						mesh.faces.push_back(polygon_vertices[corners[c]]);
+						if (faces_have_uv)
+							mesh.faces_uv.push_back(polygon_uv[corners[c]]);
+						if (faces_have_normals)
+							mesh.faces_normals.push_back(polygon_normals[corners[c]]);
+					}
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		fclose(file);
+		throw;
+	}
+	fclose(file);
+	if (!all_vertices_have_colors)
+		mesh.vertices_colors.clear();
+}
+
+#endif
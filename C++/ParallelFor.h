@@ -0,0 +1,80 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _ParallelFor_h_
+#define _ParallelFor_h_
+
+// Minimal thread pool free helper to split a loop over several threads.
+// The function f(begin, end, thread_id) is called on contiguous chunks of [0, n)
+// so that each thread can accumulate into its own buffer indexed by thread_id.
+
+#include <thread>
+#include <vector>
+
+inline int get_nb_threads(int nb_threads = 0)
+{
+	// nb_threads <= 0 means using all the available cores
+	if (nb_threads <= 0)
+	{
+		nb_threads = (int)std::thread::hardware_concurrency();
+		if (nb_threads <= 0)
+			nb_threads = 1;
+	}
+	return nb_threads;
+}
+
+template <class F> void parallel_for(int n, int nb_threads, int min_chunk_size, F f)
+{
+	nb_threads = get_nb_threads(nb_threads);
+	if (min_chunk_size < 1)
+		min_chunk_size = 1;
+	if (nb_threads > n / min_chunk_size)
+		nb_threads = n / min_chunk_size;
+	if (nb_threads <= 1)
+	{
+		f(0, n, 0);
+		return;
+	}
+	std::vector<std::thread> threads;
+	int chunk_size = (n + nb_threads - 1) / nb_threads;
+	for (int t = 1; t < nb_threads; t++)
+	{
+		int begin = t * chunk_size;
+		int end = (begin + chunk_size < n) ? begin + chunk_size : n;
+		if (begin >= end)
+			break;
+		threads.push_back(std::thread(f, begin, end, t));
+	}
+	f(0, chunk_size < n ? chunk_size : n, 0);
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
+
+#endif
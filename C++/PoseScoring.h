@@ -0,0 +1,146 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _PoseScoring_h_
+#define _PoseScoring_h_
+
+// Evaluate the squared error between the rendering of a mesh and an observation for many candidate
+// poses, as needed to initialize or recover a tracker. Only the losses are returned: each thread keeps
+// its own copy of the pipeline buffers and reuses them for all the poses it scores, so that no image
+// is kept per pose. The losses can optionally be computed at a reduced resolution, the observation
+// and the background being averaged by blocks of factor x factor pixels and the camera rescaled.
+
+#include "Scene3DPipeline.h"
+#include "ParallelFor.h"
+
+void downsample_camera(const Camera& camera, int factor, Camera& camera_low)
+{
+	// pixel centers are at integer coordinates, the block of pixels [factor*x, factor*x+factor-1]
+	// of the full resolution image has its center at factor*x+(factor-1)/2
+	camera_low = camera;
+	camera_low.height = camera.height / factor;
+	camera_low.width = camera.width / factor;
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			camera_low.intrinsic[3 * i + j] = camera.intrinsic[3 * i + j] / factor;
+		camera_low.intrinsic[3 * i + 2] -= 0.5 * (factor - 1) / factor;
+	}
+}
+
+void downsample_image(const double* image, int height, int width, int nb_channels, int factor, double* image_low)
+{
+	// average over blocks of factor x factor pixels, discarding the last rows and columns
+	// when the size is not a multiple of factor
+	int height_low = height / factor;
+	int width_low = width / factor;
+	double normalization = 1.0 / (factor * factor);
+	for (int y = 0; y < height_low; y++)
+		for (int x = 0; x < width_low; x++)
+		{
+			double* out = &image_low[(y * width_low + x) * nb_channels];
+			for (int c = 0; c < nb_channels; c++)
+				out[c] = 0;
+			for (int dy = 0; dy < factor; dy++)
+				for (int dx = 0; dx < factor; dx++)
+				{
+					const double* in = &image[((y * factor + dy) * width + x * factor + dx) * nb_channels];
+					for (int c = 0; c < nb_channels; c++)
+						out[c] += in[c];
+				}
+			for (int c = 0; c < nb_channels; c++)
+				out[c] *= normalization;
+		}
+}
+
+void score_poses(const Scene3DPipeline& pipeline, int nb_poses, const double* quaternions, const double* translations, const double* vertices, const double* obs, int downsample, double* losses, int nb_threads = 0)
+{
+	// quaternions (nb_poses x 4), translations (nb_poses x 3) and vertices (nb_poses x nb_vertices x 3)
+	// can be NULL, in which case the corresponding input of the pipeline is used for all the poses
+	int nb_vertices = pipeline.topology->nb_vertices;
+	if (obs == NULL)
+		throw "an observation should be provided to score the poses";
+	if (pipeline.background == NULL)
+		throw "the background should be set before scoring poses";
+	if ((vertices != NULL) && (pipeline.shape_basis != NULL))
+		throw "vertices cannot be provided per pose when using a shape basis";
+	if (downsample < 1)
+		throw "downsample should be greater or equal to 1";
+
+	Camera camera = pipeline.camera;
+	double* background = pipeline.background;
+	double* obs_scored = (double*)obs;
+	vector<double> background_low;
+	vector<double> obs_low;
+	if (downsample > 1)
+	{
+		downsample_camera(pipeline.camera, downsample, camera);
+		size_t size_low = (size_t)camera.height * camera.width * pipeline.nb_colors;
+		if (size_low == 0)
+			throw "downsample is too large for the image size";
+		background_low.resize(size_low);
+		obs_low.resize(size_low);
+		downsample_image(pipeline.background, pipeline.camera.height, pipeline.camera.width, pipeline.nb_colors, downsample, &background_low[0]);
+		downsample_image(obs, pipeline.camera.height, pipeline.camera.width, pipeline.nb_colors, downsample, &obs_low[0]);
+		background = &background_low[0];
+		obs_scored = &obs_low[0];
+	}
+
+	// exceptions cannot cross the thread boundaries, they are stored per thread and rethrown after joining
+	vector<const char*> errors(get_nb_threads(nb_threads), NULL);
+	parallel_for(nb_poses, nb_threads, 1, [&](int begin, int end, int thread_id) {
+		Scene3DPipeline local(pipeline);
+		local.camera = camera;
+		local.background = background;
+		local.nb_threads = 1;
+		try
+		{
+			for (int k = begin; k < end; k++)
+			{
+				if (quaternions != NULL)
+					local.quaternion = (double*)&quaternions[4 * k];
+				if (translations != NULL)
+					local.translation = (double*)&translations[3 * k];
+				if (vertices != NULL)
+					local.vertices = (double*)&vertices[3 * nb_vertices * k];
+				losses[k] = local.render(obs_scored);
+			}
+		}
+		catch (const char* message)
+		{
+			errors[thread_id] = message;
+		}
+	});
+	for (size_t t = 0; t < errors.size(); t++)
+		if (errors[t] != NULL)
+			throw errors[t];
+}
+
+#endif
@@ -0,0 +1,156 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _ROIRenderer_h_
+#define _ROIRenderer_h_
+
+// Render only a rectangular region of interest (x0, y0, width, height) of the image of a scene into
+// buffers of the size of the region. The faces whose bounding box, enlarged by the width of the
+// antialiasing edge stencils, does not intersect the region are culled before sorting. The remaining
+// faces are rendered with their 2D coordinates shifted by (-x0, -y0), so that the triangles and the
+// edge stencils are clipped at the region borders by the usual image bounds tests, and the adjoint
+// only touches the region. The gradients are accumulated into the buffers of the full scene.
+// renderSceneTile renders a region with its own background without reading scene.background, so that
+// images too large to be held in memory can be rendered tile by tile.
+
+#include "DifferentiableRenderer.h"
+
+struct SceneROIView {
+	Scene scene;
+	vector<unsigned int> faces;
+	vector<unsigned int> faces_uv;
+	vector<unsigned int> faces_ids; // index of each face of the view in the full scene
+	vector<double> ij;
+	vector<unsigned char> edgeflags;
+	vector<unsigned char> textured;
+	vector<unsigned char> shaded;
+	vector<double> background;
+};
+
+void get_scene_roi_view(const Scene& scene, int x0, int y0, int width, int height, double sigma, bool copy_background, SceneROIView& view)
+{
+	if ((x0 < 0) || (y0 < 0) || (width <= 0) || (height <= 0) || (x0 + width > scene.width) || (y0 + height > scene.height))
+		throw "the region of interest should be non empty and inside the image";
+
+	view.ij.resize(2 * scene.nb_vertices);
+	for (int v = 0; v < scene.nb_vertices; v++)
+	{
+		view.ij[2 * v] = scene.ij[2 * v] - x0;
+		view.ij[2 * v + 1] = scene.ij[2 * v + 1] - y0;
+	}
+
+	double margin = (sigma > 0 ? sigma : 0) + 1;
+	view.faces.clear();
+	view.faces_uv.clear();
+	view.faces_ids.clear();
+	view.edgeflags.clear();
+	view.textured.clear();
+	view.shaded.clear();
+	for (int k = 0; k < scene.nb_triangles; k++)
+	{
+		const unsigned int* face = &scene.faces[3 * k];
+		double xmin = view.ij[2 * face[0]], xmax = xmin;
+		double ymin = view.ij[2 * face[0] + 1], ymax = ymin;
+		for (int i = 1; i < 3; i++)
+		{
+			xmin = min(xmin, view.ij[2 * face[i]]);
+			xmax = max(xmax, view.ij[2 * face[i]]);
+			ymin = min(ymin, view.ij[2 * face[i] + 1]);
+			ymax = max(ymax, view.ij[2 * face[i] + 1]);
+		}
+		if ((xmax + margin < 0) || (xmin - margin > width - 1) || (ymax + margin < 0) || (ymin - margin > height - 1))
+			continue;
+		for (int i = 0; i < 3; i++)
+		{
+			view.faces.push_back(face[i]);
+			view.faces_uv.push_back(scene.faces_uv[3 * k + i]);
+			view.edgeflags.push_back(scene.edgeflags[3 * k + i]);
+		}
+		view.faces_ids.push_back(k);
+		view.textured.push_back(scene.textured[k]);
+		view.shaded.push_back(scene.shaded[k]);
+	}
+
+	if (copy_background)
+	{
+		view.background.resize((size_t)width * height * scene.nb_colors);
+		for (int y = 0; y < height; y++)
+			memcpy(&view.background[(size_t)y * width * scene.nb_colors], &scene.background[((size_t)(y + y0) * scene.width + x0) * scene.nb_colors], (size_t)width * scene.nb_colors * sizeof(double));
+	}
+
+	// the vectors are given a dummy element so that the pointers are valid when all the faces are culled
+	unsigned char dummy_flag = 0;
+	view.faces.push_back(0);
+	view.faces_uv.push_back(0);
+	view.edgeflags.push_back(dummy_flag);
+	view.textured.push_back(dummy_flag);
+	view.shaded.push_back(dummy_flag);
+
+	view.scene = scene;
+	view.scene.nb_triangles = (int)view.textured.size() - 1;
+	view.scene.height = height;
+	view.scene.width = width;
+	view.scene.faces = &view.faces[0];
+	view.scene.faces_uv = &view.faces_uv[0];
+	view.scene.ij = &view.ij[0];
+	view.scene.edgeflags = (bool*)&view.edgeflags[0];
+	view.scene.textured = (bool*)&view.textured[0];
+	view.scene.shaded = (bool*)&view.shaded[0];
+	if (copy_background)
+		view.scene.background = &view.background[0];
+}
+
+void renderSceneROI(Scene scene, int x0, int y0, int width, int height, double* image, double* z_buffer, double sigma, bool antialiaseError = 0, double* obs = NULL, double* err_buffer = NULL)
+{
+	// image, z_buffer, obs and err_buffer are of the size of the region of interest
+	SceneROIView view;
+	get_scene_roi_view(scene, x0, y0, width, height, sigma, true, view);
+	renderScene(view.scene, image, z_buffer, sigma, antialiaseError, obs, err_buffer);
+}
+
+void renderSceneTile(Scene scene, int x0, int y0, int width, int height, double* background, double* image, double* z_buffer, double sigma)
+{
+	// background, image and z_buffer are of the size of the tile, scene.height and scene.width
+	// give the size of the full image and scene.background is not used
+	SceneROIView view;
+	get_scene_roi_view(scene, x0, y0, width, height, sigma, false, view);
+	view.scene.background = background;
+	renderScene(view.scene, image, z_buffer, sigma);
+}
+
+void renderSceneROI_B(Scene scene, int x0, int y0, int width, int height, double* image, double* z_buffer, double* image_b, double sigma, bool antialiaseError = 0, double* obs = NULL, double* err_buffer = NULL, double* err_buffer_b = NULL)
+{
+	// the background is not used by the adjoint and is not copied
+	SceneROIView view;
+	get_scene_roi_view(scene, x0, y0, width, height, sigma, false, view);
+	renderScene_B(view.scene, image, z_buffer, image_b, sigma, antialiaseError, obs, err_buffer, err_buffer_b);
+}
+
+#endif
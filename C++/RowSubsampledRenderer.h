@@ -0,0 +1,101 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _RowSubsampledRenderer_h_
+#define _RowSubsampledRenderer_h_
+
+// Evaluate the antialiased squared error between the rendering of a scene and an observation on a
+// subset of the rows only, for stochastic gradient descent. Each row y has a weight row_weights[y],
+// zero for the rows that are not sampled, and the loss is the weighted sum of the errors of the
+// sampled rows, which is an unbiased estimate of the full loss when the weights are the inverse of
+// the sampling probabilities. Each band of consecutive sampled rows is rendered as a full width
+// region of interest directly into the rows of the full size buffers, so that the faces and the edges
+// that do not overlap the band are culled. The rows that are not sampled are left untouched.
+
+#include "ROIRenderer.h"
+
+void get_sampled_row_bands(const double* row_weights, int height, vector<int>& bands_begin, vector<int>& bands_end)
+{
+	bands_begin.clear();
+	bands_end.clear();
+	for (int y = 0; y < height; y++)
+		if (row_weights[y] != 0)
+		{
+			if (bands_end.empty() || (bands_end.back() != y))
+			{
+				bands_begin.push_back(y);
+				bands_end.push_back(y + 1);
+			}
+			else
+				bands_end.back()++;
+		}
+}
+
+double renderSceneRows(Scene scene, const double* row_weights, double* image, double* z_buffer, double sigma, double* obs, double* err_buffer)
+{
+	// image, z_buffer, obs and err_buffer are of the size of the full image, returns the weighted loss
+	vector<int> bands_begin, bands_end;
+	get_sampled_row_bands(row_weights, scene.height, bands_begin, bands_end);
+	size_t row_size = (size_t)scene.width * scene.nb_colors;
+	double loss = 0;
+	for (size_t b = 0; b < bands_begin.size(); b++)
+	{
+		int y0 = bands_begin[b];
+		renderSceneROI(scene, 0, y0, scene.width, bands_end[b] - y0, image + y0 * row_size, z_buffer + (size_t)y0 * scene.width, sigma, true, obs + y0 * row_size, err_buffer + (size_t)y0 * scene.width);
+		for (int y = y0; y < bands_end[b]; y++)
+		{
+			double s = 0;
+			for (int x = 0; x < scene.width; x++)
+				s += err_buffer[(size_t)y * scene.width + x];
+			loss += row_weights[y] * s;
+		}
+	}
+	return loss;
+}
+
+void renderSceneRows_B(Scene scene, const double* row_weights, double* image, double* z_buffer, double sigma, double* obs, double* err_buffer)
+{
+	// backpropagate the weighted loss returned by renderSceneRows, err_buffer is modified in place
+	vector<int> bands_begin, bands_end;
+	get_sampled_row_bands(row_weights, scene.height, bands_begin, bands_end);
+	size_t row_size = (size_t)scene.width * scene.nb_colors;
+	vector<double> err_buffer_b;
+	for (size_t b = 0; b < bands_begin.size(); b++)
+	{
+		int y0 = bands_begin[b];
+		int band_height = bands_end[b] - y0;
+		err_buffer_b.resize((size_t)band_height * scene.width);
+		for (int y = 0; y < band_height; y++)
+			fill(&err_buffer_b[(size_t)y * scene.width], &err_buffer_b[(size_t)y * scene.width] + scene.width, row_weights[y0 + y]);
+		renderSceneROI_B(scene, 0, y0, scene.width, band_height, image + y0 * row_size, z_buffer + (size_t)y0 * scene.width, NULL, sigma, true, obs + y0 * row_size, err_buffer + (size_t)y0 * scene.width, &err_buffer_b[0]);
+	}
+}
+
+#endif
@@ -0,0 +1,1115 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _Scene3DPipeline_h_
+#define _Scene3DPipeline_h_
+
+// Native version of the Scene3D rendering pipeline: pose -> lighting -> projection -> rasterization -> loss
+// and its adjoint, chaining the backward of each stage without going back to python between stages.
+// All the intermediate buffers are kept in the Scene3DPipeline object so that they are reused from one call to
+// the next one when rendering the same mesh at high frame rate.
+
+#include "DifferentiableRenderer.h"
+#include "Skinning.h"
+#include "LinearBasis.h"
+#include "MeshAdjacencies.h"
+#include "DepthMaskRenderer.h"
+#include "NearPlaneClipping.h"
+
+struct MeshTopology {
+	int nb_vertices;
+	int nb_faces;
+	int nb_edges;
+	bool clockwise;
+	vector<unsigned int> faces;
+	// edge n of face k joins the vertices faces[3*k+n] and faces[3*k+(n+1)%3]
+	// edges are numbered by increasing (min vertex id, max vertex id) as in TriMeshAdjacencies
+	vector<int> faces_edges;
+	// the two faces adjacent to each edge, -1 for the missing face along boundaries
+	vector<int> edges_faces;
+	// list of the faces adjacent to each vertex, stored in compressed row format
+	vector<int> vertices_faces_start;
+	vector<int> vertices_faces;
+};
+
+void build_mesh_topology(MeshTopology &topology, const unsigned int* faces, int nb_faces, int nb_vertices, bool clockwise)
+{
+	topology.nb_faces = nb_faces;
+	topology.nb_vertices = nb_vertices;
+	topology.clockwise = clockwise;
+	topology.faces.assign(faces, faces + 3 * nb_faces);
+
+	MeshAdjacencies adjacencies;
+	build_mesh_adjacencies(adjacencies, faces, nb_faces, nb_vertices, false);
+	topology.faces_edges = adjacencies.faces_edges;
+	topology.nb_edges = adjacencies.nb_edges;
+	topology.edges_faces.assign(2 * adjacencies.nb_edges, -1);
+	vector<int> nb_faces_on_edge(adjacencies.nb_edges, 0);
+	for (int i = 0; i < 3 * nb_faces; i++)
+	{
+		int id_edge = topology.faces_edges[i];
+		if (nb_faces_on_edge[id_edge] == 2)
+			throw "non manifold mesh: edge shared by more than two faces";
+		topology.edges_faces[2 * id_edge + nb_faces_on_edge[id_edge]++] = i / 3;
+	}
+
+	// faces adjacent to each vertex
+
+	topology.vertices_faces_start.assign(nb_vertices + 1, 0);
+	for (int k = 0; k < 3 * nb_faces; k++)
+		topology.vertices_faces_start[faces[k] + 1]++;
+	for (int v = 0; v < nb_vertices; v++)
+		topology.vertices_faces_start[v + 1] += topology.vertices_faces_start[v];
+	topology.vertices_faces.resize(3 * nb_faces);
+	vector<int> fill_position(topology.vertices_faces_start.begin(), topology.vertices_faces_start.end() - 1);
+	for (int k = 0; k < 3 * nb_faces; k++)
+		topology.vertices_faces[fill_position[faces[k]]++] = k / 3;
+}
+
+void edge_on_silhouette(const MeshTopology &topology, const unsigned char* face_visible, unsigned char* edgeflags)
+{
+	// an edge is on the silhouette if one and only one of its adjacent faces is visible
+	for (int k = 0; k < topology.nb_faces; k++)
+		for (int n = 0; n < 3; n++)
+		{
+			const int* faces_pair = &topology.edges_faces[2 * topology.faces_edges[3 * k + n]];
+			int nb_visible = 0;
+			for (int i = 0; i < 2; i++)
+				if ((faces_pair[i] >= 0) && face_visible[faces_pair[i]])
+					nb_visible++;
+			edgeflags[3 * k + n] = (nb_visible == 1);
+		}
+}
+
+void edge_on_silhouette(const MeshTopology &topology, const double* ij, unsigned char* edgeflags)
+{
+	vector<unsigned char> face_visible(topology.nb_faces);
+	for (int k = 0; k < topology.nb_faces; k++)
+	{
+		const unsigned int* face = &topology.faces[3 * k];
+		double tri[3][2];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+				tri[i][j] = ij[face[i] * 2 + j];
+		face_visible[k] = signedArea(tri, topology.clockwise) > 0;
+	}
+	edge_on_silhouette(topology, &face_visible[0], edgeflags);
+}
+
+struct Camera {
+	double extrinsic[12]; // 3x4 matrix [R|t] mapping world coordinates to camera coordinates
+	double intrinsic[9];
+	bool has_distortion;
+	double distortion[5]; // k1, k2, p1, p2, k3 as in opencv
+	int height;
+	int width;
+};
+
+void project_points(const Camera &camera, int nb_points, const double* points, double* p_camera, double* projected, double* ij, double* depths)
+{
+	for (int v = 0; v < nb_points; v++)
+	{
+		const double* p = &points[3 * v];
+		double* pc = &p_camera[3 * v];
+		for (int i = 0; i < 3; i++)
+			pc[i] = camera.extrinsic[4 * i] * p[0] + camera.extrinsic[4 * i + 1] * p[1] + camera.extrinsic[4 * i + 2] * p[2] + camera.extrinsic[4 * i + 3];
+		depths[v] = pc[2];
+		double* pr = &projected[2 * v];
+		pr[0] = pc[0] / pc[2];
+		pr[1] = pc[1] / pc[2];
+		double d[2];
+		if (camera.has_distortion)
+		{
+			const double* k = camera.distortion;
+			double x = pr[0], y = pr[1];
+			double x2 = x * x, y2 = y * y;
+			double r2 = x2 + y2;
+			double radial = 1 + k[0] * r2 + k[1] * r2 * r2 + k[4] * r2 * r2 * r2;
+			d[0] = x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x2);
+			d[1] = y * radial + k[2] * (r2 + 2 * y2) + 2 * k[3] * x * y;
+		}
+		else
+		{
+			d[0] = pr[0];
+			d[1] = pr[1];
+		}
+		for (int i = 0; i < 2; i++)
+			ij[2 * v + i] = camera.intrinsic[3 * i] * d[0] + camera.intrinsic[3 * i + 1] * d[1] + camera.intrinsic[3 * i + 2];
+	}
+}
+
+void project_points_B(const Camera &camera, int nb_points, const double* p_camera, const double* projected, const double* ij_b, const double* depths_b, double* points_b)
+{
+	// accumulates the gradient with respect to the 3D points into points_b
+	for (int v = 0; v < nb_points; v++)
+	{
+		const double* pc = &p_camera[3 * v];
+		const double* pr = &projected[2 * v];
+		double d_b[2];
+		for (int j = 0; j < 2; j++)
+			d_b[j] = camera.intrinsic[j] * ij_b[2 * v] + camera.intrinsic[3 + j] * ij_b[2 * v + 1];
+
+		double pr_b[2];
+		if (camera.has_distortion)
+		{
+			const double* k = camera.distortion;
+			double x = pr[0], y = pr[1];
+			double r2 = x * x + y * y;
+			double radial = 1 + k[0] * r2 + k[1] * r2 * r2 + k[4] * r2 * r2 * r2;
+			double x_b = d_b[0] * radial;
+			double y_b = d_b[1] * radial;
+			double radial_b = d_b[0] * x + d_b[1] * y;
+			x_b += d_b[0] * (2 * k[2] * y + 4 * k[3] * x);
+			y_b += d_b[0] * 2 * k[2] * x;
+			x_b += d_b[1] * 2 * k[3] * y;
+			y_b += d_b[1] * (2 * k[3] * x + 4 * k[2] * y);
+			double r2_b = d_b[0] * k[3] + d_b[1] * k[2];
+			r2_b += radial_b * (k[0] + 2 * k[1] * r2 + 3 * k[4] * r2 * r2);
+			pr_b[0] = x_b + r2_b * 2 * x;
+			pr_b[1] = y_b + r2_b * 2 * y;
+		}
+		else
+		{
+			pr_b[0] = d_b[0];
+			pr_b[1] = d_b[1];
+		}
+
+		double pc_b[3];
+		pc_b[0] = pr_b[0] / pc[2];
+		pc_b[1] = pr_b[1] / pc[2];
+		pc_b[2] = -(pr_b[0] * pc[0] + pr_b[1] * pc[1]) / (pc[2] * pc[2]);
+		if (depths_b != NULL)
+			pc_b[2] += depths_b[v];
+		for (int j = 0; j < 3; j++)
+			points_b[3 * v + j] += camera.extrinsic[j] * pc_b[0] + camera.extrinsic[4 + j] * pc_b[1] + camera.extrinsic[8 + j] * pc_b[2];
+	}
+}
+
+inline void cross_prod(const double u[3], const double v[3], double c[3])
+{
+	c[0] = u[1] * v[2] - u[2] * v[1];
+	c[1] = u[2] * v[0] - u[0] * v[2];
+	c[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+inline void cross_prod_B(const double u[3], double u_B[3], const double v[3], double v_B[3], const double c_B[3])
+{
+	double t[3];
+	cross_prod(v, c_B, t);
+	for (int i = 0; i < 3; i++) u_B[i] += t[i];
+	cross_prod(c_B, u, t);
+	for (int i = 0; i < 3; i++) v_B[i] += t[i];
+}
+
+inline void normalize_vect(int n, const double* x, double* xn)
+{
+	double s = 0;
+	for (int i = 0; i < n; i++) s += x[i] * x[i];
+	double inv_norm = 1 / sqrt(s);
+	for (int i = 0; i < n; i++) xn[i] = x[i] * inv_norm;
+}
+
+inline void normalize_vect_B(int n, const double* x, const double* xn_B, double* x_B)
+{
+	double s = 0;
+	for (int i = 0; i < n; i++) s += x[i] * x[i];
+	double inv_norm = 1 / sqrt(s);
+	double norm_B = 0;
+	for (int i = 0; i < n; i++) norm_B -= xn_B[i] * x[i];
+	norm_B *= inv_norm * inv_norm;
+	for (int i = 0; i < n; i++) x_B[i] += (xn_B[i] + x[i] * norm_B) * inv_norm;
+}
+
+inline void quaternion_rotate(const double q[4], const double v[3], double vr[3])
+{
+	// rotate v using the normalized quaternion q=(x,y,z,w)
+	double uv[3], uuv[3];
+	cross_prod(q, v, uv);
+	cross_prod(q, uv, uuv);
+	for (int i = 0; i < 3; i++)
+		vr[i] = v[i] + 2 * (q[3] * uv[i] + uuv[i]);
+}
+
+inline void quaternion_rotate_B(const double q[4], double q_B[4], const double v[3], double v_B[3], const double vr_B[3])
+{
+	double uv[3], uv_B[3] = { 0 }, uuv_B[3];
+	cross_prod(q, v, uv);
+	for (int i = 0; i < 3; i++)
+	{
+		v_B[i] += vr_B[i];
+		q_B[3] += 2 * vr_B[i] * uv[i];
+		uuv_B[i] = 2 * vr_B[i];
+		uv_B[i] = 2 * vr_B[i] * q[3];
+	}
+	cross_prod_B(q, q_B, uv, uv_B, uuv_B);
+	cross_prod_B(q, q_B, v, v_B, uv_B);
+}
+
+void compute_vertex_normals(const MeshTopology &topology, const double* vertices, double* face_normals_unnormalized, double* face_normals, double* vertex_normals_unnormalized, double* vertex_normals)
+{
+	for (int k = 0; k < topology.nb_faces; k++)
+	{
+		const unsigned int* face = &topology.faces[3 * k];
+		double u[3], v[3];
+		for (int i = 0; i < 3; i++)
+		{
+			u[i] = vertices[3 * face[1] + i] - vertices[3 * face[0] + i];
+			v[i] = vertices[3 * face[2] + i] - vertices[3 * face[0] + i];
+		}
+		double* n = &face_normals_unnormalized[3 * k];
+		cross_prod(u, v, n);
+		if (topology.clockwise)
+			for (int i = 0; i < 3; i++) n[i] = -n[i];
+		normalize_vect(3, n, &face_normals[3 * k]);
+	}
+	for (int p = 0; p < topology.nb_vertices; p++)
+	{
+		double* n = &vertex_normals_unnormalized[3 * p];
+		n[0] = 0; n[1] = 0; n[2] = 0;
+		for (int i = topology.vertices_faces_start[p]; i < topology.vertices_faces_start[p + 1]; i++)
+			for (int j = 0; j < 3; j++)
+				n[j] += face_normals[3 * topology.vertices_faces[i] + j];
+		normalize_vect(3, n, &vertex_normals[3 * p]);
+	}
+}
+
+void compute_vertex_normals_B(const MeshTopology &topology, const double* vertices, double* vertices_B, const double* face_normals_unnormalized, const double* vertex_normals_unnormalized, const double* vertex_normals_B)
+{
+	vector<double> n_B(3 * topology.nb_vertices, 0.0);
+	for (int p = 0; p < topology.nb_vertices; p++)
+		normalize_vect_B(3, &vertex_normals_unnormalized[3 * p], &vertex_normals_B[3 * p], &n_B[3 * p]);
+	vector<double> face_normals_B(3 * topology.nb_faces, 0.0);
+	for (int p = 0; p < topology.nb_vertices; p++)
+		for (int i = topology.vertices_faces_start[p]; i < topology.vertices_faces_start[p + 1]; i++)
+			for (int j = 0; j < 3; j++)
+				face_normals_B[3 * topology.vertices_faces[i] + j] += n_B[3 * p + j];
+	for (int k = 0; k < topology.nb_faces; k++)
+	{
+		const unsigned int* face = &topology.faces[3 * k];
+		double u[3], v[3];
+		for (int i = 0; i < 3; i++)
+		{
+			u[i] = vertices[3 * face[1] + i] - vertices[3 * face[0] + i];
+			v[i] = vertices[3 * face[2] + i] - vertices[3 * face[0] + i];
+		}
+		double c_B[3] = { 0 }, u_B[3] = { 0 }, v_B[3] = { 0 };
+		normalize_vect_B(3, &face_normals_unnormalized[3 * k], &face_normals_B[3 * k], c_B);
+		if (topology.clockwise)
+			for (int i = 0; i < 3; i++) c_B[i] = -c_B[i];
+		cross_prod_B(u, u_B, v, v_B, c_B);
+		for (int i = 0; i < 3; i++)
+		{
+			vertices_B[3 * face[0] + i] -= u_B[i] + v_B[i];
+			vertices_B[3 * face[1] + i] += u_B[i];
+			vertices_B[3 * face[2] + i] += v_B[i];
+		}
+	}
+}
+
+class Scene3DPipeline {
+public:
+	MeshTopology* topology;
+
+	// inputs, set by the caller before calling render. The arrays are not copied and should remain valid
+	// until render_backward has been called.
+	double* vertices;           // nb_vertices x 3 in the object coordinate system, in the rest pose when using skinning
+	LinearBasis* shape_basis;   // when not NULL the vertices are obtained from the shape coefficients
+	double* shape_coefficients;
+	SkinningWeights* skinning;  // NULL for a rigid mesh
+	double* bone_transforms;    // nb_bones x 3 x 4, used when skinning is not NULL
+	double vertices_scale;      // scale applied to the vertices before the offsets and the pose, 1 by default
+	double* vertices_offsets;   // nb_vertices x 3 added to the scaled vertices before the pose, NULL for none
+	double* quaternion;         // (x,y,z,w) rotation applied to the vertices, normalized internally. NULL for identity
+	double* translation;        // translation applied after the rotation, NULL for no translation
+	Camera camera;
+	double* vertices_colors;    // nb_vertices x nb_colors, used when texture is NULL
+	int nb_colors;
+	unsigned int* faces_uv;     // nb_faces x 3, used when texture is not NULL
+	double* uv;                 // nb_uv x 2
+	int nb_uv;
+	double* texture;            // texture_height x texture_width x nb_colors
+	LinearBasis* texture_basis; // when not NULL the texture is obtained from the texture coefficients
+	double* texture_coefficients;
+	int texture_height;
+	int texture_width;
+	double* light_directional;  // direction multiplied by the intensity, NULL for ambient light only
+	double light_ambient;
+	double* background;         // height x width x nb_colors
+	bool render_depth;          // render the depth multiplied by depth_scale instead of the colors, with nb_colors=1
+	double depth_scale;
+	bool backface_culling;
+	double near_plane;          // depth of the plane the faces are clipped against, no clipping if not positive
+	double sigma;
+	int nb_threads;
+
+	// outputs
+	vector<double> image;
+	vector<double> z_buffer;
+	vector<double> vertices_transformed;
+	vector<double> ij;
+	vector<double> depths;
+	vector<unsigned char> edgeflags;
+	double loss;
+
+	// gradients, overwritten by render_backward
+	vector<double> vertices_b;
+	vector<double> bone_transforms_b;
+	vector<double> shape_coefficients_b;
+	vector<double> texture_coefficients_b;
+	double quaternion_b[4];
+	double translation_b[3];
+	double light_directional_b[3];
+	double light_ambient_b;
+	vector<double> vertices_colors_b;
+	vector<double> texture_b;
+	double vertices_scale_b;
+
+	// optional buffers owned by the caller, not copied by set_configuration, used to share the gradients
+	// between several pipelines. When not NULL the gradients with respect to the vertices, the vertices
+	// colors and the texture are added to them instead of being written in vertices_b, vertices_colors_b
+	// and texture_b, and the gradient with respect to vertices_offsets is written in vertices_offsets_b.
+	double* vertices_b_accumulator;
+	double* vertices_colors_b_accumulator;
+	double* texture_b_accumulator;
+	double* vertices_offsets_b;
+
+	Scene3DPipeline(MeshTopology* topology)
+	{
+		this->topology = topology;
+		vertices = NULL;
+		shape_basis = NULL;
+		shape_coefficients = NULL;
+		skinning = NULL;
+		bone_transforms = NULL;
+		vertices_scale = 1;
+		vertices_offsets = NULL;
+		quaternion = NULL;
+		translation = NULL;
+		vertices_colors = NULL;
+		nb_colors = 0;
+		faces_uv = NULL;
+		uv = NULL;
+		nb_uv = 0;
+		texture = NULL;
+		texture_basis = NULL;
+		texture_coefficients = NULL;
+		texture_height = 0;
+		texture_width = 0;
+		light_directional = NULL;
+		light_ambient = 0;
+		background = NULL;
+		render_depth = false;
+		depth_scale = 1;
+		backface_culling = true;
+		near_plane = 0.1;
+		sigma = 1;
+		nb_threads = 0;
+		camera.has_distortion = false;
+		camera.height = 0;
+		camera.width = 0;
+		loss = 0;
+		vertices_scale_b = 0;
+		vertices_b_accumulator = NULL;
+		vertices_colors_b_accumulator = NULL;
+		texture_b_accumulator = NULL;
+		vertices_offsets_b = NULL;
+		clipped = false;
+	}
+
+	void set_configuration(const Scene3DPipeline& other)
+	{
+		// copy the inputs of another pipeline without copying its buffers
+		topology = other.topology;
+		vertices = other.vertices;
+		shape_basis = other.shape_basis;
+		shape_coefficients = other.shape_coefficients;
+		skinning = other.skinning;
+		bone_transforms = other.bone_transforms;
+		vertices_scale = other.vertices_scale;
+		vertices_offsets = other.vertices_offsets;
+		quaternion = other.quaternion;
+		translation = other.translation;
+		camera = other.camera;
+		vertices_colors = other.vertices_colors;
+		nb_colors = other.nb_colors;
+		faces_uv = other.faces_uv;
+		uv = other.uv;
+		nb_uv = other.nb_uv;
+		texture = other.texture;
+		texture_basis = other.texture_basis;
+		texture_coefficients = other.texture_coefficients;
+		texture_height = other.texture_height;
+		texture_width = other.texture_width;
+		light_directional = other.light_directional;
+		light_ambient = other.light_ambient;
+		background = other.background;
+		render_depth = other.render_depth;
+		depth_scale = other.depth_scale;
+		backface_culling = other.backface_culling;
+		near_plane = other.near_plane;
+		sigma = other.sigma;
+		nb_threads = other.nb_threads;
+	}
+
+	double render(double* obs = NULL)
+	{
+		// run the forward pipeline and return the sum of squared differences with obs if obs is not NULL
+
+		this->obs = obs;
+		prepare_scene();
+
+		// rasterization
+
+		image.resize((size_t)camera.height * camera.width * nb_colors);
+		z_buffer.resize((size_t)camera.height * camera.width);
+		if (render_depth)
+			renderDepth(depth_scene, depth_scale, &image[0], &z_buffer[0], sigma);
+		else
+			renderScene(scene, &image[0], &z_buffer[0], sigma);
+
+		loss = 0;
+		if (obs != NULL)
+			for (size_t k = 0; k < image.size(); k++)
+			{
+				double d = image[k] - obs[k];
+				loss += d * d;
+			}
+		return loss;
+	}
+
+	void prepare_scene()
+	{
+		// evaluate the linear models, the skinning, the pose, the lighting and the projection, and set
+		// up the 2D scene rasterized by render
+
+		int nb_vertices = topology->nb_vertices;
+		int nb_faces = topology->nb_faces;
+
+		// linear shape and texture models
+
+		vertices_rest = vertices;
+		if (shape_basis != NULL)
+		{
+			if (shape_coefficients == NULL)
+				throw "shape_coefficients should be set when using a shape basis";
+			if (shape_basis->size != 3 * nb_vertices)
+				throw "the shape basis size should be 3 x nb_vertices";
+			vertices_from_basis.resize(3 * nb_vertices);
+			shape_basis->evaluate(shape_coefficients, &vertices_from_basis[0], nb_threads);
+			vertices_rest = &vertices_from_basis[0];
+		}
+		texture_rendered = texture;
+		if (texture_basis != NULL)
+		{
+			if (texture_coefficients == NULL)
+				throw "texture_coefficients should be set when using a texture basis";
+			if (texture_basis->size != texture_height * texture_width * nb_colors)
+				throw "the texture basis size should be texture_height x texture_width x nb_colors";
+			texture_from_basis.resize(texture_basis->size);
+			texture_basis->evaluate(texture_coefficients, &texture_from_basis[0], nb_threads);
+			texture_rendered = &texture_from_basis[0];
+		}
+
+		if ((vertices_rest == NULL) || (background == NULL))
+			throw "vertices and background should be set before calling render";
+		if (render_depth)
+		{
+			if (nb_colors != 1)
+				throw "nb_colors should be 1 when rendering depth";
+			texture_rendered = NULL;
+		}
+		else if ((texture_rendered == NULL) && (vertices_colors == NULL))
+			throw "either texture or vertices_colors should be set";
+		if (((vertices_scale != 1) || (vertices_offsets != NULL) || (vertices_b_accumulator != NULL)) && ((skinning != NULL) || (shape_basis != NULL)))
+			throw "vertices_scale, vertices_offsets and vertices_b_accumulator are not supported with skinning or a shape basis";
+		if ((texture_b_accumulator != NULL) && (texture_basis != NULL))
+			throw "texture_b_accumulator is not supported with a texture basis";
+
+		// skinning
+
+		const double* vertices_deformed = vertices_rest;
+		if (skinning != NULL)
+		{
+			if (bone_transforms == NULL)
+				throw "bone_transforms should be set when using skinning";
+			if (skinning->nb_vertices != nb_vertices)
+				throw "the skinning weights and the topology have different number of vertices";
+			vertices_skinned.resize(3 * nb_vertices);
+			linear_blend_skinning(*skinning, vertices_rest, bone_transforms, &vertices_skinned[0], nb_threads);
+			vertices_deformed = &vertices_skinned[0];
+		}
+
+		// pose, the scale and the offsets are applied on the fly
+
+		vertices_transformed.resize(3 * nb_vertices);
+		if (quaternion != NULL)
+			normalize_vect(4, quaternion, q_normalized);
+		for (int v = 0; v < nb_vertices; v++)
+		{
+			double* vt = &vertices_transformed[3 * v];
+			double p[3];
+			scale_and_offset_vertex(vertices_deformed, v, p);
+			if (quaternion != NULL)
+				quaternion_rotate(q_normalized, p, vt);
+			else
+				for (int i = 0; i < 3; i++) vt[i] = p[i];
+			if (translation != NULL)
+				for (int i = 0; i < 3; i++) vt[i] += translation[i];
+		}
+
+		// lighting
+
+		luminosity.resize(nb_vertices);
+		directional.resize(nb_vertices);
+		if ((light_directional != NULL) && !render_depth)
+		{
+			face_normals_unnormalized.resize(3 * nb_faces);
+			face_normals.resize(3 * nb_faces);
+			vertex_normals_unnormalized.resize(3 * nb_vertices);
+			vertex_normals.resize(3 * nb_vertices);
+			compute_vertex_normals(*topology, &vertices_transformed[0], &face_normals_unnormalized[0], &face_normals[0], &vertex_normals_unnormalized[0], &vertex_normals[0]);
+			for (int v = 0; v < nb_vertices; v++)
+			{
+				double d = -dot_prod(&vertex_normals[3 * v], light_directional);
+				directional[v] = d > 0 ? d : 0;
+			}
+		}
+		else
+			fill(directional.begin(), directional.end(), 0.0);
+		for (int v = 0; v < nb_vertices; v++)
+			luminosity[v] = directional[v] + light_ambient;
+
+		// projection
+
+		p_camera.resize(3 * nb_vertices);
+		projected.resize(2 * nb_vertices);
+		ij.resize(2 * nb_vertices);
+		depths.resize(nb_vertices);
+		project_points(camera, nb_vertices, &vertices_transformed[0], &p_camera[0], &projected[0], &ij[0], &depths[0]);
+
+		// near plane clipping
+
+		bool textured_uv = (texture_rendered != NULL) && (faces_uv != NULL) && (uv != NULL);
+		clipped = (near_plane > 0) && clip_faces_near_plane(clipping, &topology->faces[0], textured_uv ? faces_uv : &topology->faces[0], nb_faces, nb_vertices, textured_uv ? nb_uv : nb_vertices, &depths[0], near_plane);
+		if (clipped)
+			project_clip_vertices();
+
+		edgeflags.resize(3 * nb_faces);
+		if (sigma > 0)
+		{
+			if (clipped)
+			{
+				// the visibility of the clipped faces is given by their part in front of the plane
+				vector<unsigned char> face_visible(nb_faces, 0);
+				for (size_t k = 0; k < clipping.faces_origin.size(); k++)
+				{
+					double tri[3][2];
+					for (int i = 0; i < 3; i++)
+						for (int j = 0; j < 2; j++)
+							tri[i][j] = ij_clipped[clipping.faces[3 * k + i] * 2 + j];
+					if (signedArea(tri, topology->clockwise) > 0)
+						face_visible[clipping.faces_origin[k]] = 1;
+				}
+				edge_on_silhouette(*topology, &face_visible[0], &edgeflags[0]);
+			}
+			else
+				edge_on_silhouette(*topology, &ij[0], &edgeflags[0]);
+		}
+		else
+			fill(edgeflags.begin(), edgeflags.end(), 0);
+
+		if (render_depth)
+			setup_depth_scene();
+		else
+			setup_scene();
+		if (clipped)
+			clip_scene();
+	}
+
+	Scene& get_scene()
+	{
+		// 2D scene set up by prepare_scene, its gradient buffers are owned by the pipeline
+		return scene;
+	}
+
+	void clear_scene_gradients()
+	{
+		fill(ij_b.begin(), ij_b.end(), 0.0);
+		fill(shade_b.begin(), shade_b.end(), 0.0);
+		fill(colors_b.begin(), colors_b.end(), 0.0);
+		fill(uv_b.begin(), uv_b.end(), 0.0);
+		fill(texture_b.begin(), texture_b.end(), 0.0);
+	}
+
+	void render_backward(double* image_b = NULL)
+	{
+		// backpropagate image_b, or the gradient of the loss if image_b is NULL, down to the inputs
+
+		image_work.assign(image.begin(), image.end()); // renderScene_B undoes the antialiasing in place
+		image_b_work.resize(image.size());
+		if (image_b == NULL)
+		{
+			if (obs == NULL)
+				throw "render should be called with an observation to backpropagate the loss";
+			for (size_t k = 0; k < image.size(); k++)
+				image_b_work[k] = 2 * (image[k] - obs[k]);
+		}
+		else
+			image_b_work.assign(image_b, image_b + image.size());
+
+		if (render_depth)
+		{
+			// the gradients of the clip vertices are stored after the ones of the mesh vertices
+			ij_b.assign(2 * depth_scene.nb_vertices, 0.0);
+			depths_b.assign(depth_scene.nb_vertices, 0.0);
+			depth_scene.ij_b = &ij_b[0];
+			depth_scene.depths_b = &depths_b[0];
+			renderDepth_B(depth_scene, depth_scale, &image_work[0], &z_buffer[0], &image_b_work[0], sigma);
+		}
+		else
+		{
+			clear_scene_gradients();
+			renderScene_B(scene, &image_work[0], &z_buffer[0], &image_b_work[0], sigma);
+		}
+		prepare_scene_backward();
+	}
+
+	void prepare_scene_backward()
+	{
+		// backpropagate the gradients accumulated in the 2D scene by the adjoint of the rasterization
+		// down to the inputs
+
+		int nb_vertices = topology->nb_vertices;
+		int nb_clip = clipped ? clipping.nb_clip_vertices : 0;
+
+		// near plane clipping backward for the colors, shade and uv, whose gradients with respect to
+		// the clip vertices are stored after the ones of the mesh vertices
+
+		if (nb_clip > 0)
+		{
+			clip_weights_b.assign(nb_clip, 0.0);
+			if (!render_depth)
+			{
+				clip_interpolate_B(clipping, false, nb_colors, &colors[0], &colors_b[(size_t)nb_vertices * nb_colors], &colors_b[0], &clip_weights_b[0]);
+				clip_interpolate_B(clipping, false, 1, &shade[0], &shade_b[nb_vertices], &shade_b[0], &clip_weights_b[0]);
+				if (texture_rendered != NULL)
+					clip_interpolate_B(clipping, true, 2, uv, &uv_b[2 * nb_uv], &uv_b[0], &clip_weights_b[0]);
+			}
+		}
+
+		// lighting backward
+
+		vector<double> &luminosity_b = luminosity_b_work;
+		luminosity_b.resize(nb_vertices);
+		if (render_depth)
+		{
+			fill(luminosity_b.begin(), luminosity_b.end(), 0.0);
+			vertices_colors_b.clear();
+		}
+		else if (texture_rendered != NULL)
+		{
+			luminosity_b.assign(shade_b.begin(), shade_b.end());
+			vertices_colors_b.clear();
+		}
+		else
+		{
+			if (vertices_colors_b_accumulator != NULL)
+				vertices_colors_b.clear();
+			else
+				vertices_colors_b.resize(nb_vertices * nb_colors);
+			for (int v = 0; v < nb_vertices; v++)
+			{
+				double s = 0;
+				for (int c = 0; c < nb_colors; c++)
+				{
+					int k = v * nb_colors + c;
+					s += vertices_colors[k] * colors_b[k];
+					if (vertices_colors_b_accumulator != NULL)
+						vertices_colors_b_accumulator[k] += colors_b[k] * luminosity[v];
+					else
+						vertices_colors_b[k] = colors_b[k] * luminosity[v];
+				}
+				luminosity_b[v] = s;
+			}
+		}
+
+		vertices_transformed_b.assign(3 * nb_vertices, 0.0);
+		light_ambient_b = 0;
+		for (int v = 0; v < nb_vertices; v++)
+			light_ambient_b += luminosity_b[v];
+		for (int i = 0; i < 3; i++)
+			light_directional_b[i] = 0;
+		if ((light_directional != NULL) && !render_depth)
+		{
+			vertex_normals_b.resize(3 * nb_vertices);
+			for (int v = 0; v < nb_vertices; v++)
+			{
+				double d_b = directional[v] > 0 ? luminosity_b[v] : 0;
+				for (int i = 0; i < 3; i++)
+				{
+					light_directional_b[i] -= d_b * vertex_normals[3 * v + i];
+					vertex_normals_b[3 * v + i] = -d_b * light_directional[i];
+				}
+			}
+			compute_vertex_normals_B(*topology, &vertices_transformed[0], &vertices_transformed_b[0], &face_normals_unnormalized[0], &vertex_normals_unnormalized[0], &vertex_normals_b[0]);
+		}
+
+		// projection backward
+
+		const double* projected_depths_b = render_depth ? &depths_b[0] : NULL;
+		if (nb_clip > 0)
+		{
+			if (!render_depth)
+				depths_b.assign(nb_vertices + nb_clip, 0.0);
+			vertices_clipped_b.assign(3 * nb_clip, 0.0);
+			project_points_B(camera, nb_clip, &p_camera_clipped[0], &projected_clipped[0], &ij_b[2 * nb_vertices], &depths_b[nb_vertices], &vertices_clipped_b[0]);
+			clip_interpolate_B(clipping, false, 3, &vertices_transformed[0], &vertices_clipped_b[0], &vertices_transformed_b[0], &clip_weights_b[0]);
+			clip_weights_B(clipping, &depths[0], &clip_weights_b[0], &depths_b[0]);
+			projected_depths_b = &depths_b[0];
+		}
+		project_points_B(camera, nb_vertices, &p_camera[0], &projected[0], &ij_b[0], projected_depths_b, &vertices_transformed_b[0]);
+
+		// pose backward
+
+		for (int i = 0; i < 3; i++)
+			translation_b[i] = 0;
+		double q_normalized_b[4] = { 0 };
+		const double* vertices_deformed = (skinning != NULL) ? &vertices_skinned[0] : vertices_rest;
+		vertices_scale_b = 0;
+		if (vertices_b_accumulator != NULL)
+			vertices_b.clear();
+		else if (skinning == NULL)
+			vertices_b.resize(3 * nb_vertices);
+		for (int v = 0; v < nb_vertices; v++)
+		{
+			double* vt_b = &vertices_transformed_b[3 * v];
+			if (translation != NULL)
+				for (int i = 0; i < 3; i++) translation_b[i] += vt_b[i];
+			double p_b[3] = { 0, 0, 0 };
+			if (quaternion != NULL)
+			{
+				double p[3];
+				scale_and_offset_vertex(vertices_deformed, v, p);
+				quaternion_rotate_B(q_normalized, q_normalized_b, p, p_b, vt_b);
+			}
+			else
+				for (int i = 0; i < 3; i++) p_b[i] = vt_b[i];
+
+			// with skinning the gradient with respect to the skinned vertices is discarded, the
+			// rotation adjoint is applied again in linear_blend_skinning_B
+			if (skinning != NULL)
+				continue;
+			if (vertices_offsets_b != NULL)
+				for (int i = 0; i < 3; i++) vertices_offsets_b[3 * v + i] = p_b[i];
+			for (int i = 0; i < 3; i++)
+			{
+				vertices_scale_b += vertices_deformed[3 * v + i] * p_b[i];
+				if (vertices_b_accumulator != NULL)
+					vertices_b_accumulator[3 * v + i] += vertices_scale * p_b[i];
+				else
+					vertices_b[3 * v + i] = vertices_scale * p_b[i];
+			}
+		}
+		for (int i = 0; i < 4; i++)
+			quaternion_b[i] = 0;
+		if (quaternion != NULL)
+			normalize_vect_B(4, quaternion, q_normalized_b, quaternion_b);
+
+		// skinning backward, chained with the rotation of the pose
+
+		if (skinning != NULL)
+		{
+			double rotation[9];
+			if (quaternion != NULL)
+				for (int j = 0; j < 3; j++)
+				{
+					double axis[3] = { 0, 0, 0 }, column[3];
+					axis[j] = 1;
+					quaternion_rotate(q_normalized, axis, column);
+					for (int i = 0; i < 3; i++) rotation[3 * i + j] = column[i];
+				}
+			bone_transforms_b.assign(12 * skinning->nb_bones, 0.0);
+			vertices_b.resize(3 * nb_vertices);
+			linear_blend_skinning_B(*skinning, vertices_rest, bone_transforms, (quaternion != NULL) ? rotation : NULL, &vertices_transformed_b[0], &bone_transforms_b[0], &vertices_b[0], nb_threads);
+		}
+		else
+			bone_transforms_b.clear();
+
+		// linear models backward
+
+		if (shape_basis != NULL)
+		{
+			shape_coefficients_b.assign(shape_basis->nb_components, 0.0);
+			shape_basis->evaluate_B(&vertices_b[0], &shape_coefficients_b[0], nb_threads);
+		}
+		else
+			shape_coefficients_b.clear();
+		if (texture_basis != NULL)
+		{
+			texture_coefficients_b.assign(texture_basis->nb_components, 0.0);
+			texture_basis->evaluate_B(&texture_b[0], &texture_coefficients_b[0], nb_threads);
+		}
+		else
+			texture_coefficients_b.clear();
+	}
+
+private:
+	void scale_and_offset_vertex(const double* vertices_deformed, int v, double p[3]) const
+	{
+		for (int i = 0; i < 3; i++)
+			p[i] = vertices_scale * vertices_deformed[3 * v + i] + ((vertices_offsets != NULL) ? vertices_offsets[3 * v + i] : 0);
+	}
+
+	Scene scene;
+	DepthMaskScene depth_scene;
+	double* obs;
+	double q_normalized[4];
+	const double* vertices_rest;
+	double* texture_rendered;
+	vector<double> vertices_from_basis;
+	vector<double> texture_from_basis;
+	vector<double> vertices_skinned;
+	vector<double> luminosity;
+	vector<double> directional;
+	vector<double> face_normals_unnormalized;
+	vector<double> face_normals;
+	vector<double> vertex_normals_unnormalized;
+	vector<double> vertex_normals;
+	vector<double> p_camera;
+	vector<double> projected;
+	vector<double> colors;
+	vector<double> shade;
+	vector<double> uv_zeros;
+	vector<unsigned char> textured;
+	vector<double> texture_empty;
+	vector<double> image_work;
+	vector<double> image_b_work;
+	vector<double> ij_b;
+	vector<double> shade_b;
+	vector<double> colors_b;
+	vector<double> uv_b;
+	vector<double> luminosity_b_work;
+	vector<double> depths_b;
+	vector<double> vertex_normals_b;
+	vector<double> vertices_transformed_b;
+	NearPlaneClipping clipping;
+	bool clipped;
+	vector<double> vertices_clipped;
+	vector<double> p_camera_clipped;
+	vector<double> projected_clipped;
+	vector<double> ij_clipped;
+	vector<double> depths_clipped;
+	vector<unsigned char> edgeflags_clipped;
+	vector<double> colors_clipped;
+	vector<double> shade_clipped;
+	vector<double> uv_clipped;
+	vector<double> clip_weights_b;
+	vector<double> vertices_clipped_b;
+
+	void project_clip_vertices()
+	{
+		// the clip vertices are interpolated in the world coordinate system, which is equivalent to
+		// interpolating them in the camera coordinate system, and then projected using the camera
+		int nb_vertices = topology->nb_vertices;
+		int nb_clip = clipping.nb_clip_vertices;
+		clip_interpolate(clipping, false, 3, &vertices_transformed[0], vertices_clipped);
+		p_camera_clipped.resize(3 * nb_clip);
+		projected_clipped.resize(2 * nb_clip);
+		ij_clipped.resize(2 * (nb_vertices + nb_clip));
+		depths_clipped.resize(nb_vertices + nb_clip);
+		copy(ij.begin(), ij.end(), ij_clipped.begin());
+		copy(depths.begin(), depths.end(), depths_clipped.begin());
+		if (nb_clip > 0)
+			project_points(camera, nb_clip, &vertices_clipped[3 * nb_vertices], &p_camera_clipped[0], &projected_clipped[0], &ij_clipped[2 * nb_vertices], &depths_clipped[nb_vertices]);
+	}
+
+	void clip_scene()
+	{
+		// replace the faces of the 2D scene set up by setup_scene or setup_depth_scene by the clipped faces
+		int nb_vertices_clipped = topology->nb_vertices + clipping.nb_clip_vertices;
+		int nb_faces_clipped = (int)clipping.faces_origin.size();
+
+		edgeflags_clipped.resize(3 * nb_faces_clipped + 1);
+		for (int k = 0; k < 3 * nb_faces_clipped; k++)
+		{
+			int n = clipping.faces_edges_origin[k];
+			edgeflags_clipped[k] = (n >= 0) && edgeflags[3 * clipping.faces_origin[k / 3] + n];
+		}
+		if (nb_faces_clipped == 0)
+		{
+			// all the faces are behind the plane, use valid pointers for the empty scene
+			clipping.faces.assign(3, 0);
+			clipping.faces_uv.assign(3, 0);
+		}
+
+		if (render_depth)
+		{
+			depth_scene.faces = &clipping.faces[0];
+			depth_scene.nb_triangles = nb_faces_clipped;
+			depth_scene.nb_vertices = nb_vertices_clipped;
+			depth_scene.depths = &depths_clipped[0];
+			depth_scene.ij = &ij_clipped[0];
+			depth_scene.edgeflags = (bool*)&edgeflags_clipped[0];
+			return;
+		}
+
+		scene.faces = &clipping.faces[0];
+		scene.nb_triangles = nb_faces_clipped;
+		scene.nb_vertices = nb_vertices_clipped;
+		scene.depths = &depths_clipped[0];
+		scene.ij = &ij_clipped[0];
+		scene.edgeflags = (bool*)&edgeflags_clipped[0];
+
+		textured.assign(nb_faces_clipped + 1, texture_rendered != NULL);
+		scene.textured = (bool*)&textured[0];
+		scene.shaded = (bool*)&textured[0];
+		clip_interpolate(clipping, false, nb_colors, &colors[0], colors_clipped);
+		clip_interpolate(clipping, false, 1, &shade[0], shade_clipped);
+		scene.colors = &colors_clipped[0];
+		scene.shade = &shade_clipped[0];
+		if (texture_rendered != NULL)
+		{
+			clip_interpolate(clipping, true, 2, uv, uv_clipped);
+			scene.faces_uv = &clipping.faces_uv[0];
+			scene.uv = &uv_clipped[0];
+			scene.nb_uv = nb_uv + clipping.nb_clip_vertices;
+		}
+		else
+		{
+			uv_zeros.assign(2 * nb_vertices_clipped, 0.0);
+			scene.faces_uv = &clipping.faces[0];
+			scene.uv = &uv_zeros[0];
+			scene.nb_uv = nb_vertices_clipped;
+		}
+
+		ij_b.resize(2 * nb_vertices_clipped);
+		shade_b.resize(nb_vertices_clipped);
+		colors_b.resize(nb_vertices_clipped * nb_colors);
+		uv_b.resize(2 * scene.nb_uv);
+		scene.ij_b = &ij_b[0];
+		scene.shade_b = &shade_b[0];
+		scene.colors_b = &colors_b[0];
+		scene.uv_b = &uv_b[0];
+	}
+
+	void setup_depth_scene()
+	{
+		depth_scene.faces = &topology->faces[0];
+		depth_scene.nb_triangles = topology->nb_faces;
+		depth_scene.nb_vertices = topology->nb_vertices;
+		depth_scene.clockwise = topology->clockwise;
+		depth_scene.backface_culling = backface_culling;
+		depth_scene.height = camera.height;
+		depth_scene.width = camera.width;
+		depth_scene.depths = &depths[0];
+		depth_scene.ij = &ij[0];
+		depth_scene.edgeflags = (bool*)&edgeflags[0];
+		depth_scene.background = background;
+		depth_scene.ij_b = NULL;
+		depth_scene.depths_b = NULL;
+	}
+
+	void setup_scene()
+	{
+		int nb_vertices = topology->nb_vertices;
+		int nb_faces = topology->nb_faces;
+
+		scene.faces = &topology->faces[0];
+		scene.nb_triangles = nb_faces;
+		scene.nb_vertices = nb_vertices;
+		scene.clockwise = topology->clockwise;
+		scene.backface_culling = backface_culling;
+		scene.height = camera.height;
+		scene.width = camera.width;
+		scene.nb_colors = nb_colors;
+		scene.depths = &depths[0];
+		scene.ij = &ij[0];
+		scene.edgeflags = (bool*)&edgeflags[0];
+		scene.background = background;
+
+		textured.assign(nb_faces, texture_rendered != NULL);
+		scene.textured = (bool*)&textured[0];
+		scene.shaded = (bool*)&textured[0];
+
+		colors.resize(nb_vertices * nb_colors);
+		shade.resize(nb_vertices);
+		if (texture_rendered != NULL)
+		{
+			if ((faces_uv == NULL) || (uv == NULL))
+				throw "faces_uv and uv should be set when using a texture";
+			scene.faces_uv = faces_uv;
+			scene.uv = uv;
+			scene.nb_uv = nb_uv;
+			scene.texture = texture_rendered;
+			scene.texture_height = texture_height;
+			scene.texture_width = texture_width;
+			shade.assign(luminosity.begin(), luminosity.end());
+			fill(colors.begin(), colors.end(), 0.0);
+			if (texture_b_accumulator != NULL)
+				texture_b.clear();
+			else
+				texture_b.resize(texture_height * texture_width * nb_colors);
+		}
+		else
+		{
+			uv_zeros.assign(2 * nb_vertices, 0.0);
+			texture_empty.assign(1, 0.0);
+			scene.faces_uv = &topology->faces[0];
+			scene.uv = &uv_zeros[0];
+			scene.nb_uv = nb_vertices;
+			scene.texture = &texture_empty[0];
+			scene.texture_height = 0;
+			scene.texture_width = 0;
+			fill(shade.begin(), shade.end(), 0.0);
+			if (render_depth)
+				for (int v = 0; v < nb_vertices; v++)
+					colors[v] = depths[v] * depth_scale;
+			else
+				for (int v = 0; v < nb_vertices; v++)
+					for (int c = 0; c < nb_colors; c++)
+						colors[v * nb_colors + c] = vertices_colors[v * nb_colors + c] * luminosity[v];
+			texture_b.assign(1, 0.0);
+		}
+		scene.shade = &shade[0];
+		scene.colors = &colors[0];
+
+		ij_b.resize(2 * nb_vertices);
+		shade_b.resize(nb_vertices);
+		colors_b.resize(nb_vertices * nb_colors);
+		uv_b.resize(2 * scene.nb_uv);
+		scene.ij_b = &ij_b[0];
+		scene.shade_b = &shade_b[0];
+		scene.colors_b = &colors_b[0];
+		scene.uv_b = &uv_b[0];
+		scene.texture_b = ((texture_rendered != NULL) && (texture_b_accumulator != NULL)) ? texture_b_accumulator : &texture_b[0];
+	}
+};
+
+#endif
@@ -0,0 +1,152 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _Skinning_h_
+#define _Skinning_h_
+
+// Linear blend skinning with sparse per-vertex bone weights and its adjoint.
+// Each bone transform is a 3x4 matrix [R|t] stored row major, a vertex is deformed using
+// v = sum_b w_vb (R_b t_v + t_b) where t_v is the vertex position in the rest pose.
+
+#include <vector>
+#include "ParallelFor.h"
+
+using namespace std;
+
+struct SkinningWeights {
+	int nb_vertices;
+	int nb_bones;
+	// non zero weights stored in compressed row format, one row per vertex
+	vector<int> vertices_start;
+	vector<int> bones;
+	vector<double> weights;
+};
+
+void build_skinning_weights(SkinningWeights &skinning, int nb_vertices, int nb_bones, int nb_weights, const int* vertices_ids, const int* bones_ids, const double* weights)
+{
+	// build the compressed row storage from a list of (vertex, bone, weight) triplets
+	skinning.nb_vertices = nb_vertices;
+	skinning.nb_bones = nb_bones;
+	skinning.vertices_start.assign(nb_vertices + 1, 0);
+	for (int k = 0; k < nb_weights; k++)
+	{
+		if ((vertices_ids[k] < 0) || (vertices_ids[k] >= nb_vertices))
+			throw "skinning vertex id out of bounds";
+		if ((bones_ids[k] < 0) || (bones_ids[k] >= nb_bones))
+			throw "skinning bone id out of bounds";
+		skinning.vertices_start[vertices_ids[k] + 1]++;
+	}
+	for (int v = 0; v < nb_vertices; v++)
+		skinning.vertices_start[v + 1] += skinning.vertices_start[v];
+	skinning.bones.resize(nb_weights);
+	skinning.weights.resize(nb_weights);
+	vector<int> fill_position(skinning.vertices_start.begin(), skinning.vertices_start.end() - 1);
+	for (int k = 0; k < nb_weights; k++)
+	{
+		int i = fill_position[vertices_ids[k]]++;
+		skinning.bones[i] = bones_ids[k];
+		skinning.weights[i] = weights[k];
+	}
+}
+
+void linear_blend_skinning(const SkinningWeights &skinning, const double* vertices_rest, const double* bone_transforms, double* vertices, int nb_threads = 0)
+{
+	parallel_for(skinning.nb_vertices, nb_threads, 1024, [&](int begin, int end, int)
+	{
+		for (int v = begin; v < end; v++)
+		{
+			const double* p = &vertices_rest[3 * v];
+			double* q = &vertices[3 * v];
+			q[0] = 0; q[1] = 0; q[2] = 0;
+			for (int k = skinning.vertices_start[v]; k < skinning.vertices_start[v + 1]; k++)
+			{
+				const double* M = &bone_transforms[12 * skinning.bones[k]];
+				double w = skinning.weights[k];
+				for (int i = 0; i < 3; i++)
+					q[i] += w * (M[4 * i] * p[0] + M[4 * i + 1] * p[1] + M[4 * i + 2] * p[2] + M[4 * i + 3]);
+			}
+		}
+	});
+}
+
+void linear_blend_skinning_B(const SkinningWeights &skinning, const double* vertices_rest, const double* bone_transforms, const double* rotation, const double* vertices_posed_B, double* bone_transforms_B, double* vertices_rest_B = NULL, int nb_threads = 0)
+{
+	// vertices_posed_B is the gradient with respect to the skinned vertices rotated by the 3x3 row major
+	// matrix rotation (identity if NULL) and possibly translated. The rotation adjoint is applied on the
+	// fly so that the gradient with respect to the skinned vertices is never stored.
+	// accumulates the gradient with respect to the bone transforms into bone_transforms_B and,
+	// if vertices_rest_B is not NULL, overwrites it with the gradient with respect to the rest pose.
+	// Each thread accumulates the bones gradients in its own buffer and the buffers are summed at the end.
+
+	int nb_bones = skinning.nb_bones;
+	nb_threads = get_nb_threads(nb_threads);
+	vector<double> bone_transforms_B_threads(nb_threads * nb_bones * 12, 0.0);
+
+	parallel_for(skinning.nb_vertices, nb_threads, 1024, [&](int begin, int end, int thread_id)
+	{
+		double* M_B_thread = &bone_transforms_B_threads[thread_id * nb_bones * 12];
+		for (int v = begin; v < end; v++)
+		{
+			const double* p = &vertices_rest[3 * v];
+			const double* vp_B = &vertices_posed_B[3 * v];
+			double q_B[3];
+			for (int i = 0; i < 3; i++)
+				q_B[i] = (rotation != NULL) ? rotation[i] * vp_B[0] + rotation[3 + i] * vp_B[1] + rotation[6 + i] * vp_B[2] : vp_B[i];
+			double p_B[3] = { 0, 0, 0 };
+			for (int k = skinning.vertices_start[v]; k < skinning.vertices_start[v + 1]; k++)
+			{
+				int b = skinning.bones[k];
+				const double* M = &bone_transforms[12 * b];
+				double* M_B = &M_B_thread[12 * b];
+				double w = skinning.weights[k];
+				for (int i = 0; i < 3; i++)
+				{
+					double wq_B = w * q_B[i];
+					M_B[4 * i] += wq_B * p[0];
+					M_B[4 * i + 1] += wq_B * p[1];
+					M_B[4 * i + 2] += wq_B * p[2];
+					M_B[4 * i + 3] += wq_B;
+					p_B[0] += wq_B * M[4 * i];
+					p_B[1] += wq_B * M[4 * i + 1];
+					p_B[2] += wq_B * M[4 * i + 2];
+				}
+			}
+			if (vertices_rest_B != NULL)
+				for (int i = 0; i < 3; i++)
+					vertices_rest_B[3 * v + i] = p_B[i];
+		}
+	});
+
+	for (int t = 0; t < nb_threads; t++)
+		for (int k = 0; k < 12 * nb_bones; k++)
+			bone_transforms_B[k] += bone_transforms_B_threads[t * nb_bones * 12 + k];
+}
+
+#endif
@@ -0,0 +1,180 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+#ifndef _StaticLayerRenderer_h_
+#define _StaticLayerRenderer_h_
+
+// Render a dynamic scene in front of, behind or intersecting a static scene whose rendering is cached.
+// set_static_scene renders the static triangles over the background once, and keeps the resulting
+// image and z_buffer together with the final image including the static silhouette edges. Each call
+// to render copies the cached final image and only renders the region covered by the dynamic scene,
+// enlarged by the width of the edge stencils: that region is initialized from the cached static
+// triangles image and z_buffer, the dynamic triangles are rasterized against the static z_buffer, and
+// the silhouette edges of both scenes intersecting the region are drawn sorted globally, so that the
+// occlusions and the antialiasing between the two scenes are the same as when rendering them at once.
+// The static scene does not receive gradients, its edges are backpropagated into the gradient buffers
+// of the static scene only to propagate image_b correctly to the dynamic triangles beneath them.
+// The arrays of both scenes should remain valid until the adjoint has been computed.
+
+#include "FrameRenderer.h"
+#include "ROIRenderer.h"
+
+class StaticLayerRenderer {
+public:
+	Scene static_scene;
+	double sigma;
+	int height;
+	int width;
+	int nb_colors;
+	vector<double> image_triangles;
+	vector<double> z_buffer_static;
+	vector<double> image_static;
+
+	// state of the last rendering used by the adjoint
+	int roi[4];
+	SceneROIView static_view;
+	SceneROIView dynamic_view;
+	FrameRenderer frame;
+	vector<double> image_roi;
+	vector<double> z_buffer_roi;
+	bool has_rendering;
+
+	StaticLayerRenderer(const Scene& scene, double sigma)
+	{
+		set_static_scene(scene, sigma);
+	}
+
+	void set_static_scene(const Scene& scene, double sigma)
+	{
+		checkSceneValid(scene, false);
+		static_scene = scene;
+		this->sigma = sigma;
+		height = scene.height;
+		width = scene.width;
+		nb_colors = scene.nb_colors;
+		size_t nb_pixels = (size_t)height * width;
+		image_triangles.resize(nb_pixels * nb_colors);
+		z_buffer_static.resize(nb_pixels);
+		image_static.resize(nb_pixels * nb_colors);
+
+		FrameRenderer static_frame;
+		static_frame.begin_frame(height, width, nb_colors, scene.background, &image_static[0], &z_buffer_static[0]);
+		static_frame.draw_batch(scene);
+		image_triangles = image_static;
+		static_frame.end_frame(sigma);
+		roi[0] = roi[1] = roi[2] = roi[3] = 0;
+		has_rendering = false;
+	}
+
+	void get_dynamic_roi(const Scene& scene, int roi[4])
+	{
+		// bounding box of the projected vertices of the dynamic scene enlarged by the edge stencils
+		// width and clipped to the image, with a zero size when the dynamic scene is not visible
+		double margin = (sigma > 0 ? sigma : 0) + 1;
+		double xmin = numeric_limits<double>::infinity(), xmax = -xmin;
+		double ymin = xmin, ymax = -xmin;
+		for (int k = 0; k < scene.nb_triangles * 3; k++)
+		{
+			const double* ij = &scene.ij[2 * scene.faces[k]];
+			xmin = min(xmin, ij[0]);
+			xmax = max(xmax, ij[0]);
+			ymin = min(ymin, ij[1]);
+			ymax = max(ymax, ij[1]);
+		}
+		int x_begin = max(0, floor_to_int(xmin - margin));
+		int x_end = min(width, floor_to_int(xmax + margin) + 2);
+		int y_begin = max(0, floor_to_int(ymin - margin));
+		int y_end = min(height, floor_to_int(ymax + margin) + 2);
+		roi[0] = x_begin;
+		roi[1] = y_begin;
+		roi[2] = max(0, x_end - x_begin);
+		roi[3] = max(0, y_end - y_begin);
+		if ((roi[2] == 0) || (roi[3] == 0))
+			roi[2] = roi[3] = 0;
+	}
+
+	void render(const Scene& scene, double* image, double* z_buffer)
+	{
+		// render the dynamic scene with the static scene, image and z_buffer are of the size of the image
+		if ((scene.height != height) || (scene.width != width) || (scene.nb_colors != nb_colors))
+			throw "the dynamic scene dimensions do not match the static scene dimensions";
+		checkSceneValid(scene, false);
+		memcpy(image, &image_static[0], image_static.size() * sizeof(double));
+		memcpy(z_buffer, &z_buffer_static[0], z_buffer_static.size() * sizeof(double));
+		get_dynamic_roi(scene, roi);
+		has_rendering = true;
+		int x0 = roi[0], y0 = roi[1], roi_width = roi[2], roi_height = roi[3];
+		if (roi_width == 0)
+			return;
+
+		size_t row_size = (size_t)roi_width * nb_colors;
+		vector<double> background_roi(row_size * roi_height);
+		vector<double> z_buffer_background_roi((size_t)roi_width * roi_height);
+		for (int y = 0; y < roi_height; y++)
+		{
+			memcpy(&background_roi[y * row_size], &image_triangles[((size_t)(y + y0) * width + x0) * nb_colors], row_size * sizeof(double));
+			memcpy(&z_buffer_background_roi[(size_t)y * roi_width], &z_buffer_static[(size_t)(y + y0) * width + x0], roi_width * sizeof(double));
+		}
+
+		get_scene_roi_view(static_scene, x0, y0, roi_width, roi_height, sigma, false, static_view);
+		get_scene_roi_view(scene, x0, y0, roi_width, roi_height, sigma, false, dynamic_view);
+		image_roi.resize(row_size * roi_height);
+		z_buffer_roi.resize((size_t)roi_width * roi_height);
+		frame.begin_frame(roi_height, roi_width, nb_colors, &background_roi[0], &image_roi[0], &z_buffer_roi[0], &z_buffer_background_roi[0]);
+		frame.draw_batch(static_view.scene, false);
+		frame.draw_batch(dynamic_view.scene);
+		frame.end_frame(sigma);
+
+		for (int y = 0; y < roi_height; y++)
+		{
+			memcpy(&image[((size_t)(y + y0) * width + x0) * nb_colors], &image_roi[y * row_size], row_size * sizeof(double));
+			memcpy(&z_buffer[(size_t)(y + y0) * width + x0], &z_buffer_roi[(size_t)y * roi_width], roi_width * sizeof(double));
+		}
+	}
+
+	void render_B(const double* image_b)
+	{
+		// accumulate the gradients of the last rendering into the _b buffers of the dynamic scene,
+		// image_b is of the size of the image
+		if (!has_rendering)
+			throw "the adjoint can only be computed once after each rendering";
+		has_rendering = false;
+		int x0 = roi[0], y0 = roi[1], roi_width = roi[2], roi_height = roi[3];
+		if (roi_width == 0)
+			return;
+		size_t row_size = (size_t)roi_width * nb_colors;
+		vector<double> image_b_roi(row_size * roi_height);
+		for (int y = 0; y < roi_height; y++)
+			memcpy(&image_b_roi[y * row_size], &image_b[((size_t)(y + y0) * width + x0) * nb_colors], row_size * sizeof(double));
+		frame.render_B(&image_roi[0], &image_b_roi[0], sigma);
+	}
+};
+
+#endif
@@ -1,3 +1,4 @@
 mex 'render_b.cpp' 
 mex 'render.cpp' 
+mex CXXFLAGS='$CXXFLAGS -std=c++11 -pthread' LDFLAGS='$LDFLAGS -pthread' 'scene_handle.cpp'
 addpath('examples')
@@ -1,5 +1,4 @@
 #include <mex.h>
-#include "array2D.h"
 #include "../C++/DifferentiableRenderer.h"
 
 void error(const char* msg)
@@ -28,7 +27,7 @@ void mexFunction(int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[])
 	const mwSize  *dim_array;
 	mwSize strlen;  
 	const mxArray * matlab_scene;
-	Scene scene;
+	Scene scene = {};
 	double* obs;
 	double* err_buffer; 
     // loading type 
@@ -61,8 +60,11 @@ void mexFunction(int nlhs,mxArray *plhs[],int nrhs,const mxArray *prhs[])
 	scene.faces= (uint32_T *)mxGetData(source);
     
     
-    scene.clockwise=true;
-	scene.backface_culling=true;
+	// optional fields, true by default for backward compatibility
+	source=mxGetField(matlab_scene,0,"clockwise");
+	scene.clockwise=source ? (mxGetScalar(source)!=0) : true;
+	source=mxGetField(matlab_scene,0,"backface_culling");
+	scene.backface_culling=source ? (mxGetScalar(source)!=0) : true;
     
     source=mxGetField(matlab_scene,0,"faces_uv");
     if (!source)
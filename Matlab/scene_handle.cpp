@@ -0,0 +1,361 @@
+// MEX function keeping scenes in memory between calls and rendering batches of views in parallel.
+//
+// handle = scene_handle('create', scene)
+//     copies the fields of the scene that do not change between views (faces, faces_uv, uv, textured,
+//     shaded, texture, background and the optional clockwise and backface_culling fields)
+// [images, z_buffers] = scene_handle('render', handle, sigma, ij, colors, depths, shade, edgeflags)
+//     renders B views with ij 2 x nb_vertices x B, colors nb_colors x nb_vertices x B, depths and shade
+//     1 x nb_vertices x B and edgeflags 3 x nb_triangles x B, images is nb_colors x W x H x B and
+//     z_buffers W x H x B
+// [ij_b, colors_b, shade_b] = scene_handle('render_b', handle, sigma, images, z_buffers, images_b, ij, colors, depths, shade, edgeflags)
+//     adjoint of the batched rendering
+// scene_handle('delete', handle)
+
+#include <mex.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include "../C++/DifferentiableRenderer.h"
+#include "../C++/ParallelFor.h"
+
+using namespace std;
+
+void error(const char* msg)
+{
+	mexErrMsgTxt(msg);
+}
+
+struct StoredScene {
+	vector<unsigned int> faces;
+	vector<unsigned int> faces_uv;
+	vector<double> uv;
+	// mxLogical and bool are both stored on one byte
+	vector<unsigned char> textured;
+	vector<unsigned char> shaded;
+	vector<double> texture;
+	vector<double> background;
+	int nb_triangles;
+	int nb_uv;
+	int nb_colors;
+	int height;
+	int width;
+	int texture_height;
+	int texture_width;
+	bool clockwise;
+	bool backface_culling;
+};
+
+static map<unsigned long long, StoredScene*> stored_scenes;
+static unsigned long long next_handle = 1;
+
+void clear_stored_scenes()
+{
+	for (auto& it : stored_scenes)
+		delete it.second;
+	stored_scenes.clear();
+}
+
+const mxArray* get_field(const mxArray* matlab_scene, const char* name)
+{
+	const mxArray* source = mxGetField(matlab_scene, 0, name);
+	if (!source)
+		mexErrMsgIdAndTxt("deodr:scene_handle", "missing field %s", name);
+	return source;
+}
+
+void check_size(const mxArray* source, int dim0, int dim1, int dim2, const char* message)
+{
+	// a negative expected size is not checked, dim2 < 0 means that the array is not batched
+	const mwSize* dims = mxGetDimensions(source);
+	int nb_dims = mxGetNumberOfDimensions(source);
+	if (!mxIsDouble(source) && !mxIsLogical(source) && !mxIsUint32(source))
+		error(message);
+	if ((dim0 >= 0) && (dims[0] != dim0))
+		error(message);
+	if ((dim1 >= 0) && (dims[1] != dim1))
+		error(message);
+	if (dim2 >= 0)
+	{
+		mwSize batch_size = nb_dims > 2 ? dims[2] : 1;
+		if (nb_dims > 3 || batch_size != dim2)
+			error(message);
+	}
+	else if (nb_dims != 2)
+		error(message);
+}
+
+StoredScene* create_scene(const mxArray* matlab_scene)
+{
+	// all the fields are validated before allocating the stored scene, as error does not return
+	// and would leak it
+	if (!mxIsStruct(matlab_scene))
+		error("scene should a struct");
+	const mxArray* faces = get_field(matlab_scene, "faces");
+	if (!mxIsUint32(faces) || mxGetNumberOfDimensions(faces) != 2 || mxGetM(faces) != 3)
+		error("the input scene.faces should be a uint32 array of size 3xNbTriangles");
+	size_t nb_triangles = mxGetN(faces);
+
+	const mxArray* faces_uv = get_field(matlab_scene, "faces_uv");
+	if (!mxIsUint32(faces_uv) || mxGetNumberOfDimensions(faces_uv) != 2 || mxGetM(faces_uv) != 3 || mxGetN(faces_uv) != nb_triangles)
+		error("the input scene.faces_uv should be a uint32 array of size 3xNbTriangles");
+
+	const mxArray* uv = get_field(matlab_scene, "uv");
+	check_size(uv, 2, -1, -1, "the input scene.uv should be of size 2xNb_uv");
+
+	const mxArray* textured = get_field(matlab_scene, "textured");
+	if (!mxIsLogical(textured) || mxGetNumberOfElements(textured) != nb_triangles)
+		error("the input scene.textured should be a logical array of size 1xNbTriangles");
+	const mxArray* shaded = get_field(matlab_scene, "shaded");
+	if (!mxIsLogical(shaded) || mxGetNumberOfElements(shaded) != nb_triangles)
+		error("the input scene.shaded should be a logical array of size 1xNbTriangles");
+
+	const mxArray* background = get_field(matlab_scene, "background");
+	if (!mxIsDouble(background) || mxGetNumberOfDimensions(background) != 3)
+		error("the input scene.background should be of size nb_colors x W x H");
+	const mwSize* background_dims = mxGetDimensions(background);
+
+	const mxArray* texture = get_field(matlab_scene, "texture");
+	if (!mxIsDouble(texture) || mxGetNumberOfDimensions(texture) != 3)
+		error("the input scene.texture should be of size nb_colors x W x H");
+	const mwSize* texture_dims = mxGetDimensions(texture);
+	if (texture_dims[0] != background_dims[0])
+		error("the input scene.texture should be of size nb_colors x W x H");
+
+	StoredScene* stored = new StoredScene();
+	stored->nb_triangles = nb_triangles;
+	unsigned int* faces_data = (unsigned int*)mxGetData(faces);
+	stored->faces.assign(faces_data, faces_data + 3 * nb_triangles);
+	unsigned int* faces_uv_data = (unsigned int*)mxGetData(faces_uv);
+	stored->faces_uv.assign(faces_uv_data, faces_uv_data + 3 * nb_triangles);
+	stored->nb_uv = mxGetN(uv);
+	stored->uv.assign(mxGetPr(uv), mxGetPr(uv) + 2 * stored->nb_uv);
+	stored->textured.assign(mxGetLogicals(textured), mxGetLogicals(textured) + nb_triangles);
+	stored->shaded.assign(mxGetLogicals(shaded), mxGetLogicals(shaded) + nb_triangles);
+	stored->nb_colors = background_dims[0];
+	stored->width = background_dims[1];
+	stored->height = background_dims[2];
+	stored->background.assign(mxGetPr(background), mxGetPr(background) + mxGetNumberOfElements(background));
+	stored->texture_width = texture_dims[1];
+	stored->texture_height = texture_dims[2];
+	stored->texture.assign(mxGetPr(texture), mxGetPr(texture) + mxGetNumberOfElements(texture));
+
+	// optional fields, true by default for consistency with render and render_b
+	const mxArray* source = mxGetField(matlab_scene, 0, "clockwise");
+	stored->clockwise = source ? (mxGetScalar(source) != 0) : true;
+	source = mxGetField(matlab_scene, 0, "backface_culling");
+	stored->backface_culling = source ? (mxGetScalar(source) != 0) : true;
+	return stored;
+}
+
+StoredScene* get_stored_scene(const mxArray* handle)
+{
+	if (!mxIsUint64(handle) || mxGetNumberOfElements(handle) != 1)
+		error("the scene handle should be a uint64 scalar");
+	unsigned long long id = *(unsigned long long*)mxGetData(handle);
+	auto it = stored_scenes.find(id);
+	if (it == stored_scenes.end())
+		error("invalid or deleted scene handle");
+	return it->second;
+}
+
+struct BatchInputs {
+	double* ij;
+	double* colors;
+	double* depths;
+	double* shade;
+	bool* edgeflags;
+	int nb_vertices;
+	int batch_size;
+};
+
+BatchInputs get_batch_inputs(const StoredScene* stored, const mxArray** prhs)
+{
+	// prhs points to ij, colors, depths, shade and edgeflags
+	BatchInputs inputs;
+	const mwSize* dims = mxGetDimensions(prhs[0]);
+	inputs.nb_vertices = dims[1];
+	inputs.batch_size = mxGetNumberOfDimensions(prhs[0]) > 2 ? dims[2] : 1;
+	check_size(prhs[0], 2, inputs.nb_vertices, inputs.batch_size, "ij should be of size 2 x nb_vertices x B");
+	check_size(prhs[1], stored->nb_colors, inputs.nb_vertices, inputs.batch_size, "colors should be of size nb_colors x nb_vertices x B");
+	check_size(prhs[2], 1, inputs.nb_vertices, inputs.batch_size, "depths should be of size 1 x nb_vertices x B");
+	check_size(prhs[3], 1, inputs.nb_vertices, inputs.batch_size, "shade should be of size 1 x nb_vertices x B");
+	check_size(prhs[4], 3, stored->nb_triangles, inputs.batch_size, "edgeflags should be of size 3 x nb_triangles x B");
+	if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || !mxIsDouble(prhs[2]) || !mxIsDouble(prhs[3]))
+		error("ij, colors, depths and shade should be of type double");
+	if (!mxIsLogical(prhs[4]))
+		error("edgeflags should be of type logical");
+	for (int k = 0; k < 3 * stored->nb_triangles; k++)
+		if (stored->faces[k] >= (unsigned int)inputs.nb_vertices)
+			error("scene.faces contains invalid vertex indices");
+	inputs.ij = mxGetPr(prhs[0]);
+	inputs.colors = mxGetPr(prhs[1]);
+	inputs.depths = mxGetPr(prhs[2]);
+	inputs.shade = mxGetPr(prhs[3]);
+	inputs.edgeflags = mxGetLogicals(prhs[4]);
+	return inputs;
+}
+
+Scene get_scene(StoredScene* stored, const BatchInputs& inputs, int b)
+{
+	Scene scene = {};
+	int nb_vertices = inputs.nb_vertices;
+	scene.faces = &stored->faces[0];
+	scene.faces_uv = &stored->faces_uv[0];
+	scene.uv = &stored->uv[0];
+	scene.textured = (bool*)&stored->textured[0];
+	scene.shaded = (bool*)&stored->shaded[0];
+	scene.texture = &stored->texture[0];
+	scene.background = &stored->background[0];
+	scene.nb_triangles = stored->nb_triangles;
+	scene.nb_uv = stored->nb_uv;
+	scene.nb_colors = stored->nb_colors;
+	scene.height = stored->height;
+	scene.width = stored->width;
+	scene.texture_height = stored->texture_height;
+	scene.texture_width = stored->texture_width;
+	scene.clockwise = stored->clockwise;
+	scene.backface_culling = stored->backface_culling;
+	scene.nb_vertices = nb_vertices;
+	scene.ij = inputs.ij + (size_t)b * 2 * nb_vertices;
+	scene.colors = inputs.colors + (size_t)b * stored->nb_colors * nb_vertices;
+	scene.depths = inputs.depths + (size_t)b * nb_vertices;
+	scene.shade = inputs.shade + (size_t)b * nb_vertices;
+	scene.edgeflags = inputs.edgeflags + (size_t)b * 3 * stored->nb_triangles;
+	return scene;
+}
+
+void report_errors(const vector<string>& errors)
+{
+	// mexErrMsgTxt cannot be called from the worker threads
+	for (size_t b = 0; b < errors.size(); b++)
+		if (!errors[b].empty())
+			error(errors[b].c_str());
+}
+
+void render_batch(StoredScene* stored, double sigma, const mxArray** prhs, mxArray** plhs)
+{
+	BatchInputs inputs = get_batch_inputs(stored, prhs);
+	int batch_size = inputs.batch_size;
+	const mwSize dims_image[] = { (mwSize)stored->nb_colors, (mwSize)stored->width, (mwSize)stored->height, (mwSize)batch_size };
+	plhs[0] = mxCreateNumericArray(4, dims_image, mxDOUBLE_CLASS, mxREAL);
+	const mwSize dims_z_buffer[] = { (mwSize)stored->width, (mwSize)stored->height, (mwSize)batch_size };
+	plhs[1] = mxCreateNumericArray(3, dims_z_buffer, mxDOUBLE_CLASS, mxREAL);
+	double* images = mxGetPr(plhs[0]);
+	double* z_buffers = mxGetPr(plhs[1]);
+	size_t image_size = (size_t)stored->nb_colors * stored->width * stored->height;
+	size_t z_buffer_size = (size_t)stored->width * stored->height;
+	vector<string> errors(batch_size);
+	parallel_for(batch_size, 0, 1, [&](int begin, int end, int thread_id)
+	{
+		for (int b = begin; b < end; b++)
+		{
+			Scene scene = get_scene(stored, inputs, b);
+			try
+			{
+				renderScene(scene, images + b * image_size, z_buffers + b * z_buffer_size, sigma);
+			}
+			catch (const char* message)
+			{
+				errors[b] = message;
+			}
+		}
+	});
+	report_errors(errors);
+}
+
+void render_batch_B(StoredScene* stored, double sigma, const mxArray** prhs, mxArray** plhs)
+{
+	// prhs points to images, z_buffers, images_b, ij, colors, depths, shade and edgeflags
+	BatchInputs inputs = get_batch_inputs(stored, prhs + 3);
+	int batch_size = inputs.batch_size;
+	size_t image_size = (size_t)stored->nb_colors * stored->width * stored->height;
+	size_t z_buffer_size = (size_t)stored->width * stored->height;
+	if (!mxIsDouble(prhs[0]) || mxGetNumberOfElements(prhs[0]) != image_size * batch_size)
+		error("images should be of size nb_colors x W x H x B");
+	if (!mxIsDouble(prhs[1]) || mxGetNumberOfElements(prhs[1]) != z_buffer_size * batch_size)
+		error("z_buffers should be of size W x H x B");
+	if (!mxIsDouble(prhs[2]) || mxGetNumberOfElements(prhs[2]) != image_size * batch_size)
+		error("images_b should be of size nb_colors x W x H x B");
+	// renderScene_B modifies the image in place, work on a copy to leave the matlab input untouched
+	vector<double> images(mxGetPr(prhs[0]), mxGetPr(prhs[0]) + image_size * batch_size);
+	double* z_buffers = mxGetPr(prhs[1]);
+	double* images_b = mxGetPr(prhs[2]);
+
+	int nb_vertices = inputs.nb_vertices;
+	plhs[0] = mxCreateNumericArray(mxGetNumberOfDimensions(prhs[3]), mxGetDimensions(prhs[3]), mxDOUBLE_CLASS, mxREAL);
+	plhs[1] = mxCreateNumericArray(mxGetNumberOfDimensions(prhs[4]), mxGetDimensions(prhs[4]), mxDOUBLE_CLASS, mxREAL);
+	plhs[2] = mxCreateNumericArray(mxGetNumberOfDimensions(prhs[6]), mxGetDimensions(prhs[6]), mxDOUBLE_CLASS, mxREAL);
+	double* ij_b = mxGetPr(plhs[0]);
+	double* colors_b = mxGetPr(plhs[1]);
+	double* shade_b = mxGetPr(plhs[2]);
+	int nb_threads = get_nb_threads(0);
+	// adjoints of the shared uv and texture are computed in per thread buffers and not returned
+	vector<vector<double>> uv_b(nb_threads, vector<double>(stored->uv.size()));
+	vector<vector<double>> texture_b(nb_threads, vector<double>(stored->texture.size()));
+	vector<string> errors(batch_size);
+	parallel_for(batch_size, nb_threads, 1, [&](int begin, int end, int thread_id)
+	{
+		for (int b = begin; b < end; b++)
+		{
+			Scene scene = get_scene(stored, inputs, b);
+			scene.ij_b = ij_b + (size_t)b * 2 * nb_vertices;
+			scene.colors_b = colors_b + (size_t)b * stored->nb_colors * nb_vertices;
+			scene.shade_b = shade_b + (size_t)b * nb_vertices;
+			scene.uv_b = &uv_b[thread_id][0];
+			scene.texture_b = &texture_b[thread_id][0];
+			try
+			{
+				renderScene_B(scene, &images[b * image_size], z_buffers + b * z_buffer_size, images_b + b * image_size, sigma);
+			}
+			catch (const char* message)
+			{
+				errors[b] = message;
+			}
+		}
+	});
+	report_errors(errors);
+}
+
+void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+{
+	mexAtExit(clear_stored_scenes);
+	if (nrhs < 1 || !mxIsChar(prhs[0]))
+		error("the first argument should be one of 'create', 'render', 'render_b' or 'delete'");
+	char* command_chars = mxArrayToString(prhs[0]);
+	string command(command_chars);
+	mxFree(command_chars);
+
+	if (command == "create")
+	{
+		if (nrhs != 2)
+			error("usage: handle = scene_handle('create', scene)");
+		StoredScene* stored = create_scene(prhs[1]);
+		unsigned long long id = next_handle++;
+		stored_scenes[id] = stored;
+		plhs[0] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+		*(unsigned long long*)mxGetData(plhs[0]) = id;
+	}
+	else if (command == "render")
+	{
+		if (nrhs != 8)
+			error("usage: [images, z_buffers] = scene_handle('render', handle, sigma, ij, colors, depths, shade, edgeflags)");
+		render_batch(get_stored_scene(prhs[1]), mxGetScalar(prhs[2]), prhs + 3, plhs);
+	}
+	else if (command == "render_b")
+	{
+		if (nrhs != 11)
+			error("usage: [ij_b, colors_b, shade_b] = scene_handle('render_b', handle, sigma, images, z_buffers, images_b, ij, colors, depths, shade, edgeflags)");
+		render_batch_B(get_stored_scene(prhs[1]), mxGetScalar(prhs[2]), prhs + 3, plhs);
+	}
+	else if (command == "delete")
+	{
+		if (nrhs != 2)
+			error("usage: scene_handle('delete', handle)");
+		StoredScene* stored = get_stored_scene(prhs[1]);
+		stored_scenes.erase(*(unsigned long long*)mxGetData(prhs[1]));
+		delete stored;
+	}
+	else
+		error("unknown command, should be one of 'create', 'render', 'render_b' or 'delete'");
+}
@@ -0,0 +1,105 @@
+function test_scene_handle
+% renders a batch of views of a scene stored once with scene_handle and
+% checks that they match the images obtained with render and render_b
+
+scene=example_scene();
+sigma=1;
+nb_views=4;
+ij=repmat(scene.ij,1,1,nb_views);
+colors=repmat(scene.colors,1,1,nb_views);
+for k=1:nb_views
+    ij(:,:,k)=ij(:,:,k)+5*(k-1);
+    colors(:,:,k)=colors(:,:,k)*(k/nb_views);
+end
+depths=repmat(scene.depths,1,1,nb_views);
+shade=repmat(scene.shade,1,1,nb_views);
+edgeflags=repmat(scene.edgeflags,1,1,nb_views);
+
+handle=scene_handle('create',scene);
+tic
+[images,z_buffers]=scene_handle('render',handle,sigma,ij,colors,depths,shade,edgeflags);
+toc
+images_b=randn(size(images));
+[ij_b,colors_b]=scene_handle('render_b',handle,sigma,images,z_buffers,images_b,ij,colors,depths,shade,edgeflags);
+scene_handle('delete',handle);
+
+for k=1:nb_views
+    scene_k=scene;
+    scene_k.ij=ij(:,:,k);
+    scene_k.colors=colors(:,:,k);
+    [image,z_buffer]=render(scene_k,sigma);
+    assert(max(abs(image(:)-reshape(images(:,:,:,k),[],1)))<1e-12);
+    scene_k.ij_b=zeros(size(scene_k.ij));
+    scene_k.colors_b=zeros(size(scene_k.colors));
+    scene_k.uv_b=zeros(size(scene_k.uv));
+    scene_k.shade_b=zeros(size(scene_k.shade));
+    scene_k.texture_b=zeros(size(scene_k.texture));
+    render_b(scene_k,image,z_buffer,images_b(:,:,:,k),sigma);
+    assert(max(max(abs(scene_k.ij_b-ij_b(:,:,k))))<1e-10);
+    assert(max(max(abs(scene_k.colors_b-colors_b(:,:,k))))<1e-10);
+end
+
+function scene=example_scene()
+
+rng('default');
+rng(10);
+Ntri=50;
+width=200;
+height=200;
+
+material=double(permute(imread('../data/trefle.jpg'),[3,1,2]))/255;
+Hmaterial=size(material,2);
+Wmaterial=size(material,3);
+
+scale_matrix=[height,0;0,width];
+scale_material=[Hmaterial-1,0;0,Wmaterial-1];
+triangles=cell(Ntri,1);
+
+for k=1:Ntri
+    
+    tmp=scale_matrix*(rand(2,1)*[1,1,1]+0.5*(-0.5+rand(2,3)));
+    while abs(det([tmp;[1,1,1]]))<1000
+        tmp=scale_matrix*(rand(2,1)*[1,1,1]+0.5*(-0.5+rand(2,3)));
+    end
+    if det([tmp;[1,1,1]])<0
+        tmp=fliplr(tmp) ;
+    end
+    triangle=[];
+    triangle.ij=tmp;
+    triangle.depths=rand(1)*[1,1,1];
+    textured=rand(1)>0.5;
+    if textured
+        triangle.uv=scale_material*[0,1,0;0,0,1]+1;
+        triangle.shade=rand(1,3);
+        triangle.colors= zeros(3,3);
+        triangle.textured=1;
+        triangle.shaded=1;
+    else
+        triangle.uv=zeros(2,3);
+        triangle.shade=zeros(1,3);
+        triangle.colors=rand(3,3);
+        triangle.textured=0;
+        triangle.shaded=0;
+    end
+    triangle.edgeflags=[true,true,true]';
+    triangles{k}=triangle;
+    
+end
+triangles=cell2mat(triangles);
+
+nb_vertices=Ntri*3;
+scene.faces= uint32(reshape([1:nb_vertices]-1,3,Ntri));
+scene.faces_uv= uint32(reshape([1:nb_vertices]-1,3,Ntri));
+scene.uv=cat(2,triangles.uv);
+scene.ij=cat(2,triangles.ij);
+scene.depths=cat(2,triangles.depths);
+scene.shade=cat(2,triangles.shade);
+scene.colors=cat(2,triangles.colors);
+scene.edgeflags=squeeze(cat(2,triangles.edgeflags));
+scene.textured=logical([triangles.textured]);
+scene.shaded=logical([triangles.shaded]);
+scene.height=height;
+scene.width=width;
+scene.texture=material;
+background_color=[0.3,0.5,0.7];
+scene.background=repmat(background_color(:),1,scene.height,scene.width);
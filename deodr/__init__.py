@@ -14,6 +14,7 @@ __all__ = [
     "Scene3D",
     "Camera",
     "read_obj",
+    "load_obj",
     "LaplacianRigidEnergy",
     "TriMesh",
     "ColoredTriMesh",
@@ -23,7 +24,7 @@ import os
 
 from .differentiable_renderer import Camera, Scene2D, Scene3D
 from .laplacian_rigid_energy import LaplacianRigidEnergy
-from .obj import read_obj
+from .obj import load_obj, read_obj
 from .triangulated_mesh import ColoredTriMesh, TriMesh
 
 data_path = os.path.join(os.path.dirname(__file__), "data")
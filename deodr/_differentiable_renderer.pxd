@@ -31,3 +31,244 @@ cdef extern from "../C++/DifferentiableRenderer.h":
 		double* texture_b
 	void renderScene(Scene scene,double* image,double* z_buffer,double sigma,bool antialiase_error ,double* obs,double*  err_buffer)
 	void renderScene_B(Scene scene,double* image,double* z_buffer,double* image_b,double sigma,bool antialiase_error ,double* obs,double*  err_buffer, double* err_buffer_b)
+
+from libcpp.vector cimport vector
+cdef extern from "../C++/Skinning.h":
+	cdef cppclass SkinningWeights:
+		int nb_vertices
+		int nb_bones
+	void build_skinning_weights(SkinningWeights &skinning, int nb_vertices, int nb_bones, int nb_weights, const int* vertices_ids, const int* bones_ids, const double* weights) except +
+
+cdef extern from "../C++/LinearBasis.h":
+	cdef cppclass LinearBasis:
+		int nb_components
+		int size
+		LinearBasis(int nb_components, int size, const double* mean, const double* basis, int block_size) except +
+		void evaluate(const double* coefs, double* values, int nb_threads)
+		void evaluate_B(const double* values_B, double* coefs_B, int nb_threads)
+
+cdef extern from "../C++/Scene3DPipeline.h":
+	cdef cppclass MeshTopology:
+		int nb_vertices
+		int nb_faces
+		int nb_edges
+		bool clockwise
+		vector[unsigned int] faces
+		vector[int] faces_edges
+		vector[int] edges_faces
+	void build_mesh_topology(MeshTopology &topology, const unsigned int* faces, int nb_faces, int nb_vertices, bool clockwise) except +
+	ctypedef struct Camera:
+		double extrinsic[12]
+		double intrinsic[9]
+		bool has_distortion
+		double distortion[5]
+		int height
+		int width
+	cdef cppclass Scene3DPipeline:
+		Scene3DPipeline(MeshTopology* topology)
+		double* vertices
+		LinearBasis* shape_basis
+		double* shape_coefficients
+		SkinningWeights* skinning
+		double* bone_transforms
+		double* quaternion
+		double* translation
+		Camera camera
+		double* vertices_colors
+		int nb_colors
+		unsigned int* faces_uv
+		double* uv
+		int nb_uv
+		double* texture
+		LinearBasis* texture_basis
+		double* texture_coefficients
+		int texture_height
+		int texture_width
+		double* light_directional
+		double light_ambient
+		double* background
+		bool render_depth
+		double depth_scale
+		bool backface_culling
+		double near_plane
+		double sigma
+		int nb_threads
+		vector[double] image
+		vector[double] z_buffer
+		vector[double] vertices_transformed
+		vector[double] ij
+		vector[double] depths
+		double loss
+		vector[double] vertices_b
+		vector[double] bone_transforms_b
+		vector[double] shape_coefficients_b
+		vector[double] texture_coefficients_b
+		double quaternion_b[4]
+		double translation_b[3]
+		double light_directional_b[3]
+		double light_ambient_b
+		vector[double] vertices_colors_b
+		vector[double] texture_b
+		double render(double* obs) except +
+		void render_backward(double* image_b) except +
+
+cdef extern from "../C++/LaplacianRigidEnergy.h":
+	cdef cppclass LaplacianRigidEnergy:
+		int nb_vertices
+		double cregu
+		int nb_threads
+		LaplacianRigidEnergy(int nb_vertices, const int* indptr, const int* indices, const double* values, const double* vertices_ref, double cregu) except +
+		void set_vertices_ref(const double* vertices_ref)
+		double evaluate(const double* vertices, double* grad)
+		void factorize(double regularization) except +
+		void solve(const double* rhs, double* x, double regularization) except +
+
+cdef extern from "../C++/MeshFitter.h":
+	cdef cppclass MeshFitter:
+		Scene3DPipeline* pipeline
+		double* observation
+		double max_depth
+		double inertia
+		double damping
+		double step_factor_vertices
+		double step_max_vertices
+		double step_factor_quaternion
+		double step_max_quaternion
+		double step_factor_translation
+		double step_max_translation
+		double step_factor_light_directional
+		double step_factor_light_ambient
+		double step_factor_color
+		bool update_lights
+		bool update_color
+		vector[double] vertices
+		vector[double] speed_vertices
+		double quaternion[4]
+		double speed_quaternion[4]
+		double translation[3]
+		double speed_translation[3]
+		double light_directional[3]
+		double speed_light_directional[3]
+		double light_ambient
+		double speed_light_ambient
+		vector[double] color
+		vector[double] speed_color
+		vector[double] energies
+		vector[double] energies_data
+		vector[double] energies_rigid
+		vector[double] diff_image
+		MeshFitter(Scene3DPipeline* pipeline, LaplacianRigidEnergy* rigid_energy) except +
+		void run(int nb_iterations) except +
+
+cdef extern from "../C++/MeshAdjacencies.h":
+	cdef cppclass MeshAdjacencies:
+		int nb_vertices
+		int nb_faces
+		int nb_edges
+		vector[int] faces_edges
+		vector[int] edges
+		vector[int] edges_nb_faces
+		bool is_manifold
+		bool is_closed
+		bool has_boundaries
+		vector[int] laplacian_start
+		vector[int] laplacian_columns
+		vector[double] laplacian_values
+	void build_mesh_adjacencies(MeshAdjacencies &adjacencies, const unsigned int* faces, int nb_faces, int nb_vertices) except +
+
+cdef extern from "../C++/ObjLoader.h":
+	cdef cppclass ObjMesh:
+		vector[double] vertices
+		vector[double] vertices_colors
+		vector[double] uv
+		vector[double] normals
+		vector[int] faces
+		vector[int] faces_uv
+		vector[int] faces_normals
+	void read_obj(const char* filename, ObjMesh& mesh) except +
+
+cdef extern from "../C++/DeferredRenderer.h":
+	void render_gbuffer(const unsigned int* faces, const double* ij, const double* depths, int nb_faces, int height, int width, bool clockwise, bool backface_culling, unsigned int* face_ids, double* barycentrics, double* z_buffer) except +
+	void resolve_gbuffer_attributes(const unsigned int* face_ids, const double* barycentrics, int nb_pixels, const unsigned int* faces, const double* attributes, int size, const double* background, double* image, int nb_threads) except +
+
+cdef extern from "../C++/DepthMaskRenderer.h":
+	ctypedef struct DepthMaskScene:
+		unsigned int* faces
+		double* depths
+		double* ij
+		bool* edgeflags
+		int nb_triangles
+		int nb_vertices
+		bool clockwise
+		bool backface_culling
+		int height
+		int width
+		double* background
+		double* ij_b
+		double* depths_b
+	void renderDepth(DepthMaskScene scene, double depth_scale, double* image, double* z_buffer, double sigma) except +
+	void renderDepth_B(DepthMaskScene scene, double depth_scale, double* image, double* z_buffer, double* image_b, double sigma) except +
+	void renderMask(DepthMaskScene scene, double* image, double* z_buffer, double sigma) except +
+	void renderMask_B(DepthMaskScene scene, double* image, double* z_buffer, double* image_b, double sigma) except +
+
+cdef extern from "../C++/MultiOutputRenderer.h":
+	void renderSceneMultiOutput(Scene scene, double* image, double* z_buffer, double sigma, double depth_scale, double* depth_background, double* depth, double* mask) except +
+	void renderSceneMultiOutput_B(Scene scene, double* image, double* z_buffer, double* image_b, double sigma, double depth_scale, double* depth, double* depth_b, double* mask, double* mask_b, double* depths_b) except +
+
+cdef extern from "../C++/PoseScoring.h":
+	void downsample_camera(const Camera& camera, int factor, Camera& camera_low)
+	void downsample_image(const double* image, int height, int width, int nb_channels, int factor, double* image_low)
+	void score_poses(const Scene3DPipeline& pipeline, int nb_poses, const double* quaternions, const double* translations, const double* vertices, const double* obs, int downsample, double* losses, int nb_threads) except +
+
+cdef extern from "../C++/ROIRenderer.h":
+	void renderSceneROI(Scene scene, int x0, int y0, int width, int height, double* image, double* z_buffer, double sigma, bool antialiaseError, double* obs, double* err_buffer) except +
+	void renderSceneROI_B(Scene scene, int x0, int y0, int width, int height, double* image, double* z_buffer, double* image_b, double sigma, bool antialiaseError, double* obs, double* err_buffer, double* err_buffer_b) except +
+	void renderSceneTile(Scene scene, int x0, int y0, int width, int height, double* background, double* image, double* z_buffer, double sigma) except +
+
+cdef extern from "../C++/RowSubsampledRenderer.h":
+	double renderSceneRows(Scene scene, const double* row_weights, double* image, double* z_buffer, double sigma, double* obs, double* err_buffer) except +
+	void renderSceneRows_B(Scene scene, const double* row_weights, double* image, double* z_buffer, double sigma, double* obs, double* err_buffer) except +
+
+cdef extern from "../C++/FrameRenderer.h":
+	cdef cppclass FrameRenderer:
+		FrameRenderer()
+		void begin_frame(int height, int width, int nb_colors, const double* background, double* image, double* z_buffer, const double* z_buffer_background) except +
+		void draw_batch(const Scene& scene, bool draw_triangles) except +
+		void end_frame(double sigma, bool antialiaseError, double* obs, double* err_buffer) except +
+		void render_B(double* image, double* image_b, double sigma, bool antialiaseError, double* obs, double* err_buffer, double* err_buffer_b) except +
+
+cdef extern from "../C++/StaticLayerRenderer.h":
+	cdef cppclass StaticLayerRenderer:
+		StaticLayerRenderer(const Scene& scene, double sigma) except +
+		int roi[4]
+		void render(const Scene& scene, double* image, double* z_buffer) except +
+		void render_B(const double* image_b) except +
+
+cdef extern from "../C++/IncrementalRenderer.h":
+	cdef cppclass IncrementalRenderer:
+		IncrementalRenderer(double sigma)
+		int dirty[4]
+		void render(const Scene& scene, double* image, double* z_buffer, unsigned int* face_ids) except +
+		void update(const Scene& scene, int nb_changed, const int* changed_vertices) except +
+
+cdef extern from "../C++/InstancedRenderer.h":
+	cdef cppclass InstancedRenderer:
+		InstancedRenderer(Scene3DPipeline* pipeline)
+		int nb_instances
+		double* quaternions
+		double* translations
+		double* scales
+		double* offsets
+		vector[double] image
+		vector[double] z_buffer
+		vector[double] vertices_b
+		vector[double] quaternions_b
+		vector[double] translations_b
+		vector[double] scales_b
+		vector[double] offsets_b
+		double light_directional_b[3]
+		double light_ambient_b
+		vector[double] vertices_colors_b
+		vector[double] texture_b
+		double render(double* obs) except +
+		void render_backward(double* image_b) except +
@@ -0,0 +1,82 @@
+"""Versioned binary files storing named numpy arrays that are loaded with memory mapping.
+
+The file starts with a magic string, the format version and a json header giving the dtype, shape
+and offset of each array, followed by the raw data of the arrays aligned on 64 bytes. Loading only
+maps the file in memory, the arrays are read lazily by the operating system when accessed.
+"""
+
+import json
+import os
+import struct
+
+import numpy as np
+
+ARRAY_CACHE_MAGIC = b"DEODRARR"
+ARRAY_CACHE_FORMAT_VERSION = 1
+_ALIGNMENT = 64
+
+
+def save_arrays(filename, arrays, metadata=None):
+    """Save a dictionary of arrays along with json serializable metadata.
+
+    The file is written to a temporary file first and then renamed so that concurrent readers
+    never see a partially written file.
+    """
+    # np.ascontiguousarray would turn the 0-d arrays into 1-d arrays, tobytes is already C ordered
+    arrays = {name: np.asarray(array) for name, array in arrays.items()}
+    header = {"metadata": metadata, "arrays": {}}
+    offset = 0
+    for name, array in arrays.items():
+        header["arrays"][name] = {
+            "dtype": array.dtype.str,
+            "shape": list(array.shape),
+            "offset": offset,
+        }
+        offset += (array.nbytes + _ALIGNMENT - 1) // _ALIGNMENT * _ALIGNMENT
+    header_bytes = json.dumps(header).encode("utf-8")
+    prefix_size = len(ARRAY_CACHE_MAGIC) + 8 + len(header_bytes)
+    data_start = (prefix_size + _ALIGNMENT - 1) // _ALIGNMENT * _ALIGNMENT
+    temporary_filename = "%s.%d.tmp" % (filename, os.getpid())
+    with open(temporary_filename, "wb") as f:
+        f.write(ARRAY_CACHE_MAGIC)
+        f.write(struct.pack("<II", ARRAY_CACHE_FORMAT_VERSION, len(header_bytes)))
+        f.write(header_bytes)
+        for name, array in arrays.items():
+            f.seek(data_start + header["arrays"][name]["offset"])
+            f.write(array.tobytes())
+        f.truncate(data_start + offset)
+    os.replace(temporary_filename, filename)
+
+
+def load_arrays(filename, metadata=None):
+    """Load the arrays saved with save_arrays using memory mapping.
+
+    Returns None if the file does not exist, has been written with another version of the format
+    or if its metadata differs from the expected metadata. The arrays are copy-on-write views of
+    the file: they can be modified without altering the file.
+    """
+    if not os.path.isfile(filename):
+        return None
+    with open(filename, "rb") as f:
+        if f.read(len(ARRAY_CACHE_MAGIC)) != ARRAY_CACHE_MAGIC:
+            return None
+        version, header_size = struct.unpack("<II", f.read(8))
+        if version != ARRAY_CACHE_FORMAT_VERSION:
+            return None
+        header = json.loads(f.read(header_size).decode("utf-8"))
+    if metadata is not None and header["metadata"] != metadata:
+        return None
+    prefix_size = len(ARRAY_CACHE_MAGIC) + 8 + header_size
+    data_start = (prefix_size + _ALIGNMENT - 1) // _ALIGNMENT * _ALIGNMENT
+    if os.path.getsize(filename) == data_start:
+        data = np.zeros(0, dtype=np.uint8)
+    else:
+        data = np.memmap(filename, dtype=np.uint8, mode="c", offset=data_start)
+    arrays = {}
+    for name, description in header["arrays"].items():
+        dtype = np.dtype(description["dtype"])
+        shape = tuple(description["shape"])
+        nbytes = int(np.prod(shape, dtype=np.int64)) * dtype.itemsize
+        start = description["offset"]
+        arrays[name] = data[start : start + nbytes].view(dtype).reshape(shape)
+    return arrays
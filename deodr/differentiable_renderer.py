@@ -426,18 +426,27 @@ class Scene3D:
     antialiasing edge overdraw.
     """
 
+    # the methods that call the native renderers directly instead of going through
+    # _render_2d are only available when True, subclasses that differentiate
+    # _render_2d with their framework set it to False
+    native_rendering = True
+
     def __init__(self, sigma=1):
         self.mesh = None
         self.light_directional = None
         self.light_ambient = None
         self.sigma = sigma
 
+    def _check_native_rendering(self, feature):
+        assert self.native_rendering, "%s is not supported by this class" % feature
+
     def clear_gradients(self):
         # fields to store gradients
         self.uv_b = np.zeros((self.mesh.nb_vertices, 2))
         self.ij_b = np.zeros((self.mesh.nb_vertices, 2))
         self.shade_b = np.zeros((self.mesh.nb_vertices))
-        self.colors_b = np.zeros(self.colors.shape)
+        if hasattr(self, "colors"):  # not set when only rendering depth or masks
+            self.colors_b = np.zeros(self.colors.shape)
         self.texture_b = np.zeros((0, 0))
 
     def set_light(self, light_directional, light_ambient):
@@ -529,9 +538,57 @@ class Scene3D:
         )
         return self.ij_b, self.colors_b
 
-    def render(self, camera, return_z_buffer=False, backface_culling=True):
+    def _render_2d_roi(self, ij, colors, roi):
+        x0, y0, width, height = roi
+        image = np.empty((height, width, colors.shape[1]))
+        z_buffer = np.empty((height, width))
+        self.ij = np.array(ij)
+        self.colors = np.array(colors)
+        differentiable_renderer_cython.renderSceneROI(
+            self, roi, self.sigma, image, z_buffer
+        )
+        if self.store_backward_current is not None:
+            self.store_backward_current["render_2d"] = (ij, colors, image, z_buffer)
+        return image, z_buffer
+
+    def _render_2d_roi_backward(self, image_b, roi):
+        ij, colors, image, z_buffer = self.store_backward_current["render_2d"]
+        self.ij = np.array(ij)
+        self.colors = np.array(colors)
+        differentiable_renderer_cython.renderSceneROIB(
+            self, roi, self.sigma, image.copy(), z_buffer, np.array(image_b)
+        )
+        return self.ij_b, self.colors_b
+
+    def render(self, camera, return_z_buffer=False, backface_culling=True, roi=None):
+        """Render the mesh seen from the camera.
+
+        When roi = (x0, y0, width, height) is given, only that region of the image is
+        rendered, the faces outside of it being culled, and the returned image and
+        z_buffer are of size (height, width).
+        """
         self.store_backward_current = {}
+        points_2d, colors = self._setup_2d_scene(camera, backface_culling)
+        if roi is None:
+            image, z_buffer = self._render_2d(points_2d, colors)
+        else:
+            self._check_native_rendering("rendering a region of interest")
+            image, z_buffer = self._render_2d_roi(points_2d, colors, roi)
+        if self.store_backward_current is not None:
+            self.store_backward_current["render"] = (
+                camera,
+                self.edgeflags,
+                roi,
+            )  # store this field as it could be overwritten when
+            # rendering several views
+        if return_z_buffer:
+            return image, z_buffer
+        else:
+            return image
 
+    def _setup_2d_scene(self, camera, backface_culling):
+        # project the mesh and set the fields of the 2D scene, returns the projected
+        # points and the colors of the vertices
         if self.light_directional is not None:
             self.mesh.compute_vertex_normals()
 
@@ -576,21 +633,14 @@ class Scene3D:
 
         self.clockwise = self.mesh.clockwise
         self.backface_culling = backface_culling
-        image, z_buffer = self._render_2d(points_2d, colors)
-        if self.store_backward_current is not None:
-            self.store_backward_current["render"] = (
-                camera,
-                self.edgeflags,
-            )  # store this field as it could be overwritten when
-            # rendering several views
-        if return_z_buffer:
-            return image, z_buffer
-        else:
-            return image
+        return points_2d, colors
 
     def render_backward(self, image_b):
-        camera, self.edgeflags = self.store_backward_current["render"]
-        points_2d_b, colors_b = self._render_2d_backward(image_b)
+        camera, self.edgeflags, roi = self.store_backward_current["render"]
+        if roi is None:
+            points_2d_b, colors_b = self._render_2d_backward(image_b)
+        else:
+            points_2d_b, colors_b = self._render_2d_roi_backward(image_b, roi)
         self._compute_vertices_colors_with_illumination_backward(colors_b)
         self.mesh.vertices_b = camera.project_points_backward(
             points_2d_b, store_backward=self.store_backward_current
@@ -598,7 +648,240 @@ class Scene3D:
         if self.light_directional is not None:
             self.mesh.compute_vertex_normals_backward(self.vertex_normals_b)
 
-    def render_depth(self, camera, height, width, depth_scale=1, backface_culling=True):
+    def render_meshes(
+        self, camera, meshes, return_z_buffer=False, backface_culling=True
+    ):
+        """Render several meshes seen from the camera in a single image.
+
+        Each mesh has its own vertices colors or texture, the meshes share the lights,
+        the z_buffer and the ordering of the antialiasing edges, which gives the same
+        occlusions as when rendering the meshes merged into a single mesh without
+        concatenating their arrays. render_meshes_backward sets the gradients of each
+        mesh separately, including the texture gradients of the textured meshes.
+        """
+        self._check_native_rendering("rendering several meshes")
+        mesh_scene = self.mesh
+        renderer = differentiable_renderer_cython.FrameRenderer(self.sigma)
+        renderer.begin_frame(self.background)
+        batches = []
+        stores = []
+        # the 2D scene of each mesh is set up through self.mesh and
+        # self.store_backward_current, reset even if a mesh fails to render
+        try:
+            for mesh in meshes:
+                self.mesh = mesh
+                self.store_backward_current = {}
+                points_2d, colors = self._setup_2d_scene(camera, backface_culling)
+                batch = Scene2DBase(
+                    faces=self.faces,
+                    faces_uv=self.faces_uv,
+                    ij=points_2d,
+                    depths=self.depths,
+                    textured=self.textured,
+                    uv=self.uv,
+                    shade=self.shade,
+                    colors=colors,
+                    shaded=self.shaded,
+                    edgeflags=self.edgeflags,
+                    height=self.height,
+                    width=self.width,
+                    nb_colors=colors.shape[1],
+                    texture=self.texture,
+                    background=self.background,
+                    clockwise=self.clockwise,
+                    backface_culling=backface_culling,
+                )
+                renderer.draw_batch(batch)
+                batches.append(batch)
+                stores.append(self.store_backward_current)
+        finally:
+            self.mesh = mesh_scene
+            self.store_backward_current = {}
+        image, z_buffer = renderer.end_frame()
+        self.store_backward_current = {
+            "render_meshes": (camera, list(meshes), renderer, batches, stores)
+        }
+        if return_z_buffer:
+            return image, z_buffer
+        else:
+            return image
+
+    def render_meshes_backward(self, image_b):
+        """Backpropagate image_b through render_meshes.
+
+        Sets vertices_b and either vertices_colors_b or texture_b of each mesh, and the
+        gradients of the lights summed over the meshes.
+        """
+        camera, meshes, renderer, batches, stores = self.store_backward_current[
+            "render_meshes"
+        ]
+        renderer.backward(image_b)
+        mesh_scene = self.mesh
+        store_scene = self.store_backward_current
+        light_directional_b = np.zeros(3)
+        light_ambient_b = 0
+        try:
+            for mesh, batch, store in zip(meshes, batches, stores):
+                self.mesh = mesh
+                self.store_backward_current = store
+                if mesh.uv is not None:
+                    self.compute_vertices_luminosity_backward(batch.shade_b)
+                    mesh.texture_b = batch.texture_b
+                else:
+                    self._compute_vertices_colors_with_illumination_backward(
+                        batch.colors_b
+                    )
+                mesh.vertices_b = camera.project_points_backward(
+                    batch.ij_b, store_backward=store
+                )
+                if self.light_directional is not None:
+                    mesh.compute_vertex_normals_backward(self.vertex_normals_b)
+                    light_directional_b += self.light_directional_b
+                light_ambient_b += self.light_ambient_b
+        finally:
+            self.mesh = mesh_scene
+            self.store_backward_current = store_scene
+        if self.light_directional is not None:
+            self.light_directional_b = light_directional_b
+        self.light_ambient_b = light_ambient_b
+
+    def render_tiled(
+        self,
+        camera,
+        tile_height,
+        tile_width,
+        callback=None,
+        output=None,
+        backface_culling=True,
+    ):
+        """Render the mesh seen from the camera one tile at a time.
+
+        Only buffers of the size of a tile are allocated, which bounds the memory
+        used when rendering very large images. Each finished tile is passed to
+        callback(x0, y0, image, z_buffer) and/or copied into output, an array of
+        size (height, width, nb_colors) that can be a numpy memmap. The background
+        is read tile by tile and can thus also be a memmap. Returns output.
+        """
+        self._check_native_rendering("tiled rendering")
+        self.store_backward_current = None
+        points_2d, colors = self._setup_2d_scene(camera, backface_culling)
+        self.ij = np.array(points_2d)
+        self.colors = np.array(colors)
+        nb_colors = self.colors.shape[1]
+        if output is not None:
+            assert output.shape == (self.height, self.width, nb_colors)
+        for y0 in range(0, self.height, tile_height):
+            for x0 in range(0, self.width, tile_width):
+                height = min(tile_height, self.height - y0)
+                width = min(tile_width, self.width - x0)
+                image = np.empty((height, width, nb_colors))
+                z_buffer = np.empty((height, width))
+                background = self.background[y0 : y0 + height, x0 : x0 + width]
+                differentiable_renderer_cython.renderSceneTile(
+                    self,
+                    (x0, y0, width, height),
+                    background,
+                    self.sigma,
+                    image,
+                    z_buffer,
+                )
+                if callback is not None:
+                    callback(x0, y0, image, z_buffer)
+                if output is not None:
+                    output[y0 : y0 + height, x0 : x0 + width] = image
+        return output
+
+    def render_with_depth_and_mask(
+        self, camera, depth_scale=1, depth_background=None, backface_culling=True
+    ):
+        """Render the colors, the depth and the antialiased silhouette mask.
+
+        The three images share the same projection, silhouette edges, sorting and
+        rasterization. The depth is multiplied by depth_scale and drawn over
+        depth_background, which defaults to the max depth of the vertices.
+        Returns the image (height, width, nb_colors), the depth (height, width, 1)
+        and the mask (height, width).
+        """
+        self._check_native_rendering("render_with_depth_and_mask")
+        self.store_backward_current = {}
+        points_2d, colors = self._setup_2d_scene(camera, backface_culling)
+        self.ij = np.array(points_2d)
+        self.colors = np.array(colors)
+        if depth_background is None:
+            depth_background = np.max(self.depths) * depth_scale
+        image = np.empty((self.height, self.width, self.colors.shape[1]))
+        z_buffer = np.empty((self.height, self.width))
+        depth = np.empty((self.height, self.width))
+        mask = np.empty((self.height, self.width))
+        differentiable_renderer_cython.renderSceneMultiOutput(
+            self,
+            self.sigma,
+            image,
+            z_buffer,
+            depth_scale,
+            depth_background,
+            depth,
+            mask,
+        )
+        if self.store_backward_current is not None:
+            self.store_backward_current["render_with_depth_and_mask"] = (
+                camera,
+                self.edgeflags,
+                self.ij,
+                self.colors,
+                depth_scale,
+                image,
+                z_buffer,
+                depth,
+                mask,
+            )
+        return image, depth[:, :, None], mask
+
+    def render_with_depth_and_mask_backward(
+        self, image_b=None, depth_b=None, mask_b=None
+    ):
+        """Backpropagate the adjoints of the outputs of render_with_depth_and_mask
+        that are not None in a single sweep.
+        """
+        (
+            camera,
+            self.edgeflags,
+            self.ij,
+            self.colors,
+            depth_scale,
+            image,
+            z_buffer,
+            depth,
+            mask,
+        ) = self.store_backward_current["render_with_depth_and_mask"]
+
+        def copy_or_none(x, shape):
+            return None if x is None else np.array(x, dtype=np.double).reshape(shape)
+
+        depths_b = differentiable_renderer_cython.renderSceneMultiOutputB(
+            self,
+            self.sigma,
+            image.copy(),
+            z_buffer,
+            copy_or_none(image_b, image.shape),
+            depth_scale,
+            depth.copy(),
+            copy_or_none(depth_b, depth.shape),
+            mask.copy(),
+            copy_or_none(mask_b, mask.shape),
+        )
+        if image_b is not None:
+            self._compute_vertices_colors_with_illumination_backward(self.colors_b)
+        self.mesh.vertices_b = camera.project_points_backward(
+            self.ij_b, depths_b=depths_b, store_backward=self.store_backward_current
+        )
+        if image_b is not None and self.light_directional is not None:
+            self.mesh.compute_vertex_normals_backward(self.vertex_normals_b)
+
+    def _render_depth_with_colors(
+        self, camera, height, width, depth_scale, backface_culling
+    ):
+        # generic path rendering the depth as an interpolated color, through _render_2d
         self.store_backward_current = {}
         points_2d, depths = camera.project_points(
             self.mesh.vertices, store_backward=self.store_backward_current
@@ -633,7 +916,7 @@ class Scene3D:
             self.store_backward_current["render_depth"] = (camera, depth_scale)
         return image
 
-    def render_depth_backward(self, depth_b):
+    def _render_depth_with_colors_backward(self, depth_b):
         camera, depth_scale = self.store_backward_current["render_depth"]
         ij_b, colors_b = self._render_2d_backward(depth_b)
         depths_b = np.squeeze(colors_b * depth_scale, axis=1)
@@ -641,6 +924,201 @@ class Scene3D:
             ij_b, depths_b=depths_b, store_backward=self.store_backward_current
         )
 
+    def render_depth(self, camera, height, width, depth_scale=1, backface_culling=True):
+        """Render the depth multiplied by depth_scale over the background.
+
+        The z-only rasterizer is used, the depth being read from the z_buffer
+        instead of being interpolated as a color.
+        """
+        if not self.native_rendering:
+            return self._render_depth_with_colors(
+                camera, height, width, depth_scale, backface_culling
+            )
+        self.store_backward_current = {}
+        points_2d, depths = camera.project_points(
+            self.mesh.vertices, store_backward=self.store_backward_current
+        )
+
+        # compute silhouette edges
+        if self.sigma > 0:
+            edgeflags = self.mesh.edge_on_silhouette(points_2d)
+        else:
+            edgeflags = np.zeros((self.mesh.nb_faces, 3), dtype=np.bool)
+
+        image, z_buffer = differentiable_renderer_cython.renderDepth(
+            self.mesh.faces,
+            points_2d,
+            depths,
+            edgeflags,
+            self.background.reshape(height, width),
+            self.mesh.clockwise,
+            backface_culling,
+            depth_scale,
+            self.sigma,
+        )
+        if self.store_backward_current is not None:
+            self.store_backward_current["render_depth"] = (
+                camera,
+                depth_scale,
+                points_2d,
+                depths,
+                edgeflags,
+                backface_culling,
+                image,
+                z_buffer,
+            )
+        return image[:, :, None]
+
+    def render_depth_backward(self, depth_b):
+        if not self.native_rendering:
+            return self._render_depth_with_colors_backward(depth_b)
+        (
+            camera,
+            depth_scale,
+            points_2d,
+            depths,
+            edgeflags,
+            backface_culling,
+            image,
+            z_buffer,
+        ) = self.store_backward_current["render_depth"]
+        ij_b, depths_b = differentiable_renderer_cython.renderDepthB(
+            self.mesh.faces,
+            points_2d,
+            depths,
+            edgeflags,
+            self.mesh.clockwise,
+            backface_culling,
+            depth_scale,
+            self.sigma,
+            image,
+            z_buffer,
+            depth_b,
+        )
+        self.mesh.vertices_b = camera.project_points_backward(
+            ij_b, depths_b=depths_b, store_backward=self.store_backward_current
+        )
+
+    def render_mask(self, camera, backface_culling=True):
+        """Render the silhouette mask of the mesh, antialiased along the silhouette
+        edges when sigma > 0, as a (height, width) array.
+        """
+        self._check_native_rendering("render_mask")
+        self.store_backward_current = {}
+        points_2d, depths = camera.project_points(
+            self.mesh.vertices, store_backward=self.store_backward_current
+        )
+        if self.sigma > 0:
+            edgeflags = self.mesh.edge_on_silhouette(points_2d)
+        else:
+            edgeflags = np.zeros((self.mesh.nb_faces, 3), dtype=np.bool)
+        mask, z_buffer = differentiable_renderer_cython.renderMask(
+            self.mesh.faces,
+            points_2d,
+            depths,
+            edgeflags,
+            camera.height,
+            camera.width,
+            self.mesh.clockwise,
+            backface_culling,
+            self.sigma,
+        )
+        if self.store_backward_current is not None:
+            self.store_backward_current["render_mask"] = (
+                camera,
+                points_2d,
+                depths,
+                edgeflags,
+                backface_culling,
+                mask,
+                z_buffer,
+            )
+        return mask
+
+    def render_mask_backward(self, mask_b):
+        (
+            camera,
+            points_2d,
+            depths,
+            edgeflags,
+            backface_culling,
+            mask,
+            z_buffer,
+        ) = self.store_backward_current["render_mask"]
+        ij_b = differentiable_renderer_cython.renderMaskB(
+            self.mesh.faces,
+            points_2d,
+            depths,
+            edgeflags,
+            self.mesh.clockwise,
+            backface_culling,
+            self.sigma,
+            mask,
+            z_buffer,
+            mask_b,
+        )
+        self.mesh.vertices_b = camera.project_points_backward(
+            ij_b, store_backward=self.store_backward_current
+        )
+
+    def render_error_rows(self, camera, obs, row_weights, backface_culling=True):
+        """Evaluate the antialiased squared error with obs on a subset of the rows.
+
+        row_weights (height,) gives the weight of each row in the loss, zero for the
+        rows that are not evaluated, whose faces and edges are culled. With weights
+        equal to the inverse of the rows sampling probabilities, as returned by
+        sample_row_weights, the loss is an unbiased estimate of the full loss.
+        Returns the loss and the error buffer, which is zero on the skipped rows.
+        """
+        self._check_native_rendering("render_error_rows")
+        self.store_backward_current = {}
+        points_2d, colors = self._setup_2d_scene(camera, backface_culling)
+        self.ij = np.array(points_2d)
+        self.colors = np.array(colors)
+        image = np.zeros((self.height, self.width, self.colors.shape[1]))
+        z_buffer = np.zeros((self.height, self.width))
+        err_buffer = np.zeros((self.height, self.width))
+        obs = np.ascontiguousarray(obs, dtype=np.double)
+        loss = differentiable_renderer_cython.renderSceneRows(
+            self, row_weights, self.sigma, image, z_buffer, obs, err_buffer
+        )
+        if self.store_backward_current is not None:
+            self.store_backward_current["render_error_rows"] = (
+                camera,
+                self.edgeflags,
+                self.ij,
+                self.colors,
+                row_weights,
+                obs,
+                image,
+                z_buffer,
+                err_buffer,
+            )
+        return loss, err_buffer
+
+    def render_error_rows_backward(self):
+        """Backpropagate the loss returned by render_error_rows."""
+        (
+            camera,
+            self.edgeflags,
+            self.ij,
+            self.colors,
+            row_weights,
+            obs,
+            image,
+            z_buffer,
+            err_buffer,
+        ) = self.store_backward_current["render_error_rows"]
+        differentiable_renderer_cython.renderSceneRowsB(
+            self, row_weights, self.sigma, image, z_buffer, obs, err_buffer.copy()
+        )
+        self._compute_vertices_colors_with_illumination_backward(self.colors_b)
+        self.mesh.vertices_b = camera.project_points_backward(
+            self.ij_b, store_backward=self.store_backward_current
+        )
+        if self.light_directional is not None:
+            self.mesh.compute_vertex_normals_backward(self.vertex_normals_b)
+
     def render_deferred(
         self,
         camera,
@@ -653,11 +1131,21 @@ class Scene3D:
         uv=True,
         xyz=True,
         backface_culling=True,
+        barycentrics=False,
+        face_id_uint32=False,
     ):
-
+        """Render the requested channels without antialiasing.
+
+        The indexed mesh is rasterized once into a face id buffer and a barycentric
+        coordinates buffer, from which each channel is then interpolated per pixel.
+        Each channel is returned as a (height, width, size) array. The face_id channel
+        is a float array that is zero on the background, which cannot be told apart
+        from the first face, unless face_id_uint32 is True, in which case the uint32
+        face ids are returned with GBUFFER_NO_FACE on the background.
+        """
+        self._check_native_rendering("deferred rendering")
         points_2d, depths = camera.project_points(self.mesh.vertices)
 
-        # compute silhouette edges
         self.store_backward_current = None
 
         if self.sigma > 0:
@@ -665,106 +1153,57 @@ class Scene3D:
                 "Antialiasing is not supposed to be used when using deferred rendering, please use sigma==0"
             )
 
-        edgeflags = np.zeros((self.mesh.nb_faces, 3), dtype=np.bool)
-
         if luminosity or normal:
             self.mesh.compute_vertex_normals()
         if luminosity:
             vertices_luminosity = self.compute_vertices_luminosity()
 
-        # construct triangle soup (loosing connectivity), needed to render
-        # discontinuous uv maps and face ids
-        soup_nb_faces = self.mesh.nb_faces
-        soup_nb_vertices = 3 * self.mesh.nb_faces
-        soup_faces = np.arange(0, soup_nb_vertices, dtype=np.uint32).reshape(
-            self.mesh.nb_faces, 3
+        faces = self.mesh.faces
+        (
+            face_ids,
+            barycentrics_buffer,
+            z_buffer,
+        ) = differentiable_renderer_cython.render_gbuffer(
+            faces,
+            points_2d,
+            depths,
+            camera.height,
+            camera.width,
+            self.mesh.clockwise,
+            backface_culling,
         )
+        covered = face_ids != differentiable_renderer_cython.GBUFFER_NO_FACE
 
-        soup_faces_uv = soup_faces
-        soup_ij = points_2d[self.mesh.faces].reshape(soup_nb_vertices, 2)
-        soup_depths = depths[self.mesh.faces].reshape(soup_nb_vertices, 1)
+        def resolve(faces, attributes):
+            return differentiable_renderer_cython.resolve_gbuffer_attributes(
+                face_ids, barycentrics_buffer, faces, attributes
+            )
 
-        channels = {}
+        output = {}
         if depth:
-            channels["depth"] = soup_depths * depth_scale
+            output["depth"] = np.where(covered, z_buffer * depth_scale, depths.max())[
+                :, :, None
+            ]
         if face_id:
-            soup_face_ids = np.tile(
-                np.arange(0, self.mesh.nb_faces)[:, None], (1, 3)
-            ).reshape(soup_nb_vertices, 1)
-            channels["face_id"] = soup_face_ids
+            if face_id_uint32:
+                output["face_id"] = face_ids[:, :, None]
+            else:
+                output["face_id"] = np.where(covered, face_ids, 0)[:, :, None].astype(
+                    np.float64
+                )
+        if barycentrics:
+            output["barycentrics"] = barycentrics_buffer
         if normal:
-            soup_normals = self.mesh.vertex_normals[self.mesh.faces].reshape(
-                soup_nb_vertices, 3
-            )
-            channels["normal"] = soup_normals
+            output["normal"] = resolve(faces, self.mesh.vertex_normals)
         if luminosity:
-            soup_luminosity = vertices_luminosity[self.mesh.faces].reshape(
-                soup_nb_vertices, 1
-            )
-            channels["luminosity"] = soup_luminosity
+            output["luminosity"] = resolve(faces, vertices_luminosity[:, None])
         if xyz:
-            soup_xyz = self.mesh.vertices[self.mesh.faces].reshape(soup_nb_vertices, 3)
-            channels["xyz"] = soup_xyz
+            output["xyz"] = resolve(faces, self.mesh.vertices)
 
         if self.mesh.uv is None:
             if color:
-                soup_vertices_colors = self.mesh.vertices_colors[
-                    self.mesh.faces
-                ].reshape(soup_nb_vertices, 3)
-                channels["color"] = soup_vertices_colors
+                output["color"] = resolve(faces, self.mesh.vertices_colors)
         elif uv:
-            soup_uv = self.mesh.uv[self.mesh.faces_uv].reshape(soup_nb_vertices, 2)
-            channels["uv"] = soup_uv
-
-        offset = 0
-        ranges = {}
-        for k, v in channels.items():
-            size = v.shape[1]
-            ranges[k] = (offset, offset + size)
-            offset += size
-
-        colors = np.column_stack(list(channels.values()))
-
-        nb_colors = colors.shape[1]
-        uv_zeros = np.zeros((soup_nb_vertices, 2))
-        textured = np.zeros((soup_nb_faces), dtype=np.bool)
-        shade = np.zeros((soup_nb_vertices), dtype=np.bool)
-
-        height = camera.height
-        width = camera.width
-        shaded = np.zeros(
-            (soup_nb_faces), dtype=np.bool
-        )  # eventually used when using texture
-        texture = np.zeros((0, 0))
-
-        background = np.zeros((height, width, nb_colors))
-        if "depth" in channels:
-            background[:, :, ranges["depth"][0] : ranges["depth"][1]] = depths.max()
-
-        scene_2d = Scene2DBase(
-            faces=soup_faces,
-            faces_uv=soup_faces_uv,
-            ij=soup_ij,
-            depths=soup_depths,
-            textured=textured,
-            uv=uv_zeros,
-            shade=shade,
-            colors=colors,
-            shaded=shaded,
-            edgeflags=edgeflags,
-            height=height,
-            width=width,
-            nb_colors=nb_colors,
-            texture=texture,
-            background=background,
-            backface_culling=backface_culling,
-        )
-        buffers = np.empty((camera.height, camera.width, nb_colors))
-        z_buffer = np.empty((camera.height, camera.width))
-        differentiable_renderer_cython.renderScene(scene_2d, 0, buffers, z_buffer)
-
-        output = {}
-        for k in channels.keys():
-            output[k] = buffers[:, :, ranges[k][0] : ranges[k][1]]
+            output["uv"] = resolve(self.mesh.faces_uv, self.mesh.uv)
 
         return output
@@ -1,6 +1,8 @@
 # distutils: language = c++
 from libcpp cimport bool
 cimport _differentiable_renderer 
+from libcpp.vector cimport vector
+from libc.string cimport memcpy
 
 import cython
 # import both numpy and the Cython declarations for numpy
@@ -322,3 +324,1083 @@ def renderSceneB(scene,
 	scene.colors_b = colors_b_c.reshape(scene.colors_b.shape)
 	scene.texture_b = texture_b_c.reshape(scene.texture_b.shape)
 	
+
+
+cdef _vector_to_array(vector[double] &v, shape):
+	cdef np.ndarray[np.double_t, mode = "c"] a = np.empty((v.size()), dtype = np.double)
+	if v.size() > 0:
+		memcpy(a.data, &v[0], v.size() * sizeof(double))
+	return a.reshape(shape)
+
+
+cdef _int_vector_to_array(vector[int] &v, shape):
+	cdef np.ndarray[np.int32_t, mode = "c"] a = np.empty((v.size()), dtype = np.int32)
+	if v.size() > 0:
+		memcpy(a.data, &v[0], v.size() * sizeof(int))
+	return a.reshape(shape)
+
+
+cdef class MeshTopology:
+	"""Adjacency tables of a triangulated mesh stored natively so that it can be shared by
+	several Scene3DPipeline instances rendering the same mesh.
+	"""
+	cdef _differentiable_renderer.MeshTopology* thisptr
+
+	def __cinit__(self, faces, nb_vertices = None, bool clockwise = False):
+		assert(faces.ndim  ==  2)
+		assert(faces.shape[1]  ==  3)
+		cdef np.ndarray[np.uint32_t, mode = "c"] faces_c  =  np.ascontiguousarray(faces.flatten(), dtype = np.uint32)
+		if nb_vertices is None:
+			nb_vertices = np.max(faces) + 1
+		self.thisptr = new _differentiable_renderer.MeshTopology()
+		_differentiable_renderer.build_mesh_topology(self.thisptr[0], <unsigned int*> faces_c.data, faces.shape[0], nb_vertices, clockwise)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	property nb_vertices:
+		def __get__(self):
+			return self.thisptr.nb_vertices
+
+	property nb_faces:
+		def __get__(self):
+			return self.thisptr.nb_faces
+
+	property nb_edges:
+		def __get__(self):
+			return self.thisptr.nb_edges
+
+	property clockwise:
+		def __get__(self):
+			return self.thisptr.clockwise
+
+	property faces_edges:
+		def __get__(self):
+			return np.array(self.thisptr.faces_edges, dtype = np.int32).reshape(self.thisptr.nb_faces, 3)
+
+	property edges_faces:
+		def __get__(self):
+			return np.array(self.thisptr.edges_faces, dtype = np.int32).reshape(self.thisptr.nb_edges, 2)
+
+
+cdef class SkinningWeights:
+	"""Sparse linear blend skinning weights, given as (vertex, bone, weight) triplets."""
+	cdef _differentiable_renderer.SkinningWeights* thisptr
+
+	def __cinit__(self, vertices_ids, bones_ids, weights, int nb_vertices, int nb_bones):
+		assert len(vertices_ids)  ==  len(bones_ids)
+		assert len(vertices_ids)  ==  len(weights)
+		cdef np.ndarray[np.int32_t, mode = "c"] vertices_ids_c  =  np.ascontiguousarray(vertices_ids, dtype = np.int32)
+		cdef np.ndarray[np.int32_t, mode = "c"] bones_ids_c  =  np.ascontiguousarray(bones_ids, dtype = np.int32)
+		cdef np.ndarray[np.double_t, mode = "c"] weights_c  =  np.ascontiguousarray(weights, dtype = np.double)
+		self.thisptr = new _differentiable_renderer.SkinningWeights()
+		_differentiable_renderer.build_skinning_weights(self.thisptr[0], nb_vertices, nb_bones, len(weights), <int*> vertices_ids_c.data, <int*> bones_ids_c.data, <double*> weights_c.data)
+
+	@staticmethod
+	def from_dense(weights, double threshold = 0):
+		"""Create the sparse weights from a nb_vertices x nb_bones matrix, dropping weights smaller than threshold"""
+		vertices_ids, bones_ids = np.nonzero(weights > threshold)
+		return SkinningWeights(vertices_ids, bones_ids, weights[vertices_ids, bones_ids], weights.shape[0], weights.shape[1])
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	property nb_vertices:
+		def __get__(self):
+			return self.thisptr.nb_vertices
+
+	property nb_bones:
+		def __get__(self):
+			return self.thisptr.nb_bones
+
+
+cdef class LinearBasis:
+	"""Linear model values = mean + coefs.dot(basis) with a basis of shape nb_components x size,
+	used for blendshapes and PCA shape or texture models. The basis is stored natively in float32
+	and the evaluation and its backward are multithreaded."""
+	cdef _differentiable_renderer.LinearBasis* thisptr
+	cdef int nb_threads
+
+	def __cinit__(self, basis, mean = None, int block_size = 256, int nb_threads = 0):
+		assert basis.ndim  ==  2
+		cdef np.ndarray[np.double_t, mode = "c"] basis_c  =  np.ascontiguousarray(basis.flatten(), dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] mean_c
+		cdef double* mean_ptr = NULL
+		if mean is not None:
+			assert mean.size  ==  basis.shape[1]
+			mean_c = np.ascontiguousarray(mean.flatten(), dtype = np.double)
+			mean_ptr = <double*> mean_c.data
+		self.thisptr = new _differentiable_renderer.LinearBasis(basis.shape[0], basis.shape[1], mean_ptr, <double*> basis_c.data, block_size)
+		self.nb_threads = nb_threads
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	property nb_components:
+		def __get__(self):
+			return self.thisptr.nb_components
+
+	property size:
+		def __get__(self):
+			return self.thisptr.size
+
+	def evaluate(self, coefs):
+		assert coefs.size  ==  self.thisptr.nb_components
+		cdef np.ndarray[np.double_t, mode = "c"] coefs_c  =  np.ascontiguousarray(coefs, dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] values  =  np.empty((self.thisptr.size), dtype = np.double)
+		self.thisptr.evaluate(<double*> coefs_c.data, <double*> values.data, self.nb_threads)
+		return values
+
+	def evaluate_backward(self, values_b):
+		assert values_b.size  ==  self.thisptr.size
+		cdef np.ndarray[np.double_t, mode = "c"] values_b_c  =  np.ascontiguousarray(values_b.flatten(), dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] coefs_b  =  np.zeros((self.thisptr.nb_components), dtype = np.double)
+		self.thisptr.evaluate_B(<double*> values_b_c.data, <double*> coefs_b.data, self.nb_threads)
+		return coefs_b
+
+
+cdef class Scene3DPipeline:
+	"""Native rendering of a single mesh with a rigid pose, a directional and an ambient light
+	and the backpropagation of the squared error with an observed image down to the vertices,
+	the pose, the lights and the colors in a single call. Intermediate buffers are kept between
+	calls to avoid reallocations when rendering the same mesh repeatedly.
+	"""
+	cdef _differentiable_renderer.Scene3DPipeline* thisptr
+	cdef _differentiable_renderer.InstancedRenderer* instanced
+	cdef MeshTopology topology
+	cdef SkinningWeights skinning
+	cdef LinearBasis shape_basis
+	cdef LinearBasis texture_basis
+	cdef object texture_shape
+	cdef dict arrays  # keep references to the arrays pointed to by the native pipeline
+
+	def __cinit__(self, MeshTopology topology, double sigma = 1, int nb_threads = 0):
+		self.topology = topology
+		self.thisptr = new _differentiable_renderer.Scene3DPipeline(topology.thisptr)
+		self.thisptr.sigma = sigma
+		self.thisptr.nb_threads = nb_threads
+		self.instanced = new _differentiable_renderer.InstancedRenderer(self.thisptr)
+		self.arrays = {}
+
+	def __dealloc__(self):
+		del self.instanced
+		del self.thisptr
+
+	cdef double* _set_array(self, name, array, shape, dtype = np.double):
+		if array is None:
+			self.arrays.pop(name, None)
+			return NULL
+		cdef np.ndarray a = np.ascontiguousarray(array, dtype = dtype)
+		assert a.size  ==  np.prod(shape), "%s should be of size %d" % (name, np.prod(shape))
+		self.arrays[name] = a
+		return <double*> a.data
+
+	def set_camera(self, camera):
+		assert camera.extrinsic.shape  ==  (3, 4)
+		assert camera.intrinsic.shape  ==  (3, 3)
+		for k in range(12):
+			self.thisptr.camera.extrinsic[k] = camera.extrinsic.flat[k]
+		for k in range(9):
+			self.thisptr.camera.intrinsic[k] = camera.intrinsic.flat[k]
+		self.thisptr.camera.has_distortion = camera.distortion is not None
+		if camera.distortion is not None:
+			for k in range(5):
+				self.thisptr.camera.distortion[k] = camera.distortion[k]
+		self.thisptr.camera.height = camera.height
+		self.thisptr.camera.width = camera.width
+
+	def set_skinning(self, SkinningWeights skinning):
+		"""Deform the vertices using linear blend skinning, the vertices given to render are then
+		in the rest pose and the bone transforms should be provided"""
+		if skinning is None:
+			self.thisptr.skinning = NULL
+		else:
+			assert skinning.nb_vertices  ==  self.topology.nb_vertices
+			self.thisptr.skinning = skinning.thisptr
+		self.skinning = skinning
+
+	def set_light(self, light_directional, double light_ambient):
+		self.thisptr.light_directional = self._set_array("light_directional", light_directional, (3,))
+		self.thisptr.light_ambient = light_ambient
+
+	def set_background(self, background):
+		assert background.ndim  ==  3
+		assert background.shape[0]  ==  self.thisptr.camera.height
+		assert background.shape[1]  ==  self.thisptr.camera.width
+		self.thisptr.nb_colors = background.shape[2]
+		self.thisptr.background = self._set_array("background", background, background.shape)
+
+	def set_vertices_colors(self, vertices_colors):
+		assert vertices_colors.shape[0]  ==  self.topology.nb_vertices
+		self.thisptr.vertices_colors = self._set_array("vertices_colors", vertices_colors, vertices_colors.shape)
+
+	def set_texture(self, texture, uv, faces_uv):
+		if texture is None:
+			self.thisptr.texture = NULL
+			return
+		assert texture.ndim  ==  3
+		self.thisptr.texture = self._set_array("texture", texture, texture.shape)
+		self._set_uv(texture.shape, uv, faces_uv)
+
+	def set_texture_basis(self, LinearBasis texture_basis, texture_shape, uv, faces_uv):
+		"""Use a texture given by a linear model whose values are of size texture_shape,
+		the texture coefficients are then given to render"""
+		self.texture_basis = texture_basis
+		if texture_basis is None:
+			self.thisptr.texture_basis = NULL
+			return
+		assert len(texture_shape)  ==  3
+		assert texture_basis.size  ==  np.prod(texture_shape)
+		self.thisptr.texture_basis = texture_basis.thisptr
+		self._set_uv(texture_shape, uv, faces_uv)
+
+	def set_shape_basis(self, LinearBasis shape_basis):
+		"""Use vertices given by a linear model of size nb_vertices x 3, the shape coefficients
+		are then given to render instead of the vertices"""
+		self.shape_basis = shape_basis
+		if shape_basis is None:
+			self.thisptr.shape_basis = NULL
+			return
+		assert shape_basis.size  ==  3 * self.topology.nb_vertices
+		self.thisptr.shape_basis = shape_basis.thisptr
+
+	def set_render_depth(self, bool render_depth, double depth_scale = 1):
+		"""Render the depth multiplied by depth_scale instead of the colors, the background
+		should then have a single channel"""
+		self.thisptr.render_depth = render_depth
+		self.thisptr.depth_scale = depth_scale
+
+	def set_near_plane(self, double near_plane):
+		"""Clip the faces against the plane at the depth near_plane in the camera coordinate system
+		(0.1 by default) instead of dropping the faces with vertices behind the camera, a non positive
+		value disables the clipping"""
+		self.thisptr.near_plane = near_plane
+
+	def _set_uv(self, texture_shape, uv, faces_uv):
+		assert uv.shape[1]  ==  2
+		assert faces_uv.shape[0]  ==  self.topology.nb_faces
+		assert np.all(faces_uv < uv.shape[0])
+		self.texture_shape = tuple(texture_shape)
+		self.thisptr.texture_height = texture_shape[0]
+		self.thisptr.texture_width = texture_shape[1]
+		self.thisptr.uv = self._set_array("uv", uv, uv.shape)
+		self.thisptr.nb_uv = uv.shape[0]
+		self.thisptr.faces_uv = <unsigned int*> self._set_array("faces_uv", faces_uv, faces_uv.shape, np.uint32)
+
+	def render(self, vertices = None, quaternion = None, translation = None, obs = None, bool backface_culling = True, bone_transforms = None, shape_coefficients = None, texture_coefficients = None):
+		"""Render the mesh and return the image and the sum of squared differences with obs
+		(zero if obs is None)"""
+		nb_vertices = self.topology.nb_vertices
+		if self.shape_basis is None:
+			assert vertices.shape  ==  (nb_vertices, 3)
+			self.thisptr.vertices = self._set_array("vertices", vertices, vertices.shape)
+		else:
+			assert shape_coefficients is not None
+			self.thisptr.shape_coefficients = self._set_array("shape_coefficients", shape_coefficients, (self.shape_basis.nb_components,))
+		if self.texture_basis is not None:
+			assert texture_coefficients is not None
+			self.thisptr.texture_coefficients = self._set_array("texture_coefficients", texture_coefficients, (self.texture_basis.nb_components,))
+		if self.skinning is not None:
+			assert bone_transforms is not None
+			self.thisptr.bone_transforms = self._set_array("bone_transforms", bone_transforms, (self.skinning.nb_bones, 3, 4))
+		self.thisptr.quaternion = self._set_array("quaternion", quaternion, (4,))
+		self.thisptr.translation = self._set_array("translation", translation, (3,))
+		self.thisptr.backface_culling = backface_culling
+		cdef double* obs_ptr = self._set_array("obs", obs, self.image_shape())
+		loss = self.thisptr.render(obs_ptr)
+		return self.image, loss
+
+	def image_shape(self):
+		return (self.thisptr.camera.height, self.thisptr.camera.width, self.thisptr.nb_colors)
+
+	def render_backward(self, image_b = None):
+		"""Backpropagate image_b, or the gradient of the loss with respect to the image if image_b is None
+		and return a dictionary with the gradients with respect to the inputs"""
+		cdef double* image_b_ptr = self._set_array("image_b", image_b, self.image_shape())
+		self.thisptr.render_backward(image_b_ptr)
+		gradients = {}
+		gradients["vertices"] = _vector_to_array(self.thisptr.vertices_b, (self.topology.nb_vertices, 3))
+		if self.shape_basis is not None:
+			gradients["shape_coefficients"] = _vector_to_array(self.thisptr.shape_coefficients_b, (self.shape_basis.nb_components,))
+		if self.texture_basis is not None:
+			gradients["texture_coefficients"] = _vector_to_array(self.thisptr.texture_coefficients_b, (self.texture_basis.nb_components,))
+		if self.skinning is not None:
+			gradients["bone_transforms"] = _vector_to_array(self.thisptr.bone_transforms_b, (self.skinning.nb_bones, 3, 4))
+		if self.thisptr.quaternion != NULL:
+			gradients["quaternion"] = np.array([self.thisptr.quaternion_b[k] for k in range(4)])
+		if self.thisptr.translation != NULL:
+			gradients["translation"] = np.array([self.thisptr.translation_b[k] for k in range(3)])
+		if self.thisptr.light_directional != NULL:
+			gradients["light_directional"] = np.array([self.thisptr.light_directional_b[k] for k in range(3)])
+		gradients["light_ambient"] = self.thisptr.light_ambient_b
+		if (self.thisptr.texture != NULL) or (self.texture_basis is not None):
+			gradients["texture"] = _vector_to_array(self.thisptr.texture_b, self.texture_shape)
+		elif not self.thisptr.render_depth:
+			gradients["vertices_colors"] = _vector_to_array(self.thisptr.vertices_colors_b, self.arrays["vertices_colors"].shape)
+		return gradients
+
+	def score_poses(self, quaternions = None, translations = None, obs = None, vertices = None, int downsample = 1):
+		"""Return the sum of squared differences with obs of the renderings of the mesh under each of
+		the K candidate poses, without keeping the images. quaternions (K x 4), translations (K x 3)
+		and vertices (K x nb_vertices x 3) are optional, the last value given to render is used
+		for the missing ones. The losses are computed on images downsampled by the factor downsample
+		and the poses are scored in parallel using the nb_threads of the pipeline."""
+		assert obs is not None
+		nb_vertices = self.topology.nb_vertices
+		cdef np.ndarray[double, ndim = 2, mode = "c"] quaternions_c
+		cdef np.ndarray[double, ndim = 2, mode = "c"] translations_c
+		cdef np.ndarray[double, ndim = 3, mode = "c"] vertices_c
+		cdef double* quaternions_ptr = NULL
+		cdef double* translations_ptr = NULL
+		cdef double* vertices_ptr = NULL
+		nb_poses = None
+		if quaternions is not None:
+			quaternions_c = np.ascontiguousarray(quaternions, dtype = np.double)
+			assert quaternions_c.shape[1]  ==  4
+			nb_poses = quaternions_c.shape[0]
+			quaternions_ptr = <double*> quaternions_c.data
+		if translations is not None:
+			translations_c = np.ascontiguousarray(translations, dtype = np.double)
+			assert translations_c.shape[1]  ==  3
+			assert nb_poses is None or nb_poses  ==  translations_c.shape[0]
+			nb_poses = translations_c.shape[0]
+			translations_ptr = <double*> translations_c.data
+		if vertices is not None:
+			vertices_c = np.ascontiguousarray(vertices, dtype = np.double)
+			assert vertices_c.shape[1]  ==  nb_vertices and vertices_c.shape[2]  ==  3
+			assert nb_poses is None or nb_poses  ==  vertices_c.shape[0]
+			nb_poses = vertices_c.shape[0]
+			vertices_ptr = <double*> vertices_c.data
+		assert nb_poses is not None, "at least one of quaternions, translations or vertices should be provided"
+		if vertices is None and self.shape_basis is None:
+			assert self.thisptr.vertices != NULL, "vertices should be provided or set by a previous call to render"
+		cdef np.ndarray[double, ndim = 3, mode = "c"] obs_c = np.ascontiguousarray(obs, dtype = np.double)
+		assert np.shape(obs_c)  ==  self.image_shape()
+		cdef np.ndarray[double, ndim = 1, mode = "c"] losses = np.zeros((nb_poses), dtype = np.double)
+		_differentiable_renderer.score_poses(self.thisptr[0], nb_poses, quaternions_ptr, translations_ptr, vertices_ptr, <double*> obs_c.data, downsample, <double*> losses.data, self.thisptr.nb_threads)
+		return losses
+
+	def render_instances(self, vertices = None, quaternions = None, translations = None, scales = None, offsets = None, obs = None, bool backface_culling = True):
+		"""Render N instances of the mesh in a single image and return the image and the sum of squared
+		differences with obs (zero if obs is None). The vertices of the instance n are the template
+		vertices, the last ones given to render if None, multiplied by scales[n] and displaced by
+		offsets[n] (N x nb_vertices x 3), then rotated by quaternions[n] and translated by
+		translations[n]. Missing transforms are the identity, at least one should be given. The colors
+		or the texture and the lights of the pipeline are shared by the instances."""
+		nb_vertices = self.topology.nb_vertices
+		nb_instances = None
+		for name, transforms in [("quaternions", quaternions), ("translations", translations), ("scales", scales), ("offsets", offsets)]:
+			if transforms is not None:
+				assert nb_instances is None or nb_instances  ==  len(transforms), "%s should have one element per instance" % name
+				nb_instances = len(transforms)
+		assert nb_instances is not None, "at least one of quaternions, translations, scales or offsets should be provided"
+		if vertices is not None:
+			assert vertices.shape  ==  (nb_vertices, 3)
+			self.thisptr.vertices = self._set_array("vertices", vertices, vertices.shape)
+		assert self.thisptr.vertices != NULL, "vertices should be provided or set by a previous call to render"
+		self.thisptr.backface_culling = backface_culling
+		self.instanced.nb_instances = nb_instances
+		self.instanced.quaternions = self._set_array("instances_quaternions", quaternions, (nb_instances, 4))
+		self.instanced.translations = self._set_array("instances_translations", translations, (nb_instances, 3))
+		self.instanced.scales = self._set_array("instances_scales", scales, (nb_instances,))
+		self.instanced.offsets = self._set_array("instances_offsets", offsets, (nb_instances, nb_vertices, 3))
+		cdef double* obs_ptr = self._set_array("instances_obs", obs, self.image_shape())
+		loss = self.instanced.render(obs_ptr)
+		return _vector_to_array(self.instanced.image, self.image_shape()), loss
+
+	def render_instances_backward(self, image_b = None):
+		"""Backpropagate image_b, or the gradient of the loss with respect to the image if image_b is None,
+		through render_instances and return a dictionary with the gradients with respect to the
+		transforms of each instance and with respect to the template vertices, the colors or the
+		texture and the lights summed over the instances"""
+		cdef double* image_b_ptr = self._set_array("instances_image_b", image_b, self.image_shape())
+		self.instanced.render_backward(image_b_ptr)
+		nb_instances = self.instanced.nb_instances
+		gradients = {}
+		gradients["vertices"] = _vector_to_array(self.instanced.vertices_b, (self.topology.nb_vertices, 3))
+		if self.instanced.quaternions != NULL:
+			gradients["quaternions"] = _vector_to_array(self.instanced.quaternions_b, (nb_instances, 4))
+		if self.instanced.translations != NULL:
+			gradients["translations"] = _vector_to_array(self.instanced.translations_b, (nb_instances, 3))
+		if self.instanced.scales != NULL:
+			gradients["scales"] = _vector_to_array(self.instanced.scales_b, (nb_instances,))
+		if self.instanced.offsets != NULL:
+			gradients["offsets"] = _vector_to_array(self.instanced.offsets_b, (nb_instances, self.topology.nb_vertices, 3))
+		if self.thisptr.light_directional != NULL:
+			gradients["light_directional"] = np.array([self.instanced.light_directional_b[k] for k in range(3)])
+		gradients["light_ambient"] = self.instanced.light_ambient_b
+		if self.thisptr.texture != NULL:
+			gradients["texture"] = _vector_to_array(self.instanced.texture_b, self.texture_shape)
+		else:
+			gradients["vertices_colors"] = _vector_to_array(self.instanced.vertices_colors_b, self.arrays["vertices_colors"].shape)
+		return gradients
+
+	property image:
+		def __get__(self):
+			return _vector_to_array(self.thisptr.image, self.image_shape())
+
+	property z_buffer:
+		def __get__(self):
+			return _vector_to_array(self.thisptr.z_buffer, self.image_shape()[:2])
+
+	property ij:
+		def __get__(self):
+			return _vector_to_array(self.thisptr.ij, (self.topology.nb_vertices, 2))
+
+	property depths:
+		def __get__(self):
+			return _vector_to_array(self.thisptr.depths, (self.topology.nb_vertices,))
+
+
+cdef class LaplacianRigidEnergy:
+	"""Native as-rigid-as-possible energy 0.5 * cregu * sum_c (x_c - x_ref_c)^T L^T L (x_c - x_ref_c),
+	with the matrix L^T L stored once and applied to each coordinate."""
+	cdef _differentiable_renderer.LaplacianRigidEnergy* thisptr
+
+	def __cinit__(self, laplacian_t_laplacian, vertices_ref, double cregu, int nb_threads = 0):
+		LtL = laplacian_t_laplacian.tocsr()
+		LtL.sort_indices()
+		nb_vertices = LtL.shape[0]
+		assert LtL.shape[1]  ==  nb_vertices
+		assert vertices_ref.shape  ==  (nb_vertices, 3)
+		cdef np.ndarray[np.int32_t, mode = "c"] indptr_c  =  np.ascontiguousarray(LtL.indptr, dtype = np.int32)
+		cdef np.ndarray[np.int32_t, mode = "c"] indices_c  =  np.ascontiguousarray(LtL.indices, dtype = np.int32)
+		cdef np.ndarray[np.double_t, mode = "c"] values_c  =  np.ascontiguousarray(LtL.data, dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] vertices_ref_c  =  np.ascontiguousarray(vertices_ref.flatten(), dtype = np.double)
+		self.thisptr = new _differentiable_renderer.LaplacianRigidEnergy(nb_vertices, <int*> indptr_c.data, <int*> indices_c.data, <double*> values_c.data, <double*> vertices_ref_c.data, cregu)
+		self.thisptr.nb_threads = nb_threads
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	property cregu:
+		def __get__(self):
+			return self.thisptr.cregu
+		def __set__(self, double cregu):
+			self.thisptr.cregu = cregu
+
+	def set_vertices_ref(self, vertices_ref):
+		assert vertices_ref.shape  ==  (self.thisptr.nb_vertices, 3)
+		cdef np.ndarray[np.double_t, mode = "c"] vertices_ref_c  =  np.ascontiguousarray(vertices_ref.flatten(), dtype = np.double)
+		self.thisptr.set_vertices_ref(<double*> vertices_ref_c.data)
+
+	def evaluate(self, vertices):
+		nb_vertices = self.thisptr.nb_vertices
+		assert vertices.shape  ==  (nb_vertices, 3)
+		cdef np.ndarray[np.double_t, mode = "c"] vertices_c  =  np.ascontiguousarray(vertices.flatten(), dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] grad  =  np.empty((nb_vertices * 3), dtype = np.double)
+		energy = self.thisptr.evaluate(<double*> vertices_c.data, <double*> grad.data)
+		return energy, grad.reshape(nb_vertices, 3)
+
+	def solve(self, rhs, double regularization):
+		"""Solve (cregu * L^T L + regularization * I) x = rhs for each coordinate using a cached
+		sparse LDL^T factorization, recomputed only when the regularization or cregu change."""
+		nb_vertices = self.thisptr.nb_vertices
+		assert rhs.shape  ==  (nb_vertices, 3)
+		assert regularization > 0
+		cdef np.ndarray[np.double_t, mode = "c"] rhs_c  =  np.ascontiguousarray(rhs.flatten(), dtype = np.double)
+		cdef np.ndarray[np.double_t, mode = "c"] x  =  np.empty((nb_vertices * 3), dtype = np.double)
+		self.thisptr.solve(<double*> rhs_c.data, <double*> x.data, regularization)
+		return x.reshape(nb_vertices, 3)
+
+
+cdef class MeshFitter:
+	"""Native fitter running several iterations of the update rule of the python MeshDepthFitter
+	and MeshRGBFitterWithPose step methods in a single call."""
+	cdef _differentiable_renderer.MeshFitter* thisptr
+	cdef Scene3DPipeline pipeline
+	cdef LaplacianRigidEnergy rigid_energy
+	cdef np.ndarray observation
+
+	def __cinit__(self, Scene3DPipeline pipeline, LaplacianRigidEnergy rigid_energy):
+		self.pipeline = pipeline
+		self.rigid_energy = rigid_energy
+		self.thisptr = new _differentiable_renderer.MeshFitter(pipeline.thisptr, rigid_energy.thisptr)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def set_observation(self, observation, double max_depth = np.inf):
+		assert observation.shape[0]  ==  self.pipeline.thisptr.camera.height
+		assert observation.shape[1]  ==  self.pipeline.thisptr.camera.width
+		assert observation.size  ==  np.prod(self.pipeline.image_shape())
+		self.observation = np.ascontiguousarray(observation, dtype = np.double)
+		self.thisptr.observation = <double*> self.observation.data
+		self.thisptr.max_depth = max_depth
+
+	def set_parameters(self, inertia, damping, step_factor_vertices, step_max_vertices, step_factor_quaternion, step_max_quaternion, step_factor_translation, step_max_translation, step_factor_light_directional = 0.0001, step_factor_light_ambient = 0.0001, step_factor_color = 0.00001, update_lights = True, update_color = True):
+		self.thisptr.inertia = inertia
+		self.thisptr.damping = damping
+		self.thisptr.step_factor_vertices = step_factor_vertices
+		self.thisptr.step_max_vertices = step_max_vertices
+		self.thisptr.step_factor_quaternion = step_factor_quaternion
+		self.thisptr.step_max_quaternion = step_max_quaternion
+		self.thisptr.step_factor_translation = step_factor_translation
+		self.thisptr.step_max_translation = step_max_translation
+		self.thisptr.step_factor_light_directional = step_factor_light_directional
+		self.thisptr.step_factor_light_ambient = step_factor_light_ambient
+		self.thisptr.step_factor_color = step_factor_color
+		self.thisptr.update_lights = update_lights
+		self.thisptr.update_color = update_color
+
+	def set_state(self, vertices, speed_vertices, quaternion, speed_quaternion, translation, speed_translation, light_directional = None, speed_light_directional = None, light_ambient = None, speed_light_ambient = None, color = None, speed_color = None):
+		assert vertices.shape  ==  (self.rigid_energy.thisptr.nb_vertices, 3)
+		assert speed_vertices.shape  ==  vertices.shape
+		self.thisptr.vertices = vertices.flatten()
+		self.thisptr.speed_vertices = speed_vertices.flatten()
+		for k in range(4):
+			self.thisptr.quaternion[k] = quaternion[k]
+			self.thisptr.speed_quaternion[k] = speed_quaternion[k]
+		for k in range(3):
+			self.thisptr.translation[k] = translation[k]
+			self.thisptr.speed_translation[k] = speed_translation[k]
+		if light_directional is not None:
+			for k in range(3):
+				self.thisptr.light_directional[k] = light_directional[k]
+				self.thisptr.speed_light_directional[k] = speed_light_directional[k]
+		if light_ambient is not None:
+			self.thisptr.light_ambient = np.squeeze(light_ambient)
+			self.thisptr.speed_light_ambient = np.squeeze(speed_light_ambient)
+		if color is not None:
+			self.thisptr.color = np.asarray(color, dtype = np.double).flatten()
+			self.thisptr.speed_color = np.asarray(speed_color, dtype = np.double).flatten()
+
+	def get_state(self):
+		state = {}
+		state["vertices"] = _vector_to_array(self.thisptr.vertices, (self.rigid_energy.thisptr.nb_vertices, 3))
+		state["speed_vertices"] = _vector_to_array(self.thisptr.speed_vertices, (self.rigid_energy.thisptr.nb_vertices, 3))
+		state["quaternion"] = np.array([self.thisptr.quaternion[k] for k in range(4)])
+		state["speed_quaternion"] = np.array([self.thisptr.speed_quaternion[k] for k in range(4)])
+		state["translation"] = np.array([self.thisptr.translation[k] for k in range(3)])
+		state["speed_translation"] = np.array([self.thisptr.speed_translation[k] for k in range(3)])
+		if not self.pipeline.thisptr.render_depth:
+			state["light_directional"] = np.array([self.thisptr.light_directional[k] for k in range(3)])
+			state["speed_light_directional"] = np.array([self.thisptr.speed_light_directional[k] for k in range(3)])
+			state["light_ambient"] = np.array([self.thisptr.light_ambient])
+			state["speed_light_ambient"] = np.array([self.thisptr.speed_light_ambient])
+			state["color"] = _vector_to_array(self.thisptr.color, (self.thisptr.color.size(),))
+			state["speed_color"] = _vector_to_array(self.thisptr.speed_color, (self.thisptr.speed_color.size(),))
+		return state
+
+	def run(self, int nb_iterations):
+		"""Run nb_iterations iterations and return the total, data and rigidity energies of each iteration"""
+		assert self.observation is not None
+		self.thisptr.run(nb_iterations)
+		energies = _vector_to_array(self.thisptr.energies, (nb_iterations,))
+		energies_data = _vector_to_array(self.thisptr.energies_data, (nb_iterations,))
+		energies_rigid = _vector_to_array(self.thisptr.energies_rigid, (nb_iterations,))
+		return energies, energies_data, energies_rigid
+
+	property diff_image:
+		def __get__(self):
+			return _vector_to_array(self.thisptr.diff_image, self.pipeline.image_shape()[:2])
+
+
+def build_mesh_adjacencies(faces, int nb_vertices):
+	"""Compute the edges and adjacency tables of a triangulated mesh in O(F log F) time and O(F) memory.
+	Returns a dictionary with faces_edges, edges, edges_nb_faces, the is_manifold, is_closed and
+	has_boundaries flags and the Laplacian in CSR form (laplacian_indptr, laplacian_indices, laplacian_data)."""
+	assert(faces.ndim  ==  2)
+	assert(faces.shape[1]  ==  3)
+	cdef np.ndarray[np.uint32_t, mode = "c"] faces_c  =  np.ascontiguousarray(faces.flatten(), dtype = np.uint32)
+	cdef _differentiable_renderer.MeshAdjacencies adjacencies
+	_differentiable_renderer.build_mesh_adjacencies(adjacencies, <unsigned int*> faces_c.data, faces.shape[0], nb_vertices)
+	return {
+		"nb_edges": adjacencies.nb_edges,
+		"faces_edges": _int_vector_to_array(adjacencies.faces_edges, (-1, 3)),
+		"edges": _int_vector_to_array(adjacencies.edges, (-1, 2)),
+		"edges_nb_faces": _int_vector_to_array(adjacencies.edges_nb_faces, (-1,)),
+		"is_manifold": adjacencies.is_manifold,
+		"is_closed": adjacencies.is_closed,
+		"has_boundaries": adjacencies.has_boundaries,
+		"laplacian_indptr": _int_vector_to_array(adjacencies.laplacian_start, (-1,)),
+		"laplacian_indices": _int_vector_to_array(adjacencies.laplacian_columns, (-1,)),
+		"laplacian_data": _vector_to_array(adjacencies.laplacian_values, (-1,)),
+	}
+
+
+def read_obj(filename):
+	"""Parse a wavefront OBJ file natively, returns a dictionary with the vertices, faces and, when
+	present in the file, vertices_colors, uv, faces_uv, normals and faces_normals. Polygons are
+	triangulated as fans."""
+	cdef _differentiable_renderer.ObjMesh mesh
+	filename_bytes = filename.encode("utf-8")
+	_differentiable_renderer.read_obj(filename_bytes, mesh)
+	result = {
+		"vertices": _vector_to_array(mesh.vertices, (-1, 3)),
+		"faces": _int_vector_to_array(mesh.faces, (-1, 3)),
+	}
+	if mesh.vertices_colors.size() > 0:
+		result["vertices_colors"] = _vector_to_array(mesh.vertices_colors, (-1, 3))
+	if mesh.uv.size() > 0:
+		result["uv"] = _vector_to_array(mesh.uv, (-1, 2))
+	if mesh.faces_uv.size() > 0:
+		result["faces_uv"] = _int_vector_to_array(mesh.faces_uv, (-1, 3))
+	if mesh.normals.size() > 0:
+		result["normals"] = _vector_to_array(mesh.normals, (-1, 3))
+	if mesh.faces_normals.size() > 0:
+		result["faces_normals"] = _int_vector_to_array(mesh.faces_normals, (-1, 3))
+	return result
+
+
+GBUFFER_NO_FACE = np.uint32(0xFFFFFFFF)
+
+
+def render_gbuffer(faces, ij, depths, int height, int width, bool clockwise, bool backface_culling):
+	"""Rasterize the indexed mesh once without antialiasing and return the face id buffer (uint32,
+	GBUFFER_NO_FACE where no face is visible), the barycentric coordinates of each pixel in its face
+	and the z_buffer."""
+	assert(faces.ndim == 2)
+	assert(faces.shape[1] == 3)
+	assert(ij.shape[0] == depths.shape[0])
+	assert(ij.shape[1] == 2)
+	assert(faces.size == 0 or np.max(faces) < ij.shape[0])
+	cdef np.ndarray[np.uint32_t, mode = "c"] faces_c = np.ascontiguousarray(faces.flatten(), dtype = np.uint32)
+	cdef np.ndarray[np.double_t, mode = "c"] ij_c = np.ascontiguousarray(ij.flatten(), dtype = np.double)
+	cdef np.ndarray[np.double_t, mode = "c"] depths_c = np.ascontiguousarray(depths.flatten(), dtype = np.double)
+	cdef np.ndarray[np.uint32_t, ndim = 2, mode = "c"] face_ids = np.empty((height, width), dtype = np.uint32)
+	cdef np.ndarray[np.double_t, ndim = 3, mode = "c"] barycentrics = np.empty((height, width, 3), dtype = np.double)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] z_buffer = np.empty((height, width), dtype = np.double)
+	_differentiable_renderer.render_gbuffer(<unsigned int*> faces_c.data, <double*> ij_c.data, <double*> depths_c.data, faces.shape[0], height, width, clockwise, backface_culling, <unsigned int*> face_ids.data, <double*> barycentrics.data, <double*> z_buffer.data)
+	return face_ids, barycentrics, z_buffer
+
+
+def resolve_gbuffer_attributes(face_ids, barycentrics, faces, attributes, background=None, int nb_threads=0):
+	"""Interpolate per-vertex attributes (nb_vertices x size) in each pixel using the buffers returned
+	by render_gbuffer. faces indexes the rows of attributes and should have one row per face of the
+	rasterized mesh, which allows using for example faces_uv with the uv coordinates."""
+	assert(face_ids.ndim == 2)
+	assert(barycentrics.shape == (face_ids.shape[0], face_ids.shape[1], 3))
+	assert(faces.ndim == 2)
+	assert(faces.shape[1] == 3)
+	assert(attributes.ndim == 2)
+	assert(faces.size == 0 or np.max(faces) < attributes.shape[0])
+	visible = face_ids[face_ids != GBUFFER_NO_FACE]
+	assert(visible.size == 0 or np.max(visible) < faces.shape[0])
+	cdef int size = attributes.shape[1]
+	if background is None:
+		background = np.zeros((size))
+	cdef np.ndarray[np.double_t, mode = "c"] background_c = np.ascontiguousarray(np.broadcast_to(background, (size,)), dtype = np.double)
+	cdef np.ndarray[np.uint32_t, mode = "c"] face_ids_c = np.ascontiguousarray(face_ids.flatten(), dtype = np.uint32)
+	cdef np.ndarray[np.double_t, mode = "c"] barycentrics_c = np.ascontiguousarray(barycentrics.flatten(), dtype = np.double)
+	cdef np.ndarray[np.uint32_t, mode = "c"] faces_c = np.ascontiguousarray(faces.flatten(), dtype = np.uint32)
+	cdef np.ndarray[np.double_t, mode = "c"] attributes_c = np.ascontiguousarray(attributes.flatten(), dtype = np.double)
+	cdef np.ndarray[np.double_t, ndim = 3, mode = "c"] image = np.empty((face_ids.shape[0], face_ids.shape[1], size), dtype = np.double)
+	_differentiable_renderer.resolve_gbuffer_attributes(<unsigned int*> face_ids_c.data, <double*> barycentrics_c.data, face_ids.size, <unsigned int*> faces_c.data, <double*> attributes_c.data, size, <double*> background_c.data, <double*> image.data, nb_threads)
+	return image
+
+
+cdef class _DepthMaskSceneArrays:
+	"""Keep alive the contiguous copies of the arrays referenced by a DepthMaskScene."""
+	cdef _differentiable_renderer.DepthMaskScene scene
+	cdef np.ndarray faces_c, ij_c, depths_c, edgeflags_c, background_c, ij_b, depths_b
+
+	def __init__(self, faces, ij, depths, edgeflags, int height, int width, bool clockwise, bool backface_culling, background=None):
+		assert(faces.ndim == 2)
+		assert(faces.shape[1] == 3)
+		assert(ij.ndim == 2)
+		assert(ij.shape[1] == 2)
+		assert(depths.shape[0] == ij.shape[0])
+		assert(edgeflags.shape == faces.shape)
+		self.faces_c = np.ascontiguousarray(faces.flatten(), dtype = np.uint32)
+		self.ij_c = np.ascontiguousarray(ij.flatten(), dtype = np.double)
+		self.depths_c = np.ascontiguousarray(depths.flatten(), dtype = np.double)
+		self.edgeflags_c = np.ascontiguousarray(edgeflags.flatten(), dtype = np.uint8)
+		if background is None:
+			background = 0
+		self.background_c = np.ascontiguousarray(np.broadcast_to(background, (height, width)).flatten(), dtype = np.double)
+		self.ij_b = np.zeros((ij.shape[0], 2))
+		self.depths_b = np.zeros((ij.shape[0]))
+		self.scene.faces = <unsigned int*> self.faces_c.data
+		self.scene.ij = <double*> self.ij_c.data
+		self.scene.depths = <double*> self.depths_c.data
+		self.scene.edgeflags = <bool*> self.edgeflags_c.data
+		self.scene.background = <double*> self.background_c.data
+		self.scene.ij_b = <double*> self.ij_b.data
+		self.scene.depths_b = <double*> self.depths_b.data
+		self.scene.nb_triangles = faces.shape[0]
+		self.scene.nb_vertices = ij.shape[0]
+		self.scene.height = height
+		self.scene.width = width
+		self.scene.clockwise = clockwise
+		self.scene.backface_culling = backface_culling
+
+
+def renderDepth(faces, ij, depths, edgeflags, background, bool clockwise, bool backface_culling, double depth_scale, double sigma):
+	"""Render the depth multiplied by depth_scale over the background (height x width) using the
+	z-only rasterizer, returns the depth image and the z_buffer."""
+	background = np.asarray(background)
+	cdef _DepthMaskSceneArrays arrays = _DepthMaskSceneArrays(faces, ij, depths, edgeflags, background.shape[0], background.shape[1], clockwise, backface_culling, background.reshape(background.shape[0], background.shape[1]))
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image = np.empty((background.shape[0], background.shape[1]))
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] z_buffer = np.empty((background.shape[0], background.shape[1]))
+	_differentiable_renderer.renderDepth(arrays.scene, depth_scale, <double*> image.data, <double*> z_buffer.data, sigma)
+	return image, z_buffer
+
+
+def renderDepthB(faces, ij, depths, edgeflags, bool clockwise, bool backface_culling, double depth_scale, double sigma, image, z_buffer, image_b):
+	"""Adjoint of renderDepth, returns the gradients with respect to ij and depths."""
+	assert(image.shape == z_buffer.shape)
+	assert(image_b.shape[:2] == image.shape)
+	cdef _DepthMaskSceneArrays arrays = _DepthMaskSceneArrays(faces, ij, depths, edgeflags, image.shape[0], image.shape[1], clockwise, backface_culling)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image_c = np.array(image, dtype = np.double, order = "C")
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] z_buffer_c = np.ascontiguousarray(z_buffer, dtype = np.double)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image_b_c = np.array(image_b.reshape(image.shape), dtype = np.double, order = "C")
+	_differentiable_renderer.renderDepth_B(arrays.scene, depth_scale, <double*> image_c.data, <double*> z_buffer_c.data, <double*> image_b_c.data, sigma)
+	return arrays.ij_b, arrays.depths_b
+
+
+def renderMask(faces, ij, depths, edgeflags, int height, int width, bool clockwise, bool backface_culling, double sigma, background=None):
+	"""Render the antialiased silhouette mask of the mesh over the background (0 by default),
+	returns the mask and the z_buffer."""
+	cdef _DepthMaskSceneArrays arrays = _DepthMaskSceneArrays(faces, ij, depths, edgeflags, height, width, clockwise, backface_culling, background)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image = np.empty((height, width))
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] z_buffer = np.empty((height, width))
+	_differentiable_renderer.renderMask(arrays.scene, <double*> image.data, <double*> z_buffer.data, sigma)
+	return image, z_buffer
+
+
+def renderMaskB(faces, ij, depths, edgeflags, bool clockwise, bool backface_culling, double sigma, image, z_buffer, image_b):
+	"""Adjoint of renderMask, returns the gradient with respect to ij."""
+	assert(image.shape == z_buffer.shape)
+	assert(image_b.shape[:2] == image.shape)
+	cdef _DepthMaskSceneArrays arrays = _DepthMaskSceneArrays(faces, ij, depths, edgeflags, image.shape[0], image.shape[1], clockwise, backface_culling)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image_c = np.array(image, dtype = np.double, order = "C")
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] z_buffer_c = np.ascontiguousarray(z_buffer, dtype = np.double)
+	cdef np.ndarray[np.double_t, ndim = 2, mode = "c"] image_b_c = np.array(image_b.reshape(image.shape), dtype = np.double, order = "C")
+	_differentiable_renderer.renderMask_B(arrays.scene, <double*> image_c.data, <double*> z_buffer_c.data, <double*> image_b_c.data, sigma)
+	return arrays.ij_b
+
+
+cdef class _SceneArrays:
+	"""Keep alive the contiguous copies of the fields of a scene referenced by a Scene struct."""
+	cdef _differentiable_renderer.Scene scene
+	cdef np.ndarray faces_c, faces_uv_c, depths_c, uv_c, ij_c, shade_c, colors_c, edgeflags_c, textured_c, shaded_c, texture_c, background_c
+	cdef np.ndarray uv_b, ij_b, shade_b, colors_b, texture_b
+
+	def __init__(self, scene, bool with_background = True):
+		# with_background = False skips the copy of the background, for the functions that do not read it
+		nb_triangles = scene.faces.shape[0]
+		nb_vertices = scene.depths.shape[0]
+		nb_colors = scene.colors.shape[1]
+		assert(scene.faces_uv.shape[0] == nb_triangles)
+		assert(np.all(scene.faces < nb_vertices))
+		assert(np.all(scene.faces_uv < scene.uv.shape[0]))
+		assert(scene.ij.shape == (nb_vertices, 2))
+		assert(scene.colors.shape[0] == nb_vertices)
+		assert(scene.shade.shape == (nb_vertices,))
+		assert(scene.edgeflags.shape == (nb_triangles, 3))
+		assert(scene.textured.shape == (nb_triangles,))
+		assert(scene.shaded.shape == (nb_triangles,))
+		if with_background:
+			assert(scene.background.shape == (scene.height, scene.width, nb_colors))
+		if scene.texture.size > 0:
+			assert(scene.texture.ndim == 3)
+			assert(scene.texture.shape[2] == nb_colors)
+		self.faces_c = np.ascontiguousarray(scene.faces.flatten(), dtype = np.uint32)
+		self.faces_uv_c = np.ascontiguousarray(scene.faces_uv.flatten(), dtype = np.uint32)
+		self.depths_c = np.ascontiguousarray(scene.depths.flatten(), dtype = np.double)
+		self.uv_c = np.ascontiguousarray(scene.uv.flatten(), dtype = np.double)
+		self.ij_c = np.ascontiguousarray(scene.ij.flatten(), dtype = np.double)
+		self.shade_c = np.ascontiguousarray(scene.shade.flatten(), dtype = np.double)
+		self.colors_c = np.ascontiguousarray(scene.colors.flatten(), dtype = np.double)
+		self.edgeflags_c = np.ascontiguousarray(scene.edgeflags.flatten(), dtype = np.uint8)
+		self.textured_c = np.ascontiguousarray(scene.textured.flatten(), dtype = np.uint8)
+		self.shaded_c = np.ascontiguousarray(scene.shaded.flatten(), dtype = np.uint8)
+		self.texture_c = np.ascontiguousarray(scene.texture.flatten(), dtype = np.double)
+		self.background_c = np.ascontiguousarray(scene.background.flatten(), dtype = np.double) if with_background else np.zeros((1))
+		self.uv_b = np.zeros(scene.uv.shape)
+		self.ij_b = np.zeros(scene.ij.shape)
+		self.shade_b = np.zeros(scene.shade.shape)
+		self.colors_b = np.zeros(scene.colors.shape)
+		self.texture_b = np.zeros(scene.texture.shape)
+
+		self.scene.nb_colors = nb_colors
+		self.scene.height = <int> scene.height
+		self.scene.width = <int> scene.width
+		self.scene.nb_triangles = nb_triangles
+		self.scene.nb_vertices = nb_vertices
+		self.scene.backface_culling = scene.backface_culling
+		self.scene.clockwise = scene.clockwise
+		self.scene.nb_uv = scene.uv.shape[0]
+		self.scene.faces = <unsigned int*> self.faces_c.data
+		self.scene.faces_uv = <unsigned int*> self.faces_uv_c.data
+		self.scene.depths = <double*> self.depths_c.data
+		self.scene.uv = <double*> self.uv_c.data
+		self.scene.ij = <double*> self.ij_c.data
+		self.scene.shade = <double*> self.shade_c.data
+		self.scene.colors = <double*> self.colors_c.data
+		self.scene.edgeflags = <bool*> self.edgeflags_c.data
+		self.scene.textured = <bool*> self.textured_c.data
+		self.scene.shaded = <bool*> self.shaded_c.data
+		self.scene.texture = <double*> self.texture_c.data
+		self.scene.background = <double*> self.background_c.data
+		self.scene.texture_height = scene.texture.shape[0]
+		self.scene.texture_width = scene.texture.shape[1]
+		self.scene.uv_b = <double*> self.uv_b.data
+		self.scene.ij_b = <double*> self.ij_b.data
+		self.scene.shade_b = <double*> self.shade_b.data
+		self.scene.colors_b = <double*> self.colors_b.data
+		self.scene.texture_b = <double*> self.texture_b.data
+
+
+cdef double* _optional_image_ptr(np.ndarray image, shape) except? NULL:
+	if image is None:
+		return NULL
+	assert(np.shape(image) == tuple(shape))
+	assert(image.dtype == np.double)
+	assert(image.flags["C_CONTIGUOUS"])
+	return <double*> image.data
+
+
+def renderSceneMultiOutput(scene, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer, double depth_scale = 1, depth_background = None, np.ndarray depth = None, np.ndarray mask = None):
+	"""Render the colors in image and, when depth or mask (height x width) are not None, the depth
+	multiplied by depth_scale over depth_background and the antialiased silhouette mask, all sharing
+	the same rasterization and silhouette edges pass."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	shape = (scene.height, scene.width)
+	assert(np.shape(image)[:2] == shape)
+	assert(image.shape[2] == arrays.scene.nb_colors)
+	assert(z_buffer.shape[0] == scene.height and z_buffer.shape[1] == scene.width)
+	cdef np.ndarray[np.double_t, mode = "c"] depth_background_c
+	cdef double* depth_background_ptr = NULL
+	if depth is not None:
+		assert(depth_background is not None)
+		depth_background_c = np.ascontiguousarray(np.broadcast_to(depth_background, shape).flatten(), dtype = np.double)
+		depth_background_ptr = <double*> depth_background_c.data
+	_differentiable_renderer.renderSceneMultiOutput(arrays.scene, <double*> image.data, <double*> z_buffer.data, sigma, depth_scale, depth_background_ptr, _optional_image_ptr(depth, shape), _optional_image_ptr(mask, shape))
+
+
+def renderSceneMultiOutputB(scene, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer, np.ndarray image_b = None, double depth_scale = 1, np.ndarray depth = None, np.ndarray depth_b = None, np.ndarray mask = None, np.ndarray mask_b = None):
+	"""Adjoint of renderSceneMultiOutput accumulating the adjoints of all the outputs that are not
+	None in one sweep. The images and their adjoints are modified in place. Sets the fields uv_b, ij_b,
+	shade_b, colors_b and texture_b of the scene and returns the adjoint of the depths."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	shape = (scene.height, scene.width)
+	assert(np.shape(image)[:2] == shape)
+	cdef np.ndarray[np.double_t, mode = "c"] depths_b = np.zeros((arrays.scene.nb_vertices))
+	_differentiable_renderer.renderSceneMultiOutput_B(arrays.scene, <double*> image.data, <double*> z_buffer.data, _optional_image_ptr(image_b, np.shape(image)), sigma, depth_scale, _optional_image_ptr(depth, shape), _optional_image_ptr(depth_b, shape), _optional_image_ptr(mask, shape), _optional_image_ptr(mask_b, shape), <double*> depths_b.data)
+	scene.uv_b = arrays.uv_b
+	scene.ij_b = arrays.ij_b
+	scene.shade_b = arrays.shade_b
+	scene.colors_b = arrays.colors_b
+	scene.texture_b = arrays.texture_b
+	return depths_b
+
+
+def renderSceneROI(scene, roi, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer):
+	"""Render the region of interest roi = (x0, y0, width, height) of the image of the scene into
+	image and z_buffer of size height x width, culling the faces outside of the region."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	x0, y0, width, height = roi
+	assert(np.shape(image) == (height, width, arrays.scene.nb_colors))
+	assert(np.shape(z_buffer) == (height, width))
+	_differentiable_renderer.renderSceneROI(arrays.scene, x0, y0, width, height, <double*> image.data, <double*> z_buffer.data, sigma, False, NULL, NULL)
+
+
+def renderSceneROIB(scene, roi, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer, np.ndarray[double, ndim = 3, mode = "c"] image_b):
+	"""Adjoint of renderSceneROI, image and image_b are modified in place. Sets the fields uv_b,
+	ij_b, shade_b, colors_b and texture_b of the scene."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	x0, y0, width, height = roi
+	assert(np.shape(image) == (height, width, arrays.scene.nb_colors))
+	assert(np.shape(image_b) == np.shape(image))
+	assert(np.shape(z_buffer) == (height, width))
+	_differentiable_renderer.renderSceneROI_B(arrays.scene, x0, y0, width, height, <double*> image.data, <double*> z_buffer.data, <double*> image_b.data, sigma, False, NULL, NULL, NULL)
+	scene.uv_b = arrays.uv_b
+	scene.ij_b = arrays.ij_b
+	scene.shade_b = arrays.shade_b
+	scene.colors_b = arrays.colors_b
+	scene.texture_b = arrays.texture_b
+
+
+def renderSceneRows(scene, row_weights, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer, np.ndarray[double, ndim = 3, mode = "c"] obs, np.ndarray[double, ndim = 2, mode = "c"] err_buffer):
+	"""Render the antialiased squared error with obs in err_buffer on the rows with a nonzero weight
+	and return the sum of the errors of each row multiplied by its weight. The other rows of image,
+	z_buffer and err_buffer are left untouched."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	cdef np.ndarray[double, ndim = 1, mode = "c"] row_weights_c = np.ascontiguousarray(row_weights, dtype = np.double)
+	assert(row_weights_c.shape[0] == scene.height)
+	assert(np.shape(image) == (scene.height, scene.width, arrays.scene.nb_colors))
+	assert(np.shape(obs) == np.shape(image))
+	assert(np.shape(z_buffer) == (scene.height, scene.width))
+	assert(np.shape(err_buffer) == (scene.height, scene.width))
+	return _differentiable_renderer.renderSceneRows(arrays.scene, <double*> row_weights_c.data, <double*> image.data, <double*> z_buffer.data, sigma, <double*> obs.data, <double*> err_buffer.data)
+
+
+def renderSceneRowsB(scene, row_weights, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer, np.ndarray[double, ndim = 3, mode = "c"] obs, np.ndarray[double, ndim = 2, mode = "c"] err_buffer):
+	"""Adjoint of the loss returned by renderSceneRows, err_buffer is modified in place. Sets the
+	fields uv_b, ij_b, shade_b, colors_b and texture_b of the scene."""
+	cdef _SceneArrays arrays = _SceneArrays(scene)
+	cdef np.ndarray[double, ndim = 1, mode = "c"] row_weights_c = np.ascontiguousarray(row_weights, dtype = np.double)
+	assert(row_weights_c.shape[0] == scene.height)
+	assert(np.shape(image) == (scene.height, scene.width, arrays.scene.nb_colors))
+	assert(np.shape(obs) == np.shape(image))
+	assert(np.shape(z_buffer) == (scene.height, scene.width))
+	assert(np.shape(err_buffer) == (scene.height, scene.width))
+	_differentiable_renderer.renderSceneRows_B(arrays.scene, <double*> row_weights_c.data, <double*> image.data, <double*> z_buffer.data, sigma, <double*> obs.data, <double*> err_buffer.data)
+	scene.uv_b = arrays.uv_b
+	scene.ij_b = arrays.ij_b
+	scene.shade_b = arrays.shade_b
+	scene.colors_b = arrays.colors_b
+	scene.texture_b = arrays.texture_b
+
+
+def renderSceneTile(scene, roi, background, double sigma, np.ndarray[double, ndim = 3, mode = "c"] image, np.ndarray[double, ndim = 2, mode = "c"] z_buffer):
+	"""Render the tile roi = (x0, y0, width, height) of the image of the scene over background into
+	image and z_buffer of size height x width, without reading the full size scene.background."""
+	cdef _SceneArrays arrays = _SceneArrays(scene, with_background = False)
+	x0, y0, width, height = roi
+	assert(np.shape(image) == (height, width, arrays.scene.nb_colors))
+	assert(np.shape(z_buffer) == (height, width))
+	cdef np.ndarray[double, ndim = 3, mode = "c"] background_c = np.ascontiguousarray(background, dtype = np.double)
+	assert(np.shape(background_c) == np.shape(image))
+	_differentiable_renderer.renderSceneTile(arrays.scene, x0, y0, width, height, <double*> background_c.data, <double*> image.data, <double*> z_buffer.data, sigma)
+
+
+cdef class FrameRenderer:
+	"""Render several scenes, sharing the image size and the number of colors, into the same image
+	and z_buffer without concatenating them. Call begin_frame, then draw_batch for each scene, then
+	end_frame. The edges antialiasing is sorted globally across the batches. backward sets the fields
+	uv_b, ij_b, shade_b, colors_b and texture_b of each scene drawn in the frame."""
+	cdef _differentiable_renderer.FrameRenderer* thisptr
+	cdef double sigma
+	cdef list scenes, arrays
+	cdef np.ndarray image, z_buffer, obs, err_buffer
+
+	def __cinit__(self, double sigma = 1):
+		self.thisptr = new _differentiable_renderer.FrameRenderer()
+		self.sigma = sigma
+		self.scenes = []
+		self.arrays = []
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def begin_frame(self, background):
+		cdef np.ndarray[double, ndim = 3, mode = "c"] background_c = np.ascontiguousarray(background, dtype = np.double)
+		height, width, nb_colors = np.shape(background_c)
+		self.image = np.empty((height, width, nb_colors))
+		self.z_buffer = np.empty((height, width))
+		self.obs = None
+		self.err_buffer = None
+		self.scenes = []
+		self.arrays = []
+		self.thisptr.begin_frame(height, width, nb_colors, <double*> background_c.data, <double*> self.image.data, <double*> self.z_buffer.data, NULL)
+
+	def draw_batch(self, scene):
+		# the contiguous copies of the scene fields are kept alive until the next frame
+		cdef _SceneArrays arrays = _SceneArrays(scene, with_background = False)
+		self.thisptr.draw_batch(arrays.scene, True)
+		self.scenes.append(scene)
+		self.arrays.append(arrays)
+
+	def end_frame(self, obs = None):
+		"""Returns the image and the z_buffer, and the antialiased squared error with obs when given."""
+		if obs is None:
+			self.thisptr.end_frame(self.sigma, False, NULL, NULL)
+			return self.image, self.z_buffer
+		self.obs = np.ascontiguousarray(obs, dtype = np.double)
+		self.err_buffer = np.empty(np.shape(self.z_buffer))
+		self.thisptr.end_frame(self.sigma, True, _optional_image_ptr(self.obs, np.shape(self.image)), <double*> self.err_buffer.data)
+		return self.image, self.z_buffer, self.err_buffer
+
+	def backward(self, image_b = None, err_buffer_b = None):
+		# the adjoint modifies the image and the error buffer in place, it works on copies so that
+		# the results returned by end_frame are preserved
+		cdef np.ndarray image = self.image.copy()
+		cdef np.ndarray image_b_c, err_buffer_c, err_buffer_b_c
+		cdef _SceneArrays arrays
+		for arrays in self.arrays:
+			arrays.uv_b.fill(0)
+			arrays.ij_b.fill(0)
+			arrays.shade_b.fill(0)
+			arrays.colors_b.fill(0)
+			arrays.texture_b.fill(0)
+		if self.obs is None:
+			image_b_c = np.array(image_b, dtype = np.double, order = "C")
+			self.thisptr.render_B(<double*> image.data, _optional_image_ptr(image_b_c, np.shape(image)), self.sigma, False, NULL, NULL, NULL)
+		else:
+			err_buffer_c = self.err_buffer.copy()
+			err_buffer_b_c = np.array(err_buffer_b, dtype = np.double, order = "C")
+			self.thisptr.render_B(<double*> image.data, NULL, self.sigma, True, <double*> self.obs.data, <double*> err_buffer_c.data, _optional_image_ptr(err_buffer_b_c, np.shape(err_buffer_c)))
+		for scene, arrays in zip(self.scenes, self.arrays):
+			scene.uv_b = arrays.uv_b.copy()
+			scene.ij_b = arrays.ij_b.copy()
+			scene.shade_b = arrays.shade_b.copy()
+			scene.colors_b = arrays.colors_b.copy()
+			scene.texture_b = arrays.texture_b.copy()
+
+
+cdef class StaticLayerRenderer:
+	"""Render scenes in front of a static scene, such as the environment, whose rendering is cached
+	at construction. Each call to render only rasterizes the region of the image covered by the
+	given dynamic scene, while keeping the occlusions and the edges antialiasing with the static scene
+	exact. The static scene does not receive gradients, backward sets the fields uv_b, ij_b, shade_b,
+	colors_b and texture_b of the last rendered dynamic scene."""
+	cdef _differentiable_renderer.StaticLayerRenderer* thisptr
+	cdef _SceneArrays static_arrays, arrays
+	cdef object scene
+	cdef int height, width, nb_colors
+
+	def __cinit__(self, static_scene, double sigma = 1):
+		self.static_arrays = _SceneArrays(static_scene)
+		self.height = static_scene.height
+		self.width = static_scene.width
+		self.nb_colors = self.static_arrays.scene.nb_colors
+		self.thisptr = new _differentiable_renderer.StaticLayerRenderer(self.static_arrays.scene, sigma)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	property roi:
+		def __get__(self):
+			"""Region (x0, y0, width, height) rendered by the last call to render."""
+			return tuple(self.thisptr.roi[i] for i in range(4))
+
+	def render(self, scene):
+		cdef np.ndarray[double, ndim = 3, mode = "c"] image = np.empty((self.height, self.width, self.nb_colors))
+		cdef np.ndarray[double, ndim = 2, mode = "c"] z_buffer = np.empty((self.height, self.width))
+		self.arrays = _SceneArrays(scene, with_background = False)
+		self.scene = scene
+		self.thisptr.render(self.arrays.scene, <double*> image.data, <double*> z_buffer.data)
+		return image, z_buffer
+
+	def backward(self, image_b):
+		cdef np.ndarray[double, ndim = 3, mode = "c"] image_b_c = np.ascontiguousarray(image_b, dtype = np.double)
+		assert(np.shape(image_b_c) == (self.height, self.width, self.nb_colors))
+		assert self.arrays is not None, "render should be called before backward"
+		self.thisptr.render_B(<double*> image_b_c.data)
+		self.scene.uv_b = self.arrays.uv_b
+		self.scene.ij_b = self.arrays.ij_b
+		self.scene.shade_b = self.arrays.shade_b
+		self.scene.colors_b = self.arrays.colors_b
+		self.scene.texture_b = self.arrays.texture_b
+
+
+cdef class IncrementalRenderer:
+	"""Render a scene of which only a few vertices change between calls. render renders the full image
+	into the persistent buffers image, z_buffer and face_ids, the id of the face visible in each pixel,
+	GBUFFER_NO_FACE for the background. update(scene, changed_vertices) re-renders in place only the
+	region affected by the changed vertices and returns it as (x0, y0, width, height)."""
+	cdef _differentiable_renderer.IncrementalRenderer* thisptr
+	cdef public np.ndarray image, z_buffer, face_ids
+
+	def __cinit__(self, double sigma = 1):
+		self.thisptr = new _differentiable_renderer.IncrementalRenderer(sigma)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def render(self, scene):
+		cdef _SceneArrays arrays = _SceneArrays(scene)
+		self.image = np.empty((scene.height, scene.width, arrays.scene.nb_colors))
+		self.z_buffer = np.empty((scene.height, scene.width))
+		self.face_ids = np.empty((scene.height, scene.width), dtype = np.uint32)
+		self.thisptr.render(arrays.scene, <double*> self.image.data, <double*> self.z_buffer.data, <unsigned int*> self.face_ids.data)
+		return self.image, self.z_buffer, self.face_ids
+
+	def update(self, scene, changed_vertices):
+		cdef _SceneArrays arrays = _SceneArrays(scene)
+		cdef np.ndarray[int, ndim = 1, mode = "c"] changed_c = np.ascontiguousarray(np.asarray(changed_vertices).flatten(), dtype = np.int32)
+		self.thisptr.update(arrays.scene, changed_c.shape[0], <int*> changed_c.data)
+		return tuple(self.thisptr.dirty[i] for i in range(4))
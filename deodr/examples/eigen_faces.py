@@ -3,6 +3,7 @@
 import cv2
 
 from deodr.differentiable_renderer import Scene2D
+from deodr.differentiable_renderer_cython import LinearBasis
 
 import matplotlib.pyplot as plt
 
@@ -21,6 +22,7 @@ faces = sklearn.datasets.fetch_olivetti_faces()
 faces_pca = decomposition.PCA(n_components=150, whiten=True)
 faces_pca.fit(faces.data)
 plt.imshow(faces_pca.mean_.reshape(faces.images[0].shape), cmap=plt.cm.bone)
+texture_basis = LinearBasis(faces_pca.components_, faces_pca.mean_)
 
 # coefs = faces_pca.transform(faces.data)
 # print(faces)
@@ -119,7 +121,7 @@ rescale_factor = 10
 def fun(points_deformed, pca_coefs):
     ij = points_deformed * 64 - 0.5
     # face=faces_pca.inverse_transform(coefs[:,None])
-    face = (faces_pca.mean_ + pca_coefs.dot(faces_pca.components_)).reshape((64, 64))
+    face = texture_basis.evaluate(pca_coefs).reshape((64, 64))
     scene.ij = ij
     scene.texture = face[:, :, None]
     print("render")
@@ -172,7 +174,7 @@ def fun(points_deformed, pca_coefs):
     cv2.waitKey(1)
 
     # get gradient on pca coefs
-    coefs_grad = faces_pca.components_.dot(scene.texture_b.flatten())
+    coefs_grad = texture_basis.evaluate_backward(scene.texture_b)
     points_deformed_grad = scene.ij_b * 64
     print(np.max(np.abs(points_deformed_grad)))
     grads = {"points_deformed": points_deformed_grad, "pca_coefs": coefs_grad}
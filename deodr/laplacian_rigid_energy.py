@@ -5,38 +5,92 @@ import copy
 import scipy
 import scipy.sparse
 
+from . import differentiable_renderer_cython
+
 
 class LaplacianRigidEnergy:
     """Class that implements an as-rigi-as-possible energy based on the difference of laplacian with a reference shape."""
 
     def __init__(self, mesh, vertices, cregu):
-        self.cT = scipy.sparse.kron(
-            mesh.adjacencies.Laplacian.T * mesh.adjacencies.Laplacian,
-            scipy.sparse.eye(3),
-        ).tocsr()
+        # L^T L is stored once and applied to each coordinate, the 3 channels matrix cT
+        # kron(L^T L, eye(3)) is only built when accessed
+        self.LtL = mesh.adjacencies.laplacian_t_laplacian
+        self._native = None
         self.vertices_ref = copy.copy(vertices)
         self.mesh = mesh
         self.cregu = cregu
-        self.approx_hessian = self.cregu * self.cT
-        n_components, labels = scipy.sparse.csgraph.connected_components(
-            csgraph=self.mesh.adjacencies.adjacency_vertices,
-            directed=False,
-            return_labels=True,
-        )
-        if n_components > 1:
+        self._cT = None
+        if self.mesh.adjacencies.nb_connected_components > 1:
             raise (
                 BaseException(
                     "You have more than one connected component in your mesh."
                 )
             )
 
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state["_native"] = None
+        return state
+
+    @property
+    def cregu(self):
+        return self._cregu
+
+    @cregu.setter
+    def cregu(self, cregu):
+        # keep the native energy, that may be shared with a native fitter, in sync
+        self._cregu = cregu
+        self._approx_hessian = None
+        if self._native is not None:
+            self._native.cregu = cregu
+
+    @property
+    def vertices_ref(self):
+        return self._vertices_ref
+
+    @vertices_ref.setter
+    def vertices_ref(self, vertices_ref):
+        # the native energy keeps a copy, modifying the array in place does not update it
+        self._vertices_ref = vertices_ref
+        if self._native is not None:
+            self._native.set_vertices_ref(vertices_ref)
+
+    @property
+    def cT(self):
+        if self._cT is None:
+            self._cT = scipy.sparse.kron(self.LtL, scipy.sparse.eye(3)).tocsr()
+        return self._cT
+
+    @property
+    def approx_hessian(self):
+        if self._approx_hessian is None:
+            self._approx_hessian = self.cregu * self.cT
+        return self._approx_hessian
+
+    @property
+    def native(self):
+        """Native energy using a multithreaded sparse matrix product and caching the factorization of
+        the regularized hessian."""
+        if self._native is None:
+            self._native = differentiable_renderer_cython.LaplacianRigidEnergy(
+                self.LtL, self.vertices_ref, self.cregu
+            )
+        return self._native
+
+    def solve(self, rhs, regularization=1e-6):
+        """Solve (cregu * L^T L + regularization * I) x = rhs for each coordinate of rhs.
+
+        This allows preconditioned or Gauss-Newton steps on the vertices, the sparse factorization of
+        the regularized hessian is computed once and reused as long as cregu and the regularization
+        do not change.
+        """
+        return self.native.solve(rhs, regularization)
+
     def evaluate(
         self, vertices, return_grad=True, return_hessian=True, refresh_rotations=True
     ):
 
-        diff = (vertices - self.vertices_ref).flatten()
-        grad_vertices = self.cregu * (self.cT * diff).reshape((vertices.shape[0], 3))
-        energy = 0.5 * diff.dot(grad_vertices.flatten())
+        energy, grad_vertices = self.native.evaluate(vertices)
         if not (return_grad):
             assert not (return_hessian)
             return energy
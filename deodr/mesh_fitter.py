@@ -8,9 +8,163 @@ import scipy.sparse.linalg
 import scipy.spatial.transform.rotation
 
 from . import Camera, ColoredTriMesh, LaplacianRigidEnergy, Scene3D, TriMesh
+from . import differentiable_renderer_cython
 from .tools import normalize, normalize_backward, qrot, qrot_backward
 
 
+def run_native_fitter(fitter, nb_iterations, state_names, render_depth=False):
+    """Run nb_iterations iterations of the fitter update rule natively, starting from the
+    current state of the python fitter, copy the resulting state back into the python fitter
+    and return the energy of each iteration.
+
+    state_names maps the names of the native fitter variables to the python fitter attributes.
+    The native fitter is created on the first call and reused afterward.
+    """
+    if getattr(fitter, "native_fitter", None) is None:
+        mesh = fitter.mesh
+        topology = differentiable_renderer_cython.MeshTopology(
+            mesh.faces, mesh.nb_vertices, mesh.clockwise
+        )
+        fitter.native_pipeline = differentiable_renderer_cython.Scene3DPipeline(
+            topology, fitter.scene.sigma
+        )
+        fitter.native_fitter = differentiable_renderer_cython.MeshFitter(
+            fitter.native_pipeline, fitter.rigid_energy.native
+        )
+    native_fitter = fitter.native_fitter
+    pipeline = fitter.native_pipeline
+    assert (
+        fitter.coarse_to_fine.nb_levels == 1
+    ), "coarse to fine fitting is not supported by the native fitter"
+    assert (
+        getattr(fitter, "preconditioning_regularization", None) is None
+    ), "preconditioned steps are not supported by the native fitter"
+    native_fitter.set_parameters(
+        inertia=fitter.inertia,
+        damping=fitter.damping,
+        step_factor_vertices=fitter.step_factor_vertices,
+        step_max_vertices=fitter.step_max_vertices,
+        step_factor_quaternion=fitter.step_factor_quaternion,
+        step_max_quaternion=fitter.step_max_quaternion,
+        step_factor_translation=fitter.step_factor_translation,
+        step_max_translation=fitter.step_max_translation,
+    )
+    pipeline.set_camera(fitter.camera)
+    pipeline.set_background(fitter.scene.background)
+    if render_depth:
+        pipeline.set_render_depth(True, fitter.depthScale)
+        native_fitter.set_observation(
+            fitter.hand_image[:, :, None], fitter.scene.max_depth
+        )
+    else:
+        native_fitter.set_observation(fitter.hand_image)
+
+    native_fitter.set_state(
+        **{name: getattr(fitter, attribute) for name, attribute in state_names.items()}
+    )
+    energies, _, _ = native_fitter.run(nb_iterations)
+    state = native_fitter.get_state()
+    for name, attribute in state_names.items():
+        setattr(fitter, attribute, state[name])
+    fitter.iter += nb_iterations
+    return energies
+
+
+def downsample_camera(camera, factor):
+    """Return the camera seeing the image downsampled by blocks of factor x factor pixels.
+
+    Pixel centers are at integer coordinates, the center of the block of pixels
+    [factor * x, factor * x + factor - 1] is at factor * x + (factor - 1) / 2.
+    """
+    intrinsic = camera.intrinsic.astype(np.double)
+    intrinsic[:2] /= factor
+    intrinsic[:2, 2] -= 0.5 * (factor - 1) / factor
+    return Camera(
+        extrinsic=camera.extrinsic,
+        intrinsic=intrinsic,
+        distortion=camera.distortion,
+        height=camera.height // factor,
+        width=camera.width // factor,
+    )
+
+
+def downsample_image(image, factor):
+    """Average the image over blocks of factor x factor pixels, the last rows and columns
+    being discarded when the size is not a multiple of factor."""
+    height = image.shape[0] // factor
+    width = image.shape[1] // factor
+    image = image[: height * factor, : width * factor]
+    return image.reshape((height, factor, width, factor) + image.shape[2:]).mean(
+        axis=(1, 3)
+    )
+
+
+class CoarseToFineSchedule:
+    """Image pyramid and schedule of a coarse to fine fitting.
+
+    The fitting starts at the coarsest level, where the observation, the background and
+    the camera are downsampled by factor ** (nb_levels - 1), and moves to the next finer
+    level once the energy decreased by less than convergence_threshold (relative) over the
+    last min_iterations iterations, or after max_iterations iterations at that level.
+    The antialiasing sigma is kept in pixels of each level, which blurs the silhouettes
+    more in the coarse levels, and the data term is weighted by the number of full
+    resolution pixels in each pixel so that it stays balanced with the regularization.
+    The default single level fits at full resolution only.
+    """
+
+    def __init__(
+        self,
+        nb_levels=1,
+        factor=2,
+        min_iterations=10,
+        max_iterations=50,
+        convergence_threshold=0.01,
+    ):
+        assert nb_levels >= 1
+        self.nb_levels = nb_levels
+        self.factor = factor
+        self.min_iterations = min_iterations
+        self.max_iterations = max_iterations
+        self.convergence_threshold = convergence_threshold
+        self.levels = None
+
+    def build(self, camera, observation, background):
+        # the pyramid is built once for each observation
+        self.levels = [(camera, observation, background)]
+        for level in range(1, self.nb_levels):
+            factor = self.factor**level
+            self.levels.append(
+                (
+                    downsample_camera(camera, factor),
+                    downsample_image(observation, factor),
+                    downsample_image(background, factor),
+                )
+            )
+        self.level = self.nb_levels - 1
+        self.energies = []
+
+    def current(self):
+        """Return the camera, the observation and the background of the current level."""
+        return self.levels[self.level]
+
+    def pixel_weight(self):
+        return float(self.factor ** (2 * self.level))
+
+    def update(self, energy):
+        """Record the energy of an iteration and move to the next finer level when the
+        fitting converged at the current level."""
+        self.energies.append(energy)
+        if self.level == 0:
+            return
+        nb_iterations = len(self.energies)
+        converged = nb_iterations > self.min_iterations and (
+            self.energies[-self.min_iterations - 1] - energy
+        ) <= self.convergence_threshold * abs(self.energies[-self.min_iterations - 1])
+        if converged or nb_iterations >= self.max_iterations:
+            self.level -= 1
+            self.energies = []
+
+
 class MeshDepthFitter:
     """Class to fit a deformable mesh to a depth image."""
 
@@ -34,6 +188,9 @@ class MeshDepthFitter:
         self.step_max_quaternion = 0.1
         self.step_factor_translation = 0.00005
         self.step_max_translation = 0.1
+        # regularization of the rigid energy hessian used to precondition the vertices steps, it
+        # plays the role of 1 / step_factor_vertices, plain gradient steps when None
+        self.preconditioning_regularization = None
 
         self.mesh = TriMesh(
             faces, vertices=vertices
@@ -49,6 +206,7 @@ class MeshDepthFitter:
         self.Hfactorized = None
         self.Hpreconditioner = None
         self.set_mesh_transform_init(euler=euler_init, translation=translation_init)
+        self.coarse_to_fine = CoarseToFineSchedule()
 
         self.reset()
 
@@ -67,6 +225,7 @@ class MeshDepthFitter:
         self.speed_quaternion = np.zeros(4)
 
     def set_max_depth(self, max_depth):
+        self._reset_pyramid()
         self.scene.max_depth = max_depth
         self.scene.set_background(
             np.full((self.height, self.width, 1), max_depth, dtype=np.float)
@@ -79,6 +238,7 @@ class MeshDepthFitter:
         self.width = hand_image.shape[1]
         self.height = hand_image.shape[0]
         assert hand_image.ndim == 2
+        self._reset_pyramid()
         self.hand_image = hand_image
         if focal is None:
             focal = 2 * self.width
@@ -97,6 +257,28 @@ class MeshDepthFitter:
         )
         self.iter = 0
 
+    def set_coarse_to_fine(self, nb_levels, factor=2, **kwargs):
+        """Fit coarse to fine using an image pyramid with nb_levels levels, the other
+        arguments are passed to CoarseToFineSchedule."""
+        self._reset_pyramid()
+        self.coarse_to_fine = CoarseToFineSchedule(nb_levels, factor, **kwargs)
+
+    def _set_level(self):
+        # build the pyramid if needed and set the background of the current level
+        if self.coarse_to_fine.levels is None:
+            self.coarse_to_fine.build(
+                self.camera, self.hand_image, self.scene.background
+            )
+        camera, hand_image, background = self.coarse_to_fine.current()
+        self.scene.set_background(background)
+        return camera, hand_image
+
+    def _reset_pyramid(self):
+        # restore the full resolution background, the pyramid is rebuilt at the next step
+        if self.coarse_to_fine.levels is not None:
+            self.scene.set_background(self.coarse_to_fine.levels[0][2])
+            self.coarse_to_fine.levels = None
+
     def render(self):
         q_normalized = normalize(
             self.transform_quaternion
@@ -105,10 +287,11 @@ class MeshDepthFitter:
             qrot(q_normalized, self.vertices) + self.transform_translation
         )
         self.mesh.set_vertices(vertices_transformed)
+        camera, _ = self._set_level()
         self.depth_not_cliped = self.scene.render_depth(
-            self.camera,
-            width=self.width,
-            height=self.height,
+            camera,
+            width=camera.width,
+            height=camera.height,
             depth_scale=self.depthScale,
         )
         depth = np.clip(self.depth_not_cliped, 0, self.scene.max_depth)
@@ -133,24 +316,25 @@ class MeshDepthFitter:
     def step(self):
 
         self.vertices = self.vertices - np.mean(self.vertices, axis=0)[None, :]
+        _, hand_image = self._set_level()
+        pixel_weight = self.coarse_to_fine.pixel_weight()
         depth = self.render()
 
-        diff_image = np.sum((depth - self.hand_image[:, :, None]) ** 2, axis=2)
-        energy_data = np.sum(diff_image)
-        depth_b = 2 * (depth - self.hand_image[:, :, None])
+        diff_image = np.sum((depth - hand_image[:, :, None]) ** 2, axis=2)
+        energy_data = pixel_weight * np.sum(diff_image)
+        depth_b = 2 * pixel_weight * (depth - hand_image[:, :, None])
         self.render_backward(depth_b)
 
         self.vertices_b = self.vertices_b - np.mean(self.vertices_b, axis=0)[None, :]
         grad_data = self.vertices_b
         # update v
 
-        (
-            energy_rigid,
-            grad_rigidity,
-            approx_hessian_rigidity,
-        ) = self.rigid_energy.evaluate(self.vertices)
+        energy_rigid, grad_rigidity = self.rigid_energy.evaluate(
+            self.vertices, return_hessian=False
+        )
         energy = energy_data + energy_rigid
         print("Energy=%f : EData=%f E_rigid=%f" % (energy, energy_data, energy_rigid))
+        self.coarse_to_fine.update(energy)
 
         # update v
         grad = grad_data + grad_rigidity
@@ -160,9 +344,17 @@ class MeshDepthFitter:
 
         inertia = self.inertia
         # update vertices
-        step_vertices = mult_and_clamp(
-            -grad, self.step_factor_vertices, self.step_max_vertices
-        )
+        if self.preconditioning_regularization is None:
+            step_vertices = mult_and_clamp(
+                -grad, self.step_factor_vertices, self.step_max_vertices
+            )
+        else:
+            # Gauss-Newton step on the rigid energy using its factorized hessian
+            step_vertices = mult_and_clamp(
+                -self.rigid_energy.solve(grad, self.preconditioning_regularization),
+                1,
+                self.step_max_vertices,
+            )
         self.speed_vertices = (1 - self.damping) * (
             self.speed_vertices * self.inertia + (1 - self.inertia) * step_vertices
         )
@@ -194,6 +386,22 @@ class MeshDepthFitter:
         self.iter += 1
         return energy, depth[:, :, 0], diff_image
 
+    def steps_native(self, nb_iterations):
+        """Run nb_iterations iterations of step natively and return the energy of each iteration."""
+        return run_native_fitter(
+            self,
+            nb_iterations,
+            {
+                "vertices": "vertices",
+                "speed_vertices": "speed_vertices",
+                "quaternion": "transform_quaternion",
+                "speed_quaternion": "speed_quaternion",
+                "translation": "transform_translation",
+                "speed_translation": "speed_translation",
+            },
+            render_depth=True,
+        )
+
 
 class MeshRGBFitterWithPose:
     """Class to fit a deformable mesh to a color image."""
@@ -239,9 +447,11 @@ class MeshRGBFitterWithPose:
         self.Hfactorized = None
         self.Hpreconditioner = None
         self.set_mesh_transform_init(euler=euler_init, translation=translation_init)
+        self.coarse_to_fine = CoarseToFineSchedule()
         self.reset()
 
     def set_background_color(self, background_color):
+        self._reset_pyramid()
         self.scene.set_background(
             np.tile(background_color[None, None, :], (self.height, self.width, 1))
         )
@@ -272,6 +482,7 @@ class MeshRGBFitterWithPose:
         self.width = hand_image.shape[1]
         self.height = hand_image.shape[0]
         assert hand_image.ndim == 3
+        self._reset_pyramid()
         self.hand_image = hand_image
         if focal is None:
             focal = 2 * self.width
@@ -291,6 +502,28 @@ class MeshRGBFitterWithPose:
         )
         self.iter = 0
 
+    def set_coarse_to_fine(self, nb_levels, factor=2, **kwargs):
+        """Fit coarse to fine using an image pyramid with nb_levels levels, the other
+        arguments are passed to CoarseToFineSchedule."""
+        self._reset_pyramid()
+        self.coarse_to_fine = CoarseToFineSchedule(nb_levels, factor, **kwargs)
+
+    def _set_level(self):
+        # build the pyramid if needed and set the background of the current level
+        if self.coarse_to_fine.levels is None:
+            self.coarse_to_fine.build(
+                self.camera, self.hand_image, self.scene.background
+            )
+        camera, hand_image, background = self.coarse_to_fine.current()
+        self.scene.set_background(background)
+        return camera, hand_image
+
+    def _reset_pyramid(self):
+        # restore the full resolution background, the pyramid is rebuilt at the next step
+        if self.coarse_to_fine.levels is not None:
+            self.scene.set_background(self.coarse_to_fine.levels[0][2])
+            self.coarse_to_fine.levels = None
+
     def render(self):
         q_normalized = normalize(
             self.transform_quaternion
@@ -305,7 +538,8 @@ class MeshRGBFitterWithPose:
         self.mesh.set_vertices_colors(
             np.tile(self.hand_color, (self.mesh.nb_vertices, 1))
         )
-        image = self.scene.render(self.camera)
+        camera, _ = self._set_level()
+        image = self.scene.render(camera)
         return image
 
     def render_backward(self, image_b):
@@ -328,19 +562,20 @@ class MeshRGBFitterWithPose:
     def step(self):
         self.vertices = self.vertices - np.mean(self.vertices, axis=0)[None, :]
 
+        _, hand_image = self._set_level()
+        pixel_weight = self.coarse_to_fine.pixel_weight()
         image = self.render()
 
-        diff_image = np.sum((image - self.hand_image) ** 2, axis=2)
-        image_b = 2 * (image - self.hand_image)
-        energy_data = np.sum(diff_image)
+        diff_image = np.sum((image - hand_image) ** 2, axis=2)
+        image_b = 2 * pixel_weight * (image - hand_image)
+        energy_data = pixel_weight * np.sum(diff_image)
 
-        (
-            energy_rigid,
-            grad_rigidity,
-            approx_hessian_rigidity,
-        ) = self.rigid_energy.evaluate(self.vertices)
+        energy_rigid, grad_rigidity = self.rigid_energy.evaluate(
+            self.vertices, return_hessian=False
+        )
         energy = energy_data + energy_rigid
         print("Energy=%f : EData=%f E_rigid=%f" % (energy, energy_data, energy_rigid))
+        self.coarse_to_fine.update(energy)
 
         self.render_backward(image_b)
 
@@ -406,6 +641,27 @@ class MeshRGBFitterWithPose:
         self.iter += 1
         return energy, image, diff_image
 
+    def steps_native(self, nb_iterations):
+        """Run nb_iterations iterations of step natively and return the energy of each iteration."""
+        return run_native_fitter(
+            self,
+            nb_iterations,
+            {
+                "vertices": "vertices",
+                "speed_vertices": "speed_vertices",
+                "quaternion": "transform_quaternion",
+                "speed_quaternion": "speed_quaternion",
+                "translation": "transform_translation",
+                "speed_translation": "speed_translation",
+                "light_directional": "light_directional",
+                "speed_light_directional": "speed_light_directional",
+                "light_ambient": "light_ambient",
+                "speed_light_ambient": "speed_light_ambient",
+                "color": "hand_color",
+                "speed_color": "speed_hand_color",
+            },
+        )
+
 
 class MeshRGBFitterWithPoseMultiFrame:
     """Class to fit a deformable mesh to multiple color images."""
@@ -593,11 +849,9 @@ class MeshRGBFitterWithPoseMultiFrame:
             energy_datas[idframe] = coef_data * np.sum(diff_image[idframe])
             self.render_backward(image_b)
         energy_data = np.sum(energy_datas)
-        (
-            energy_rigid,
-            grad_rigidity,
-            approx_hessian_rigidity,
-        ) = self.rigid_energy.evaluate(self.vertices)
+        energy_rigid, grad_rigidity = self.rigid_energy.evaluate(
+            self.vertices, return_hessian=False
+        )
         energy = energy_data + energy_rigid
         print("Energy=%f : EData=%f E_rigid=%f" % (energy, energy_data, energy_rigid))
 
@@ -1,46 +1,62 @@
 #! /usr/bin/env python
-"""Function to oad wavefront OBJ files
+"""Function to load wavefront OBJ files
 
 See http://www.fileformat.info/format/wavefrontobj/.
-At the moment only v and f keywords are supported
+The v (with optional vertex colors), vt, vn and f keywords are supported, polygonal faces are
+triangulated. The parsing is done natively and the result can be cached in a binary file next to
+the OBJ file that is memory mapped on the next loads.
 """
 
-import numpy as np
+import os
 
+import numpy as np
 
-def read_obj(filename):
-
-    faces = []
-    vertices = []
-    fid = open(filename, "r")
-    node_counter = 0
-    while True:
-
-        line = fid.readline()
-        if line == "":
-            break
-        while line.endswith("\\"):
-            # Remove backslash and concatenate with next line
-            line = line[:-1] + fid.readline()
-        if line.startswith("v"):
-            coord = line.split()
-            coord.pop(0)
-            node_counter += 1
-            vertices.append(np.array([float(c) for c in coord]))
-
-        elif line.startswith("f "):
-            fields = line.split()
-            fields.pop(0)
-
-            # in some obj faces are defined as -70//-70 -69//-69 -62//-62
-            cleaned_fields = []
-            for f in fields:
-                f = int(f.split("/")[0]) - 1
-                if f < 0:
-                    f = node_counter + f
-                cleaned_fields.append(f)
-            faces.append(np.array(cleaned_fields))
-
-    faces = np.row_stack(faces)
-    vertices = np.row_stack(vertices)
-    return faces, vertices
+from . import differentiable_renderer_cython
+from .array_cache import load_arrays, save_arrays
+
+OBJ_CACHE_VERSION = 1
+
+
+def obj_cache_filename(filename):
+    return filename + ".deodr_cache"
+
+
+def load_obj(filename, cache=False):
+    """Load an OBJ file into a dictionary of arrays.
+
+    The dictionary contains vertices and faces and, when present in the file, vertices_colors, uv,
+    faces_uv, normals and faces_normals. Faces indices are zero based int32. With cache=True the
+    arrays are saved in a binary file next to the OBJ file and memory mapped on the next calls as long
+    as the size and modification time of the OBJ file do not change.
+    """
+    cache_filename = obj_cache_filename(filename)
+    stat = os.stat(filename)
+    metadata = {
+        "kind": "obj",
+        "version": OBJ_CACHE_VERSION,
+        "source_size": stat.st_size,
+        "source_mtime_ns": stat.st_mtime_ns,
+    }
+    if cache:
+        arrays = load_arrays(cache_filename, metadata)
+        if arrays is not None:
+            return arrays
+    arrays = differentiable_renderer_cython.read_obj(filename)
+    if cache:
+        try:
+            save_arrays(cache_filename, arrays, metadata)
+        except OSError:
+            pass  # read only location, the cache is only an optimization
+    return arrays
+
+
+def read_obj(filename, cache=False):
+    """Return the faces and the vertices of an OBJ file.
+
+    When the v lines contain colors they are appended to the vertices coordinates.
+    """
+    mesh = load_obj(filename, cache=cache)
+    vertices = mesh["vertices"]
+    if "vertices_colors" in mesh:
+        vertices = np.column_stack((vertices, mesh["vertices_colors"]))
+    return mesh["faces"], vertices
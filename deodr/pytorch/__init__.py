@@ -8,10 +8,15 @@ __all__ = [
     "TriMeshPytorch",
     "MeshRGBFitterWithPose",
     "MeshDepthFitter",
+    "render_2d_batch",
 ]
 
 
-from .differentiable_renderer_pytorch import CameraPytorch, Scene3DPytorch
+from .differentiable_renderer_pytorch import (
+    CameraPytorch,
+    Scene3DPytorch,
+    render_2d_batch,
+)
 from .laplacian_rigid_energy_pytorch import LaplacianRigidEnergyPytorch
 from .mesh_fitter_pytorch import MeshDepthFitter, MeshRGBFitterWithPose
 from .triangulated_mesh_pytorch import ColoredTriMeshPytorch, TriMeshPytorch
@@ -1,5 +1,7 @@
 """Pytorch interface to deodr."""
 
+import os
+
 import numpy as np
 
 import torch
@@ -43,7 +45,7 @@ class TorchDifferentiableRenderer2DFunc(torch.autograd.Function):
         scene.ij = ij.detach().numpy()  # should automatically detached according to
         # https://pytorch.org/docs/master/notes/extending.html
         scene.colors = colors.detach().numpy()
-        differentiable_renderer_cython.renderScene(scene, 1, image, z_buffer)
+        differentiable_renderer_cython.renderScene(scene, scene.sigma, image, z_buffer)
         ctx.save_for_backward(ij, colors)
         ctx.image = (
             image.copy()
@@ -61,17 +63,157 @@ class TorchDifferentiableRenderer2DFunc(torch.autograd.Function):
         scene.colors_b = np.zeros(scene.colors.shape)
         scene.texture_b = np.zeros(scene.texture.shape)
         differentiable_renderer_cython.renderSceneB(
-            scene, 1, ctx.image, ctx.z_buffer, image_b.numpy()
+            scene, scene.sigma, ctx.image, ctx.z_buffer, image_b.numpy()
         )
         return torch.as_tensor(scene.ij_b), torch.as_tensor(scene.colors_b), None
 
 
 TorchDifferentiableRender2D = TorchDifferentiableRenderer2DFunc.apply
 
+_torch_extension = None
+
+
+def load_torch_extension(verbose=False):
+    """Compile on first use and load the C++ torch extension rendering batches of 2D scenes."""
+    global _torch_extension
+    if _torch_extension is None:
+        from torch.utils.cpp_extension import load
+
+        _torch_extension = load(
+            name="deodr_differentiable_renderer_torch",
+            sources=[
+                os.path.join(
+                    os.path.dirname(__file__), "differentiable_renderer_torch.cpp"
+                )
+            ],
+            extra_cflags=["-O3"],
+            verbose=verbose,
+        )
+    return _torch_extension
+
+
+class TorchDifferentiableRendererBatch2DFunc(torch.autograd.Function):
+    """Batched 2D rendering function using the C++ torch extension.
+
+    ij is of size [B, V, 2], colors [B, V, C], depths and shade [B, V] and edgeflags [B, F, 3],
+    faces, faces_uv, uv, texture, textured and shaded are shared by the batch and background is
+    of size [H, W, C] or [B, H, W, C]. Tensors can be float32 or float64, the images are returned
+    in the dtype of colors and the gradients are computed with respect to ij and colors.
+    """
+
+    @staticmethod
+    def forward(
+        ctx,
+        ij,
+        colors,
+        depths,
+        shade,
+        edgeflags,
+        faces,
+        faces_uv,
+        uv,
+        texture,
+        background,
+        textured,
+        shaded,
+        sigma,
+        clockwise,
+        backface_culling,
+    ):
+        extension = load_torch_extension()
+        inputs = (
+            ij,
+            colors,
+            depths,
+            shade,
+            edgeflags,
+            faces,
+            faces_uv,
+            uv,
+            texture,
+            background,
+            textured,
+            shaded,
+        )
+        image, z_buffer, image_double = extension.render_forward(
+            *inputs, sigma, clockwise, backface_culling
+        )
+        ctx.save_for_backward(image_double, z_buffer, *inputs)
+        ctx.options = (sigma, clockwise, backface_culling)
+        ctx.mark_non_differentiable(z_buffer)
+        return image, z_buffer
+
+    @staticmethod
+    def backward(ctx, image_b, z_buffer_b):
+        extension = load_torch_extension()
+        image_double, z_buffer, *inputs = ctx.saved_tensors
+        ij_b, colors_b = extension.render_backward(
+            image_b, image_double, z_buffer, *inputs, *ctx.options
+        )
+        return (ij_b, colors_b) + (None,) * 13
+
+
+def render_2d_batch(
+    ij,
+    colors,
+    depths,
+    faces,
+    background,
+    edgeflags=None,
+    shade=None,
+    uv=None,
+    faces_uv=None,
+    texture=None,
+    sigma=1,
+    clockwise=False,
+    backface_culling=True,
+):
+    """Render a batch of 2D scenes sharing the same triangles using the C++ torch extension.
+
+    The edgeflags, of size [B, F, 3], flag the edges on the silhouette that get antialiased, none
+    by default. Without texture the faces are not textured and the shade is not used.
+    """
+    batch_size, nb_vertices = ij.shape[:2]
+    nb_faces = faces.shape[0]
+    dtype = colors.dtype
+    if edgeflags is None:
+        edgeflags = torch.zeros((batch_size, nb_faces, 3), dtype=torch.bool)
+    if shade is None:
+        shade = torch.zeros((batch_size, nb_vertices), dtype=dtype)
+    if texture is None:
+        # the renderer needs non empty buffers even when no face is textured
+        uv = torch.zeros((1, 2), dtype=dtype)
+        faces_uv = torch.zeros((nb_faces, 3), dtype=torch.int32)
+        texture = torch.zeros((1, 1, colors.shape[2]), dtype=dtype)
+        textured = torch.zeros(nb_faces, dtype=torch.bool)
+        shaded = torch.zeros(nb_faces, dtype=torch.bool)
+    else:
+        textured = torch.ones(nb_faces, dtype=torch.bool)
+        shaded = torch.ones(nb_faces, dtype=torch.bool)
+    return TorchDifferentiableRendererBatch2DFunc.apply(
+        ij,
+        colors,
+        depths,
+        shade,
+        edgeflags,
+        faces,
+        faces_uv,
+        uv,
+        texture,
+        background,
+        textured,
+        shaded,
+        float(sigma),
+        clockwise,
+        backface_culling,
+    )
+
 
 class Scene3DPytorch(Scene3D):
     """Pytorch implementation of deodr 3D scenes."""
 
+    native_rendering = False
+
     def __init__(self):
         super().__init__()
 
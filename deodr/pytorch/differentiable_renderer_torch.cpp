@@ -0,0 +1,291 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+
+// PyTorch extension operator rendering batches of 2D scenes and computing their adjoints.
+// Batched inputs are ij [B, V, 2], colors [B, V, C], depths [B, V], shade [B, V] and edgeflags [B, F, 3],
+// the topology, uv coordinates and texture are shared by the batch. float32 and float64 inputs are supported,
+// the renderer runs in double precision and each batch element is rendered on the intra-op thread pool.
+
+#include <torch/extension.h>
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <stdexcept>
+#include "../../C++/DifferentiableRenderer.h"
+
+using namespace std;
+
+struct BatchedScene {
+	// inputs converted once to contiguous double and uint32 buffers
+	torch::Tensor ij;
+	torch::Tensor colors;
+	torch::Tensor depths;
+	torch::Tensor shade;
+	torch::Tensor edgeflags;
+	torch::Tensor faces;
+	torch::Tensor faces_uv;
+	torch::Tensor uv;
+	torch::Tensor texture;
+	torch::Tensor background;
+	torch::Tensor textured;
+	torch::Tensor shaded;
+	int64_t batch_size;
+	bool background_batched;
+	int height;
+	int width;
+	int nb_colors;
+	bool clockwise;
+	bool backface_culling;
+};
+
+torch::Tensor to_double(const torch::Tensor& tensor)
+{
+	return tensor.to(torch::kDouble).contiguous();
+}
+
+torch::Tensor to_uint32(const torch::Tensor& tensor)
+{
+	// torch has no uint32 type, int32 has the same memory layout for valid indices
+	return tensor.to(torch::kInt).contiguous();
+}
+
+BatchedScene make_batched_scene(
+	const torch::Tensor& ij,
+	const torch::Tensor& colors,
+	const torch::Tensor& depths,
+	const torch::Tensor& shade,
+	const torch::Tensor& edgeflags,
+	const torch::Tensor& faces,
+	const torch::Tensor& faces_uv,
+	const torch::Tensor& uv,
+	const torch::Tensor& texture,
+	const torch::Tensor& background,
+	const torch::Tensor& textured,
+	const torch::Tensor& shaded,
+	bool clockwise,
+	bool backface_culling,
+	bool check_values)
+{
+	// the sizes are always checked, the values only when check_values is true as the backward pass
+	// receives the inputs already checked by the forward pass. The face indices are checked by the renderer
+	TORCH_CHECK(ij.dim() == 3 && ij.size(2) == 2, "ij should be of size [B, V, 2]");
+	int64_t batch_size = ij.size(0);
+	int64_t nb_vertices = ij.size(1);
+	TORCH_CHECK(colors.dim() == 3 && colors.size(0) == batch_size && colors.size(1) == nb_vertices, "colors should be of size [B, V, C]");
+	TORCH_CHECK(depths.dim() == 2 && depths.size(0) == batch_size && depths.size(1) == nb_vertices, "depths should be of size [B, V]");
+	TORCH_CHECK(shade.dim() == 2 && shade.size(0) == batch_size && shade.size(1) == nb_vertices, "shade should be of size [B, V]");
+	TORCH_CHECK(faces.dim() == 2 && faces.size(1) == 3, "faces should be of size [F, 3]");
+	int64_t nb_faces = faces.size(0);
+	TORCH_CHECK(faces_uv.dim() == 2 && faces_uv.size(0) == nb_faces && faces_uv.size(1) == 3, "faces_uv should be of size [F, 3]");
+	TORCH_CHECK(edgeflags.dim() == 3 && edgeflags.size(0) == batch_size && edgeflags.size(1) == nb_faces && edgeflags.size(2) == 3, "edgeflags should be of size [B, F, 3]");
+	TORCH_CHECK(textured.numel() == nb_faces && shaded.numel() == nb_faces, "textured and shaded should have one element per face");
+	TORCH_CHECK(uv.dim() == 2 && uv.size(1) == 2, "uv should be of size [U, 2]");
+	TORCH_CHECK(texture.dim() == 3, "texture should be of size [H, W, C]");
+	TORCH_CHECK(background.dim() == 3 || (background.dim() == 4 && background.size(0) == batch_size), "background should be of size [H, W, C] or [B, H, W, C]");
+	TORCH_CHECK(background.size(-1) == colors.size(2), "background and colors should have the same number of channels");
+
+	BatchedScene scene;
+	scene.ij = to_double(ij);
+	scene.colors = to_double(colors);
+	scene.depths = to_double(depths);
+	scene.shade = to_double(shade);
+	scene.edgeflags = edgeflags.to(torch::kBool).contiguous();
+	scene.faces = to_uint32(faces);
+	scene.faces_uv = to_uint32(faces_uv);
+	scene.uv = to_double(uv);
+	scene.texture = to_double(texture);
+	scene.background = to_double(background);
+	scene.textured = textured.to(torch::kBool).contiguous();
+	scene.shaded = shaded.to(torch::kBool).contiguous();
+	scene.batch_size = batch_size;
+	scene.background_batched = background.dim() == 4;
+	scene.height = (int)background.size(-3);
+	scene.width = (int)background.size(-2);
+	scene.nb_colors = (int)colors.size(2);
+	scene.clockwise = clockwise;
+	scene.backface_culling = backface_culling;
+	if (check_values && texture.size(2) != colors.size(2))
+	{
+		const bool* textured_ptr = scene.textured.data_ptr<bool>();
+		TORCH_CHECK(std::none_of(textured_ptr, textured_ptr + nb_faces, [](bool t) { return t; }), "texture and colors should have the same number of channels");
+	}
+	return scene;
+}
+
+Scene get_scene(BatchedScene& batched, int64_t b)
+{
+	// view on the b-th element of the batch, no copy
+	Scene scene;
+	int nb_vertices = (int)batched.ij.size(1);
+	int nb_pixels = batched.height * batched.width;
+	scene.faces = (unsigned int*)batched.faces.data_ptr<int>();
+	scene.faces_uv = (unsigned int*)batched.faces_uv.data_ptr<int>();
+	scene.depths = batched.depths.data_ptr<double>() + b * nb_vertices;
+	scene.uv = batched.uv.data_ptr<double>();
+	scene.ij = batched.ij.data_ptr<double>() + b * nb_vertices * 2;
+	scene.shade = batched.shade.data_ptr<double>() + b * nb_vertices;
+	scene.colors = batched.colors.data_ptr<double>() + b * nb_vertices * batched.nb_colors;
+	scene.edgeflags = batched.edgeflags.data_ptr<bool>() + b * batched.faces.size(0) * 3;
+	scene.textured = batched.textured.data_ptr<bool>();
+	scene.shaded = batched.shaded.data_ptr<bool>();
+	scene.nb_triangles = (int)batched.faces.size(0);
+	scene.nb_vertices = nb_vertices;
+	scene.clockwise = batched.clockwise;
+	scene.backface_culling = batched.backface_culling;
+	scene.nb_uv = (int)batched.uv.size(0);
+	scene.height = batched.height;
+	scene.width = batched.width;
+	scene.nb_colors = batched.nb_colors;
+	scene.texture = batched.texture.data_ptr<double>();
+	scene.texture_height = (int)batched.texture.size(0);
+	scene.texture_width = (int)batched.texture.size(1);
+	scene.background = batched.background.data_ptr<double>() + (batched.background_batched ? b * nb_pixels * batched.nb_colors : 0);
+	scene.uv_b = NULL;
+	scene.ij_b = NULL;
+	scene.shade_b = NULL;
+	scene.colors_b = NULL;
+	scene.texture_b = NULL;
+	return scene;
+}
+
+vector<torch::Tensor> render_forward(
+	torch::Tensor ij,
+	torch::Tensor colors,
+	torch::Tensor depths,
+	torch::Tensor shade,
+	torch::Tensor edgeflags,
+	torch::Tensor faces,
+	torch::Tensor faces_uv,
+	torch::Tensor uv,
+	torch::Tensor texture,
+	torch::Tensor background,
+	torch::Tensor textured,
+	torch::Tensor shaded,
+	double sigma,
+	bool clockwise,
+	bool backface_culling)
+{
+	// returns the image [B, H, W, C] in the dtype of colors and the z_buffer [B, H, W] in double
+	// precision, the double precision image is also returned as it is needed by the backward pass
+	BatchedScene batched = make_batched_scene(ij, colors, depths, shade, edgeflags, faces, faces_uv, uv, texture, background, textured, shaded, clockwise, backface_culling, true);
+	auto options = torch::TensorOptions().dtype(torch::kDouble);
+	torch::Tensor image = torch::empty({ batched.batch_size, batched.height, batched.width, batched.nb_colors }, options);
+	torch::Tensor z_buffer = torch::empty({ batched.batch_size, batched.height, batched.width }, options);
+	int64_t image_size = batched.height * batched.width * batched.nb_colors;
+	int64_t z_buffer_size = batched.height * batched.width;
+	double* image_ptr = image.data_ptr<double>();
+	double* z_buffer_ptr = z_buffer.data_ptr<double>();
+	at::parallel_for(0, batched.batch_size, 1, [&](int64_t begin, int64_t end)
+	{
+		for (int64_t b = begin; b < end; b++)
+		{
+			Scene scene = get_scene(batched, b);
+			try
+			{
+				renderScene(scene, image_ptr + b * image_size, z_buffer_ptr + b * z_buffer_size, sigma);
+			}
+			catch (const char* message)
+			{
+				throw std::runtime_error(message);
+			}
+		}
+	});
+	// for float64 the image and the double precision image are the same tensor
+	return { image.to(colors.scalar_type()), z_buffer, image };
+}
+
+vector<torch::Tensor> render_backward(
+	torch::Tensor image_b,
+	torch::Tensor image,
+	torch::Tensor z_buffer,
+	torch::Tensor ij,
+	torch::Tensor colors,
+	torch::Tensor depths,
+	torch::Tensor shade,
+	torch::Tensor edgeflags,
+	torch::Tensor faces,
+	torch::Tensor faces_uv,
+	torch::Tensor uv,
+	torch::Tensor texture,
+	torch::Tensor background,
+	torch::Tensor textured,
+	torch::Tensor shaded,
+	double sigma,
+	bool clockwise,
+	bool backface_culling)
+{
+	// returns ij_b [B, V, 2] and colors_b [B, V, C] in the dtype of ij and colors, image is the double
+	// precision image returned by render_forward, the rounding errors of a float32 image would be amplified
+	// by the removal of the antialiasing
+	BatchedScene batched = make_batched_scene(ij, colors, depths, shade, edgeflags, faces, faces_uv, uv, texture, background, textured, shaded, clockwise, backface_culling, false);
+	TORCH_CHECK(image.scalar_type() == torch::kDouble && image.dim() == 4 && image.size(0) == batched.batch_size, "image should be the double precision image returned by render_forward");
+	TORCH_CHECK(image_b.sizes() == image.sizes(), "image_b should have the same size as the image");
+	// renderScene_B modifies the image in place while removing the antialiasing, always work on a copy
+	torch::Tensor image_work = image.clone();
+	torch::Tensor z_buffer_c = to_double(z_buffer);
+	torch::Tensor image_b_c = to_double(image_b);
+	torch::Tensor ij_b = torch::zeros_like(batched.ij);
+	torch::Tensor colors_b = torch::zeros_like(batched.colors);
+	torch::Tensor shade_b = torch::zeros_like(batched.shade);
+	int64_t image_size = batched.height * batched.width * batched.nb_colors;
+	int64_t z_buffer_size = batched.height * batched.width;
+	int64_t nb_vertices = batched.ij.size(1);
+	at::parallel_for(0, batched.batch_size, 1, [&](int64_t begin, int64_t end)
+	{
+		// the adjoints of the shared uv and texture are not returned, they are accumulated in
+		// scratch buffers allocated once per thread whose values are discarded
+		vector<double> uv_b(batched.uv.numel());
+		vector<double> texture_b(batched.texture.numel());
+		for (int64_t b = begin; b < end; b++)
+		{
+			Scene scene = get_scene(batched, b);
+			scene.ij_b = ij_b.data_ptr<double>() + b * nb_vertices * 2;
+			scene.colors_b = colors_b.data_ptr<double>() + b * nb_vertices * batched.nb_colors;
+			scene.shade_b = shade_b.data_ptr<double>() + b * nb_vertices;
+			scene.uv_b = uv_b.data();
+			scene.texture_b = texture_b.data();
+			try
+			{
+				renderScene_B(scene, image_work.data_ptr<double>() + b * image_size, z_buffer_c.data_ptr<double>() + b * z_buffer_size, image_b_c.data_ptr<double>() + b * image_size, sigma);
+			}
+			catch (const char* message)
+			{
+				throw std::runtime_error(message);
+			}
+		}
+	});
+	return { ij_b.to(ij.scalar_type()), colors_b.to(colors.scalar_type()) };
+}
+
+PYBIND11_MODULE(TORCH_EXTENSION_NAME, m)
+{
+	m.def("render_forward", &render_forward, "batched forward rendering of 2D scenes");
+	m.def("render_backward", &render_backward, "batched adjoint of the rendering of 2D scenes");
+}
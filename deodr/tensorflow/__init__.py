@@ -8,9 +8,14 @@ __all__ = [
     "TriMeshTensorflow",
     "MeshRGBFitterWithPose",
     "MeshDepthFitter",
+    "render_2d_batch",
 ]
 
-from .differentiable_renderer_tensorflow import CameraTensorflow, Scene3DTensorflow
+from .differentiable_renderer_tensorflow import (
+    CameraTensorflow,
+    Scene3DTensorflow,
+    render_2d_batch,
+)
 from .laplacian_rigid_energy_tensorflow import LaplacianRigidEnergyTensorflow
 from .mesh_fitter_tensorflow import MeshDepthFitter, MeshRGBFitterWithPose
 from .triangulated_mesh_tensorflow import ColoredTriMeshTensorflow, TriMeshTensorflow
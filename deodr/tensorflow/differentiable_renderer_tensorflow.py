@@ -1,5 +1,9 @@
 """Tensorflow interface to deodr."""
 
+import os
+import subprocess
+import tempfile
+
 import numpy as np
 
 import tensorflow as tf
@@ -54,7 +58,7 @@ def TensorflowDifferentiableRender2D(ij, colors, scene):
         # https://pytorch.org/docs/master/notes/extending.html
         scene.colors = np.array(colors)
         scene.depths = np.array(scene.depths)
-        differentiable_renderer_cython.renderScene(scene, 1, image, z_buffer)
+        differentiable_renderer_cython.renderScene(scene, scene.sigma, image, z_buffer)
 
         def backward(image_b):
             scene.uv_b = np.zeros(scene.uv.shape)
@@ -68,7 +72,7 @@ def TensorflowDifferentiableRender2D(ij, colors, scene):
             # the forward pass (the c++ backpropagation undo antialiasing), could be
             # optional if we don't care about getting aliased images
             differentiable_renderer_cython.renderSceneB(
-                scene, 1, image_copy, z_buffer, image_b.numpy()
+                scene, scene.sigma, image_copy, z_buffer, image_b.numpy()
             )
             return tf.constant(scene.ij_b), tf.constant(scene.colors_b)
 
@@ -77,9 +81,119 @@ def TensorflowDifferentiableRender2D(ij, colors, scene):
     return forward(ij, colors)
 
 
+_tensorflow_op = None
+
+
+def load_tensorflow_op(build_dir=None):
+    """Compile on first use and load the DeodrRender2D tensorflow custom op and its gradient op."""
+    global _tensorflow_op
+    if _tensorflow_op is None:
+        source = os.path.join(
+            os.path.dirname(__file__), "differentiable_renderer_tensorflow_op.cpp"
+        )
+        if build_dir is None:
+            build_dir = os.path.join(tempfile.gettempdir(), "deodr_tensorflow_op")
+        os.makedirs(build_dir, exist_ok=True)
+        library = os.path.join(build_dir, "deodr_tensorflow_op.so")
+        if not os.path.isfile(library) or os.path.getmtime(library) < os.path.getmtime(
+            source
+        ):
+            # the c++ standard is given by the tensorflow compile flags
+            subprocess.check_call(
+                ["g++", "-shared", "-fPIC", "-O3", source, "-o", library]
+                + tf.sysconfig.get_compile_flags()
+                + tf.sysconfig.get_link_flags()
+            )
+        _tensorflow_op = tf.load_op_library(library)
+
+        @tf.RegisterGradient("DeodrRender2D")
+        def _render_2d_grad(op, image_b, z_buffer_b, image_double_b):
+            ij_b, colors_b = _tensorflow_op.deodr_render2d_grad(
+                image_b,
+                op.outputs[2],
+                op.outputs[1],
+                *op.inputs,
+                sigma=op.get_attr("sigma"),
+                clockwise=op.get_attr("clockwise"),
+                backface_culling=op.get_attr("backface_culling"),
+            )
+            return [ij_b, colors_b] + [None] * 10
+
+    return _tensorflow_op
+
+
+def render_2d_batch(
+    ij,
+    colors,
+    depths,
+    faces,
+    background,
+    edgeflags=None,
+    shade=None,
+    uv=None,
+    faces_uv=None,
+    texture=None,
+    sigma=1,
+    clockwise=False,
+    backface_culling=True,
+):
+    """Render a batch of 2D scenes sharing the same triangles using the tensorflow custom op.
+
+    ij is of size [B, V, 2], colors [B, V, C], depths [B, V] and background [H, W, C] or
+    [B, H, W, C]. The op can be used in graph mode and inside tf.function, the batch is sharded
+    across the tensorflow CPU thread pool and gradients are defined with respect to ij and colors.
+    Returns the image [B, H, W, C] and the z_buffer [B, H, W].
+    """
+    op = load_tensorflow_op()
+    ij = tf.convert_to_tensor(ij)
+    dtype = ij.dtype
+    colors = tf.convert_to_tensor(colors, dtype=dtype)
+    depths = tf.convert_to_tensor(depths, dtype=dtype)
+    batch_size = tf.shape(ij)[0]
+    nb_vertices = tf.shape(ij)[1]
+    nb_faces = faces.shape[0]
+    if edgeflags is None:
+        edgeflags = tf.zeros((batch_size, nb_faces, 3), dtype=tf.bool)
+    if shade is None:
+        shade = tf.zeros((batch_size, nb_vertices), dtype=dtype)
+    background = tf.convert_to_tensor(background, dtype=dtype)
+    if len(background.shape) == 3:
+        background = tf.tile(background[None], (batch_size, 1, 1, 1))
+    if texture is None:
+        # the renderer needs non empty buffers even when no face is textured
+        uv = tf.zeros((1, 2), dtype=dtype)
+        faces_uv = tf.zeros((nb_faces, 3), dtype=tf.int32)
+        texture = tf.zeros((1, 1, colors.shape[2]), dtype=dtype)
+        textured = tf.zeros(nb_faces, dtype=tf.bool)
+        shaded = tf.zeros(nb_faces, dtype=tf.bool)
+    else:
+        textured = tf.ones(nb_faces, dtype=tf.bool)
+        shaded = tf.ones(nb_faces, dtype=tf.bool)
+    image, z_buffer, _ = op.deodr_render2d(
+        ij,
+        colors,
+        depths,
+        tf.convert_to_tensor(shade, dtype=dtype),
+        edgeflags,
+        tf.convert_to_tensor(faces, dtype=tf.int32),
+        tf.convert_to_tensor(faces_uv, dtype=tf.int32),
+        tf.convert_to_tensor(uv, dtype=dtype),
+        tf.convert_to_tensor(texture, dtype=dtype),
+        background,
+        textured,
+        shaded,
+        sigma=float(sigma),
+        clockwise=clockwise,
+        backface_culling=backface_culling,
+    )
+    return image, z_buffer
+
+
 class Scene3DTensorflow(Scene3D):
     """Tensorflow implementation of deodr 3D scenes."""
 
+    native_rendering = False
+
     def __init__(self):
         super().__init__()
 
@@ -0,0 +1,426 @@
+/* License FreeBSD:
+
+	Copyright (c) 2016  Martin de La Gorce
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	The views and conclusions contained in the software and documentation are those
+	of the authors and should not be interpreted as representing official policies,
+	either expressed or implied, of the FreeBSD Project.
+
+*/
+
+// TensorFlow custom operators rendering batches of 2D scenes (DeodrRender2D) and computing their adjoints
+// (DeodrRender2DGrad). Batched inputs are ij [B, V, 2], colors [B, V, C], depths [B, V], shade [B, V],
+// edgeflags [B, F, 3] and background [B, H, W, C], the topology, uv coordinates and texture are shared by the
+// batch. The renderer runs in double precision and the batch is sharded across the TensorFlow CPU thread pool.
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+#include "../../C++/DifferentiableRenderer.h"
+
+using namespace tensorflow;
+using namespace std;
+
+REGISTER_OP("DeodrRender2D")
+	.Attr("T: {float, double}")
+	.Attr("sigma: float")
+	.Attr("clockwise: bool")
+	.Attr("backface_culling: bool")
+	.Input("ij: T")
+	.Input("colors: T")
+	.Input("depths: T")
+	.Input("shade: T")
+	.Input("edgeflags: bool")
+	.Input("faces: int32")
+	.Input("faces_uv: int32")
+	.Input("uv: T")
+	.Input("texture: T")
+	.Input("background: T")
+	.Input("textured: bool")
+	.Input("shaded: bool")
+	.Output("image: T")
+	.Output("z_buffer: double")
+	.Output("image_double: double")
+	.SetShapeFn([](shape_inference::InferenceContext* c)
+	{
+		shape_inference::ShapeHandle background;
+		TF_RETURN_IF_ERROR(c->WithRank(c->input(9), 4, &background));
+		c->set_output(0, background);
+		c->set_output(1, c->MakeShape({ c->Dim(background, 0), c->Dim(background, 1), c->Dim(background, 2) }));
+		c->set_output(2, background);
+		return OkStatus();
+	});
+
+REGISTER_OP("DeodrRender2DGrad")
+	.Attr("T: {float, double}")
+	.Attr("sigma: float")
+	.Attr("clockwise: bool")
+	.Attr("backface_culling: bool")
+	.Input("image_b: T")
+	.Input("image_double: double")
+	.Input("z_buffer: double")
+	.Input("ij: T")
+	.Input("colors: T")
+	.Input("depths: T")
+	.Input("shade: T")
+	.Input("edgeflags: bool")
+	.Input("faces: int32")
+	.Input("faces_uv: int32")
+	.Input("uv: T")
+	.Input("texture: T")
+	.Input("background: T")
+	.Input("textured: bool")
+	.Input("shaded: bool")
+	.Output("ij_b: T")
+	.Output("colors_b: T")
+	.SetShapeFn([](shape_inference::InferenceContext* c)
+	{
+		c->set_output(0, c->input(3));
+		c->set_output(1, c->input(4));
+		return OkStatus();
+	});
+
+template <typename T>
+const double* input_as_double(const Tensor& tensor, vector<double>& buffer)
+{
+	// float tensors are converted into buffer, double tensors are read without copy
+	auto flat = tensor.flat<T>();
+	buffer.assign(flat.data(), flat.data() + flat.size());
+	return &buffer[0];
+}
+
+template <>
+const double* input_as_double<double>(const Tensor& tensor, vector<double>&)
+{
+	return tensor.flat<double>().data();
+}
+
+template <typename T>
+double* output_as_double(Tensor* tensor, vector<double>& buffer)
+{
+	// zero initialized buffer of the size of the output, copied into float tensors by copy_from_double
+	// while double tensors are written in place
+	buffer.assign(tensor->NumElements(), 0.0);
+	return &buffer[0];
+}
+
+template <>
+double* output_as_double<double>(Tensor* tensor, vector<double>&)
+{
+	auto flat = tensor->flat<double>();
+	std::fill(flat.data(), flat.data() + flat.size(), 0.0);
+	return flat.data();
+}
+
+template <typename T>
+void copy_from_double(const vector<double>& buffer, Tensor* tensor)
+{
+	auto flat = tensor->flat<T>();
+	for (int64 k = 0; k < flat.size(); k++)
+		flat(k) = (T)buffer[k];
+}
+
+template <>
+void copy_from_double<double>(const vector<double>&, Tensor*)
+{
+}
+
+template <typename T>
+class BatchedScene {
+	// views on the input buffers, the float inputs are converted once to double and the faces to uint32,
+	// get_scene returns a view on one batch element
+public:
+	const double *ij, *colors, *depths, *shade, *uv, *texture, *background;
+	const bool *edgeflags, *textured, *shaded;
+	vector<unsigned int> faces, faces_uv;
+	int64 batch_size, uv_size, texture_size;
+	int nb_vertices, nb_faces, nb_colors, nb_uv, height, width, texture_height, texture_width;
+	bool clockwise, backface_culling;
+
+	Status load(OpKernelContext* context, int first_input, bool clockwise, bool backface_culling)
+	{
+		const Tensor& ij_t = context->input(first_input);
+		const Tensor& colors_t = context->input(first_input + 1);
+		const Tensor& depths_t = context->input(first_input + 2);
+		const Tensor& shade_t = context->input(first_input + 3);
+		const Tensor& edgeflags_t = context->input(first_input + 4);
+		const Tensor& faces_t = context->input(first_input + 5);
+		const Tensor& faces_uv_t = context->input(first_input + 6);
+		const Tensor& uv_t = context->input(first_input + 7);
+		const Tensor& texture_t = context->input(first_input + 8);
+		const Tensor& background_t = context->input(first_input + 9);
+		const Tensor& textured_t = context->input(first_input + 10);
+		const Tensor& shaded_t = context->input(first_input + 11);
+		if (ij_t.dims() != 3 || ij_t.dim_size(2) != 2)
+			return errors::InvalidArgument("ij should be of size [B, V, 2]");
+		batch_size = ij_t.dim_size(0);
+		nb_vertices = (int)ij_t.dim_size(1);
+		if (colors_t.dims() != 3 || colors_t.dim_size(0) != batch_size || colors_t.dim_size(1) != nb_vertices)
+			return errors::InvalidArgument("colors should be of size [B, V, C]");
+		nb_colors = (int)colors_t.dim_size(2);
+		if (depths_t.dims() != 2 || depths_t.dim_size(0) != batch_size || depths_t.dim_size(1) != nb_vertices)
+			return errors::InvalidArgument("depths should be of size [B, V]");
+		if (shade_t.dims() != 2 || shade_t.dim_size(0) != batch_size || shade_t.dim_size(1) != nb_vertices)
+			return errors::InvalidArgument("shade should be of size [B, V]");
+		if (faces_t.dims() != 2 || faces_t.dim_size(1) != 3)
+			return errors::InvalidArgument("faces should be of size [F, 3]");
+		nb_faces = (int)faces_t.dim_size(0);
+		if (faces_uv_t.dims() != 2 || faces_uv_t.dim_size(0) != nb_faces || faces_uv_t.dim_size(1) != 3)
+			return errors::InvalidArgument("faces_uv should be of size [F, 3]");
+		if (edgeflags_t.dims() != 3 || edgeflags_t.dim_size(0) != batch_size || edgeflags_t.dim_size(1) != nb_faces || edgeflags_t.dim_size(2) != 3)
+			return errors::InvalidArgument("edgeflags should be of size [B, F, 3]");
+		if (textured_t.NumElements() != nb_faces || shaded_t.NumElements() != nb_faces)
+			return errors::InvalidArgument("textured and shaded should have one element per face");
+		if (uv_t.dims() != 2 || uv_t.dim_size(1) != 2 || uv_t.dim_size(0) == 0)
+			return errors::InvalidArgument("uv should be of size [U, 2] with U > 0");
+		nb_uv = (int)uv_t.dim_size(0);
+		if (texture_t.dims() != 3 || texture_t.NumElements() == 0)
+			return errors::InvalidArgument("texture should be a non empty array of size [H, W, C]");
+		texture_height = (int)texture_t.dim_size(0);
+		texture_width = (int)texture_t.dim_size(1);
+		if (background_t.dims() != 4 || background_t.dim_size(0) != batch_size || background_t.dim_size(3) != nb_colors)
+			return errors::InvalidArgument("background should be of size [B, H, W, C]");
+		height = (int)background_t.dim_size(1);
+		width = (int)background_t.dim_size(2);
+
+		auto faces_flat = faces_t.flat<int32>();
+		auto faces_uv_flat = faces_uv_t.flat<int32>();
+		faces.resize(faces_flat.size());
+		faces_uv.resize(faces_flat.size());
+		for (int64 k = 0; k < faces_flat.size(); k++)
+		{
+			if (faces_flat(k) < 0 || faces_flat(k) >= nb_vertices)
+				return errors::InvalidArgument("faces contain invalid vertex indices");
+			if (faces_uv_flat(k) < 0 || faces_uv_flat(k) >= nb_uv)
+				return errors::InvalidArgument("faces_uv contain invalid uv indices");
+			faces[k] = (unsigned int)faces_flat(k);
+			faces_uv[k] = (unsigned int)faces_uv_flat(k);
+		}
+		ij = input_as_double<T>(ij_t, ij_buffer);
+		colors = input_as_double<T>(colors_t, colors_buffer);
+		depths = input_as_double<T>(depths_t, depths_buffer);
+		shade = input_as_double<T>(shade_t, shade_buffer);
+		uv = input_as_double<T>(uv_t, uv_buffer);
+		texture = input_as_double<T>(texture_t, texture_buffer);
+		background = input_as_double<T>(background_t, background_buffer);
+		uv_size = uv_t.NumElements();
+		texture_size = texture_t.NumElements();
+		edgeflags = edgeflags_t.flat<bool>().data();
+		textured = textured_t.flat<bool>().data();
+		shaded = shaded_t.flat<bool>().data();
+		this->clockwise = clockwise;
+		this->backface_culling = backface_culling;
+		return OkStatus();
+	}
+
+	Scene get_scene(int64 b)
+	{
+		Scene scene;
+		scene.faces = &faces[0];
+		scene.faces_uv = &faces_uv[0];
+		// the renderer does not modify its inputs
+		scene.depths = const_cast<double*>(depths + b * nb_vertices);
+		scene.uv = const_cast<double*>(uv);
+		scene.ij = const_cast<double*>(ij + b * nb_vertices * 2);
+		scene.shade = const_cast<double*>(shade + b * nb_vertices);
+		scene.colors = const_cast<double*>(colors + b * nb_vertices * nb_colors);
+		scene.edgeflags = const_cast<bool*>(edgeflags + b * nb_faces * 3);
+		scene.textured = const_cast<bool*>(textured);
+		scene.shaded = const_cast<bool*>(shaded);
+		scene.nb_triangles = nb_faces;
+		scene.nb_vertices = nb_vertices;
+		scene.clockwise = clockwise;
+		scene.backface_culling = backface_culling;
+		scene.nb_uv = nb_uv;
+		scene.height = height;
+		scene.width = width;
+		scene.nb_colors = nb_colors;
+		scene.texture = const_cast<double*>(texture);
+		scene.texture_height = texture_height;
+		scene.texture_width = texture_width;
+		scene.background = const_cast<double*>(background + b * height * width * nb_colors);
+		scene.uv_b = NULL;
+		scene.ij_b = NULL;
+		scene.shade_b = NULL;
+		scene.colors_b = NULL;
+		scene.texture_b = NULL;
+		return scene;
+	}
+
+private:
+	vector<double> ij_buffer, colors_buffer, depths_buffer, shade_buffer, uv_buffer, texture_buffer, background_buffer;
+};
+
+template <typename T>
+class DeodrRender2DOp : public OpKernel {
+public:
+	explicit DeodrRender2DOp(OpKernelConstruction* context) : OpKernel(context)
+	{
+		OP_REQUIRES_OK(context, context->GetAttr("sigma", &sigma));
+		OP_REQUIRES_OK(context, context->GetAttr("clockwise", &clockwise));
+		OP_REQUIRES_OK(context, context->GetAttr("backface_culling", &backface_culling));
+	}
+
+	void Compute(OpKernelContext* context) override
+	{
+		BatchedScene<T> batched;
+		OP_REQUIRES_OK(context, batched.load(context, 0, clockwise, backface_culling));
+		TensorShape image_shape({ batched.batch_size, batched.height, batched.width, batched.nb_colors });
+		TensorShape z_buffer_shape({ batched.batch_size, batched.height, batched.width });
+		Tensor* z_buffer = NULL;
+		Tensor* image_double = NULL;
+		OP_REQUIRES_OK(context, context->allocate_output(1, z_buffer_shape, &z_buffer));
+		OP_REQUIRES_OK(context, context->allocate_output(2, image_shape, &image_double));
+		double* image_ptr = image_double->flat<double>().data();
+		double* z_buffer_ptr = z_buffer->flat<double>().data();
+		int64 image_size = (int64)batched.height * batched.width * batched.nb_colors;
+		int64 z_buffer_size = (int64)batched.height * batched.width;
+		vector<string> errors_batch(batched.batch_size);
+		auto work = [&](int64 begin, int64 end)
+		{
+			for (int64 b = begin; b < end; b++)
+			{
+				Scene scene = batched.get_scene(b);
+				try
+				{
+					renderScene(scene, image_ptr + b * image_size, z_buffer_ptr + b * z_buffer_size, sigma);
+				}
+				catch (const char* message)
+				{
+					errors_batch[b] = message;
+				}
+			}
+		};
+		auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+		Shard(worker_threads->num_threads, worker_threads->workers, batched.batch_size, image_size * 100, work);
+		for (int64 b = 0; b < batched.batch_size; b++)
+			OP_REQUIRES(context, errors_batch[b].empty(), errors::InvalidArgument(errors_batch[b]));
+		if (std::is_same<T, double>::value)
+		{
+			// the image shares the buffer of the double precision image
+			context->set_output(0, *image_double);
+			return;
+		}
+		Tensor* image = NULL;
+		OP_REQUIRES_OK(context, context->allocate_output(0, image_shape, &image));
+		auto image_flat = image->flat<T>();
+		for (int64 k = 0; k < image_flat.size(); k++)
+			image_flat(k) = (T)image_ptr[k];
+	}
+
+private:
+	float sigma;
+	bool clockwise;
+	bool backface_culling;
+};
+
+template <typename T>
+class DeodrRender2DGradOp : public OpKernel {
+public:
+	explicit DeodrRender2DGradOp(OpKernelConstruction* context) : OpKernel(context)
+	{
+		OP_REQUIRES_OK(context, context->GetAttr("sigma", &sigma));
+		OP_REQUIRES_OK(context, context->GetAttr("clockwise", &clockwise));
+		OP_REQUIRES_OK(context, context->GetAttr("backface_culling", &backface_culling));
+	}
+
+	void Compute(OpKernelContext* context) override
+	{
+		BatchedScene<T> batched;
+		OP_REQUIRES_OK(context, batched.load(context, 3, clockwise, backface_culling));
+		const Tensor& image_b_t = context->input(0);
+		const Tensor& image_double_t = context->input(1);
+		const Tensor& z_buffer_t = context->input(2);
+		TensorShape image_shape({ batched.batch_size, batched.height, batched.width, batched.nb_colors });
+		OP_REQUIRES(context, image_b_t.shape() == image_shape && image_double_t.shape() == image_shape, errors::InvalidArgument("image_b and image_double should be of size [B, H, W, C]"));
+		OP_REQUIRES(context, z_buffer_t.NumElements() == (int64)batched.batch_size * batched.height * batched.width, errors::InvalidArgument("z_buffer should be of size [B, H, W]"));
+
+		Tensor* ij_b_t = NULL;
+		Tensor* colors_b_t = NULL;
+		OP_REQUIRES_OK(context, context->allocate_output(0, context->input(3).shape(), &ij_b_t));
+		OP_REQUIRES_OK(context, context->allocate_output(1, context->input(4).shape(), &colors_b_t));
+		vector<double> ij_b_buffer, colors_b_buffer;
+		double* ij_b = output_as_double<T>(ij_b_t, ij_b_buffer);
+		double* colors_b = output_as_double<T>(colors_b_t, colors_b_buffer);
+		const double* image_double = image_double_t.flat<double>().data();
+		const double* z_buffer = z_buffer_t.flat<double>().data();
+		auto image_b_flat = image_b_t.flat<T>();
+		int64 image_size = (int64)batched.height * batched.width * batched.nb_colors;
+		int64 z_buffer_size = (int64)batched.height * batched.width;
+		vector<string> errors_batch(batched.batch_size);
+		auto work = [&](int64 begin, int64 end)
+		{
+			// renderScene_B modifies the image and image_b in place while removing the antialiasing, they
+			// are copied one batch element at a time into scratch buffers allocated once per shard. The
+			// adjoints of the shade and of the shared uv and texture are not returned and are discarded
+			vector<double> image(image_size);
+			vector<double> image_b(image_size);
+			vector<double> shade_b(batched.nb_vertices);
+			vector<double> uv_b(batched.uv_size);
+			vector<double> texture_b(batched.texture_size);
+			for (int64 b = begin; b < end; b++)
+			{
+				Scene scene = batched.get_scene(b);
+				scene.ij_b = ij_b + b * batched.nb_vertices * 2;
+				scene.colors_b = colors_b + b * batched.nb_vertices * batched.nb_colors;
+				scene.shade_b = &shade_b[0];
+				scene.uv_b = &uv_b[0];
+				scene.texture_b = &texture_b[0];
+				std::copy(image_double + b * image_size, image_double + (b + 1) * image_size, image.begin());
+				std::copy(image_b_flat.data() + b * image_size, image_b_flat.data() + (b + 1) * image_size, image_b.begin());
+				try
+				{
+					// the z_buffer is only read
+					renderScene_B(scene, &image[0], const_cast<double*>(z_buffer + b * z_buffer_size), &image_b[0], sigma);
+				}
+				catch (const char* message)
+				{
+					errors_batch[b] = message;
+				}
+			}
+		};
+		auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+		Shard(worker_threads->num_threads, worker_threads->workers, batched.batch_size, image_size * 200, work);
+		for (int64 b = 0; b < batched.batch_size; b++)
+			OP_REQUIRES(context, errors_batch[b].empty(), errors::InvalidArgument(errors_batch[b]));
+		copy_from_double<T>(ij_b_buffer, ij_b_t);
+		copy_from_double<T>(colors_b_buffer, colors_b_t);
+	}
+
+private:
+	float sigma;
+	bool clockwise;
+	bool backface_culling;
+};
+
+#define REGISTER_CPU(T) \
+	REGISTER_KERNEL_BUILDER(Name("DeodrRender2D").Device(DEVICE_CPU).TypeConstraint<T>("T"), DeodrRender2DOp<T>); \
+	REGISTER_KERNEL_BUILDER(Name("DeodrRender2DGrad").Device(DEVICE_CPU).TypeConstraint<T>("T"), DeodrRender2DGradOp<T>);
+
+REGISTER_CPU(float);
+REGISTER_CPU(double);
@@ -48,3 +48,34 @@ def cross_backward(u, v, c_b):
     v_b = np.cross(c_b, u)
     u_b = np.cross(v, c_b)
     return u_b, v_b
+
+
+def sample_row_weights(
+    height, nb_bands, band_height=1, band_probabilities=None, random_state=None
+):
+    """Sample nb_bands bands of band_height consecutive rows of an image and return the
+    weights (height,) of the rows giving an unbiased estimate of a sum over all the rows,
+    zero for the rows that are not sampled.
+
+    The bands are sampled uniformly without replacement, or with replacement according to
+    band_probabilities when given, for example proportionally to the error of each band
+    at the previous iteration for importance sampling.
+    """
+    if random_state is None:
+        random_state = np.random
+    nb_bands_total = (height + band_height - 1) // band_height
+    band_weights = np.zeros((nb_bands_total))
+    if band_probabilities is None:
+        assert nb_bands <= nb_bands_total
+        sampled = random_state.choice(nb_bands_total, nb_bands, replace=False)
+        band_weights[sampled] = nb_bands_total / nb_bands
+    else:
+        band_probabilities = np.asarray(band_probabilities, dtype=np.double)
+        assert band_probabilities.shape == (nb_bands_total,)
+        band_probabilities = band_probabilities / np.sum(band_probabilities)
+        counts = random_state.multinomial(nb_bands, band_probabilities)
+        sampled = counts > 0
+        band_weights[sampled] = counts[sampled] / (
+            nb_bands * band_probabilities[sampled]
+        )
+    return np.repeat(band_weights, band_height)[:height]
@@ -1,18 +1,86 @@
 """Implementation of triangulated meshes."""
 
+import hashlib
+import os
+
 import numpy as np
 
 from scipy import sparse
+from scipy.sparse import csgraph
 
+from . import differentiable_renderer_cython
+from .array_cache import load_arrays, save_arrays
 from .tools import cross_backward, normalize, normalize_backward
 
 
+TOPOLOGY_CACHE_VERSION = 1
+
+
+def faces_hash(faces):
+    """Hash of the content of a faces array, independent of its integer type and memory layout."""
+    faces = np.ascontiguousarray(faces, dtype=np.int64)
+    return hashlib.sha256(
+        np.array(faces.shape, dtype=np.int64).tobytes() + faces.tobytes()
+    ).hexdigest()
+
+
+def build_topology_arrays(faces, nb_vertices):
+    """Compute the edges tables, the Laplacian, L^T L and the number of connected components."""
+    adjacencies = differentiable_renderer_cython.build_mesh_adjacencies(
+        faces, nb_vertices
+    )
+    laplacian = sparse.csr_matrix(
+        (
+            adjacencies["laplacian_data"],
+            adjacencies["laplacian_indices"],
+            adjacencies["laplacian_indptr"],
+        ),
+        shape=(nb_vertices, nb_vertices),
+    )
+    laplacian_t_laplacian = (laplacian.T * laplacian).tocsr()
+    laplacian_t_laplacian.sort_indices()
+    adjacencies["ltl_indptr"] = laplacian_t_laplacian.indptr
+    adjacencies["ltl_indices"] = laplacian_t_laplacian.indices
+    adjacencies["ltl_data"] = laplacian_t_laplacian.data
+    adjacencies["nb_connected_components"] = csgraph.connected_components(
+        laplacian, directed=False, return_labels=False
+    )
+    return {name: np.asarray(value) for name, value in adjacencies.items()}
+
+
+def load_topology_arrays(faces, nb_vertices, cache_dir):
+    """Load the topology arrays from a file in cache_dir named after the hash of the faces.
+
+    The file is created if it does not exist and memory mapped on the next calls.
+    """
+    hash_value = faces_hash(faces)
+    filename = os.path.join(cache_dir, "topology_%s.deodr_cache" % hash_value)
+    metadata = {
+        "kind": "topology",
+        "version": TOPOLOGY_CACHE_VERSION,
+        "faces_hash": hash_value,
+    }
+    arrays = load_arrays(filename, metadata)
+    if arrays is None:
+        arrays = build_topology_arrays(faces, nb_vertices)
+        try:
+            os.makedirs(cache_dir, exist_ok=True)
+            save_arrays(filename, arrays, metadata)
+        except OSError:
+            pass  # the cache is only an optimization
+    return arrays
+
+
 class TriMeshAdjacencies:
     """Class that stores adjacency matrices and methods that use this adjacencies.
     Unlike the TriMesh class there are no vertices stored in this class
+
+    If cache_dir is provided, or else if the DEODR_CACHE_DIR environment variable is set,
+    the edges tables, the Laplacian and L^T L are stored in a file named after the hash of the
+    faces and reused by all the meshes with the same faces.
     """
 
-    def __init__(self, faces, clockwise=False):
+    def __init__(self, faces, clockwise=False, cache_dir=None):
         self.faces = faces
         self.nb_faces = faces.shape[0]
         self.nb_vertices = np.max(faces.flat) + 1
@@ -23,63 +91,75 @@ class TriMeshAdjacencies:
         self._vertices_faces = sparse.coo_matrix(
             (v, (i, j)), shape=(self.nb_vertices, self.nb_faces)
         )
-        id_faces = np.hstack(
-            (
-                np.arange(self.nb_faces),
-                np.arange(self.nb_faces),
-                np.arange(self.nb_faces),
-            )
-        )
         self.clockwise = clockwise
-        edges = np.vstack(
-            (self.faces[:, [0, 1]], self.faces[:, [1, 2]], self.faces[:, [2, 0]])
-        )
-
-        id_edge_tmp, edge_increase = self.id_edge(edges)
-
-        _, id_edge, unique_counts = np.unique(
-            id_edge_tmp, return_inverse=True, return_counts=True
-        )
 
-        self.nb_edges = np.max(id_edge) + 1
-
-        nb_inc = np.zeros((self.nb_edges))
-        np.add.at(nb_inc, id_edge, edge_increase)
-        nb_dec = np.zeros((self.nb_edges))
-        np.add.at(nb_dec, id_edge, ~edge_increase)
-        self.is_manifold = (
-            np.all(unique_counts <= 2) and np.all(nb_inc <= 1) and np.all(nb_dec <= 1)
-        )
-        self.is_closed = self.is_manifold and np.all(unique_counts == 2)
-
-        self.edges_faces_ones = sparse.coo_matrix(
-            (np.ones((len(id_edge))), (id_edge, id_faces)),
+        # sort based native computation of the edges, linear in memory with the number of faces
+        if cache_dir is None:
+            cache_dir = os.environ.get("DEODR_CACHE_DIR")
+        if cache_dir:
+            adjacencies = load_topology_arrays(self.faces, self.nb_vertices, cache_dir)
+            self._laplacian_t_laplacian = sparse.csr_matrix(
+                (
+                    adjacencies["ltl_data"],
+                    adjacencies["ltl_indices"],
+                    adjacencies["ltl_indptr"],
+                ),
+                shape=(self.nb_vertices, self.nb_vertices),
+            )
+            self._nb_connected_components = adjacencies[
+                "nb_connected_components"
+            ].item()
+        else:
+            adjacencies = differentiable_renderer_cython.build_mesh_adjacencies(
+                self.faces, self.nb_vertices
+            )
+            adjacencies = {
+                name: np.asarray(value) for name, value in adjacencies.items()
+            }
+            self._laplacian_t_laplacian = None
+            self._nb_connected_components = None
+        self.nb_edges = adjacencies["nb_edges"].item()
+        self.is_manifold = adjacencies["is_manifold"].item()
+        self.is_closed = adjacencies["is_closed"].item()
+        self.hasBoundaries = adjacencies["has_boundaries"].item()
+        self.edges = adjacencies["edges"]
+        self.Faces_Edges = adjacencies["faces_edges"]
+        self.edges_faces_ones = sparse.csr_matrix(
+            (np.ones(3 * self.nb_faces), (self.Faces_Edges.flatten(), j)),
             shape=(self.nb_edges, self.nb_faces),
         )
-        v = np.hstack(
+        self.Laplacian = sparse.csr_matrix(
             (
-                np.full((self.nb_faces), 0),
-                np.full((self.nb_faces), 1),
-                np.full((self.nb_faces), 2),
-            )
+                adjacencies["laplacian_data"],
+                adjacencies["laplacian_indices"],
+                adjacencies["laplacian_indptr"],
+            ),
+            shape=(self.nb_vertices, self.nb_vertices),
         )
-        self.Faces_Edges = sparse.coo_matrix(
-            (id_edge, (id_faces, v)), shape=(self.nb_faces, 3)
-        ).todense()
+        # degree_v_e(i)=j means that the vertex i appears in j edges
+        self.degree_v_e = self.Laplacian.diagonal()
         self.adjacency_vertices = (
-            (self._vertices_faces * self._vertices_faces.T) > 0
-        ) - sparse.eye(self.nb_vertices)
-        self.degree_v_e = self.adjacency_vertices.dot(
-            np.ones((self.nb_vertices))
-        )  # degree_v_e(i)=j means that the vertex i appears in j edges
-        self.Laplacian = (
             sparse.diags([self.degree_v_e], [0], (self.nb_vertices, self.nb_vertices))
-            - self.adjacency_vertices
-        )
-        self.hasBoundaries = np.any(np.sum(self.edges_faces_ones, axis=1) == 1)
+            - self.Laplacian
+        ).tocsr()
+        self.adjacency_vertices.eliminate_zeros()
         assert np.all(self.Laplacian * np.ones((self.nb_vertices)) == 0)
         self.store_backward = {}
 
+    @property
+    def laplacian_t_laplacian(self):
+        if self._laplacian_t_laplacian is None:
+            self._laplacian_t_laplacian = (self.Laplacian.T * self.Laplacian).tocsr()
+        return self._laplacian_t_laplacian
+
+    @property
+    def nb_connected_components(self):
+        if self._nb_connected_components is None:
+            self._nb_connected_components = csgraph.connected_components(
+                self.adjacency_vertices, directed=False, return_labels=False
+            )
+        return self._nb_connected_components
+
     def id_edge(self, idv):
 
         return (
@@ -140,9 +220,20 @@ class TriMeshAdjacencies:
 
 
 class TriMesh:
-    """Class that implements a triangulated mesh."""
+    """Class that implements a triangulated mesh.
+
+    cache_dir is passed to TriMeshAdjacencies to reuse the topology arrays of the
+    meshes with the same faces.
+    """
 
-    def __init__(self, faces, vertices=None, clockwise=False, compute_adjacencies=True):
+    def __init__(
+        self,
+        faces,
+        vertices=None,
+        clockwise=False,
+        compute_adjacencies=True,
+        cache_dir=None,
+    ):
         self.faces = faces
         self.nb_vertices = np.max(faces) + 1
         self.nb_faces = faces.shape[0]
@@ -151,12 +242,15 @@ class TriMesh:
         self.face_normals = None
         self.vertex_normals = None
         self.clockwise = clockwise
+        self.cache_dir = cache_dir
         self.set_vertices(vertices)
         if compute_adjacencies:
             self.compute_adjacencies()
 
     def compute_adjacencies(self):
-        self.adjacencies = TriMeshAdjacencies(self.faces, self.clockwise)
+        self.adjacencies = TriMeshAdjacencies(
+            self.faces, self.clockwise, cache_dir=self.cache_dir
+        )
         assert self.adjacencies.is_manifold
         if self.vertices is not None:
 
@@ -238,12 +332,14 @@ class ColoredTriMesh(TriMesh):
         colors=None,
         nb_colors=None,
         compute_adjacencies=True,
+        cache_dir=None,
     ):
         super(ColoredTriMesh, self).__init__(
             faces,
             vertices=vertices,
             clockwise=clockwise,
             compute_adjacencies=compute_adjacencies,
+            cache_dir=cache_dir,
         )
         self.faces_uv = faces_uv
         self.uv = uv
@@ -277,7 +373,9 @@ class ColoredTriMesh(TriMesh):
         ax.quiver(x, y, z, u, v, w, length=0.03, normalize=True, color=[0, 1, 0])
 
     @staticmethod
-    def from_trimesh(mesh, compute_adjacencies=True):  # inspired from pyrender
+    def from_trimesh(
+        mesh, compute_adjacencies=True, cache_dir=None
+    ):  # inspired from pyrender
         """Get the vertex colors, texture coordinates, and material properties
         from a :class:`~trimesh.base.Trimesh`.
         """
@@ -345,4 +443,5 @@ class ColoredTriMesh(TriMesh):
             texture=texture,
             colors=colors2,
             compute_adjacencies=compute_adjacencies,
+            cache_dir=cache_dir,
         )
@@ -0,0 +1,70 @@
+"""Fixtures shared by the tests rendering the duck scene."""
+
+import os
+
+import deodr
+from deodr.differentiable_renderer_cython import MeshTopology, Scene3DPipeline
+from deodr.examples.render_mesh import default_scene
+
+import numpy as np
+
+import pytest
+
+
+@pytest.fixture
+def make_scene():
+    """Factory of the textured duck scene seen by a 160x120 camera.
+
+    With colored=True the texture is replaced by random vertices colors.
+    """
+
+    def make(colored=False):
+        obj_file = os.path.join(deodr.data_path, "duck.obj")
+        scene, camera = default_scene(obj_file, width=160, height=120)
+        if colored:
+            scene.mesh.uv = None
+            scene.mesh.set_vertices_colors(
+                np.random.RandomState(0).rand(scene.mesh.nb_vertices, 3)
+            )
+        return scene, camera
+
+    return make
+
+
+@pytest.fixture
+def make_pipeline(make_scene):
+    """Factory of the duck scene and of a Scene3DPipeline with the same mesh, colors,
+    lights, camera and background.
+    """
+
+    def make(textured, nb_threads=0):
+        scene, camera = make_scene(colored=not textured)
+        scene.light_ambient = 0.3
+        mesh = scene.mesh
+        topology = MeshTopology(mesh.faces, mesh.nb_vertices, mesh.clockwise)
+        pipeline = Scene3DPipeline(topology, scene.sigma, nb_threads=nb_threads)
+        pipeline.set_camera(camera)
+        pipeline.set_light(scene.light_directional, scene.light_ambient)
+        pipeline.set_background(scene.background)
+        if textured:
+            pipeline.set_texture(mesh.texture, mesh.uv, mesh.faces_uv)
+        else:
+            pipeline.set_vertices_colors(mesh.vertices_colors)
+        return scene, camera, pipeline
+
+    return make
+
+
+@pytest.fixture
+def frame_scene(make_scene):
+    """The colored duck scene after a rendering, with its 2D scene fields set and
+    zero gradients, to be drawn directly by the native renderers.
+    """
+    scene, camera = make_scene(colored=True)
+    scene.render(camera)
+    scene.uv_b = np.zeros(scene.uv.shape)
+    scene.ij_b = np.zeros(scene.ij.shape)
+    scene.shade_b = np.zeros(scene.shade.shape)
+    scene.colors_b = np.zeros(scene.colors.shape)
+    scene.texture_b = np.zeros(scene.texture.shape)
+    return scene
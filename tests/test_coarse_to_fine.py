@@ -0,0 +1,66 @@
+"""Test the coarse to fine fitting with an image pyramid."""
+
+import os
+
+import deodr
+from deodr.mesh_fitter import MeshDepthFitter, downsample_camera, downsample_image
+
+import numpy as np
+
+
+def test_downsample_camera():
+    camera = deodr.Camera(
+        extrinsic=np.column_stack((np.eye(3), [0.1, -0.2, 3])),
+        intrinsic=np.array([[200, 0, 80], [0, 210, 60], [0, 0, 1]]),
+        width=160,
+        height=120,
+        distortion=[0.1, 0.01, 0.001, -0.002, 0],
+    )
+    points = np.random.RandomState(0).randn(20, 3)
+    ij, _ = camera.project_points(points)
+    for factor in [2, 3, 4]:
+        camera_low = downsample_camera(camera, factor)
+        ij_low, _ = camera_low.project_points(points)
+        assert np.allclose(ij_low, (ij - 0.5 * (factor - 1)) / factor)
+        assert camera_low.width == 160 // factor
+        assert camera_low.height == 120 // factor
+
+    image = np.random.RandomState(1).rand(7, 9, 3)
+    image_low = downsample_image(image, 2)
+    assert image_low.shape == (3, 4, 3)
+    assert np.allclose(image_low[1, 2], np.mean(image[2:4, 4:6], axis=(0, 1)))
+
+
+def test_coarse_to_fine_depth_fitting():
+    max_depth = 450
+    depth_image = np.fliplr(
+        np.fromfile(os.path.join(deodr.data_path, "depth.bin"), dtype=np.float32)
+        .reshape(240, 320)
+        .astype(np.double)
+    )
+    depth_image = depth_image[20:-20, 60:-60]
+    depth_image[depth_image == 0] = max_depth
+    depth_image = depth_image / max_depth
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    hand_fitter = MeshDepthFitter(
+        vertices, faces, np.array([0.1, 0.1, 0.1]), np.zeros(3), cregu=1000
+    )
+    hand_fitter.set_image(depth_image, focal=241, distortion=[1, 0, 0, 0, 0])
+    hand_fitter.set_max_depth(1)
+    hand_fitter.set_depth_scale(110 / max_depth)
+    hand_fitter.set_coarse_to_fine(3, min_iterations=3, max_iterations=5)
+
+    shapes = []
+    energies = []
+    for _ in range(20):
+        energy, depth, _ = hand_fitter.step()
+        shapes.append(depth.shape)
+        energies.append(energy)
+    assert shapes[0] == (50, 50)
+    assert shapes[-1] == (200, 200)
+    assert (100, 100) in shapes
+    assert energies[-1] < energies[0]
+
+    # changing the observation restores the full resolution and rebuilds the pyramid
+    hand_fitter.set_image(depth_image, focal=241, distortion=[1, 0, 0, 0, 0])
+    assert hand_fitter.scene.background.shape == (200, 200, 1)
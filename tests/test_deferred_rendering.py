@@ -0,0 +1,73 @@
+"""Test the native deferred rendering against rendering a triangle soup."""
+
+from deodr import differentiable_renderer_cython
+from deodr.differentiable_renderer import Scene2DBase
+
+import numpy as np
+
+
+def render_soup(scene, camera, attributes, faces):
+    """Render per-vertex attributes indexed by faces using a triangle soup."""
+    points_2d, depths = camera.project_points(scene.mesh.vertices)
+    nb_faces = scene.mesh.nb_faces
+    soup_faces = np.arange(3 * nb_faces, dtype=np.uint32).reshape(nb_faces, 3)
+    colors = attributes[faces].reshape(3 * nb_faces, -1)
+    nb_colors = colors.shape[1]
+    scene_2d = Scene2DBase(
+        faces=soup_faces,
+        faces_uv=soup_faces,
+        ij=points_2d[scene.mesh.faces].reshape(-1, 2),
+        depths=depths[scene.mesh.faces].reshape(-1),
+        textured=np.zeros(nb_faces, dtype=bool),
+        uv=np.zeros((3 * nb_faces, 2)),
+        shade=np.zeros(3 * nb_faces),
+        colors=colors,
+        shaded=np.zeros(nb_faces, dtype=bool),
+        edgeflags=np.zeros((nb_faces, 3), dtype=bool),
+        height=camera.height,
+        width=camera.width,
+        nb_colors=nb_colors,
+        texture=np.zeros((0, 0)),
+        background=np.zeros((camera.height, camera.width, nb_colors)),
+        clockwise=scene.mesh.clockwise,
+        backface_culling=True,
+    )
+    image = np.empty((camera.height, camera.width, nb_colors))
+    z_buffer = np.empty((camera.height, camera.width))
+    differentiable_renderer_cython.renderScene(scene_2d, 0, image, z_buffer)
+    return image
+
+
+def test_render_deferred(make_scene):
+    scene, camera = make_scene()
+    scene.sigma = 0
+    channels = scene.render_deferred(camera, barycentrics=True)
+    mesh = scene.mesh
+    face_ids = np.tile(np.arange(mesh.nb_faces)[:, None], (1, 3)).reshape(-1, 1)
+    soup_face_ids = np.arange(3 * mesh.nb_faces).reshape(-1, 3)
+    face_id = render_soup(scene, camera, face_ids, soup_face_ids)
+    # the face ids interpolated in the soup are only exact up to rounding errors
+    assert np.allclose(channels["face_id"], face_id, atol=1e-6)
+    face_ids_uint32 = scene.render_deferred(camera, face_id_uint32=True)["face_id"]
+    assert face_ids_uint32.dtype == np.uint32
+    covered = face_ids_uint32[:, :, 0] != differentiable_renderer_cython.GBUFFER_NO_FACE
+    assert np.array_equal(face_ids_uint32[covered], channels["face_id"][covered])
+    assert np.all(channels["face_id"][~covered] == 0)
+
+    references = {
+        "normal": (mesh.vertex_normals, mesh.faces),
+        "xyz": (mesh.vertices, mesh.faces),
+        "uv": (mesh.uv, mesh.faces_uv),
+    }
+    for name, (attributes, faces) in references.items():
+        reference = render_soup(scene, camera, attributes, faces)
+        assert np.allclose(channels[name][covered], reference[covered], atol=1e-8)
+
+    _, depths = camera.project_points(mesh.vertices)
+    depth = render_soup(scene, camera, depths[:, None], mesh.faces)
+    assert np.allclose(channels["depth"][covered], depth[covered], atol=1e-8)
+    assert np.all(channels["depth"][~covered] == depths.max())
+
+    barycentrics = channels["barycentrics"][covered]
+    assert np.allclose(np.sum(barycentrics, axis=1), 1)
+    assert np.all(barycentrics > -1e-8)
@@ -24,7 +24,7 @@ def test_depth_image_hand_fitting_numpy():
         save_images=False,
         max_iter=50,
     )
-    assert abs(energies[49] - 253.03801111458935) < 1e-5
+    assert abs(energies[49] - 251.31650557093997) < 1e-5
 
 
 def test_depth_image_hand_fitting_tensorflow():
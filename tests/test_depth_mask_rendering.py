@@ -0,0 +1,66 @@
+"""Test the depth and mask kernels against rendering them as colors."""
+
+import numpy as np
+
+import pytest
+
+
+def test_render_depth(make_scene):
+    scene, camera = make_scene()
+    scene.set_background(np.full((camera.height, camera.width, 1), 10.0))
+    depth_scale = 0.5
+    depth_b = np.random.RandomState(0).randn(camera.height, camera.width, 1)
+
+    depth = scene.render_depth(camera, camera.height, camera.width, depth_scale)
+    scene.render_depth_backward(depth_b)
+    vertices_b = scene.mesh.vertices_b
+
+    scene.native_rendering = False
+    depth_ref = scene.render_depth(camera, camera.height, camera.width, depth_scale)
+    scene.clear_gradients()
+    scene.render_depth_backward(depth_b)
+
+    assert depth.shape == depth_ref.shape
+    assert np.max(np.abs(depth - depth_ref)) < 1e-10
+    assert np.allclose(vertices_b, scene.mesh.vertices_b, rtol=1e-8, atol=1e-8)
+
+
+def test_render_mask(make_scene):
+    scene, camera = make_scene()
+    mask_b = np.random.RandomState(0).randn(camera.height, camera.width)
+
+    mask = scene.render_mask(camera)
+    scene.render_mask_backward(mask_b)
+    vertices_b = scene.mesh.vertices_b
+    assert np.any((mask > 0) & (mask < 1))  # antialiased silhouette
+
+    # render the mask as a white mesh on a black background
+    scene.mesh.uv = None
+    scene.mesh.set_vertices_colors(np.ones((scene.mesh.nb_vertices, 1)))
+    scene.set_light(light_directional=None, light_ambient=1)
+    scene.set_background(np.zeros((camera.height, camera.width, 1)))
+    mask_ref = scene.render(camera)
+    scene.clear_gradients()
+    scene.render_backward(mask_b[:, :, None])
+
+    assert np.max(np.abs(mask - mask_ref[:, :, 0])) < 1e-10
+    assert np.allclose(vertices_b, scene.mesh.vertices_b, rtol=1e-6, atol=1e-6)
+
+
+def test_native_rendering_flag(make_scene):
+    # the subclasses that differentiate _render_2d with their framework cannot use the
+    # methods calling the native renderers directly
+    scene, camera = make_scene()
+    scene.native_rendering = False
+    for render in [
+        lambda: scene.render_mask(camera),
+        lambda: scene.render_with_depth_and_mask(camera),
+        lambda: scene.render_error_rows(
+            camera, np.zeros((camera.height, camera.width, 3)), np.ones(camera.height)
+        ),
+        lambda: scene.render_tiled(camera, 32, 32),
+        lambda: scene.render_meshes(camera, [scene.mesh]),
+        lambda: scene.render(camera, roi=(0, 0, 32, 32)),
+    ]:
+        with pytest.raises(AssertionError):
+            render()
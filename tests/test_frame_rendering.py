@@ -0,0 +1,83 @@
+"""Test rendering a scene by batches against rendering it at once."""
+
+import copy
+
+from deodr import differentiable_renderer_cython
+
+import numpy as np
+
+
+def split_scene(scene, nb_batches):
+    batches = []
+    for faces_ids in np.array_split(np.arange(scene.faces.shape[0]), nb_batches):
+        batch = copy.copy(scene)
+        batch.faces = scene.faces[faces_ids]
+        batch.faces_uv = scene.faces_uv[faces_ids]
+        batch.edgeflags = scene.edgeflags[faces_ids]
+        batch.textured = scene.textured[faces_ids]
+        batch.shaded = scene.shaded[faces_ids]
+        batches.append(batch)
+    return batches
+
+
+def test_frame_rendering(frame_scene):
+    scene = frame_scene
+    image_b = np.random.RandomState(1).randn(scene.height, scene.width, 3)
+    image = np.zeros((scene.height, scene.width, 3))
+    z_buffer = np.zeros((scene.height, scene.width))
+    differentiable_renderer_cython.renderScene(
+        scene, scene.sigma, image, z_buffer, False, None, None
+    )
+    differentiable_renderer_cython.renderSceneB(
+        scene, scene.sigma, image.copy(), z_buffer, image_b.copy()
+    )
+
+    batches = split_scene(scene, 3)
+    renderer = differentiable_renderer_cython.FrameRenderer(scene.sigma)
+    renderer.begin_frame(scene.background)
+    for batch in batches:
+        renderer.draw_batch(batch)
+    image_frame, z_buffer_frame = renderer.end_frame()
+    renderer.backward(image_b)
+
+    assert np.allclose(image_frame, image, atol=1e-8)
+    assert np.allclose(z_buffer_frame, z_buffer)
+    ij_b = sum(batch.ij_b for batch in batches)
+    colors_b = sum(batch.colors_b for batch in batches)
+    assert np.allclose(ij_b, scene.ij_b, rtol=1e-6, atol=1e-8)
+    assert np.allclose(colors_b, scene.colors_b, rtol=1e-6, atol=1e-8)
+
+
+def test_frame_rendering_error(frame_scene):
+    scene = frame_scene
+    obs = np.random.RandomState(2).rand(scene.height, scene.width, 3)
+    err_buffer_b = np.random.RandomState(3).rand(scene.height, scene.width)
+    image = np.zeros((scene.height, scene.width, 3))
+    z_buffer = np.zeros((scene.height, scene.width))
+    err_buffer = np.zeros((scene.height, scene.width))
+    differentiable_renderer_cython.renderScene(
+        scene, scene.sigma, image, z_buffer, True, obs, err_buffer
+    )
+    differentiable_renderer_cython.renderSceneB(
+        scene,
+        scene.sigma,
+        image,
+        z_buffer,
+        None,
+        True,
+        obs,
+        err_buffer.copy(),
+        err_buffer_b.copy(),
+    )
+
+    batches = split_scene(scene, 2)
+    renderer = differentiable_renderer_cython.FrameRenderer(scene.sigma)
+    renderer.begin_frame(scene.background)
+    for batch in batches:
+        renderer.draw_batch(batch)
+    _, _, err_buffer_frame = renderer.end_frame(obs)
+    renderer.backward(err_buffer_b=err_buffer_b)
+
+    assert np.allclose(err_buffer_frame, err_buffer, atol=1e-8)
+    ij_b = sum(batch.ij_b for batch in batches)
+    assert np.allclose(ij_b, scene.ij_b, rtol=1e-6, atol=1e-8)
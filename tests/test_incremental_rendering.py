@@ -0,0 +1,48 @@
+"""Test the incremental rendering against full renderings."""
+
+import copy
+
+from deodr import differentiable_renderer_cython
+
+import numpy as np
+
+
+def test_incremental_rendering(frame_scene):
+    scene = frame_scene
+    renderer = differentiable_renderer_cython.IncrementalRenderer(scene.sigma)
+    renderer.render(scene)
+
+    random = np.random.RandomState(4)
+    for _ in range(3):
+        changed_vertices = random.choice(scene.ij.shape[0], 2, replace=False)
+        scene = copy.copy(scene)
+        scene.ij = scene.ij.copy()
+        scene.depths = scene.depths.copy()
+        scene.colors = scene.colors.copy()
+        scene.ij[changed_vertices] += random.randn(2, 2)
+        scene.depths[changed_vertices] *= 1.01
+        scene.colors[changed_vertices] = random.rand(2, 3)
+        x0, y0, width, height = renderer.update(scene, changed_vertices)
+        assert width * height < 0.5 * scene.width * scene.height
+
+        reference = differentiable_renderer_cython.IncrementalRenderer(scene.sigma)
+        image, z_buffer, face_ids = reference.render(scene)
+        assert np.allclose(renderer.image, image, atol=1e-8)
+        assert np.allclose(renderer.z_buffer, z_buffer)
+        assert np.array_equal(renderer.face_ids, face_ids)
+
+    image = np.zeros_like(image)
+    differentiable_renderer_cython.renderScene(
+        scene, scene.sigma, image, np.zeros_like(z_buffer), False, None, None
+    )
+    assert np.allclose(renderer.image, image, atol=1e-8)
+    face_ids_gbuffer, _, _ = differentiable_renderer_cython.render_gbuffer(
+        scene.faces,
+        scene.ij,
+        scene.depths,
+        scene.height,
+        scene.width,
+        scene.clockwise,
+        scene.backface_culling,
+    )
+    assert np.array_equal(renderer.face_ids, face_ids_gbuffer)
@@ -0,0 +1,109 @@
+"""Test the instanced rendering against the rendering of the concatenated instances."""
+
+from deodr.differentiable_renderer_cython import MeshTopology, Scene3DPipeline
+from deodr.tools import normalize, normalize_backward, qrot, qrot_backward
+
+import numpy as np
+
+import pytest
+
+
+def test_instanced_rendering(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=False)
+    mesh = scene.mesh
+    vertices = mesh.vertices.copy()
+    nb_instances = 3
+    random = np.random.RandomState(5)
+    quaternions = np.array([0, 0, 0, 1.0]) + 0.1 * random.randn(nb_instances, 4)
+    extent = np.ptp(vertices, axis=0)
+    translations = np.array([[-0.3, 0, 0.1], [0, 0.1, 0], [0.3, 0, -0.1]]) * extent
+    scales = np.array([0.8, 1.0, 1.1])
+    offsets = 0.01 * extent * random.randn(nb_instances, mesh.nb_vertices, 3)
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+
+    image, loss = pipeline.render_instances(
+        vertices, quaternions, translations, scales, offsets, obs
+    )
+    gradients = pipeline.render_instances_backward()
+
+    # reference rendering of the instances concatenated in a single mesh
+    faces = np.vstack([mesh.faces + n * mesh.nb_vertices for n in range(nb_instances)])
+    topology = MeshTopology(faces, nb_instances * mesh.nb_vertices, mesh.clockwise)
+    pipeline_ref = Scene3DPipeline(topology, scene.sigma)
+    pipeline_ref.set_camera(camera)
+    pipeline_ref.set_light(scene.light_directional, scene.light_ambient)
+    pipeline_ref.set_background(scene.background)
+    pipeline_ref.set_vertices_colors(np.tile(mesh.vertices_colors, (nb_instances, 1)))
+    instances_vertices = [
+        qrot(normalize(quaternions[n]), scales[n] * vertices + offsets[n])
+        + translations[n]
+        for n in range(nb_instances)
+    ]
+    image_ref, loss_ref = pipeline_ref.render(np.vstack(instances_vertices), obs=obs)
+    gradients_ref = pipeline_ref.render_backward()
+
+    assert np.max(np.abs(image - image_ref)) < 1e-10
+    assert abs(loss - loss_ref) < 1e-8
+    world_b = gradients_ref["vertices"].reshape(nb_instances, mesh.nb_vertices, 3)
+    vertices_b = np.zeros_like(vertices)
+    for n in range(nb_instances):
+        q_normalized = normalize(quaternions[n])
+        q_normalized_b, offsets_b = qrot_backward(
+            q_normalized, scales[n] * vertices + offsets[n], world_b[n]
+        )
+        vertices_b += scales[n] * offsets_b
+        assert np.allclose(gradients["offsets"][n], offsets_b, atol=1e-8)
+        assert np.allclose(gradients["scales"][n], np.sum(vertices * offsets_b))
+        assert np.allclose(gradients["translations"][n], np.sum(world_b[n], axis=0))
+        assert np.allclose(
+            gradients["quaternions"][n],
+            normalize_backward(quaternions[n], q_normalized_b),
+        )
+    assert np.allclose(gradients["vertices"], vertices_b, atol=1e-8)
+    assert np.allclose(gradients["light_ambient"], gradients_ref["light_ambient"])
+    assert np.allclose(
+        gradients["light_directional"], gradients_ref["light_directional"]
+    )
+    assert np.allclose(
+        gradients["vertices_colors"],
+        np.sum(gradients_ref["vertices_colors"].reshape(nb_instances, -1, 3), axis=0),
+    )
+
+
+def test_instanced_rendering_textured(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=True)
+    mesh = scene.mesh
+    vertices = mesh.vertices.copy()
+    nb_instances = 2
+    extent = np.ptp(vertices, axis=0)
+    translations = np.array([[-0.2, 0, 0.1], [0.2, 0, -0.1]]) * extent
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+
+    with pytest.raises(RuntimeError):  # render_backward before render
+        pipeline.render_instances_backward()
+    image, loss = pipeline.render_instances(
+        vertices, translations=translations, obs=obs
+    )
+    gradients = pipeline.render_instances_backward()
+
+    faces = np.vstack([mesh.faces + n * mesh.nb_vertices for n in range(nb_instances)])
+    topology = MeshTopology(faces, nb_instances * mesh.nb_vertices, mesh.clockwise)
+    pipeline_ref = Scene3DPipeline(topology, scene.sigma)
+    pipeline_ref.set_camera(camera)
+    pipeline_ref.set_light(scene.light_directional, scene.light_ambient)
+    pipeline_ref.set_background(scene.background)
+    pipeline_ref.set_texture(
+        mesh.texture, mesh.uv, np.tile(mesh.faces_uv, (nb_instances, 1))
+    )
+    instances_vertices = np.vstack([vertices + t for t in translations])
+    image_ref, loss_ref = pipeline_ref.render(instances_vertices, obs=obs)
+    gradients_ref = pipeline_ref.render_backward()
+
+    assert np.max(np.abs(image - image_ref)) < 1e-10
+    assert abs(loss - loss_ref) < 1e-8
+    assert np.allclose(
+        gradients["vertices"],
+        np.sum(gradients_ref["vertices"].reshape(nb_instances, -1, 3), axis=0),
+        atol=1e-8,
+    )
+    assert np.allclose(gradients["texture"], gradients_ref["texture"], atol=1e-8)
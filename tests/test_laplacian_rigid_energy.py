@@ -0,0 +1,78 @@
+"""Test the native laplacian rigid energy against scipy."""
+
+import os
+
+import deodr
+from deodr import LaplacianRigidEnergy, TriMesh
+from deodr.mesh_fitter import MeshDepthFitter
+
+import numpy as np
+
+import scipy.sparse
+import scipy.sparse.linalg
+
+
+def test_laplacian_rigid_energy():
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    mesh = TriMesh(faces)
+    cregu = 1000
+    rigid_energy = LaplacianRigidEnergy(mesh, vertices, cregu)
+    vertices_deformed = vertices + 0.01 * np.random.RandomState(0).randn(
+        *vertices.shape
+    )
+
+    energy, grad = rigid_energy.evaluate(vertices_deformed, return_hessian=False)
+    diff = (vertices_deformed - vertices).flatten()
+    grad_ref = cregu * (rigid_energy.cT * diff)
+    assert np.allclose(grad.flatten(), grad_ref, rtol=1e-10, atol=1e-12)
+    assert np.allclose(energy, 0.5 * diff.dot(grad_ref), rtol=1e-10)
+
+    regularization = 1.0
+    hessian = rigid_energy.approx_hessian + regularization * scipy.sparse.eye(diff.size)
+    for _ in range(2):  # the second solve reuses the factorization
+        x = rigid_energy.solve(grad, regularization)
+        x_ref = scipy.sparse.linalg.spsolve(hessian.tocsc(), grad.flatten())
+        assert np.allclose(x.flatten(), x_ref, rtol=1e-6, atol=1e-10)
+
+    # the native energy follows the changes of cregu and of the reference vertices
+    rigid_energy.cregu = 2 * cregu
+    rigid_energy.vertices_ref = vertices_deformed
+    energy, grad = rigid_energy.evaluate(vertices, return_hessian=False)
+    assert np.allclose(grad.flatten(), -2 * grad_ref, rtol=1e-10, atol=1e-12)
+    # same regularization, the factorization is updated as cregu changed
+    x = rigid_energy.solve(grad, regularization)
+    x_ref = scipy.sparse.linalg.spsolve(
+        (
+            rigid_energy.approx_hessian + regularization * scipy.sparse.eye(diff.size)
+        ).tocsc(),
+        grad.flatten(),
+    )
+    assert np.allclose(x.flatten(), x_ref, rtol=1e-6, atol=1e-10)
+
+
+def test_preconditioned_depth_fitting():
+    depth_image = np.fliplr(
+        np.fromfile(os.path.join(deodr.data_path, "depth.bin"), dtype=np.float32)
+        .reshape(240, 320)
+        .astype(np.float64)
+    )
+    depth_image = depth_image[20:-20, 60:-60]
+    max_depth = 450
+    depth_image[depth_image == 0] = max_depth
+    depth_image = depth_image / max_depth
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+
+    energies = {}
+    for regularization in [None, 1000]:
+        hand_fitter = MeshDepthFitter(
+            vertices, faces, np.array([0.1, 0.1, 0.1]), np.zeros(3), cregu=1000
+        )
+        hand_fitter.set_image(depth_image, focal=241, distortion=[1, 0, 0, 0, 0])
+        hand_fitter.set_max_depth(1)
+        hand_fitter.set_depth_scale(110 / max_depth)
+        hand_fitter.preconditioning_regularization = regularization
+        for _ in range(50):
+            energy, _, _ = hand_fitter.step()
+        energies[regularization] = energy
+    # the steps preconditioned by the rigid energy hessian converge faster
+    assert energies[1000] < 0.9 * energies[None]
@@ -0,0 +1,84 @@
+"""Test the native mesh adjacencies against a scipy implementation."""
+
+import os
+
+import deodr
+from deodr.triangulated_mesh import ColoredTriMesh, TriMesh, TriMeshAdjacencies
+
+import numpy as np
+
+from scipy import sparse
+
+
+def adjacencies_reference(faces):
+    nb_faces = faces.shape[0]
+    nb_vertices = np.max(faces) + 1
+    vertices_faces = sparse.coo_matrix(
+        (np.ones(3 * nb_faces), (faces.flatten(), np.repeat(np.arange(nb_faces), 3))),
+        shape=(nb_vertices, nb_faces),
+    )
+    edges = np.vstack((faces[:, [0, 1]], faces[:, [1, 2]], faces[:, [2, 0]]))
+    id_edge_tmp = np.minimum(edges[:, 0], edges[:, 1]).astype(
+        np.int64
+    ) * nb_vertices + np.maximum(edges[:, 0], edges[:, 1])
+    _, id_edge, unique_counts = np.unique(
+        id_edge_tmp, return_inverse=True, return_counts=True
+    )
+    faces_edges = id_edge.reshape(3, nb_faces).T
+    adjacency = ((vertices_faces * vertices_faces.T) > 0) - sparse.eye(nb_vertices)
+    laplacian = (
+        sparse.diags([adjacency.dot(np.ones(nb_vertices))], [0]) - adjacency
+    ).toarray()
+    return faces_edges, unique_counts, laplacian
+
+
+def test_mesh_adjacencies():
+    faces, _ = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    adjacencies = TriMeshAdjacencies(faces)
+    faces_edges, unique_counts, laplacian = adjacencies_reference(faces)
+    assert np.array_equal(adjacencies.Faces_Edges, faces_edges)
+    assert adjacencies.nb_edges == len(unique_counts)
+    assert np.array_equal(adjacencies.Laplacian.toarray(), laplacian)
+    assert adjacencies.is_manifold
+    assert adjacencies.is_closed == np.all(unique_counts == 2)
+    assert adjacencies.hasBoundaries == np.any(unique_counts == 1)
+
+    # three faces sharing an edge
+    adjacencies = TriMeshAdjacencies(np.array([[0, 1, 2], [1, 0, 3], [0, 1, 4]]))
+    assert not adjacencies.is_manifold
+    assert not adjacencies.is_closed
+    assert adjacencies.hasBoundaries
+
+
+def test_mesh_adjacencies_cache(tmp_path):
+    faces, _ = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    cache_dir = str(tmp_path)
+    reference = TriMeshAdjacencies(faces)
+    adjacencies = TriMeshAdjacencies(faces, cache_dir=cache_dir)
+    assert len(os.listdir(cache_dir)) == 1
+    # the hash does not depend on the integer type of the faces
+    cached = TriMeshAdjacencies(faces.astype(np.int64), cache_dir=cache_dir)
+    assert len(os.listdir(cache_dir)) == 1
+    for mesh_adjacencies in [adjacencies, cached]:
+        assert np.array_equal(mesh_adjacencies.Faces_Edges, reference.Faces_Edges)
+        assert (mesh_adjacencies.Laplacian != reference.Laplacian).nnz == 0
+        assert (
+            mesh_adjacencies.laplacian_t_laplacian != reference.laplacian_t_laplacian
+        ).nnz == 0
+        assert mesh_adjacencies.nb_connected_components == 1
+        assert mesh_adjacencies.nb_edges == reference.nb_edges
+        assert mesh_adjacencies.is_manifold == reference.is_manifold
+        assert mesh_adjacencies.is_closed == reference.is_closed
+    assert isinstance(cached.Faces_Edges.base, np.memmap)
+
+
+def test_mesh_cache_dir(tmp_path):
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    cache_dir = str(tmp_path)
+    mesh = ColoredTriMesh(
+        faces, vertices, colors=np.ones((vertices.shape[0], 3)), cache_dir=cache_dir
+    )
+    assert len(os.listdir(cache_dir)) == 1
+    cached = TriMesh(faces, vertices, cache_dir=cache_dir)
+    assert isinstance(cached.adjacencies.Faces_Edges.base, np.memmap)
+    assert np.array_equal(cached.adjacencies.Faces_Edges, mesh.adjacencies.Faces_Edges)
@@ -0,0 +1,123 @@
+"""Test rendering several meshes against rendering them merged in a single mesh."""
+
+from deodr.triangulated_mesh import ColoredTriMesh
+
+import numpy as np
+
+import pytest
+
+
+def test_multi_mesh_rendering(make_scene):
+    scene, camera = make_scene()
+    duck = scene.mesh
+    random = np.random.RandomState(0)
+    shift = np.array([0.3, 0, -0.2]) * np.ptp(duck.vertices, axis=0)
+    meshes = [
+        ColoredTriMesh(
+            duck.faces,
+            duck.vertices + n * shift,
+            clockwise=duck.clockwise,
+            colors=random.rand(duck.nb_vertices, 3),
+        )
+        for n in range(2)
+    ]
+    merged = ColoredTriMesh(
+        np.vstack([duck.faces + n * duck.nb_vertices for n in range(2)]),
+        np.vstack([mesh.vertices for mesh in meshes]),
+        clockwise=duck.clockwise,
+        colors=np.vstack([mesh.vertices_colors for mesh in meshes]),
+    )
+    image_b = random.randn(camera.height, camera.width, 3)
+
+    scene.set_mesh(merged)
+    image_ref = scene.render(camera)
+    scene.clear_gradients()
+    scene.render_backward(image_b.copy())  # modified in place by the adjoint
+    light_directional_b = scene.light_directional_b
+    light_ambient_b = scene.light_ambient_b
+
+    image = scene.render_meshes(camera, meshes)
+    scene.render_meshes_backward(image_b)
+
+    assert np.allclose(image, image_ref, atol=1e-8)
+    for n, mesh in enumerate(meshes):
+        vertices_ids = slice(n * duck.nb_vertices, (n + 1) * duck.nb_vertices)
+        assert np.allclose(
+            mesh.vertices_b, merged.vertices_b[vertices_ids], rtol=1e-6, atol=1e-8
+        )
+        assert np.allclose(
+            mesh.vertices_colors_b,
+            merged.vertices_colors_b[vertices_ids],
+            rtol=1e-6,
+            atol=1e-8,
+        )
+    assert np.allclose(scene.light_directional_b, light_directional_b)
+    assert np.allclose(scene.light_ambient_b, light_ambient_b)
+
+
+def test_multi_mesh_rendering_textured(make_scene):
+    # the python Scene3D does not backpropagate to textures, use finite differences
+    scene, camera = make_scene()
+    mesh = scene.mesh
+    image_ref = scene.render(camera)
+    image = scene.render_meshes(camera, [mesh])
+    assert np.allclose(image, image_ref, atol=1e-8)
+
+    random = np.random.RandomState(1)
+    image_b = random.randn(*image.shape)
+    scene.render_meshes_backward(image_b)
+    direction = random.randn(*mesh.texture.shape)
+    epsilon = 1e-6
+    texture = mesh.texture
+    mesh.texture = texture + epsilon * direction
+    image_shifted = scene.render_meshes(camera, [mesh])
+    mesh.texture = texture
+    finite_difference = np.sum((image_shifted - image) * image_b) / epsilon
+    assert np.allclose(finite_difference, np.sum(mesh.texture_b * direction), rtol=1e-4)
+
+
+def test_multi_mesh_rendering_mixed(make_scene):
+    # a textured and a colored mesh that do not overlap in the image, each mesh gets
+    # the gradients it would get when rendered alone
+    scene, camera = make_scene()
+    duck = scene.mesh
+    random = np.random.RandomState(2)
+    shift = np.array([1.2, 0, 0]) * np.ptp(duck.vertices, axis=0)
+    colored = ColoredTriMesh(
+        duck.faces,
+        duck.vertices + shift,
+        clockwise=duck.clockwise,
+        colors=random.rand(duck.nb_vertices, 3),
+    )
+    image_b = random.randn(camera.height, camera.width, 3)
+    background = scene.background
+
+    image_textured = scene.render_meshes(camera, [duck])
+    scene.render_meshes_backward(image_b)
+    texture_b = duck.texture_b
+    textured_vertices_b = duck.vertices_b
+    scene.set_mesh(colored)
+    image_colored = scene.render(camera)
+    scene.clear_gradients()
+    scene.render_backward(image_b.copy())  # modified in place by the adjoint
+    colored_vertices_b = colored.vertices_b
+    colors_b = colored.vertices_colors_b
+    scene.set_mesh(duck)
+
+    image = scene.render_meshes(camera, [duck, colored])
+    scene.render_meshes_backward(image_b)
+
+    assert scene.mesh is duck
+    assert np.allclose(image, image_textured + image_colored - background, atol=1e-8)
+    assert np.allclose(duck.texture_b, texture_b, atol=1e-8)
+    assert np.allclose(duck.vertices_b, textured_vertices_b, atol=1e-8)
+    assert np.allclose(colored.vertices_b, colored_vertices_b, atol=1e-8)
+    assert np.allclose(colored.vertices_colors_b, colors_b, atol=1e-8)
+
+
+def test_multi_mesh_rendering_restores_mesh(make_scene):
+    scene, camera = make_scene()
+    duck = scene.mesh
+    with pytest.raises(AttributeError):
+        scene.render_meshes(camera, [duck, None])
+    assert scene.mesh is duck
@@ -0,0 +1,53 @@
+"""Test rendering the colors, the depth and the mask in a single pass."""
+
+import numpy as np
+
+
+def test_render_with_depth_and_mask(make_scene):
+    scene, camera = make_scene()
+    scene.mesh.uv = None
+    scene.mesh.set_vertices_colors(
+        np.random.RandomState(0).rand(scene.mesh.nb_vertices, 3)
+    )
+    background = scene.background
+    random = np.random.RandomState(1)
+    image_b = random.randn(camera.height, camera.width, 3)
+    depth_b = random.randn(camera.height, camera.width, 1)
+    mask_b = random.randn(camera.height, camera.width)
+    depth_scale = 0.5
+    depth_background = 10.0
+
+    image, depth, mask = scene.render_with_depth_and_mask(
+        camera, depth_scale=depth_scale, depth_background=depth_background
+    )
+    scene.render_with_depth_and_mask_backward(image_b, depth_b, mask_b)
+    vertices_b = scene.mesh.vertices_b
+    vertices_colors_b = scene.mesh.vertices_colors_b
+
+    image_ref = scene.render(camera)
+    scene.clear_gradients()
+    scene.render_backward(image_b)
+    vertices_b_ref = scene.mesh.vertices_b
+    vertices_colors_b_ref = scene.mesh.vertices_colors_b
+
+    scene.set_background(np.full((camera.height, camera.width, 1), depth_background))
+    depth_ref = scene.render_depth(camera, camera.height, camera.width, depth_scale)
+    scene.render_depth_backward(depth_b)
+    vertices_b_ref = vertices_b_ref + scene.mesh.vertices_b
+    scene.set_background(background)
+
+    mask_ref = scene.render_mask(camera)
+    scene.render_mask_backward(mask_b)
+    vertices_b_mask = scene.mesh.vertices_b
+    vertices_b_ref = vertices_b_ref + vertices_b_mask
+
+    assert np.max(np.abs(image - image_ref)) < 1e-10
+    assert np.max(np.abs(depth - depth_ref)) < 1e-10
+    assert np.max(np.abs(mask - mask_ref)) < 1e-10
+    assert np.allclose(vertices_b, vertices_b_ref, rtol=1e-8, atol=1e-8)
+    assert np.allclose(vertices_colors_b, vertices_colors_b_ref)
+
+    # adjoints of the outputs that are not used can be omitted
+    scene.render_with_depth_and_mask(camera, depth_scale, depth_background)
+    scene.render_with_depth_and_mask_backward(mask_b=mask_b)
+    assert np.allclose(scene.mesh.vertices_b, vertices_b_mask)
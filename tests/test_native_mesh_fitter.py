@@ -0,0 +1,79 @@
+"""Test the native fitter loop against the python step methods."""
+
+import copy
+import os
+
+import deodr
+from deodr.mesh_fitter import MeshDepthFitter, MeshRGBFitterWithPose
+
+from imageio import imread
+
+import numpy as np
+
+
+def depth_fitter():
+    max_depth = 450
+    depth_image = np.fliplr(
+        np.fromfile(os.path.join(deodr.data_path, "depth.bin"), dtype=np.float32)
+        .reshape(240, 320)
+        .astype(np.double)
+    )
+    depth_image = depth_image[20:-20, 60:-60]
+    depth_image[depth_image == 0] = max_depth
+    depth_image = depth_image / max_depth
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    hand_fitter = MeshDepthFitter(
+        vertices, faces, np.array([0.1, 0.1, 0.1]), np.zeros(3), cregu=1000
+    )
+    hand_fitter.set_image(depth_image, focal=241, distortion=[1, 0, 0, 0, 0])
+    hand_fitter.set_max_depth(1)
+    hand_fitter.set_depth_scale(110 / max_depth)
+    return hand_fitter
+
+
+def rgb_fitter():
+    hand_image = (
+        imread(os.path.join(deodr.data_path, "hand.png")).astype(np.double) / 255
+    )
+    faces, vertices = deodr.read_obj(os.path.join(deodr.data_path, "hand.obj"))
+    translation_init = np.mean(vertices, axis=0)
+    vertices = vertices - translation_init[None, :]
+    hand_fitter = MeshRGBFitterWithPose(
+        vertices,
+        faces,
+        default_color=np.array([0.4, 0.3, 0.25]),
+        default_light={
+            "directional": -np.array([0.1, 0.5, 0.4]),
+            "ambient": np.array([0.6]),
+        },
+        euler_init=np.array([0, 0, 0]),
+        translation_init=translation_init,
+        cregu=1000,
+    )
+    hand_fitter.reset()
+    hand_fitter.set_image(hand_image, distortion=[-1, 0, 0, 0, 0])
+    hand_fitter.set_background_color(np.array([0.5, 0.6, 0.7]))
+    return hand_fitter
+
+
+def check_native_steps(hand_fitter, rtol, atol, nb_iterations=20):
+    hand_fitter_native = copy.deepcopy(hand_fitter)
+    energies = [hand_fitter.step()[0] for _ in range(nb_iterations)]
+    energies_native = np.hstack(
+        (
+            hand_fitter_native.steps_native(nb_iterations // 2),
+            hand_fitter_native.steps_native(nb_iterations - nb_iterations // 2),
+        )
+    )
+    assert np.allclose(energies_native, energies, rtol=rtol)
+    assert np.allclose(hand_fitter_native.vertices, hand_fitter.vertices, atol=atol)
+    assert hand_fitter_native.iter == hand_fitter.iter
+
+
+def test_native_depth_fitter():
+    check_native_steps(depth_fitter(), rtol=1e-8, atol=1e-8)
+
+
+def test_native_rgb_fitter():
+    # rounding differences get amplified along the iterations when fitting colors
+    check_native_steps(rgb_fitter(), rtol=1e-4, atol=1e-2)
@@ -0,0 +1,114 @@
+"""Test the clipping of the faces against the near plane in the native Scene3D pipeline."""
+
+from deodr.differentiable_renderer import Camera
+from deodr.differentiable_renderer_cython import MeshTopology, Scene3DPipeline
+
+import numpy as np
+
+
+def test_near_plane_clipping_coverage():
+    # a large floor below the camera, extending behind it, whose faces all cross the near plane
+    height, width = 120, 160
+    intrinsic = np.array([[100, 0, 80], [0, 100, 60], [0, 0, 1.0]])
+    extrinsic = np.column_stack((np.eye(3), np.zeros(3)))
+    camera = Camera(extrinsic, intrinsic, height, width)
+    size = 1000
+    vertices = np.array(
+        [[-size, 1, -size], [size, 1, -size], [size, 1, size], [-size, 1, size]],
+        dtype=np.float64,
+    )
+    faces = np.array([[0, 1, 2], [0, 2, 3]], dtype=np.uint32)
+    pipeline = Scene3DPipeline(MeshTopology(faces, 4), sigma=0)
+    pipeline.set_camera(camera)
+    pipeline.set_light(None, 1.0)
+    pipeline.set_background(np.zeros((height, width, 3)))
+    pipeline.set_vertices_colors(np.ones((4, 3)))
+    pipeline.set_near_plane(3)
+    image, _ = pipeline.render(vertices, backface_culling=False)
+
+    # the rays of the rows 61 to 93 hit the floor at depths between 3 and size
+    expected = np.zeros((height, width))
+    expected[61:94] = 1
+    assert np.array_equal(image[:, :, 0], expected)
+
+
+def test_near_plane_clipping_triangle_gradients():
+    # a triangle with one vertex behind the near plane, cut into two triangles
+    height, width = 60, 80
+    intrinsic = np.array([[50, 0, 40], [0, 50, 30], [0, 0, 1.0]])
+    extrinsic = np.column_stack((np.eye(3), np.zeros(3)))
+    camera = Camera(extrinsic, intrinsic, height, width)
+    vertices = np.array([[-0.53, -0.41, 2.07], [0.61, -0.33, 2.46], [0.13, 0.52, 0.47]])
+    faces = np.array([[0, 2, 1]], dtype=np.uint32)
+    obs = np.random.RandomState(0).rand(height, width, 3)
+    for sigma in [0, 1]:
+        pipeline = Scene3DPipeline(MeshTopology(faces, 3), sigma=sigma)
+        pipeline.set_camera(camera)
+        pipeline.set_light(None, 1.0)
+        pipeline.set_background(np.zeros((height, width, 3)))
+        pipeline.set_vertices_colors(np.eye(3))
+        pipeline.set_near_plane(1)
+        _, loss = pipeline.render(vertices, obs=obs)
+        vertices_b = pipeline.render_backward()["vertices"]
+        epsilon = 1e-7
+        for v in range(3):
+            for i in range(3):
+                vertices_shifted = vertices.copy()
+                vertices_shifted[v, i] += epsilon
+                _, loss_shifted = pipeline.render(vertices_shifted, obs=obs)
+                finite_difference = (loss_shifted - loss) / epsilon
+                assert np.allclose(finite_difference, vertices_b[v, i], rtol=1e-4)
+
+
+def test_near_plane_clipping_mesh(make_pipeline):
+    for textured in [False, True]:
+        scene, camera, pipeline = make_pipeline(textured)
+        vertices = scene.mesh.vertices.copy()
+        depths = vertices.dot(camera.extrinsic[2, :3]) + camera.extrinsic[2, 3]
+        near_plane = np.median(depths)
+        obs = np.full((camera.height, camera.width, 3), 0.5)
+
+        pipeline.set_near_plane(0)
+        image, _ = pipeline.render(vertices, obs=obs)
+        nb_pixels = np.sum(np.any(image != scene.background, axis=2))
+        pipeline.set_near_plane(near_plane)
+        image, loss = pipeline.render(vertices, obs=obs)
+        nb_pixels_clipped = np.sum(np.any(image != scene.background, axis=2))
+        assert 0 < nb_pixels_clipped < nb_pixels
+
+        # gradient with respect to the vertices behind the plane
+        vertices_b = pipeline.render_backward()["vertices"]
+        direction = np.random.RandomState(2).randn(*vertices.shape)
+        direction *= 0.01 * np.ptp(vertices) * (depths < near_plane)[:, None]
+        epsilon = 1e-6
+        _, loss_shifted = pipeline.render(vertices + epsilon * direction, obs=obs)
+        finite_difference = (loss_shifted - loss) / epsilon
+        assert np.allclose(finite_difference, np.sum(vertices_b * direction), rtol=1e-3)
+
+
+def test_near_plane_clipping_depth(make_pipeline):
+    scene, camera, _ = make_pipeline(textured=False)
+    mesh = scene.mesh
+    vertices = mesh.vertices.copy()
+    depths = vertices.dot(camera.extrinsic[2, :3]) + camera.extrinsic[2, 3]
+    near_plane = np.median(depths)
+    depth_scale = 0.1
+    pipeline = Scene3DPipeline(
+        MeshTopology(mesh.faces, mesh.nb_vertices, mesh.clockwise)
+    )
+    pipeline.set_camera(camera)
+    pipeline.set_render_depth(True, depth_scale)
+    pipeline.set_background(np.full((camera.height, camera.width, 1), 10.0))
+    pipeline.set_near_plane(near_plane)
+    obs = np.ones((camera.height, camera.width, 1))
+
+    image, loss = pipeline.render(vertices, obs=obs)
+    assert np.min(image) > near_plane * depth_scale - 1e-10
+    vertices_b = pipeline.render_backward()["vertices"]
+    direction = (
+        np.random.RandomState(3).randn(*vertices.shape) * 0.01 * np.ptp(vertices)
+    )
+    epsilon = 1e-6
+    _, loss_shifted = pipeline.render(vertices + epsilon * direction, obs=obs)
+    finite_difference = (loss_shifted - loss) / epsilon
+    assert np.allclose(finite_difference, np.sum(vertices_b * direction), rtol=1e-3)
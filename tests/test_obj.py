@@ -0,0 +1,73 @@
+"""Test the native OBJ loader and its binary cache."""
+
+import os
+import shutil
+
+import deodr
+from deodr import load_obj, read_obj
+from deodr.obj import obj_cache_filename
+
+import numpy as np
+
+
+def test_read_obj_keywords(tmp_path):
+    filename = str(tmp_path / "quad.obj")
+    with open(filename, "w") as f:
+        f.write(
+            "# comment\n"
+            "v 0 0 0 1 0 0\n"
+            "v 1 0 0 0 1 0\n"
+            "v 1 1 0 0 0 1\n"
+            "v 0 1 \\\n0 1 1 1\n"
+            "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+            "f -4/-4/-1 -2/-2/-1 -1/-1/-1\n"
+        )
+    mesh = load_obj(filename)
+    assert np.array_equal(
+        mesh["vertices"], [[0, 0, 0], [1, 0, 0], [1, 1, 0], [0, 1, 0]]
+    )
+    assert np.array_equal(mesh["vertices_colors"][3], [1, 1, 1])
+    assert np.array_equal(mesh["faces"], [[0, 1, 2], [0, 2, 3], [0, 2, 3]])
+    assert np.array_equal(mesh["faces_uv"], mesh["faces"])
+    assert np.array_equal(mesh["faces_normals"], np.zeros((3, 3)))
+    assert mesh["uv"].shape == (4, 2)
+    faces, vertices = read_obj(filename)
+    assert vertices.shape == (4, 6)
+
+
+def test_read_obj_crlf_and_comments(tmp_path):
+    filename = str(tmp_path / "triangle.obj")
+    with open(filename, "wb") as f:
+        f.write(
+            b"v 0 0 0 # first vertex\r\n"
+            b"v 1 0 0\t\r\n"
+            b"v 1 1 0 \r\n"
+            b"f 1 2 3 # triangle\r\n"
+            b"f 3 2 1"
+            b"\r"
+        )
+    mesh = load_obj(filename)
+    assert np.array_equal(mesh["vertices"], [[0, 0, 0], [1, 0, 0], [1, 1, 0]])
+    assert np.array_equal(mesh["faces"], [[0, 1, 2], [2, 1, 0]])
+
+
+def test_read_obj_cache(tmp_path):
+    filename = str(tmp_path / "hand.obj")
+    shutil.copy(os.path.join(deodr.data_path, "hand.obj"), filename)
+    faces, vertices = read_obj(filename)
+    lines = [line.split() for line in open(filename)]
+    vertices_ref = np.array([line[1:] for line in lines if line[:1] == ["v"]], float)
+    faces_ref = np.array([line[1:] for line in lines if line[:1] == ["f"]], int) - 1
+    assert np.array_equal(vertices, vertices_ref)
+    assert np.array_equal(faces, faces_ref)
+
+    faces_cached, vertices_cached = read_obj(filename, cache=True)
+    assert os.path.isfile(obj_cache_filename(filename))
+    faces_cached, vertices_cached = read_obj(filename, cache=True)
+    assert isinstance(vertices_cached.base, np.memmap)
+    assert np.array_equal(vertices_cached, vertices)
+    assert np.array_equal(faces_cached, faces)
+    vertices_cached[0] = 0  # copy on write, the cache file is not modified
+    assert np.array_equal(read_obj(filename, cache=True)[1], vertices)
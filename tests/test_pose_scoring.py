@@ -0,0 +1,62 @@
+"""Test the scoring of many candidate poses against individual renderings."""
+
+import numpy as np
+
+
+def random_poses(nb_poses):
+    random = np.random.RandomState(1)
+    quaternions = np.column_stack((0.2 * random.randn(nb_poses, 3), np.ones(nb_poses)))
+    translations = 0.05 * random.randn(nb_poses, 3)
+    return quaternions, translations
+
+
+def test_score_poses(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=False)
+    vertices = scene.mesh.vertices.copy()
+    quaternions, translations = random_poses(13)
+    obs, _ = pipeline.render(vertices, quaternions[0], translations[0])
+    obs = obs.copy()
+
+    losses = pipeline.score_poses(quaternions, translations, obs)
+    losses_ref = [
+        pipeline.render(vertices, q, t, obs)[1]
+        for q, t in zip(quaternions, translations)
+    ]
+    assert losses[0] == 0
+    assert np.allclose(losses, losses_ref, rtol=1e-12)
+
+    vertices_poses = vertices[None] + 0.01 * np.random.RandomState(2).randn(
+        5, *vertices.shape
+    )
+    pipeline.render(vertices)  # the poses are now given by the vertices only
+    losses = pipeline.score_poses(vertices=vertices_poses, obs=obs)
+    losses_ref = [pipeline.render(v, obs=obs)[1] for v in vertices_poses]
+    assert np.allclose(losses, losses_ref, rtol=1e-12)
+
+
+def test_score_poses_downsampled(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=False, nb_threads=2)
+    vertices = scene.mesh.vertices.copy()
+    quaternions, translations = random_poses(4)
+    obs = np.random.RandomState(3).rand(camera.height, camera.width, 3)
+    pipeline.render(vertices, quaternions[0], translations[0])
+    losses = pipeline.score_poses(quaternions, translations, obs, downsample=2)
+
+    def downsample(image):
+        height, width, nb_colors = image.shape
+        return image.reshape(height // 2, 2, width // 2, 2, nb_colors).mean(axis=(1, 3))
+
+    camera.intrinsic = camera.intrinsic.copy()
+    camera.intrinsic[:2] /= 2
+    camera.intrinsic[:2, 2] -= 0.25
+    camera.height //= 2
+    camera.width //= 2
+    pipeline_low = make_pipeline(textured=False)[2]
+    pipeline_low.set_camera(camera)
+    pipeline_low.set_background(downsample(scene.background))
+    obs_low = downsample(obs)
+    losses_ref = [
+        pipeline_low.render(vertices, q, t, obs_low)[1]
+        for q, t in zip(quaternions, translations)
+    ]
+    assert np.allclose(losses, losses_ref, rtol=1e-12)
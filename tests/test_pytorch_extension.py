@@ -0,0 +1,62 @@
+"""Test the batched C++ torch extension against the cython renderer."""
+
+import os
+
+import deodr
+from deodr.examples.render_mesh import default_scene
+
+import numpy as np
+
+
+def test_render_2d_batch_pytorch():
+    import torch
+
+    from deodr.pytorch import render_2d_batch
+
+    obj_file = os.path.join(deodr.data_path, "duck.obj")
+    scene, camera = default_scene(obj_file, width=160, height=120)
+    scene.mesh.uv = None
+    random = np.random.RandomState(0)
+    images = []
+    ij = []
+    colors = []
+    depths = []
+    edgeflags = []
+    for _ in range(2):
+        scene.mesh.set_vertices_colors(random.rand(scene.mesh.nb_vertices, 3))
+        images.append(scene.render(camera))
+        ij.append(scene.ij)
+        colors.append(scene.colors)
+        depths.append(scene.depths)
+        edgeflags.append(scene.edgeflags)
+
+    for dtype, tolerance in [(torch.float64, 1e-10), (torch.float32, 1e-5)]:
+        colors_torch = torch.tensor(np.array(colors), dtype=dtype, requires_grad=True)
+        ij_torch = torch.tensor(np.array(ij), dtype=dtype, requires_grad=True)
+        image, _ = render_2d_batch(
+            ij_torch,
+            colors_torch,
+            torch.tensor(np.array(depths), dtype=dtype),
+            torch.tensor(scene.faces.astype(np.int32)),
+            torch.tensor(scene.background, dtype=dtype),
+            edgeflags=torch.tensor(np.array(edgeflags)),
+            sigma=scene.sigma,
+            clockwise=scene.mesh.clockwise,
+        )
+        assert image.dtype == dtype
+        assert np.max(np.abs(image.detach().numpy() - np.array(images))) < tolerance
+
+        # the gradient of the last batch element matches the cython adjoint
+        image_b = random.rand(*image.shape[1:])
+        image_b_batch = np.zeros(image.shape)
+        image_b_batch[1] = image_b
+        image.backward(torch.tensor(image_b_batch, dtype=dtype))
+        scene.clear_gradients()
+        scene.render_backward(image_b)
+        assert np.allclose(
+            ij_torch.grad[1].numpy(), scene.ij_b, rtol=1e-4, atol=tolerance
+        )
+        assert np.allclose(
+            colors_torch.grad[1].numpy(), scene.colors_b, rtol=1e-4, atol=tolerance
+        )
+        assert np.all(colors_torch.grad[0].numpy() == 0)
@@ -0,0 +1,40 @@
+"""Test rendering a region of interest against cropping the full image."""
+
+import numpy as np
+
+
+ROI = (50, 30, 45, 37)
+
+
+def test_roi_rendering(make_scene):
+    scene, camera = make_scene()
+    scene.mesh.uv = None
+    scene.mesh.set_vertices_colors(
+        np.random.RandomState(0).rand(scene.mesh.nb_vertices, 3)
+    )
+    x0, y0, width, height = roi = ROI
+    image_b = np.random.RandomState(1).randn(height, width, 3)
+
+    image = scene.render(camera, roi=roi)
+    scene.clear_gradients()
+    scene.render_backward(image_b)
+    vertices_b = scene.mesh.vertices_b
+
+    image_full = scene.render(camera)
+    image_b_full = np.zeros_like(image_full)
+    image_b_full[y0 : y0 + height, x0 : x0 + width] = image_b
+    scene.clear_gradients()
+    scene.render_backward(image_b_full)
+
+    assert image.shape == (height, width, 3)
+    assert np.allclose(image, image_full[y0 : y0 + height, x0 : x0 + width], atol=1e-8)
+    assert np.allclose(vertices_b, scene.mesh.vertices_b, rtol=1e-6, atol=1e-8)
+
+
+def test_roi_rendering_textured(make_scene):
+    # the python Scene3D does not backpropagate to textures, only the image is checked
+    scene, camera = make_scene()
+    x0, y0, width, height = ROI
+    image = scene.render(camera, roi=ROI)
+    image_full = scene.render(camera)
+    assert np.allclose(image, image_full[y0 : y0 + height, x0 : x0 + width], atol=1e-8)
@@ -0,0 +1,74 @@
+"""Test the evaluation of the antialiased error on a subset of the rows."""
+
+from deodr import differentiable_renderer_cython
+from deodr.tools import sample_row_weights
+
+import numpy as np
+
+
+def test_render_error_rows(make_scene):
+    scene, camera = make_scene()
+    scene.mesh.uv = None
+    scene.mesh.set_vertices_colors(
+        np.random.RandomState(0).rand(scene.mesh.nb_vertices, 3)
+    )
+    obs = np.random.RandomState(1).rand(camera.height, camera.width, 3)
+    row_weights = sample_row_weights(
+        camera.height, 5, band_height=4, random_state=np.random.RandomState(2)
+    )
+
+    loss, err_buffer = scene.render_error_rows(camera, obs, row_weights)
+    scene.render_error_rows_backward()
+    ij_b = scene.ij_b
+
+    # reference using the full image error rendering
+    image_full = np.zeros((camera.height, camera.width, 3))
+    z_buffer_full = np.zeros((camera.height, camera.width))
+    err_buffer_full = np.zeros((camera.height, camera.width))
+    differentiable_renderer_cython.renderScene(
+        scene, scene.sigma, image_full, z_buffer_full, True, obs, err_buffer_full
+    )
+    sampled = row_weights > 0
+    assert np.allclose(err_buffer[sampled], err_buffer_full[sampled], atol=1e-10)
+    assert np.all(err_buffer[~sampled] == 0)
+    assert np.allclose(loss, np.sum(row_weights[:, None] * err_buffer_full))
+
+    scene.ij_b = np.zeros_like(scene.ij_b)
+    scene.colors_b = np.zeros_like(scene.colors_b)
+    scene.uv_b = np.zeros_like(scene.uv)
+    scene.shade_b = np.zeros_like(scene.shade)
+    scene.texture_b = np.zeros_like(scene.texture)
+    err_buffer_b = np.tile(row_weights[:, None], (1, camera.width))
+    differentiable_renderer_cython.renderSceneB(
+        scene,
+        scene.sigma,
+        image_full,
+        z_buffer_full,
+        None,
+        True,
+        obs,
+        err_buffer_full,
+        err_buffer_b,
+    )
+    assert np.allclose(ij_b, scene.ij_b, rtol=1e-6, atol=1e-8)
+
+
+def test_sample_row_weights_unbiased():
+    random_state = np.random.RandomState(3)
+    height = 50
+    probabilities = random_state.rand(25) + 0.1
+    for band_probabilities in [None, probabilities]:
+        mean_weights = np.mean(
+            [
+                sample_row_weights(
+                    height,
+                    4,
+                    band_height=2,
+                    band_probabilities=band_probabilities,
+                    random_state=random_state,
+                )
+                for _ in range(20000)
+            ],
+            axis=0,
+        )
+        assert np.allclose(mean_weights, 1, atol=0.1)
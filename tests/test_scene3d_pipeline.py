@@ -0,0 +1,163 @@
+"""Test the native Scene3D pipeline against the python implementation."""
+
+from deodr.differentiable_renderer_cython import LinearBasis, SkinningWeights
+from deodr.tools import normalize, normalize_backward, qrot, qrot_backward
+
+import numpy as np
+
+
+def render_python(scene, camera, vertices, quaternion, translation, obs):
+    q_normalized = normalize(quaternion)
+    scene.mesh.set_vertices(qrot(q_normalized, vertices) + translation)
+    image = scene.render(camera)
+    loss = np.sum((image - obs) ** 2)
+    scene.clear_gradients()
+    scene.render_backward(2 * (image - obs))
+    q_normalized_b, vertices_b = qrot_backward(
+        q_normalized, vertices, scene.mesh.vertices_b
+    )
+    gradients = {
+        "vertices": vertices_b,
+        "quaternion": normalize_backward(quaternion, q_normalized_b),
+        "translation": np.sum(scene.mesh.vertices_b, axis=0),
+        "light_directional": scene.light_directional_b,
+        "light_ambient": scene.light_ambient_b,
+        "vertices_colors": scene.mesh.vertices_colors_b,
+    }
+    return image, loss, gradients
+
+
+def test_scene3d_pipeline(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=False)
+    vertices = scene.mesh.vertices.copy()
+    quaternion = np.array([0.05, -0.1, 0.02, 1.0])
+    translation = np.array([0.01, -0.02, 0.03])
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+
+    image, loss, gradients = render_python(
+        scene, camera, vertices, quaternion, translation, obs
+    )
+
+    for _ in range(2):  # check that buffers are correctly reused
+        image_native, loss_native = pipeline.render(
+            vertices, quaternion, translation, obs
+        )
+        gradients_native = pipeline.render_backward()
+
+        assert np.max(np.abs(image_native - image)) < 1e-10
+        assert abs(loss_native - loss) < 1e-8
+        for name, grad in gradients.items():
+            assert np.allclose(gradients_native[name], grad, rtol=1e-6, atol=1e-8)
+
+
+def test_scene3d_pipeline_textured(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=True)
+    vertices = scene.mesh.vertices.copy()
+    image = scene.render(camera)
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+    translation = np.zeros(3)
+    image_native, loss = pipeline.render(vertices, None, translation, obs)
+    assert np.max(np.abs(image_native - image)) < 1e-10
+
+    # the python implementation does not support texture gradients, use finite differences
+    gradients = pipeline.render_backward()
+    epsilon = 1e-6
+    direction = np.array([0.3, -0.5, 0.2])
+    _, loss_shifted = pipeline.render(vertices, None, epsilon * direction, obs)
+    finite_difference = (loss_shifted - loss) / epsilon
+    assert np.allclose(
+        finite_difference, gradients["translation"].dot(direction), rtol=1e-2
+    )
+
+
+def test_scene3d_pipeline_skinning(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=False)
+    vertices = scene.mesh.vertices.copy()
+    nb_bones = 3
+    random = np.random.RandomState(1)
+    weights = random.rand(vertices.shape[0], nb_bones)
+    weights[weights < 0.3] = 0
+    weights[:, 0] += 0.1
+    weights = weights / np.sum(weights, axis=1, keepdims=True)
+    bone_transforms = np.tile(np.eye(3, 4), (nb_bones, 1, 1))
+    bone_transforms += 0.01 * random.randn(nb_bones, 3, 4)
+    pipeline.set_skinning(SkinningWeights.from_dense(weights))
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+
+    vertices_bones = (
+        np.einsum("bij,vj->vbi", bone_transforms[:, :, :3], vertices)
+        + bone_transforms[None, :, :, 3]
+    )
+    vertices_skinned = np.sum(weights[:, :, None] * vertices_bones, axis=1)
+    quaternion = np.array([0.05, -0.1, 0.02, 1.0])
+    translation = np.array([0.01, -0.02, 0.03])
+    image, loss, gradients = render_python(
+        scene, camera, vertices_skinned, quaternion, translation, obs
+    )
+    weighted_b = weights[:, :, None] * gradients["vertices"][:, None, :]
+    bone_transforms_b = np.concatenate(
+        (
+            np.einsum("vbi,vj->bij", weighted_b, vertices),
+            np.sum(weighted_b, axis=0)[:, :, None],
+        ),
+        axis=2,
+    )
+    vertices_b = np.einsum("vbi,bij->vj", weighted_b, bone_transforms[:, :, :3])
+
+    image_native, loss_native = pipeline.render(
+        vertices, quaternion, translation, obs=obs, bone_transforms=bone_transforms
+    )
+    gradients_native = pipeline.render_backward()
+    assert np.max(np.abs(image_native - image)) < 1e-10
+    assert abs(loss_native - loss) < 1e-8
+    assert np.allclose(gradients_native["bone_transforms"], bone_transforms_b)
+    assert np.allclose(gradients_native["vertices"], vertices_b)
+    assert np.allclose(gradients_native["quaternion"], gradients["quaternion"])
+    assert np.allclose(gradients_native["translation"], gradients["translation"])
+
+
+def test_scene3d_pipeline_linear_basis(make_pipeline):
+    scene, camera, pipeline = make_pipeline(textured=True)
+    mesh = scene.mesh
+    random = np.random.RandomState(2)
+    nb_components = 5
+    shape_basis = 0.01 * random.randn(nb_components, mesh.nb_vertices * 3)
+    texture_basis = 0.1 * random.randn(nb_components, mesh.texture.size)
+    pipeline.set_shape_basis(LinearBasis(shape_basis, mesh.vertices, block_size=100))
+    pipeline.set_texture_basis(
+        LinearBasis(texture_basis, mesh.texture),
+        mesh.texture.shape,
+        mesh.uv,
+        mesh.faces_uv,
+    )
+    shape_coefficients = random.randn(nb_components)
+    texture_coefficients = random.randn(nb_components)
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+    image, loss = pipeline.render(
+        shape_coefficients=shape_coefficients,
+        texture_coefficients=texture_coefficients,
+        obs=obs,
+    )
+    gradients = pipeline.render_backward()
+
+    pipeline.set_shape_basis(None)
+    pipeline.set_texture_basis(None, None, mesh.uv, mesh.faces_uv)
+    vertices = mesh.vertices + shape_coefficients.dot(shape_basis).reshape(-1, 3)
+    texture = mesh.texture + texture_coefficients.dot(texture_basis).reshape(
+        mesh.texture.shape
+    )
+    pipeline.set_texture(texture, mesh.uv, mesh.faces_uv)
+    image_ref, loss_ref = pipeline.render(vertices, obs=obs)
+    gradients_ref = pipeline.render_backward()
+    # the basis are stored in float32 and the vertices are only approximately equal
+    assert np.max(np.abs(image_ref - image)) < 1e-4
+    assert np.allclose(
+        gradients["shape_coefficients"],
+        shape_basis.dot(gradients_ref["vertices"].flatten()),
+        rtol=1e-2,
+    )
+    assert np.allclose(
+        gradients["texture_coefficients"],
+        texture_basis.dot(gradients_ref["texture"].flatten()),
+        rtol=1e-2,
+    )
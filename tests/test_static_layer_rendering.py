@@ -0,0 +1,47 @@
+"""Test rendering a dynamic scene over a cached static scene."""
+
+import copy
+
+from deodr import differentiable_renderer_cython
+
+import numpy as np
+
+
+def setup_scenes(static_scene):
+    # a smaller copy of the scene that intersects the static one
+    dynamic_scene = copy.copy(static_scene)
+    center = np.mean(static_scene.ij, axis=0)
+    dynamic_scene.ij = 0.3 * (static_scene.ij - center) + center + [10, 5]
+    dynamic_scene.depths = static_scene.depths - 0.3 * np.ptp(static_scene.depths)
+    dynamic_scene.colors = static_scene.colors[:, ::-1].copy()
+    return static_scene, dynamic_scene
+
+
+def test_static_layer_rendering(frame_scene):
+    static_scene, dynamic_scene = setup_scenes(frame_scene)
+    sigma = static_scene.sigma
+    image_b = np.random.RandomState(1).randn(*static_scene.background.shape)
+
+    renderer = differentiable_renderer_cython.FrameRenderer(sigma)
+    renderer.begin_frame(static_scene.background)
+    renderer.draw_batch(copy.copy(static_scene))
+    renderer.draw_batch(dynamic_scene)
+    image, z_buffer = renderer.end_frame()
+    renderer.backward(image_b)
+    ij_b = dynamic_scene.ij_b
+    colors_b = dynamic_scene.colors_b
+
+    static_renderer = differentiable_renderer_cython.StaticLayerRenderer(
+        static_scene, sigma
+    )
+    for _ in range(2):  # check that the cache is reused correctly
+        dynamic_scene = copy.copy(dynamic_scene)
+        image_static, z_buffer_static = static_renderer.render(dynamic_scene)
+        static_renderer.backward(image_b)
+        assert np.allclose(image_static, image, atol=1e-8)
+        assert np.allclose(z_buffer_static, z_buffer)
+        assert np.allclose(dynamic_scene.ij_b, ij_b, rtol=1e-6, atol=1e-8)
+        assert np.allclose(dynamic_scene.colors_b, colors_b, rtol=1e-6, atol=1e-8)
+
+    x0, y0, width, height = static_renderer.roi
+    assert width * height < 0.5 * static_scene.width * static_scene.height
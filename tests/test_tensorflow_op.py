@@ -0,0 +1,160 @@
+"""Test the batched tensorflow custom op and its gradient op."""
+
+import os
+
+import deodr
+from deodr.examples.render_mesh import default_scene
+
+import numpy as np
+
+import pytest
+
+
+def make_batch(nb_elements=2):
+    obj_file = os.path.join(deodr.data_path, "duck.obj")
+    scene, camera = default_scene(obj_file, width=160, height=120)
+    scene.mesh.uv = None
+    random = np.random.RandomState(0)
+    batch = {"images": [], "ij": [], "colors": [], "depths": [], "edgeflags": []}
+    for _ in range(nb_elements):
+        scene.mesh.set_vertices_colors(random.rand(scene.mesh.nb_vertices, 3))
+        batch["images"].append(scene.render(camera))
+        batch["ij"].append(scene.ij)
+        batch["colors"].append(scene.colors)
+        batch["depths"].append(scene.depths)
+        batch["edgeflags"].append(scene.edgeflags)
+    return scene, camera, {key: np.array(value) for key, value in batch.items()}
+
+
+def test_tensorflow_op_shape_inference():
+    import tensorflow as tf
+
+    from deodr.tensorflow import render_2d_batch
+
+    scene, _, batch = make_batch()
+    height, width, nb_colors = scene.background.shape
+    nb_vertices = batch["ij"].shape[1]
+    nb_faces = scene.faces.shape[0]
+
+    # the batch size is unknown when tracing, the other sizes come from the background
+    @tf.function(
+        input_signature=[
+            tf.TensorSpec([None, nb_vertices, 2], tf.float64),
+            tf.TensorSpec([None, nb_vertices, nb_colors], tf.float64),
+            tf.TensorSpec([None, nb_vertices], tf.float64),
+            tf.TensorSpec([None, nb_faces, 3], tf.bool),
+        ]
+    )
+    def render(ij, colors, depths, edgeflags):
+        with tf.GradientTape() as tape:
+            tape.watch((ij, colors))
+            image, z_buffer = render_2d_batch(
+                ij,
+                colors,
+                depths,
+                scene.faces,
+                scene.background,
+                edgeflags=edgeflags,
+                sigma=scene.sigma,
+                clockwise=scene.mesh.clockwise,
+            )
+            loss = tf.reduce_sum(image)
+        ij_b, colors_b = tape.gradient(loss, (ij, colors))
+        return image, z_buffer, ij_b, colors_b
+
+    image, z_buffer, ij_b, colors_b = render.get_concrete_function().outputs
+    assert image.shape.as_list() == [None, height, width, nb_colors]
+    assert z_buffer.shape.as_list() == [None, height, width]
+    assert ij_b.shape.as_list() == [None, nb_vertices, 2]
+    assert colors_b.shape.as_list() == [None, nb_vertices, nb_colors]
+
+    image, z_buffer, _, _ = render(
+        batch["ij"], batch["colors"], batch["depths"], batch["edgeflags"]
+    )
+    assert image.shape == batch["images"].shape
+    assert z_buffer.dtype == tf.float64
+
+
+def test_tensorflow_op_batched_background():
+    import tensorflow as tf
+
+    from deodr.tensorflow import render_2d_batch
+
+    scene, camera, batch = make_batch()
+    backgrounds = np.stack((scene.background, 1 - scene.background))
+    image, _ = render_2d_batch(
+        tf.constant(batch["ij"]),
+        tf.constant(batch["colors"]),
+        batch["depths"],
+        scene.faces,
+        backgrounds,
+        edgeflags=tf.constant(batch["edgeflags"]),
+        sigma=scene.sigma,
+        clockwise=scene.mesh.clockwise,
+    )
+    assert np.max(np.abs(image[0].numpy() - batch["images"][0])) < 1e-10
+
+    # each element is rendered over its own background
+    scene.mesh.set_vertices_colors(batch["colors"][1])
+    scene.set_background(backgrounds[1])
+    assert np.max(np.abs(image[1].numpy() - scene.render(camera))) < 1e-10
+
+
+def test_tensorflow_op_gradient():
+    import tensorflow as tf
+
+    from deodr.tensorflow import render_2d_batch
+
+    scene, _, batch = make_batch()
+    random = np.random.RandomState(1)
+    image_b = random.rand(*batch["images"].shape[1:])
+    image_b_batch = np.zeros(batch["images"].shape)
+    image_b_batch[1] = image_b
+    scene.clear_gradients()
+    scene.render_backward(image_b)
+
+    for dtype, tolerance in [(tf.float64, 1e-10), (tf.float32, 1e-5)]:
+        ij = tf.constant(batch["ij"], dtype=dtype)
+        colors = tf.constant(batch["colors"], dtype=dtype)
+        depths = tf.constant(batch["depths"], dtype=dtype)
+        with tf.GradientTape() as tape:
+            tape.watch((ij, colors, depths))
+            image, z_buffer = render_2d_batch(
+                ij,
+                colors,
+                depths,
+                scene.faces,
+                scene.background,
+                edgeflags=tf.constant(batch["edgeflags"]),
+                sigma=scene.sigma,
+                clockwise=scene.mesh.clockwise,
+            )
+            loss = tf.reduce_sum(image * tf.constant(image_b_batch, dtype=dtype))
+        ij_b, colors_b, depths_b = tape.gradient(loss, (ij, colors, depths))
+        assert image.dtype == dtype
+        assert np.max(np.abs(image.numpy() - batch["images"])) < tolerance
+        assert np.allclose(ij_b[1].numpy(), scene.ij_b, rtol=1e-4, atol=tolerance)
+        assert np.allclose(
+            colors_b[1].numpy(), scene.colors_b, rtol=1e-4, atol=tolerance
+        )
+        # the gradient op only propagates to ij and colors, per batch element
+        assert np.all(colors_b[0].numpy() == 0)
+        assert depths_b is None
+
+
+def test_tensorflow_op_invalid_faces():
+    import tensorflow as tf
+
+    from deodr.tensorflow import render_2d_batch
+
+    scene, _, batch = make_batch(nb_elements=1)
+    faces = scene.faces.copy()
+    faces[0, 0] = batch["ij"].shape[1]
+    with pytest.raises(tf.errors.InvalidArgumentError):
+        render_2d_batch(
+            tf.constant(batch["ij"]),
+            tf.constant(batch["colors"]),
+            batch["depths"],
+            faces,
+            scene.background,
+        )
@@ -0,0 +1,28 @@
+"""Test the gradient of the native pipeline with respect to the texture against finite differences."""
+
+from deodr.differentiable_renderer_cython import MeshTopology, Scene3DPipeline
+
+import numpy as np
+
+
+def test_texture_gradient(make_scene):
+    # each texel is sampled by several pixels, whose contributions should all be accumulated
+    scene, camera = make_scene()
+    mesh = scene.mesh
+    pipeline = Scene3DPipeline(
+        MeshTopology(mesh.faces, mesh.nb_vertices, mesh.clockwise), scene.sigma
+    )
+    pipeline.set_camera(camera)
+    pipeline.set_light(scene.light_directional, scene.light_ambient)
+    pipeline.set_background(scene.background)
+    pipeline.set_texture(mesh.texture, mesh.uv, mesh.faces_uv)
+    obs = np.full((camera.height, camera.width, 3), 0.5)
+
+    _, loss = pipeline.render(mesh.vertices, obs=obs)
+    texture_b = pipeline.render_backward()["texture"]
+    direction = np.random.RandomState(0).randn(*mesh.texture.shape)
+    epsilon = 1e-6
+    pipeline.set_texture(mesh.texture + epsilon * direction, mesh.uv, mesh.faces_uv)
+    _, loss_shifted = pipeline.render(mesh.vertices, obs=obs)
+    finite_difference = (loss_shifted - loss) / epsilon
+    assert np.allclose(finite_difference, np.sum(texture_b * direction), rtol=1e-4)
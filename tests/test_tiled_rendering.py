@@ -0,0 +1,65 @@
+"""Test rendering the image tile by tile against the full image."""
+
+import os
+import tempfile
+
+from deodr.differentiable_renderer import Scene2D
+
+import numpy as np
+
+
+def test_tiled_rendering(make_scene):
+    scene, camera = make_scene()
+    image_full, z_buffer_full = scene.render(camera, return_z_buffer=True)
+
+    tiles = []
+    image = scene.render_tiled(
+        camera,
+        tile_height=50,
+        tile_width=64,
+        callback=lambda x0, y0, image, z_buffer: tiles.append((x0, y0, z_buffer)),
+        output=np.zeros_like(image_full),
+    )
+    assert np.allclose(image, image_full, atol=1e-8)
+    assert len(tiles) == 9
+    for x0, y0, z_buffer in tiles:
+        height, width = z_buffer.shape
+        assert np.allclose(
+            z_buffer, z_buffer_full[y0 : y0 + height, x0 : x0 + width], atol=1e-8
+        )
+
+    with tempfile.TemporaryDirectory() as folder:
+        output = np.lib.format.open_memmap(
+            os.path.join(folder, "image.npy"), mode="w+", shape=image_full.shape
+        )
+        scene.render_tiled(camera, tile_height=32, tile_width=32, output=output)
+        assert np.allclose(output, image_full, atol=1e-8)
+        del output
+
+
+def test_far_vertices_rendering():
+    # vertices far outside of the image used to overflow the 16 bits pixel indices
+    ij = np.array([[-50000.0, 10.0], [70000.0, 12.0], [30.0, 90000.0], [20, 20]])
+    faces = np.array([[0, 1, 2], [0, 1, 3]], dtype=np.uint32)
+    nb_colors = 3
+    height, width = 40, 50
+    scene = Scene2D(
+        faces=faces,
+        faces_uv=faces,
+        ij=ij,
+        depths=np.array([1.0, 1.0, 1.0, 0.5]),
+        textured=np.zeros(2, dtype=np.bool),
+        uv=np.zeros((4, 2)),
+        shade=np.zeros(4),
+        colors=np.tile(np.array([[0.2], [0.5], [0.8], [1.0]]), (1, nb_colors)),
+        shaded=np.zeros(2, dtype=np.bool),
+        edgeflags=np.ones((2, 3), dtype=np.bool),
+        height=height,
+        width=width,
+        nb_colors=nb_colors,
+        texture=np.zeros((0, 0, nb_colors)),
+        background=np.zeros((height, width, nb_colors)),
+    )
+    image, z_buffer = scene.render(sigma=1)
+    assert np.all(np.isfinite(image))
+    assert np.all(z_buffer[12:, :] <= 1)